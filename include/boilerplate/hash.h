@@ -22,6 +22,7 @@
 #include <pthread.h>
 #include <boilerplate/list.h>
 
+/* Default initial number of slots, may be changed by hash_init_size(). */
 #define HASHSLOTS  (1<<8)
 
 struct hashobj {
@@ -30,6 +31,7 @@ struct hashobj {
 	char static_key[16];
 #endif
 	size_t len;
+	unsigned int hash;
 	struct holder link;
 };
 
@@ -37,8 +39,22 @@ struct hash_bucket {
 	struct listobj obj_list;
 };
 
+/*
+ * Slot arrays are allocated on first insertion, then grown or shrunk
+ * according to the load factor. Resizing is incremental: while a
+ * former array is being drained, each update moves a few of its
+ * slots over to the current one, so that no single call has to
+ * rehash the whole table.
+ */
 struct hash_table {
-	struct hash_bucket table[HASHSLOTS];
+	dref_type(struct hash_bucket *) table;
+	dref_type(struct hash_bucket *) old_table;
+	unsigned int size;
+	unsigned int old_size;
+	unsigned int migrated;
+	unsigned int init_size;
+	unsigned int count;
+	int walkers;
 	pthread_mutex_t lock;
 };
 
@@ -64,6 +80,7 @@ typedef int (*hash_walk_op)(struct hash_table *t,
 struct pvhashobj {
 	const void *key;
 	size_t len;
+	unsigned int hash;
 	struct pvholder link;
 };
 
@@ -72,7 +89,14 @@ struct pvhash_bucket {
 };
 
 struct pvhash_table {
-	struct pvhash_bucket table[HASHSLOTS];
+	struct pvhash_bucket *table;
+	struct pvhash_bucket *old_table;
+	unsigned int size;
+	unsigned int old_size;
+	unsigned int migrated;
+	unsigned int init_size;
+	unsigned int count;
+	int walkers;
 	pthread_mutex_t lock;
 };
 
@@ -100,7 +124,8 @@ extern "C" {
 unsigned int __hash_key(const void *key,
 			size_t length, unsigned int c);
 
-void __hash_init(void *heap, struct hash_table *t);
+void __hash_init_size(void *heap, struct hash_table *t,
+		      unsigned int size);
 
 int __hash_enter(struct hash_table *t,
 		 const void *key, size_t len,
@@ -108,11 +133,21 @@ int __hash_enter(struct hash_table *t,
 		 const struct hash_operations *hops,
 		 int nodup);
 
+static inline void __hash_init(void *heap, struct hash_table *t)
+{
+	__hash_init_size(heap, t, HASHSLOTS);
+}
+
 static inline void hash_init(struct hash_table *t)
 {
 	__hash_init(__main_heap, t);
 }
 
+static inline void hash_init_size(struct hash_table *t, unsigned int size)
+{
+	__hash_init_size(__main_heap, t, size);
+}
+
 void hash_destroy(struct hash_table *t);
 
 static inline int hash_enter(struct hash_table *t,
@@ -177,7 +212,14 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 				  const void *key, size_t len,
 				  const struct hash_operations *hops);
 
-void pvhash_init(struct pvhash_table *t);
+void pvhash_init_size(struct pvhash_table *t, unsigned int size);
+
+static inline void pvhash_init(struct pvhash_table *t)
+{
+	pvhash_init_size(t, HASHSLOTS);
+}
+
+void pvhash_destroy(struct pvhash_table *t);
 
 static inline
 int pvhash_enter(struct pvhash_table *t,
@@ -209,6 +251,8 @@ int pvhash_walk(struct pvhash_table *t,
 
 #else /* !CONFIG_XENO_PSHARED */
 #define pvhash_init		hash_init
+#define pvhash_init_size	hash_init_size
+#define pvhash_destroy		hash_destroy
 #define pvhash_enter		hash_enter
 #define pvhash_enter_dup	hash_enter_dup
 #define pvhash_remove		hash_remove
@@ -127,6 +127,10 @@ xnsticks_t xnclock_core_ticks_to_ns_rounded(xnsticks_t ticks);
 
 xnticks_t xnclock_core_read_monotonic(void);
 
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+xnticks_t xnclock_core_read_cycles(struct xnclock *clock);
+#endif
+
 static inline xnticks_t xnclock_core_read_raw(void)
 {
 	return pipeline_read_cycle_counter();
@@ -38,6 +38,12 @@ struct __compat_sched_rr_param {
 	struct compat_timespec __sched_rr_quantum;
 };
 
+struct __compat_sched_edf_param {
+	struct compat_timespec __sched_runtime;
+	struct compat_timespec __sched_deadline;
+	struct compat_timespec __sched_period;
+};
+
 struct compat_sched_param_ex {
 	int sched_priority;
 	union {
@@ -45,6 +51,7 @@ struct compat_sched_param_ex {
 		struct __compat_sched_rr_param rr;
 		struct __sched_tp_param tp;
 		struct __sched_quota_param quota;
+		struct __compat_sched_edf_param edf;
 	} sched_u;
 };
 
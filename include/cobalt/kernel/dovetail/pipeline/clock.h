@@ -62,6 +62,13 @@ static inline void pipeline_init_clock(void)
 	/* N/A */
 }
 
+static inline void pipeline_get_clock_mulshift(u32 *mult, u32 *shift)
+{
+	/* The core clock counts nanoseconds. */
+	*mult = 1;
+	*shift = 0;
+}
+
 static inline xnsticks_t xnclock_core_ticks_to_ns(xnsticks_t ticks)
 {
 	return ticks;
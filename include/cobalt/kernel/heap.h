@@ -78,6 +78,30 @@ struct xnheap_range {
 	size_t size;
 };
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+
+#define XNHEAP_MAG_DEPTH	CONFIG_XENO_OPT_HEAP_MAGAZINE_DEPTH
+/* Count of blocks moved at once between a magazine and its heap. */
+#define XNHEAP_MAG_BATCH	(XNHEAP_MAG_DEPTH / 2)
+
+/*
+ * A magazine caches free blocks of a single size class for a given
+ * CPU. Blocks are pushed/popped in LIFO order, so that the most
+ * recently released (i.e. cache-hot) memory is handed out first.
+ */
+struct xnheap_magazine {
+	int count;
+	void *rounds[XNHEAP_MAG_DEPTH];
+};
+
+struct xnheap_magcache {
+	struct xnheap_magazine mags[XNHEAP_MAX_BUCKETS];
+	unsigned long hits;
+	unsigned long misses;
+};
+
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
 struct xnheap {
 	void *membase;
 	struct rb_root addr_tree;
@@ -89,6 +113,12 @@ struct xnheap {
 	char name[XNOBJECT_NAME_LEN];
 	DECLARE_XNLOCK(lock);
 	struct list_head next;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+	struct xnheap_magcache __percpu *magcache;
+	/* Batch transfers from/to the magazines, under heap->lock. */
+	unsigned long mag_refills;
+	unsigned long mag_drains;
+#endif
 };
 
 extern struct xnheap cobalt_heap;
@@ -124,6 +154,15 @@ int xnheap_init(struct xnheap *heap,
 
 void xnheap_destroy(struct xnheap *heap);
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+int xnheap_enable_magazines(struct xnheap *heap);
+#else
+static inline int xnheap_enable_magazines(struct xnheap *heap)
+{
+	return 0;
+}
+#endif
+
 void *xnheap_alloc(struct xnheap *heap, size_t size);
 
 void xnheap_free(struct xnheap *heap, void *block);
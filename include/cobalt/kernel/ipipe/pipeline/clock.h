@@ -35,6 +35,8 @@ int pipeline_get_host_time(struct timespec64 *tp);
 
 void pipeline_update_clock_freq(unsigned long long freq);
 
+void pipeline_get_clock_mulshift(u32 *mult, u32 *shift);
+
 void pipeline_init_clock(void);
 
 #endif /* !_COBALT_KERNEL_IPIPE_CLOCK_H */
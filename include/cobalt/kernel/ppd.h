@@ -30,11 +30,15 @@ struct cobalt_umm {
 	void (*release)(struct cobalt_umm *umm);
 };
 
+struct rtdm_fd;
+
 struct cobalt_ppd {
 	struct cobalt_umm umm;
 	atomic_t refcnt;
 	char *exe_path;
-	struct rb_root fds;
+	/* RTDM descriptors, indexed by user fd. */
+	struct rtdm_fd **fds;
+	unsigned int nr_fds;
 };
 
 extern struct cobalt_ppd cobalt_kernel_ppd;
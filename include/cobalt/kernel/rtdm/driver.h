@@ -1016,6 +1016,9 @@ typedef void (*rtdm_task_proc_t)(void *arg);
 int rtdm_task_init(rtdm_task_t *task, const char *name,
 		   rtdm_task_proc_t task_proc, void *arg,
 		   int priority, nanosecs_rel_t period);
+int rtdm_task_init_on_cpu(rtdm_task_t *task, const char *name,
+			  rtdm_task_proc_t task_proc, void *arg,
+			  int priority, nanosecs_rel_t period, int cpu);
 int __rtdm_task_sleep(xnticks_t timeout, xntmode_t mode);
 void rtdm_task_busy_sleep(nanosecs_rel_t delay);
 
@@ -1193,6 +1196,7 @@ int rtdm_sem_down(rtdm_sem_t *sem);
 int rtdm_sem_timeddown(rtdm_sem_t *sem, nanosecs_rel_t timeout,
 		       rtdm_toseq_t *timeout_seq);
 void rtdm_sem_up(rtdm_sem_t *sem);
+void rtdm_sem_up_count(rtdm_sem_t *sem, unsigned int count);
 
 void rtdm_sem_destroy(rtdm_sem_t *sem);
 
@@ -26,6 +26,19 @@ struct class;
 struct device_node;
 struct gpio_desc;
 
+/* Chip devices handle that many lines at most. */
+#define RTDM_GPIO_CHIP_MAXLINES	256
+
+#define RTDM_GPIO_RING_SIZE	64	/* Must be a power of 2. */
+
+struct rtdm_gpio_ring {
+	rtdm_event_t event;
+	unsigned int head;
+	unsigned int tail;
+	int overrun;
+	struct rtdm_gpio_event events[RTDM_GPIO_RING_SIZE];
+};
+
 struct rtdm_gpio_pin {
 	struct rtdm_device dev;
 	struct list_head next;
@@ -34,6 +47,8 @@ struct rtdm_gpio_pin {
 	char *name;
 	struct gpio_desc *desc;
 	nanosecs_abs_t timestamp;
+	/* Edge events go there too if non-NULL, rgc->lock held. */
+	struct rtdm_gpio_ring *ring;
 };
 
 struct rtdm_gpio_chip {
@@ -42,6 +57,8 @@ struct rtdm_gpio_chip {
 	struct class *devclass;
 	struct list_head next;
 	rtdm_lock_t lock;
+	struct rtdm_driver chip_driver;
+	struct rtdm_device chip_dev;
 	struct rtdm_gpio_pin pins[0];
 };
 
@@ -0,0 +1,85 @@
+/*
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#ifndef _COBALT_KERNEL_SCHED_EDF_H
+#define _COBALT_KERNEL_SCHED_EDF_H
+
+#ifndef _COBALT_KERNEL_SCHED_H
+#error "please don't include cobalt/kernel/sched-edf.h directly"
+#endif
+
+/**
+ * @addtogroup cobalt_core_sched
+ * @{
+ */
+
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+
+#define XNSCHED_EDF_MIN_PRIO	1
+#define XNSCHED_EDF_MAX_PRIO	255
+#define XNSCHED_EDF_NR_PRIO	\
+	(XNSCHED_EDF_MAX_PRIO - XNSCHED_EDF_MIN_PRIO + 1)
+
+/* Fixed-point scale of bandwidth values (runtime / period). */
+#define XNSCHED_EDF_BW_SHIFT	20
+#define XNSCHED_EDF_BW_UNIT	(1UL << XNSCHED_EDF_BW_SHIFT)
+
+extern struct xnsched_class xnsched_class_edf;
+
+struct xnsched_edf_data {
+	/** Absolute deadline of the current reservation period. */
+	xnticks_t abs_deadline;
+	/** Runtime left in the current reservation period. */
+	xnticks_t budget;
+	/** Date the thread last started consuming its budget. */
+	xnticks_t resume_date;
+	/** Reserved bandwidth (runtime / period), in XNSCHED_EDF_BW_UNIT. */
+	unsigned long bw;
+	/** Reserved density (runtime / deadline), in XNSCHED_EDF_BW_UNIT. */
+	unsigned long density;
+	/** CPU the bandwidth is accounted to. */
+	struct xnsched *sched;
+	/** Budget timer is armed. */
+	int running;
+	/** Thread waits for its next replenishment. */
+	int throttled;
+	struct xntimer budget_timer;
+	struct xntimer repl_timer;
+	struct xnsched_edf_param param;
+	struct xnthread *thread;
+};
+
+struct xnsched_edf {
+	/** Runqueue, by increasing absolute deadline. */
+	struct list_head runnable;
+	/** Bandwidth admitted on this CPU, in XNSCHED_EDF_BW_UNIT. */
+	unsigned long bw_sum;
+};
+
+static inline int xnsched_edf_init_thread(struct xnthread *thread)
+{
+	thread->edf = NULL;
+	thread->edf_deadline = 0;
+	INIT_LIST_HEAD(&thread->edf_link);
+
+	return 0;
+}
+
+#endif /* !CONFIG_XENO_OPT_SCHED_EDF */
+
+/** @} */
+
+#endif /* !_COBALT_KERNEL_SCHED_EDF_H */
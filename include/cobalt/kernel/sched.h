@@ -27,6 +27,7 @@
 #include <cobalt/kernel/sched-weak.h>
 #include <cobalt/kernel/sched-sporadic.h>
 #include <cobalt/kernel/sched-quota.h>
+#include <cobalt/kernel/sched-edf.h>
 #include <cobalt/kernel/vfile.h>
 #include <cobalt/kernel/assert.h>
 #include <asm/xenomai/machine.h>
@@ -86,6 +87,10 @@ struct xnsched {
 #ifdef CONFIG_XENO_OPT_SCHED_QUOTA
 	/*!< Context of runtime quota scheduling. */
 	struct xnsched_quota quota;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	/*!< Context of EDF scheduling class. */
+	struct xnsched_edf edf;
 #endif
 	/*!< Interrupt nesting level. */
 	volatile unsigned inesting;
@@ -109,6 +114,17 @@ struct xnsched {
 	/*!< Currently active account */
 	xnstat_exectime_t *current_account;
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_BALANCE
+	/*!< Load balancing state. */
+	struct {
+		/*!< Date of last load sample (ticks). */
+		xnticks_t last_date;
+		/*!< Root thread execution time at last sample (ticks). */
+		xnticks_t last_idle;
+		/*!< Average real-time load (per mille). */
+		int load;
+	} balance;
+#endif
 };
 
 DECLARE_PER_CPU(struct xnsched, nksched);
@@ -383,6 +399,10 @@ void xnsched_migrate(struct xnthread *thread,
 void xnsched_migrate_passive(struct xnthread *thread,
 			     struct xnsched *sched);
 
+#ifdef CONFIG_XENO_OPT_SCHED_BALANCE
+int xnsched_balance_target(struct xnthread *thread, int cpu);
+#endif
+
 /**
  * @fn void xnsched_rotate(struct xnsched *sched, struct xnsched_class *sched_class, const union xnsched_policy_param *sched_param)
  * @brief Rotate a scheduler runqueue.
@@ -434,6 +454,11 @@ static inline int xnsched_init_thread(struct xnthread *thread)
 	if (ret)
 		return ret;
 #endif /* CONFIG_XENO_OPT_SCHED_QUOTA */
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	ret = xnsched_edf_init_thread(thread);
+	if (ret)
+		return ret;
+#endif /* CONFIG_XENO_OPT_SCHED_EDF */
 
 	return ret;
 }
@@ -50,6 +50,30 @@
 struct xnthread;
 struct xnsynch;
 
+#ifdef CONFIG_XENO_OPT_SCALABLE_SYNCH
+
+#include <linux/bitmap.h>
+
+/*
+ * Sleepers on priority-ordered objects are indexed by level, which
+ * combines the weight of their scheduling class with their current
+ * priority in that class. Level 0 is the highest.
+ */
+#define XNSYNCH_PENDQ_PRIOS	260	/* i.e. XNSCHED_CORE_NR_PRIO */
+#define XNSYNCH_PENDQ_RANKS	6	/* i.e. heaviest class weight + 1 */
+#define XNSYNCH_PENDQ_LEVELS	(XNSYNCH_PENDQ_RANKS * XNSYNCH_PENDQ_PRIOS)
+
+struct xnsynch_waiter {
+	/** Level the thread was queued at. */
+	int level;
+	/** Object the thread is queued on. */
+	struct xnsynch *synch;
+	/** Link in the hash of level leaders. */
+	struct hlist_node hlink;
+};
+
+#endif /* CONFIG_XENO_OPT_SCALABLE_SYNCH */
+
 struct xnsynch {
 	/** wait (weighted) prio in thread->boosters */
 	int wprio;
@@ -64,6 +88,10 @@ struct xnsynch {
 	unsigned long status;
 	/** Pending threads */
 	struct list_head pendq;
+#ifdef CONFIG_XENO_OPT_SCALABLE_SYNCH
+	/** Levels with sleepers in pendq */
+	DECLARE_BITMAP(levels, XNSYNCH_PENDQ_LEVELS);
+#endif
 	/** Thread which owns the resource */
 	struct xnthread *owner;
 	 /** Pointer to fast lock word */
@@ -158,6 +186,10 @@ int xnsynch_wakeup_many_sleepers(struct xnsynch *synch, int nr);
 void xnsynch_wakeup_this_sleeper(struct xnsynch *synch,
 				 struct xnthread *sleeper);
 
+int xnsynch_requeue_sleepers(struct xnsynch *synch,
+			     struct xnsynch *target,
+			     struct xnthread *owner, int nr);
+
 int __must_check xnsynch_acquire(struct xnsynch *synch,
 				 xnticks_t timeout,
 				 xntmode_t timeout_mode);
@@ -108,6 +108,11 @@ struct xnthread {
 	struct xnsched_quota_group *quota; /* Quota scheduling group. */
 	struct list_head quota_expired;
 	struct list_head quota_next;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	struct xnsched_edf_data *edf; /* EDF reservation. */
+	struct list_head edf_link;	/* Link in per-sched EDF runqueue */
+	xnticks_t edf_deadline;	/* Effective (possibly inherited) deadline */
 #endif
 	cpumask_t affinity;	/* Processor affinity. */
 
@@ -135,6 +140,10 @@ struct xnthread {
 	 * thread->cprio + scheduling class weight.
 	 */
 	struct list_head plink;
+#ifdef CONFIG_XENO_OPT_SCALABLE_SYNCH
+	/** Position of the thread in the indexed pendq. */
+	struct xnsynch_waiter pwait;
+#endif
 
 	/** Thread holder in global queue. */
 	struct list_head glink;
@@ -172,6 +181,7 @@ struct xnthread {
 		xnstat_counter_t csw;	/* Context switches (includes secondary -> primary switches) */
 		xnstat_counter_t xsc;	/* Xenomai syscalls */
 		xnstat_counter_t pf;	/* Number of page faults */
+		xnstat_counter_t mig;	/* CPU migrations */
 		xnstat_exectime_t account; /* Execution time accounting entity */
 		xnstat_exectime_t lastperiod; /* Interval marker for execution time reports */
 	} stat;
@@ -339,6 +349,15 @@ void xnthread_set_sync_window(struct xnthread *thread, int state_bits)
 	}
 }
 
+static inline
+void xnthread_switch_window(struct xnthread *prev, struct xnthread *next)
+{
+	if (prev->u_window)
+		prev->u_window->oncpu = 0;
+	if (next->u_window)
+		next->u_window->oncpu = 1;
+}
+
 static inline int normalize_priority(int prio)
 {
 	return prio < MAX_RT_PRIO ? prio : MAX_RT_PRIO - 1;
@@ -187,6 +187,97 @@ typedef struct { } xntimerq_it_t;
 #define xntimerq_it_begin(q,i)	((void) (i), xntimerq_head(q))
 #define xntimerq_it_next(q,i,h) ((void) (i), xntimerq_next((q),(h)))
 
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+/*
+ * Hierarchical timer wheel. Timers due before q->base are kept in
+ * an exactly ordered list (aka the near list), all others are
+ * hashed by date into XNTWHEEL_LEVELS levels of XNTWHEEL_SLOTS
+ * unordered slots, each level being XNTWHEEL_SLOTS times coarser
+ * than the previous one. Timers beyond the farthest level go to an
+ * overflow list. Slots are cascaded down to the near list on demand,
+ * when the head of the queue is looked up.
+ */
+#define XNTWHEEL_BITS		6
+#define XNTWHEEL_SLOTS		(1 << XNTWHEEL_BITS)
+#define XNTWHEEL_MASK		(XNTWHEEL_SLOTS - 1)
+#define XNTWHEEL_LEVELS		6
+/* Level #0 slots span 2^10 clock ticks (~1 us with ns-based clocks). */
+#define XNTWHEEL_SHIFT		10
+#define XNTWHEEL_NEAR		(-1)
+#define XNTWHEEL_OVERFLOW	(-2)
+
+typedef struct {
+	struct xntlholder tl;
+	/* Slot index in wheel, or XNTWHEEL_NEAR/OVERFLOW. */
+	int slot;
+} xntimerh_t;
+
+#define xntimerh_date(h) xntlholder_date(&(h)->tl)
+#define xntimerh_prio(h) xntlholder_prio(&(h)->tl)
+#define xntimerh_init(h) do { } while (0)
+
+typedef struct {
+	struct list_head near;
+	xnticks_t base;
+	int count;
+	u64 bitmap[XNTWHEEL_LEVELS];
+	struct list_head slots[XNTWHEEL_LEVELS * XNTWHEEL_SLOTS];
+	struct list_head overflow;
+	/* Lower bound of the dates in the overflow list. */
+	xnticks_t overflow_min;
+} xntimerq_t;
+
+void xntimerq_init(xntimerq_t *q);
+
+#define xntimerq_destroy(q) do { } while (0)
+#define xntimerq_empty(q) ((q)->count == 0)
+
+xntimerh_t *xntimerq_cascade(xntimerq_t *q, xntimerh_t *h);
+
+static inline xntimerh_t *xntimerq_head(xntimerq_t *q)
+{
+	if (likely(!list_empty(&q->near)))
+		return list_first_entry(&q->near, xntimerh_t, tl.link);
+
+	return q->count ? xntimerq_cascade(q, NULL) : NULL;
+}
+
+static inline xntimerh_t *xntimerq_second(xntimerq_t *q, xntimerh_t *h)
+{
+	if (!list_is_last(&h->tl.link, &q->near))
+		return list_next_entry(h, tl.link);
+
+	return q->count > 1 ? xntimerq_cascade(q, h) : NULL;
+}
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder);
+
+static inline void xntimerq_remove(xntimerq_t *q, xntimerh_t *holder)
+{
+	int slot = holder->slot;
+
+	list_del(&holder->tl.link);
+	q->count--;
+
+	if (slot >= 0) {
+		if (list_empty(&q->slots[slot]))
+			q->bitmap[slot >> XNTWHEEL_BITS] &=
+				~(1ULL << (slot & XNTWHEEL_MASK));
+	} else if (slot == XNTWHEEL_OVERFLOW &&
+		   list_empty(&q->overflow))
+		q->overflow_min = -1ULL;
+}
+
+typedef struct {
+	int slot;
+} xntimerq_it_t;
+
+xntimerh_t *xntimerq_it_begin(xntimerq_t *q, xntimerq_it_t *it);
+
+xntimerh_t *xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it,
+			     xntimerh_t *holder);
+
 #else /* CONFIG_XENO_OPT_TIMER_LIST */
 
 typedef struct xntlholder xntimerh_t;
@@ -28,21 +28,26 @@
 extern struct xnvdso *nkvdso;
 
 /*
- * Define the available feature set here. We have a single feature
- * defined for now, only in the I-pipe case.
+ * Define the available feature set here. The host realtime data is
+ * only maintained in the I-pipe case, Dovetail provides an
+ * out-of-band safe common vDSO instead.
  */
 #ifdef CONFIG_IPIPE_HAVE_HOSTRT
 
-#define XNVDSO_FEATURES XNVDSO_FEAT_HOST_REALTIME
+#define XNVDSO_FEATURES (XNVDSO_FEAT_HOST_REALTIME|XNVDSO_FEAT_EXT_CLOCKS)
 
 static inline struct xnvdso_hostrt_data *get_hostrt_data(void)
 {
 	return &nkvdso->hostrt_data;
 }
 
+#elif defined(CONFIG_DOVETAIL)
+
+#define XNVDSO_FEATURES (XNVDSO_FEAT_HOST_VDSO|XNVDSO_FEAT_EXT_CLOCKS)
+
 #else
 
-#define XNVDSO_FEATURES 0
+#define XNVDSO_FEATURES XNVDSO_FEAT_EXT_CLOCKS
 
 #endif
 
@@ -112,6 +112,9 @@ int pthread_setmode_np(int clrmask, int setmask,
 
 COBALT_DECL(int, pthread_setname_np(pthread_t thread, const char *name));
 
+int pthread_mutex_getspinstat_np(pthread_mutex_t *mutex,
+				 unsigned int *hits, unsigned int *misses);
+
 int pthread_create_ex(pthread_t *ptid_r,
 		      const pthread_attr_ex_t *attr_ex,
 		      void *(*start)(void *),
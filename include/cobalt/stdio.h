@@ -102,6 +102,30 @@ int rt_fprintf(FILE *stream, const char *format, ...);
 
 int rt_printf(const char *format, ...);
 
+/*
+ * Binary mode: only the format pointer and the raw arguments are
+ * logged, formatting happens later in the printer thread. The format
+ * string must therefore remain valid for the lifetime of the
+ * process; the macros below require a string literal for this
+ * reason. The return value is zero on success, since the size of
+ * the output is not known yet. Conversions which cannot be deferred
+ * (%n, %m, positional arguments, wide strings) are formatted in
+ * place as with rt_fprintf().
+ */
+int rt_vfbprintf(FILE *stream, const char *format, va_list args);
+
+int rt_fbprintf(FILE *stream, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
+
+int rt_bprintf(const char *format, ...)
+	__attribute__((format(printf, 1, 2)));
+
+#define rt_fbprintf(__stream, __fmt, __args...)	\
+	rt_fbprintf(__stream, "" __fmt, ##__args)
+
+#define rt_bprintf(__fmt, __args...)		\
+	rt_bprintf("" __fmt, ##__args)
+
 int rt_puts(const char *s);
 
 int rt_fputs(const char *s, FILE *stream);
@@ -33,6 +33,8 @@ extern int __cobalt_print_bufcount;
 
 extern int __cobalt_print_syncdelay;
 
+extern int __cobalt_print_percpu_bufsz;
+
 static inline define_config_tunable(main_prio, int, prio)
 {
 	__cobalt_main_prio = prio;
@@ -73,6 +75,16 @@ static inline read_config_tunable(print_sync_delay, int)
 	return __cobalt_print_syncdelay;
 }
 
+static inline define_config_tunable(print_percpu_size, int, size)
+{
+	__cobalt_print_percpu_bufsz = size;
+}
+
+static inline read_config_tunable(print_percpu_size, int)
+{
+	return __cobalt_print_percpu_bufsz;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -41,6 +41,7 @@
 #   define _CC_COBALT_SCHED_SPORADIC	8
 #   define _CC_COBALT_SCHED_QUOTA	16
 #   define _CC_COBALT_SCHED_TP		32
+#   define _CC_COBALT_SCHED_EDF		64
 
 #define _CC_COBALT_GET_WATCHDOG		5
 #define _CC_COBALT_GET_CORE_STATUS	6
@@ -61,6 +62,7 @@
 #   define _CC_COBALT_NET_CFG		0x00000400
 #   define _CC_COBALT_NET_CAP		0x00000800
 #   define _CC_COBALT_NET_PROXY		0x00001000
+#   define _CC_COBALT_NET_TCP		0x00002000
 
 
 enum cobalt_run_states {
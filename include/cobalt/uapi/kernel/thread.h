@@ -110,6 +110,7 @@ struct xnthread_user_window {
 	__u32 info;
 	__u32 grant_value;
 	__u32 pp_pending;
+	__u32 oncpu;	/* Currently running in primary mode. */
 };
 
 #endif /* !_COBALT_UAPI_KERNEL_THREAD_H */
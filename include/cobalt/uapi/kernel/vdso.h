@@ -19,11 +19,13 @@
 #define _COBALT_UAPI_KERNEL_VDSO_H
 
 #include <cobalt/uapi/kernel/urw.h>
+#include <cobalt/uapi/time.h>
 
 /*
  * I-pipe only. Dovetail enables the common vDSO for getting
  * CLOCK_REALTIME timestamps from the out-of-band stage
- * (XNVDSO_FEAT_HOST_REALTIME is cleared in this case).
+ * (XNVDSO_FEAT_HOST_REALTIME is cleared, XNVDSO_FEAT_HOST_VDSO is
+ * set in this case).
  */
 struct xnvdso_hostrt_data {
 	__u64 wall_sec;
@@ -38,6 +40,27 @@ struct xnvdso_hostrt_data {
 	urw_t lock;
 };
 
+/*
+ * Conversion parameters of an external Cobalt clock, as a linear
+ * function of the core cycle counter:
+ *
+ * ns = base_ns + (((cycles - base_cycles) & mask) * mult) >> shift
+ *
+ * with the product computed on 96 bits. The Cobalt core publishes
+ * them for clocks ticking on the core counter, other clock drivers
+ * do so with cobalt_clock_update_vdso(). Applications fall back to
+ * the clock_gettime() syscall unless live is set.
+ */
+struct xnvdso_clock_data {
+	__u64 base_cycles;
+	__u64 base_ns;
+	__u64 mask;
+	__u32 mult;
+	__u32 shift;
+	__u32 live;
+	urw_t lock;
+};
+
 /*
  * Data shared between the Cobalt kernel and applications, which lives
  * in the shared memory heap (COBALT_MEMDEV_SHARED).
@@ -50,12 +73,16 @@ struct xnvdso {
 	struct xnvdso_hostrt_data hostrt_data;
 	/* XNVDSO_FEAT_WALLCLOCK_OFFSET */
 	__u64 wallclock_offset;
+	/* XNVDSO_FEAT_EXT_CLOCKS */
+	struct xnvdso_clock_data ext_clocks[COBALT_MAX_EXTCLOCKS];
 };
 
 /* For each shared feature, add a flag below. */
 
 #define XNVDSO_FEAT_HOST_REALTIME	0x0000000000000001ULL
 #define XNVDSO_FEAT_WALLCLOCK_OFFSET	0x0000000000000002ULL
+#define XNVDSO_FEAT_EXT_CLOCKS		0x0000000000000004ULL
+#define XNVDSO_FEAT_HOST_VDSO		0x0000000000000008ULL
 
 static inline int xnvdso_test_feature(struct xnvdso *vdso,
 				      __u64 feature)
@@ -0,0 +1,173 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_MQUEUE_H
+#define _COBALT_UAPI_MQUEUE_H
+
+#include <cobalt/uapi/kernel/types.h>
+
+/*
+ * Creation flag (mq_attr.mq_flags): store the messages into a ring
+ * living in the shared memory heap, so that mq_send() and
+ * mq_receive() complete in user space unless they have to block or
+ * wake up a waiter. Messages are delivered in FIFO order, the
+ * priority is conveyed but does not reorder the queue. mq_maxmsg is
+ * rounded up to a power of two.
+ */
+#define COBALT_MQ_FASTPATH  0x40000000
+
+/*
+ * Bounded MPMC ring, each slot carries a sequence number telling
+ * whether it is free for the sender or ready for the receiver at a
+ * given ring position.
+ */
+struct cobalt_mq_slot {
+	atomic_t seq;
+	__u32 len;
+#define COBALT_MQ_VOID  ((__u32)-1) /* Failed send, to be skipped. */
+	__u32 prio;
+	__u32 __pad;
+	char data[0];
+};
+
+struct cobalt_mq_state {
+	atomic_t head;		/* Next position to send to. */
+	atomic_t tail;		/* Next position to receive from. */
+	atomic_t rwaiters;	/* Receivers sleeping in kernel. */
+	atomic_t swaiters;	/* Senders sleeping in kernel. */
+	__u32 flags;
+#define COBALT_MQ_KICK  0x1	/* Always notify the kernel. */
+	__u32 nslots;
+	__u32 slotsz;
+	__u32 msgsize;
+	/* nslots slots of slotsz bytes follow. */
+};
+
+/*
+ * Private view of the ring. The kernel never trusts the geometry
+ * stored in shared memory, both sides work from their own copy.
+ */
+struct cobalt_mq_ring {
+	struct cobalt_mq_state *state;
+	__u32 mask;
+	__u32 slotsz;
+	__u32 msgsize;
+};
+
+static inline struct cobalt_mq_slot *
+cobalt_mq_slot(const struct cobalt_mq_ring *ring, __u32 pos)
+{
+	return (struct cobalt_mq_slot *)((char *)(ring->state + 1) +
+					 (pos & ring->mask) * ring->slotsz);
+}
+
+/*
+ * The ring lives in memory the other side may scribble on, so give
+ * up claiming after a bounded number of lost races instead of
+ * spinning forever on a corrupted index.
+ */
+#define COBALT_MQ_MAX_RETRIES  1024
+
+static inline int
+cobalt_mq_claim_send(const struct cobalt_mq_ring *ring,
+		     struct cobalt_mq_slot **slotp, __u32 *posp)
+{
+	struct cobalt_mq_state *state = ring->state;
+	struct cobalt_mq_slot *slot;
+	int dif, retries = 0;
+	__u32 pos;
+
+	pos = atomic_read(&state->head);
+	for (;;) {
+		slot = cobalt_mq_slot(ring, pos);
+		dif = (int)((__u32)atomic_read(&slot->seq) - pos);
+		if (dif == 0) {
+			if (atomic_cmpxchg(&state->head, pos, pos + 1) == (int)pos)
+				break;
+		} else if (dif < 0)
+			return -EAGAIN; /* Full. */
+		if (++retries >= COBALT_MQ_MAX_RETRIES)
+			return -EIO;
+		pos = atomic_read(&state->head);
+	}
+
+	*slotp = slot;
+	*posp = pos;
+
+	return 0;
+}
+
+static inline void cobalt_mq_commit_send(struct cobalt_mq_slot *slot,
+					 __u32 pos)
+{
+	smp_wmb();
+	atomic_set(&slot->seq, pos + 1);
+}
+
+static inline int
+cobalt_mq_claim_receive(const struct cobalt_mq_ring *ring,
+			struct cobalt_mq_slot **slotp, __u32 *posp)
+{
+	struct cobalt_mq_state *state = ring->state;
+	struct cobalt_mq_slot *slot;
+	int dif, retries = 0;
+	__u32 pos;
+
+	pos = atomic_read(&state->tail);
+	for (;;) {
+		slot = cobalt_mq_slot(ring, pos);
+		dif = (int)((__u32)atomic_read(&slot->seq) - (pos + 1));
+		if (dif == 0) {
+			if (atomic_cmpxchg(&state->tail, pos, pos + 1) == (int)pos)
+				break;
+		} else if (dif < 0)
+			return -EAGAIN; /* Empty. */
+		if (++retries >= COBALT_MQ_MAX_RETRIES)
+			return -EIO;
+		pos = atomic_read(&state->tail);
+	}
+
+	smp_rmb();
+	*slotp = slot;
+	*posp = pos;
+
+	return 0;
+}
+
+static inline void cobalt_mq_commit_receive(const struct cobalt_mq_ring *ring,
+					    struct cobalt_mq_slot *slot,
+					    __u32 pos)
+{
+	smp_mb();
+	atomic_set(&slot->seq, pos + ring->mask + 1);
+}
+
+static inline int cobalt_mq_empty_p(const struct cobalt_mq_ring *ring)
+{
+	__u32 pos = atomic_read(&ring->state->tail);
+	struct cobalt_mq_slot *slot = cobalt_mq_slot(ring, pos);
+
+	return (int)((__u32)atomic_read(&slot->seq) - (pos + 1)) < 0;
+}
+
+static inline int cobalt_mq_full_p(const struct cobalt_mq_ring *ring)
+{
+	__u32 pos = atomic_read(&ring->state->head);
+	struct cobalt_mq_slot *slot = cobalt_mq_slot(ring, pos);
+
+	return (int)((__u32)atomic_read(&slot->seq) - pos) < 0;
+}
+
+#endif /* !_COBALT_UAPI_MQUEUE_H */
@@ -28,6 +28,16 @@ struct cobalt_mutex_state {
 #define COBALT_MUTEX_COND_SIGNAL 0x00000001
 #define COBALT_MUTEX_ERRORCHECK  0x00000002
 	__u32 ceiling;
+	/*
+	 * Adaptive mutexes only: offset of the owner's user window
+	 * into the shared heap, so that contenders can tell whether
+	 * the owner is running on some CPU, and spin/fallback
+	 * counters.
+	 */
+	__u32 owner_window;
+#define COBALT_MUTEX_NOWINDOW    ((__u32)-1)
+	atomic_t spin_hits;
+	atomic_t spin_misses;
 };
 
 union cobalt_mutex_union {
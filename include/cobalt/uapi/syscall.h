@@ -122,6 +122,8 @@
 #define sc_cobalt_sendmmsg			99
 #define sc_cobalt_clock_adjtime			100
 #define sc_cobalt_thread_setschedprio		101
+#define sc_cobalt_mq_ring			102
+#define sc_cobalt_mq_kick			103
 
 #define __NR_COBALT_SYSCALLS			128 /* Power of 2 */
 
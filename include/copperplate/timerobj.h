@@ -21,16 +21,20 @@
 
 #include <pthread.h>
 #include <time.h>
-#include <boilerplate/list.h>
+#include <boilerplate/avl.h>
 #include <boilerplate/lock.h>
 
+struct timerobj_server;
+
 struct timerobj {
 	struct itimerspec itspec;
 	void (*handler)(struct timerobj *tmobj);
 	timer_t timer;
 	pthread_mutex_t lock;
 	int cancel_state;
-	struct pvholder next;
+	struct timerobj_server *server;
+	struct avlh link;
+	int queued;
 };
 
 static inline int timerobj_lock(struct timerobj *tmobj)
@@ -28,6 +28,8 @@ struct copperplate_setup_data {
 	int shared_registry;
 	size_t mem_pool;
 	gid_t session_gid;
+	int timer_servers;
+	unsigned int hash_size;
 };
 
 #ifdef __cplusplus
@@ -93,6 +95,26 @@ static inline read_config_tunable(session_gid, gid_t)
 	return __copperplate_setup_data.session_gid;
 }
 
+static inline define_config_tunable(timer_servers, int, count)
+{
+	__copperplate_setup_data.timer_servers = count;
+}
+
+static inline read_config_tunable(timer_servers, int)
+{
+	return __copperplate_setup_data.timer_servers;
+}
+
+static inline define_config_tunable(hash_size, unsigned int, size)
+{
+	__copperplate_setup_data.hash_size = size;
+}
+
+static inline read_config_tunable(hash_size, unsigned int)
+{
+	return __copperplate_setup_data.hash_size;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -20,7 +20,65 @@
 #ifndef _RTDM_IPC_H
 #define _RTDM_IPC_H
 
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <rtdm/rtdm.h>
 #include <rtdm/uapi/ipc.h>
 
+/*
+ * Helpers for the BUFP ring mode (BUFP_SPSC). @a ring points at the
+ * mapping obtained by calling mmap() on socket @a s. Only one thread
+ * may write, and one may read at any point in time. Both fall back
+ * to the regular send/receive calls, which may block, when the
+ * ring is full (resp. does not hold @a len bytes).
+ */
+static inline ssize_t rtipc_bufp_write(int s, struct rtipc_bufp_ring *ring,
+				       const void *buf, size_t len)
+{
+	char *data = (char *)ring + RTIPC_BUFP_RING_DATA;
+	uint32_t head, tail, size = ring->size, off, n;
+
+	head = ring->head;
+	tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (len == 0 || size - (head - tail) < len)
+		return send(s, buf, len, 0);
+
+	off = head & (size - 1);
+	n = len < size - off ? len : size - off;
+	memcpy(data + off, buf, n);
+	memcpy(data, (const char *)buf + n, len - n);
+	__atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->rdwait, __ATOMIC_RELAXED))
+		ioctl(s, BUFP_RTIOC_KICK);
+
+	return len;
+}
+
+static inline ssize_t rtipc_bufp_read(int s, struct rtipc_bufp_ring *ring,
+				      void *buf, size_t len)
+{
+	char *data = (char *)ring + RTIPC_BUFP_RING_DATA;
+	uint32_t head, tail, size = ring->size, off, n;
+
+	tail = ring->tail;
+	head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	if (len == 0 || head - tail < len || head - tail > size)
+		return recv(s, buf, len, 0);
+
+	off = tail & (size - 1);
+	n = len < size - off ? len : size - off;
+	memcpy(buf, data + off, n);
+	memcpy((char *)buf + n, data, len - n);
+	__atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->wrwait, __ATOMIC_RELAXED))
+		ioctl(s, BUFP_RTIOC_KICK);
+
+	return len;
+}
+
 #endif /* !_RTDM_IPC_H */
@@ -23,6 +23,29 @@ struct rtdm_gpio_readout {
 	__s32 value;
 };
 
+/*
+ * Edge event, as read in bulk from a pin device switched to event
+ * mode (GPIO_RTIOC_EVENTS), or from a chip device.
+ */
+struct rtdm_gpio_event {
+	nanosecs_abs_t timestamp;
+	__u32 gpio;		/* GPIO number */
+	__u16 value;		/* Line value sampled upon edge */
+	__u16 flags;
+#define GPIO_EVENT_OVERRUN  0x1	/* Older events were dropped */
+};
+
+/*
+ * Set of lines of a chip device: bit n of mask and bits stands for
+ * GPIO number base + n.
+ */
+struct rtdm_gpio_bits {
+	__u32 base;
+	__s32 trigger;		/* GPIO_RTIOC_CHIP_IRQEN only */
+	__u64 mask;
+	__u64 bits;
+};
+
 #define GPIO_RTIOC_DIR_OUT	_IOW(RTDM_CLASS_GPIO, 0, int)
 #define GPIO_RTIOC_DIR_IN	_IO(RTDM_CLASS_GPIO, 1)
 #define GPIO_RTIOC_IRQEN	_IOW(RTDM_CLASS_GPIO, 2, int) /* GPIO trigger */
@@ -30,6 +53,15 @@ struct rtdm_gpio_readout {
 #define GPIO_RTIOC_REQS		_IO(RTDM_CLASS_GPIO, 4)
 #define GPIO_RTIOC_RELS		_IO(RTDM_CLASS_GPIO, 5)
 #define GPIO_RTIOC_TS		_IOR(RTDM_CLASS_GPIO, 7, int)
+#define GPIO_RTIOC_EVENTS	_IOW(RTDM_CLASS_GPIO, 8, int)
+/* Chip device requests. */
+#define GPIO_RTIOC_CHIP_DIR_OUT	_IOW(RTDM_CLASS_GPIO, 9, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_CHIP_DIR_IN	_IOW(RTDM_CLASS_GPIO, 10, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_CHIP_IRQEN	_IOW(RTDM_CLASS_GPIO, 11, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_CHIP_IRQDIS	_IOW(RTDM_CLASS_GPIO, 12, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_CHIP_RELS	_IOW(RTDM_CLASS_GPIO, 13, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_GET_BITS	_IOWR(RTDM_CLASS_GPIO, 14, struct rtdm_gpio_bits)
+#define GPIO_RTIOC_SET_BITS	_IOW(RTDM_CLASS_GPIO, 15, struct rtdm_gpio_bits)
 
 #define GPIO_TRIGGER_NONE		0x0 /* unspecified */
 #define GPIO_TRIGGER_EDGE_RISING	0x1
@@ -765,6 +765,103 @@ struct sockaddr_ipc {
  * RT/non-RT
  */
 #define IDDP_POOLSZ		2
+/**
+ * IDDP zero-copy buffer size configuration
+ *
+ * Turns the local pool of the socket into a pool of fixed-size
+ * buffers, which both the receiver and its peers may map into their
+ * address space by calling mmap() on their IDDP socket. A local pool
+ * size must have been configured with @ref IDDP_POOLSZ too. The
+ * buffer size is rounded up to the next multiple of the cache line
+ * size; reading this option back returns the actual value.
+ *
+ * Once the pool is mapped, senders may obtain a buffer from the pool
+ * of their destination by the @ref IDDP_RTIOC_ZCALLOC request, fill
+ * it in place, then pass its descriptor (struct rtipc_iddp_zcbuf) as
+ * the payload of sendmsg() with the @c MSG_ZEROCOPY flag set. The
+ * receiver picks the descriptor by recvmsg() with @c MSG_ZEROCOPY
+ * set, reads the data in place, then releases the buffer by the
+ * @ref IDDP_RTIOC_ZCFREE request, or passes it on to another socket
+ * bound to the same pool. Datagrams sent or received without @c
+ * MSG_ZEROCOPY are copied to/from a pool buffer as usual.
+ *
+ * It is not allowed to configure a buffer size after the socket was
+ * bound, or after it obtained a buffer from another pool.
+ *
+ * @param [in] level @ref sockopts_iddp "SOL_IDDP"
+ * @param [in] optname @b IDDP_ZCBUFSZ
+ * @param [in] optval Pointer to a variable of type size_t, containing
+ * the size of the buffers to carve from the local pool at binding time
+ * @param [in] optlen sizeof(size_t)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen is invalid or *@a optval is zero)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define IDDP_ZCBUFSZ		3
+/** @} */
+
+/**
+ * @anchor iddp_zerocopy @name IDDP zero-copy transfers
+ * Passing buffers of a shared pool between IDDP sockets.
+ * @{ */
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY		0x4000000
+#endif
+
+/**
+ * Zero-copy buffer descriptor.
+ */
+struct rtipc_iddp_zcbuf {
+	/** Offset of the data from the start of the pool mapping. */
+	uint32_t offset;
+	/** Length of the data, or capacity of a new buffer. */
+	uint32_t len;
+	/** Source port (recvmsg), or -1. */
+	int32_t from;
+	/** MSG_DONTWAIT (IDDP_RTIOC_ZCALLOC), zero otherwise. */
+	uint32_t flags;
+};
+
+#define RTIOC_TYPE_IPC		RTDM_CLASS_RTIPC
+
+/**
+ * Allocate a buffer from the zero-copy pool of the peer.
+ *
+ * The buffer is pulled from the pool of the default destination of
+ * the socket (see connect()), waiting for one to be released if the
+ * pool is exhausted, unless MSG_DONTWAIT is set in the @a flags
+ * field. The send timeout applies (see SO_SNDTIMEO). A socket may
+ * only allocate buffers from a single pool during its lifetime,
+ * which must be its own if it has one.
+ *
+ * @return 0 is returned upon success, with the offset and capacity
+ * of the buffer stored in the descriptor. Otherwise:
+ *
+ * - -EDESTADDRREQ (no default destination)
+ * - -ECONNRESET (destination is gone)
+ * - -EOPNOTSUPP (destination has no zero-copy pool)
+ * - -EXDEV (socket already allocates from another pool)
+ * - -EAGAIN (no buffer available, MSG_DONTWAIT set)
+ * - -ETIMEDOUT (no buffer released in time)
+ * .
+ */
+#define IDDP_RTIOC_ZCALLOC	_IOWR(RTIOC_TYPE_IPC, 0x00, struct rtipc_iddp_zcbuf)
+/**
+ * Release a buffer obtained from @ref IDDP_RTIOC_ZCALLOC or recvmsg()
+ * to its pool. Only the @a offset field is considered.
+ *
+ * @return 0 is returned upon success, or -EINVAL if the caller does
+ * not hold a buffer at this offset.
+ */
+#define IDDP_RTIOC_ZCFREE	_IOW(RTIOC_TYPE_IPC, 0x01, struct rtipc_iddp_zcbuf)
 /** @} */
 
 #define SOL_BUFP		313
@@ -834,8 +931,79 @@ struct sockaddr_ipc {
  * RT/non-RT
  */
 #define BUFP_BUFSZ		2
+/**
+ * BUFP single-producer/single-consumer ring mode
+ *
+ * Exposes the buffer of the socket as a ring in shared memory, which
+ * the receiver and a single sender connected to it may map into
+ * their address space by calling mmap() on their BUFP socket. The
+ * mapping starts with a struct rtipc_bufp_ring header, data follow
+ * at offset RTIPC_BUFP_RING_DATA.
+ *
+ * In this mode, rtipc_bufp_write() and rtipc_bufp_read() move the
+ * data directly through the mapping, entering the kernel only when
+ * the ring is full (resp. empty), or when the peer is sleeping and
+ * has to be woken up. The regular send and receive calls remain
+ * available on both ends, and interoperate with the former. However,
+ * at most one thread may write to the ring, and one thread may read
+ * from it, at any point in time. In addition, select() only
+ * reflects the state of the ring at the time of the call, it is not
+ * woken up by transfers through the mapping.
+ *
+ * The buffer size set by @ref BUFP_BUFSZ may not exceed 2 GiB in
+ * this mode, and is rounded up to the next power of two at binding
+ * time; the size of the mapping is therefore RTIPC_BUFP_RING_DATA
+ * plus the rounded size, which the @a size field of the header
+ * reports. It is not allowed to enable the ring mode after the
+ * socket was bound.
+ *
+ * @param [in] level @ref sockopts_bufp "SOL_BUFP"
+ * @param [in] optname @b BUFP_SPSC
+ * @param [in] optval Pointer to a variable of type int, non-zero to
+ * enable the ring mode
+ * @param [in] optlen sizeof(int)
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EFAULT (Invalid data address given)
+ * - -EALREADY (socket already bound)
+ * - -EINVAL (@a optlen is invalid)
+ * .
+ *
+ * @par Calling context:
+ * RT/non-RT
+ */
+#define BUFP_SPSC		3
 /** @} */
 
+/**
+ * Shared header of a BUFP ring. @a head and @a tail are free-running
+ * byte counts, which only the writer (resp. the reader) may
+ * update. A thread sleeping in the kernel for data (resp. room)
+ * publishes the amount it waits for in @a rdwait (resp. @a wrwait),
+ * in which case the other end must issue @ref BUFP_RTIOC_KICK after
+ * updating its index.
+ */
+struct rtipc_bufp_ring {
+	uint32_t head;
+	uint32_t __pad1[15];
+	uint32_t tail;
+	uint32_t __pad2[15];
+	uint32_t rdwait;
+	uint32_t wrwait;
+	/** Size of the data area. */
+	uint32_t size;
+	uint32_t __pad3[13];
+};
+
+#define RTIPC_BUFP_RING_DATA	256
+
+/**
+ * Wake up the thread sleeping on the BUFP ring of the socket, or of
+ * its default destination.
+ */
+#define BUFP_RTIOC_KICK		_IO(RTIOC_TYPE_IPC, 0x10)
+
 /**
  * @anchor sockopts_socket @name Socket level options
  * Setting and getting supported standard socket level options.
@@ -56,6 +56,73 @@
  * Use RTNET_RTIOC_TIMEOUT with any negative timeout value instead. */
 #define RTNET_RTIOC_EXTPOOL     _IOW(RTIOC_TYPE_NETWORK, 0x14, unsigned int)
 #define RTNET_RTIOC_SHRPOOL     _IOW(RTIOC_TYPE_NETWORK, 0x15, unsigned int)
+#define RTNET_RTIOC_RING        _IOW(RTIOC_TYPE_NETWORK, 0x16, struct rtnet_ring_req)
+/*
+ * RTNET_RTIOC_RING_WAIT is also what clears select()/poll() readiness
+ * of a socket in ring mode: giving RX slots back does not, see below.
+ */
+#define RTNET_RTIOC_RING_WAIT   _IOW(RTIOC_TYPE_NETWORK, 0x17, unsigned int)
+#define RTNET_RTIOC_RING_SEND   _IO(RTIOC_TYPE_NETWORK, 0x18)
+#define RTNET_RTIOC_RING_STATS  _IOR(RTIOC_TYPE_NETWORK, 0x19, struct rtnet_ring_stats)
+
+/*
+ * Shared memory rings. RTNET_RTIOC_RING sets up a memory area made of
+ * rx_frames RX slots followed by tx_frames TX slots, frame_size bytes
+ * each, which is then mapped with mmap() at offset 0. Each slot
+ * starts with a struct rtnet_ring_slot, payload data follow at
+ * RTNET_RING_DATA_OFFSET.
+ *
+ * RX slots are filled by the stack in order, then handed over to the
+ * application by setting their status to RTNET_RING_USER. The
+ * application gives them back by resetting the status to
+ * RTNET_RING_KERNEL. RTNET_RTIOC_RING_WAIT blocks until the RX slot
+ * of the given index is handed over, honoring RTNET_RTIOC_TIMEOUT.
+ *
+ * select()/poll() report the socket readable once an RX slot was
+ * handed over to an application which had emptied the ring, until
+ * RTNET_RTIOC_RING_WAIT finds the slot it waits for still empty.
+ * Applications relying on select()/poll() should therefore set a
+ * non-blocking timeout, and issue RTNET_RTIOC_RING_WAIT for the next
+ * slot once they emptied the ring, which fails with EWOULDBLOCK
+ * unless a frame arrived meanwhile. RTNET_RTIOC_RING_STATS returns
+ * the RX counters of the ring.
+ *
+ * TX slots are filled by the application, which sets their status to
+ * RTNET_RING_SEND, then issues RTNET_RTIOC_RING_SEND to have the
+ * stack transmit all pending slots in order. Transmitted slots return
+ * to RTNET_RING_KERNEL, a rejected one to RTNET_RING_ERROR, which
+ * stops the batch.
+ */
+struct rtnet_ring_req {
+	unsigned int frame_size;
+	unsigned int rx_frames;
+	unsigned int tx_frames;
+};
+
+struct rtnet_ring_stats {
+	uint64_t rx_delivered;	/* frames handed over to the application */
+	uint64_t rx_drops;	/* frames dropped for lack of a free slot */
+};
+
+struct rtnet_ring_slot {
+	uint32_t status;
+	uint32_t len;		/* frame length, maybe larger than the slot */
+	uint64_t tstamp;	/* RX arrival time (ns) */
+	uint32_t flags;
+	uint32_t addrlen;	/* RX: peer address, TX: destination, or 0 */
+	uint8_t addr[32];	/* struct sockaddr_ll / sockaddr_in */
+};
+
+#define RTNET_RING_KERNEL       0
+#define RTNET_RING_USER         1
+#define RTNET_RING_SEND         2
+#define RTNET_RING_ERROR        3
+
+#define RTNET_RING_TRUNC        0x1	/* flags: payload was truncated */
+
+#define RTNET_RING_ALIGN        64
+#define RTNET_RING_DATA_OFFSET  64
+#define RTNET_RING_MAX_SIZE     (64 * 1024 * 1024)
 
 /* socket transmission priorities */
 #define SOCK_MAX_PRIO           0
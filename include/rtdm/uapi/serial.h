@@ -93,6 +93,14 @@
 #define RTSER_DEF_FIFO_DEPTH		RTSER_FIFO_DEPTH_1
 /** @} */
 
+/*!
+ * @anchor RTSER_RX_IDLE_xxx   @name RTSER_RX_IDLE_xxx
+ * Reception idle batching, in character times
+ * @{ */
+#define RTSER_RX_IDLE_DISABLE		0
+#define RTSER_DEF_RX_IDLE		RTSER_RX_IDLE_DISABLE
+/** @} */
+
 /*!
  * @anchor RTSER_TIMEOUT_xxx   @name RTSER_TIMEOUT_xxx
  * Special timeout values, see also @ref RTDM_TIMEOUT_xxx
@@ -139,6 +147,7 @@
 #define RTSER_SET_TIMESTAMP_HISTORY	0x0800
 #define RTSER_SET_EVENT_MASK		0x1000
 #define RTSER_SET_RS485			0x2000
+#define RTSER_SET_RX_IDLE		0x4000
 /** @} */
 
 
@@ -218,7 +227,10 @@ typedef struct rtser_config {
 	/** reception FIFO interrupt threshold, see @ref RTSER_FIFO_xxx */
 	int		fifo_depth;
 
-	int		reserved;
+	/** idle time of the line, in character times, after which a
+	 *  blocked reader receives the bytes collected so far, see
+	 *  @ref RTSER_RX_IDLE_xxx */
+	int		rx_idle;
 
 	/** reception timeout, see @ref RTSER_TIMEOUT_xxx for special
 	 *  values */
@@ -270,6 +282,32 @@ typedef struct rtser_event {
 	nanosecs_abs_t	rxpend_timestamp;
 } rtser_event_t;
 
+/**
+ * Serial device statistics
+ */
+typedef struct rtser_stats {
+	/** interrupts handled */
+	uint64_t	irqs;
+
+	/** reception interrupt causes (data available, character timeout) */
+	uint64_t	rx_irqs;
+
+	/** transmitter empty interrupt causes */
+	uint64_t	tx_irqs;
+
+	/** bytes received */
+	uint64_t	rx_bytes;
+
+	/** bytes sent */
+	uint64_t	tx_bytes;
+
+	/** reader wakeups */
+	uint64_t	rx_wakeups;
+
+	/** reader wakeups due to the line going idle */
+	uint64_t	rx_idle_wakeups;
+} rtser_stats_t;
+
 
 #define RTIOC_TYPE_SERIAL		RTDM_CLASS_SERIAL
 
@@ -396,6 +434,22 @@ typedef struct rtser_event {
  */
 #define RTSER_RTIOC_BREAK_CTL	\
 	_IOR(RTIOC_TYPE_SERIAL, 0x06, int)
+
+/**
+ * Get serial device statistics
+ *
+ * @param[out] arg Pointer to statistics buffer (struct rtser_stats)
+ *
+ * @return 0 on success, otherwise negative error code
+ *
+ * @coretags{task-unrestricted}
+ *
+ * @note Counters are reset when the device is opened. Dividing @c irqs
+ * by the sum of @c rx_bytes and @c tx_bytes tells how well the FIFO
+ * trigger level and the reception idle batching perform.
+ */
+#define RTSER_RTIOC_GET_STATS	\
+	_IOR(RTIOC_TYPE_SERIAL, 0x07, struct rtser_stats)
 /** @} */
 
 /*!
@@ -61,6 +61,115 @@ typedef struct rttst_tmbench_config {
 	int freeze_max;
 } rttst_tmbench_config_t;
 
+/*
+ * Log-linear (HDR-style) latency histogram. Latencies below
+ * RTTST_HDR_SUB_COUNT ns get a bucket each, then every power of two
+ * range above is split into RTTST_HDR_SUB_COUNT buckets, which
+ * bounds the relative error of any reported value to 1/128th over
+ * the whole 32bit range of nanoseconds. Negative latencies (early
+ * wakeups) are accounted as zero.
+ */
+#define RTTST_HDR_SUB_SHIFT	7
+#define RTTST_HDR_SUB_COUNT	(1 << RTTST_HDR_SUB_SHIFT)
+#define RTTST_HDR_BUCKETS	((32 - RTTST_HDR_SUB_SHIFT + 1) << RTTST_HDR_SUB_SHIFT)
+
+static inline unsigned int rttst_hdr_index(__s32 ns)
+{
+	__u32 v = ns > 0 ? ns : 0;
+	unsigned int shift;
+
+	if (v < RTTST_HDR_SUB_COUNT)
+		return v;
+
+	shift = 31 - __builtin_clz(v) - RTTST_HDR_SUB_SHIFT;
+
+	return ((shift + 1) << RTTST_HDR_SUB_SHIFT) +
+		(v >> shift) - RTTST_HDR_SUB_COUNT;
+}
+
+/* Highest value accounted by a bucket. */
+static inline __u32 rttst_hdr_highest(unsigned int index)
+{
+	unsigned int g = index >> RTTST_HDR_SUB_SHIFT,
+		sub = index & (RTTST_HDR_SUB_COUNT - 1);
+
+	if (g == 0)
+		return index;
+
+	return ((__u32)(RTTST_HDR_SUB_COUNT + sub) << (g - 1)) +
+		((1U << (g - 1)) - 1);
+}
+
+/*
+ * Value below which q / 100000 of the samples fall, e.g. q = 99900
+ * for the 99.9th percentile.
+ */
+static inline __u32 rttst_hdr_value_at(const __u64 *buckets,
+				       __u64 samples, __u32 q)
+{
+	__u64 cum = 0;
+	unsigned int n;
+
+	if (samples == 0)
+		return 0;
+
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++) {
+		cum += buckets[n];
+		if (cum * 100000 >= samples * q)
+			return rttst_hdr_highest(n);
+	}
+
+	return rttst_hdr_highest(RTTST_HDR_BUCKETS - 1);
+}
+
+typedef struct rttst_hdr_stats {
+	/* in: CPU to report about, -1 for all CPUs merged */
+	__s32 cpu;
+	/* in: RTTST_HDR_xxx flags */
+	__u32 flags;
+	/* out: latencies in nanoseconds */
+	__u64 samples;
+	__s32 min;
+	__s32 max;
+	__s32 p50;
+	__s32 p90;
+	__s32 p99;
+	__s32 p999;
+	__s32 p9999;
+	__s32 p99999;
+} rttst_hdr_stats_t;
+
+/* Clear the histogram(s) once read, for interval reporting. */
+#define RTTST_HDR_RESET		0x1
+
+static inline __s32 __rttst_hdr_pct(const __u64 *buckets,
+				     const struct rttst_hdr_stats *stats,
+				     __u32 q)
+{
+	__u32 v = rttst_hdr_value_at(buckets, stats->samples, q);
+
+	/* Bucket bounds may overshoot the actual maximum. */
+	return (__s32)v > stats->max ? stats->max : (__s32)v;
+}
+
+/* Computes the sample count and percentiles, min and max must be set. */
+static inline void rttst_hdr_fill_stats(struct rttst_hdr_stats *stats,
+					const __u64 *buckets)
+{
+	unsigned int n;
+
+	stats->samples = 0;
+	for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+		stats->samples += buckets[n];
+
+	stats->p50 = __rttst_hdr_pct(buckets, stats, 50000);
+	stats->p90 = __rttst_hdr_pct(buckets, stats, 90000);
+	stats->p99 = __rttst_hdr_pct(buckets, stats, 99000);
+	stats->p999 = __rttst_hdr_pct(buckets, stats, 99900);
+	stats->p9999 = __rttst_hdr_pct(buckets, stats, 99990);
+	stats->p99999 = __rttst_hdr_pct(buckets, stats, 99999);
+}
+
 struct rttst_swtest_task {
 	unsigned int index;
 	unsigned int flags;
@@ -148,6 +257,9 @@ struct rttst_heap_stathdr {
 #define RTTST_RTIOC_TMBENCH_STOP \
 	_IOWR(RTIOC_TYPE_TESTING, 0x11, struct rttst_overall_bench_res)
 
+#define RTTST_RTIOC_TMBENCH_HDR \
+	_IOWR(RTIOC_TYPE_TESTING, 0x12, struct rttst_hdr_stats)
+
 #define RTTST_RTIOC_SWTEST_SET_TASKS_COUNT \
 	_IOW(RTIOC_TYPE_TESTING, 0x30, __u32)
 
@@ -193,6 +305,9 @@ struct rttst_heap_stathdr {
 #define RTTST_RTIOC_HEAP_STAT_COLLECT \
 	_IOR(RTIOC_TYPE_TESTING, 0x45, int)
 
+#define RTTST_RTIOC_RTDM_GET_EXTCLOCK \
+	_IOR(RTIOC_TYPE_TESTING, 0x46, __s32)
+
 /** @} */
 
 #endif /* !_RTDM_UAPI_TESTING_H */
@@ -300,6 +300,21 @@ xnticks_t xnclock_core_read_monotonic(void)
 }
 EXPORT_SYMBOL_GPL(xnclock_core_read_monotonic);
 
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+
+/*
+ * Raw reader for external clocks ticking on the core cycle
+ * counter. Cobalt publishes the time of such clocks in the vDSO, see
+ * cobalt_clock_register().
+ */
+xnticks_t xnclock_core_read_cycles(struct xnclock *clock)
+{
+	return xnclock_core_read_raw();
+}
+EXPORT_SYMBOL_GPL(xnclock_core_read_cycles);
+
+#endif /* CONFIG_XENO_OPT_EXTCLOCK */
+
 #ifdef CONFIG_XENO_OPT_STATS
 
 static struct xnvfile_directory timerlist_vfroot;
@@ -63,6 +63,13 @@ struct vfile_priv {
 struct vfile_data {
 	size_t all_mem;
 	size_t free_mem;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+	size_t cached_mem;
+	unsigned long mag_hits;
+	unsigned long mag_misses;
+	unsigned long mag_refills;
+	unsigned long mag_drains;
+#endif
 	char name[XNOBJECT_NAME_LEN];
 };
 
@@ -73,6 +80,42 @@ static struct xnvfile_snapshot vfile = {
 	.ops = &vfile_ops,
 };
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+
+static void collect_magazine_stats(struct xnheap *heap,
+				   struct vfile_data *p)
+{
+	struct xnheap_magcache *mc;
+	int cpu, n;
+
+	p->cached_mem = 0;
+	p->mag_hits = 0;
+	p->mag_misses = 0;
+	p->mag_refills = heap->mag_refills;
+	p->mag_drains = heap->mag_drains;
+
+	if (heap->magcache == NULL)
+		return;
+
+	/* Racy reads, but good enough for statistics. */
+	for_each_possible_cpu(cpu) {
+		mc = per_cpu_ptr(heap->magcache, cpu);
+		p->mag_hits += mc->hits;
+		p->mag_misses += mc->misses;
+		for (n = 0; n < XNHEAP_MAX_BUCKETS; n++)
+			p->cached_mem += (size_t)mc->mags[n].count <<
+				(n + XNHEAP_MIN_LOG2);
+	}
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
+static inline void collect_magazine_stats(struct xnheap *heap,
+					  struct vfile_data *p)
+{ }
+
+#endif /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
 static int vfile_rewind(struct xnvfile_snapshot_iterator *it)
 {
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
@@ -105,11 +148,37 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 
 	p->all_mem = xnheap_get_size(heap);
 	p->free_mem = xnheap_get_free(heap);
+	collect_magazine_stats(heap, p);
 	knamecpy(p->name, heap->name);
 
 	return 1;
 }
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+
+static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
+{
+	struct vfile_data *p = data;
+
+	if (p == NULL)
+		xnvfile_printf(it, "%9s %9s %9s %10s %10s %8s %8s  %s\n",
+			       "TOTAL", "FREE", "CACHED", "MAGHIT",
+			       "MAGMISS", "REFILL", "DRAIN", "NAME");
+	else
+		xnvfile_printf(it, "%9zu %9zu %9zu %10lu %10lu %8lu %8lu  %s\n",
+			       p->all_mem,
+			       p->free_mem,
+			       p->cached_mem,
+			       p->mag_hits,
+			       p->mag_misses,
+			       p->mag_refills,
+			       p->mag_drains,
+			       p->name);
+	return 0;
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
 static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_data *p = data;
@@ -125,6 +194,8 @@ static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 	return 0;
 }
 
+#endif /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
 static struct xnvfile_snapshot_ops vfile_ops = {
 	.rewind = vfile_rewind,
 	.next = vfile_next,
@@ -513,45 +584,11 @@ static void *add_free_range(struct xnheap *heap,
 	return pagenr_to_addr(heap, pg);
 }
 
-/**
- * @fn void *xnheap_alloc(struct xnheap *heap, size_t size)
- * @brief Allocate a memory block from a memory heap.
- *
- * Allocates a contiguous region of memory from an active memory heap.
- * Such allocation is guaranteed to be time-bounded.
- *
- * @param heap The descriptor address of the heap to get memory from.
- *
- * @param size The size in bytes of the requested block.
- *
- * @return The address of the allocated region upon success, or NULL
- * if no memory is available from the specified heap.
- *
- * @coretags{unrestricted}
- */
-void *xnheap_alloc(struct xnheap *heap, size_t size)
+static void *alloc_block(struct xnheap *heap, size_t bsize, int log2size)
 {
-	int log2size, ilog, pg, b = -1;
-	size_t bsize;
+	int ilog, pg, b;
 	void *block;
-	spl_t s;
 
-	if (size == 0)
-		return NULL;
-
-	if (size < XNHEAP_MIN_ALIGN) {
-		bsize = size = XNHEAP_MIN_ALIGN;
-		log2size = XNHEAP_MIN_LOG2;
-	} else {
-		log2size = ilog2(size);
-		if (log2size < XNHEAP_PAGE_SHIFT) {
-			if (size & (size - 1))
-				log2size++;
-			bsize = 1 << log2size;
-		} else
-			bsize = ALIGN(size, XNHEAP_PAGE_SIZE);
-	}
-	
 	/*
 	 * Allocate entire pages directly from the pool whenever the
 	 * block is larger or equal to XNHEAP_PAGE_SIZE.  Otherwise,
@@ -564,74 +601,51 @@ void *xnheap_alloc(struct xnheap *heap, size_t size)
 	 * this list, in which case we should immediately add a fresh
 	 * page.
 	 */
-	xnlock_get_irqsave(&heap->lock, s);
-
 	if (bsize >= XNHEAP_PAGE_SIZE)
 		/* Add a range of contiguous free pages. */
-		block = add_free_range(heap, bsize, 0);
-	else {
-		ilog = log2size - XNHEAP_MIN_LOG2;
-		XENO_WARN_ON(MEMORY, ilog < 0 || ilog >= XNHEAP_MAX_BUCKETS);
-		pg = heap->buckets[ilog];
-		/*
-		 * Find a block in the heading page if any. If there
-		 * is none, there won't be any down the list: add a
-		 * new page right away.
-		 */
-		if (pg < 0 || heap->pagemap[pg].map == -1U)
-			block = add_free_range(heap, bsize, log2size);
-		else {
-			b = ffs(~heap->pagemap[pg].map) - 1;
-			/*
-			 * Got one block from the heading per-bucket
-			 * page, tag it as busy in the per-page
-			 * allocation map.
-			 */
-			heap->pagemap[pg].map |= (1U << b);
-			heap->used_size += bsize;
-			block = heap->membase +
-				(pg << XNHEAP_PAGE_SHIFT) +
-				(b << log2size);
-			if (heap->pagemap[pg].map == -1U)
-				move_page_back(heap, pg, log2size);
-		}
-	}
+		return add_free_range(heap, bsize, 0);
 
-	xnlock_put_irqrestore(&heap->lock, s);
+	ilog = log2size - XNHEAP_MIN_LOG2;
+	XENO_WARN_ON(MEMORY, ilog < 0 || ilog >= XNHEAP_MAX_BUCKETS);
+	pg = heap->buckets[ilog];
+	/*
+	 * Find a block in the heading page if any. If there is none,
+	 * there won't be any down the list: add a new page right
+	 * away.
+	 */
+	if (pg < 0 || heap->pagemap[pg].map == -1U)
+		return add_free_range(heap, bsize, log2size);
+
+	b = ffs(~heap->pagemap[pg].map) - 1;
+	/*
+	 * Got one block from the heading per-bucket page, tag it as
+	 * busy in the per-page allocation map.
+	 */
+	heap->pagemap[pg].map |= (1U << b);
+	heap->used_size += bsize;
+	block = heap->membase +
+		(pg << XNHEAP_PAGE_SHIFT) +
+		(b << log2size);
+	if (heap->pagemap[pg].map == -1U)
+		move_page_back(heap, pg, log2size);
 
 	return block;
 }
-EXPORT_SYMBOL_GPL(xnheap_alloc);
 
-/**
- * @fn void xnheap_free(struct xnheap *heap, void *block)
- * @brief Release a block to a memory heap.
- *
- * Releases a memory block to a heap.
- *
- * @param heap The heap descriptor.
- *
- * @param block The block to be returned to the heap.
- *
- * @coretags{unrestricted}
- */
-void xnheap_free(struct xnheap *heap, void *block)
+static bool free_block(struct xnheap *heap, void *block)
 {
 	unsigned long pgoff, boff;
 	int log2size, pg, n;
 	size_t bsize;
 	u32 oldmap;
-	spl_t s;
-
-	xnlock_get_irqsave(&heap->lock, s);
 
 	/* Compute the heading page number in the page map. */
 	pgoff = block - heap->membase;
 	pg = pgoff >> XNHEAP_PAGE_SHIFT;
 
 	if (!page_is_valid(heap, pg))
-		goto bad;
-	
+		return false;
+
 	switch (heap->pagemap[pg].type) {
 	case page_list:
 		bsize = heap->pagemap[pg].bsize;
@@ -645,7 +659,7 @@ void xnheap_free(struct xnheap *heap, void *block)
 		XENO_WARN_ON(MEMORY, bsize >= XNHEAP_PAGE_SIZE);
 		boff = pgoff & ~XNHEAP_PAGE_MASK;
 		if ((boff & (bsize - 1)) != 0) /* Not at block start? */
-			goto bad;
+			return false;
 
 		n = boff >> log2size; /* Block position in page. */
 		oldmap = heap->pagemap[pg].map;
@@ -668,13 +682,264 @@ void xnheap_free(struct xnheap *heap, void *block)
 
 	heap->used_size -= bsize;
 
+	return true;
+}
+
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+
+/*
+ * Per-CPU magazines. Each CPU owns a small LIFO stack of free blocks
+ * for every bucket size class, which is only accessed with the
+ * local CPU stalled for interrupts, so that no lock is required in
+ * the common case. When a magazine runs empty (alloc) or full
+ * (free), a batch of blocks is moved from/to the bucket allocator
+ * acting as the depot, with heap->lock held.
+ *
+ * Blocks cached in magazines are still accounted as busy by the
+ * underlying heap.
+ */
+static void *magazine_alloc(struct xnheap *heap, int log2size)
+{
+	struct xnheap_magazine *mag;
+	struct xnheap_magcache *mc;
+	void *block;
+	int n;
+	spl_t s;
+
+	splhigh(s);
+
+	mc = raw_cpu_ptr(heap->magcache);
+	mag = &mc->mags[log2size - XNHEAP_MIN_LOG2];
+	if (likely(mag->count > 0)) {
+		mc->hits++;
+		block = mag->rounds[--mag->count];
+		splexit(s);
+		return block;
+	}
+
+	mc->misses++;
+
+	xnlock_get(&heap->lock);
+
+	for (n = 0; n < XNHEAP_MAG_BATCH; n++) {
+		block = alloc_block(heap, 1 << log2size, log2size);
+		if (block == NULL)
+			break;
+		mag->rounds[mag->count++] = block;
+	}
+
+	if (n > 0)
+		heap->mag_refills++;
+
+	xnlock_put(&heap->lock);
+
+	block = mag->count > 0 ? mag->rounds[--mag->count] : NULL;
+
+	splexit(s);
+
+	return block;
+}
+
+static bool magazine_free(struct xnheap *heap, void *block)
+{
+	struct xnheap_magazine *mag;
+	struct xnheap_magcache *mc;
+	unsigned long pgoff;
+	int log2size, pg, n;
+	spl_t s;
+
+	pgoff = block - heap->membase;
+	pg = pgoff >> XNHEAP_PAGE_SHIFT;
+
+	/*
+	 * The page entry of a busy block cannot change under our
+	 * feet, so peeking at its type locklessly is safe. Anything
+	 * which does not look like a valid bucketed block goes to
+	 * the regular path, which may also complain about it.
+	 */
+	if (pgoff >= heap->usable_size || !page_is_valid(heap, pg))
+		return false;
+
+	log2size = heap->pagemap[pg].type;
+	if (log2size < XNHEAP_MIN_LOG2 || log2size >= XNHEAP_PAGE_SHIFT)
+		return false;
+
+	if ((pgoff & ~XNHEAP_PAGE_MASK & ((1 << log2size) - 1)) != 0)
+		return false;
+
+	splhigh(s);
+
+	mc = raw_cpu_ptr(heap->magcache);
+	mag = &mc->mags[log2size - XNHEAP_MIN_LOG2];
+	if (unlikely(mag->count >= XNHEAP_MAG_DEPTH)) {
+		/*
+		 * Magazine is full: drain the oldest (i.e. coldest)
+		 * half back to the heap, keeping the hot blocks.
+		 */
+		xnlock_get(&heap->lock);
+		for (n = 0; n < XNHEAP_MAG_BATCH; n++)
+			free_block(heap, mag->rounds[n]);
+		heap->mag_drains++;
+		xnlock_put(&heap->lock);
+		mag->count -= XNHEAP_MAG_BATCH;
+		memmove(mag->rounds, mag->rounds + XNHEAP_MAG_BATCH,
+			mag->count * sizeof(void *));
+	}
+
+	mag->rounds[mag->count++] = block;
+
+	splexit(s);
+
+	return true;
+}
+
+static void flush_magazines(struct xnheap *heap)
+{
+	struct xnheap_magazine *mag;
+	struct xnheap_magcache *mc;
+	int cpu, n;
+	spl_t s;
+
+	for_each_possible_cpu(cpu) {
+		mc = per_cpu_ptr(heap->magcache, cpu);
+		xnlock_get_irqsave(&heap->lock, s);
+		for (n = 0; n < XNHEAP_MAX_BUCKETS; n++) {
+			mag = &mc->mags[n];
+			while (mag->count > 0)
+				free_block(heap, mag->rounds[--mag->count]);
+		}
+		xnlock_put_irqrestore(&heap->lock, s);
+	}
+}
+
+/**
+ * @fn int xnheap_enable_magazines(struct xnheap *heap)
+ * @brief Enable per-CPU magazines for a memory heap.
+ *
+ * Sets up a per-CPU cache of free blocks in front of the bucketed
+ * allocator of @a heap, so that small allocation and release
+ * requests do not contend on the heap lock in the common case.
+ * This call should be issued once, right after xnheap_init(),
+ * before any allocation takes place from @a heap.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @return 0 is returned upon success, or -ENOMEM if the per-CPU
+ * storage could not be allocated.
+ *
+ * @coretags{secondary-only}
+ */
+int xnheap_enable_magazines(struct xnheap *heap)
+{
+	secondary_mode_only();
+
+	heap->magcache = alloc_percpu(struct xnheap_magcache);
+	if (heap->magcache == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnheap_enable_magazines);
+
+static inline bool heap_has_magazines(struct xnheap *heap)
+{
+	return heap->magcache != NULL;
+}
+
+#else /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
+static inline void *magazine_alloc(struct xnheap *heap, int log2size)
+{
+	return NULL;
+}
+
+static inline bool magazine_free(struct xnheap *heap, void *block)
+{
+	return false;
+}
+
+static inline bool heap_has_magazines(struct xnheap *heap)
+{
+	return false;
+}
+
+#endif /* !CONFIG_XENO_OPT_HEAP_MAGAZINE */
+
+/**
+ * @fn void *xnheap_alloc(struct xnheap *heap, size_t size)
+ * @brief Allocate a memory block from a memory heap.
+ *
+ * Allocates a contiguous region of memory from an active memory heap.
+ * Such allocation is guaranteed to be time-bounded.
+ *
+ * @param heap The descriptor address of the heap to get memory from.
+ *
+ * @param size The size in bytes of the requested block.
+ *
+ * @return The address of the allocated region upon success, or NULL
+ * if no memory is available from the specified heap.
+ *
+ * @coretags{unrestricted}
+ */
+void *xnheap_alloc(struct xnheap *heap, size_t size)
+{
+	int log2size;
+	size_t bsize;
+	void *block;
+	spl_t s;
+
+	if (size == 0)
+		return NULL;
+
+	if (size < XNHEAP_MIN_ALIGN) {
+		bsize = size = XNHEAP_MIN_ALIGN;
+		log2size = XNHEAP_MIN_LOG2;
+	} else {
+		log2size = ilog2(size);
+		if (log2size < XNHEAP_PAGE_SHIFT) {
+			if (size & (size - 1))
+				log2size++;
+			bsize = 1 << log2size;
+		} else
+			bsize = ALIGN(size, XNHEAP_PAGE_SIZE);
+	}
+
+	if (heap_has_magazines(heap) && bsize < XNHEAP_PAGE_SIZE)
+		return magazine_alloc(heap, log2size);
+
+	xnlock_get_irqsave(&heap->lock, s);
+	block = alloc_block(heap, bsize, log2size);
 	xnlock_put_irqrestore(&heap->lock, s);
 
-	return;
-bad:
+	return block;
+}
+EXPORT_SYMBOL_GPL(xnheap_alloc);
+
+/**
+ * @fn void xnheap_free(struct xnheap *heap, void *block)
+ * @brief Release a block to a memory heap.
+ *
+ * Releases a memory block to a heap.
+ *
+ * @param heap The heap descriptor.
+ *
+ * @param block The block to be returned to the heap.
+ *
+ * @coretags{unrestricted}
+ */
+void xnheap_free(struct xnheap *heap, void *block)
+{
+	bool ret;
+	spl_t s;
+
+	if (heap_has_magazines(heap) && magazine_free(heap, block))
+		return;
+
+	xnlock_get_irqsave(&heap->lock, s);
+	ret = free_block(heap, block);
 	xnlock_put_irqrestore(&heap->lock, s);
 
-	XENO_WARN(MEMORY, 1, "invalid block %p in heap %s",
+	XENO_WARN(MEMORY, !ret, "invalid block %p in heap %s",
 		  block, heap->name);
 }
 EXPORT_SYMBOL_GPL(xnheap_free);
@@ -758,6 +1023,11 @@ int xnheap_init(struct xnheap *heap, void *membase, size_t size)
 	heap->membase = membase;
 	heap->usable_size = size;
 	heap->used_size = 0;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+	heap->magcache = NULL;
+	heap->mag_refills = 0;
+	heap->mag_drains = 0;
+#endif
 		      
 	/*
 	 * The free page pool is maintained as a set of ranges of
@@ -805,6 +1075,13 @@ void xnheap_destroy(struct xnheap *heap)
 	nrheaps--;
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINE
+	if (heap->magcache) {
+		flush_magazines(heap);
+		free_percpu(heap->magcache);
+		heap->magcache = NULL;
+	}
+#endif
 	vfree(heap->pagemap);
 }
 EXPORT_SYMBOL_GPL(xnheap_destroy);
@@ -137,6 +137,24 @@ void pipeline_update_clock_freq(unsigned long long freq)
 	xnlock_put_irqrestore(&nklock, s);
 }
 
+/*
+ * Cycles to nanoseconds factors matching xnclock_core_ticks_to_ns(),
+ * as shared with applications through the vDSO.
+ */
+void pipeline_get_clock_mulshift(u32 *mult, u32 *shift)
+{
+#ifdef XNARCH_HAVE_LLMULSHFT
+	*mult = tsc_scale;
+	*shift = tsc_shift;
+#else
+	unsigned int m, s;
+
+	xnarch_init_llmulshft(1000000000, clockfreq, &m, &s);
+	*mult = m;
+	*shift = s;
+#endif
+}
+
 void pipeline_init_clock(void)
 {
 	pipeline_update_clock_freq(cobalt_pipeline.clock_freq);
@@ -19,6 +19,7 @@
 #include <linux/clocksource.h>
 #include <linux/bitmap.h>
 #include <cobalt/kernel/clock.h>
+#include <cobalt/kernel/vdso.h>
 #include "internal.h"
 #include "thread.h"
 #include "clock.h"
@@ -51,6 +52,64 @@ DECLARE_BITMAP(cobalt_clock_extids, COBALT_MAX_EXTCLOCKS);
 	__val;							\
 })
 
+static void __update_vdso(struct xnclock *clock,
+			  xnticks_t base_cycles, xnticks_t base_ns,
+			  xnticks_t mask, u32 mult, u32 shift)
+{
+	struct xnvdso_clock_data *data = &nkvdso->ext_clocks[clock->id];
+	urwstate_t tmp;
+
+	unsynced_write_block(&tmp, &data->lock) {
+		data->base_cycles = base_cycles;
+		data->base_ns = base_ns;
+		data->mask = mask;
+		data->mult = mult;
+		data->shift = shift;
+		data->live = 1;
+	}
+}
+
+static inline bool ticks_on_core(struct xnclock *clock)
+{
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+	return clock->ops.read_raw == xnclock_core_read_cycles;
+#else
+	return true;	/* All clocks read the core counter. */
+#endif
+}
+
+/*
+ * The time of a clock ticking on the core cycle counter only differs
+ * from the core time by an offset, which we sample here. nklock must
+ * be held.
+ */
+static void sync_clock_vdso(struct xnclock *clock)
+{
+	xnticks_t before, after, ns;
+	u32 mult, shift;
+
+	if (!ticks_on_core(clock))
+		return;
+
+	pipeline_get_clock_mulshift(&mult, &shift);
+	before = xnclock_core_read_raw();
+	ns = xnclock_read_monotonic(clock);
+	after = xnclock_core_read_raw();
+	__update_vdso(clock, before + (after - before) / 2, ns,
+		      (xnticks_t)-1, mult, shift);
+}
+
+static void sync_ext_clock_vdso(clockid_t clock_id)
+{
+	int nr = __COBALT_CLOCK_EXT_INDEX(clock_id);
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	if (test_bit(nr, cobalt_clock_extids))
+		sync_clock_vdso(external_clocks[nr]);
+	xnlock_put_irqrestore(&nklock, s);
+}
+
 int __cobalt_clock_getres(clockid_t clock_id, struct timespec64 *ts)
 {
 	xnticks_t ns;
@@ -159,6 +218,7 @@ int __cobalt_clock_settime(clockid_t clock_id, const struct timespec64 *ts)
 		_ret = do_ext_clock(clock_id, set_time, ret, ts);
 		if (_ret || ret)
 			return _ret ?: ret;
+		sync_ext_clock_vdso(clock_id);
 	}
 
 	trace_cobalt_clock_settime(clock_id, ts);
@@ -180,6 +240,7 @@ int __cobalt_clock_adjtime(clockid_t clock_id, struct __kernel_timex *tx)
 		_ret = do_ext_clock(clock_id, adjust_time, ret, tx);
 		if (_ret || ret)
 			return _ret ?: ret;
+		sync_ext_clock_vdso(clock_id);
 	}
 
 	trace_cobalt_clock_adjtime(clock_id, tx);
@@ -347,6 +408,11 @@ int cobalt_clock_register(struct xnclock *clock, const cpumask_t *affinity,
 
 	clock->id = nr;
 	*clk_id = __COBALT_CLOCK_EXT(clock->id);
+	cobalt_clock_invalidate_vdso(clock);
+
+	xnlock_get_irqsave(&nklock, s);
+	sync_clock_vdso(clock);
+	xnlock_put_irqrestore(&nklock, s);
 
 	trace_cobalt_clock_register(clock->name, *clk_id);
 
@@ -354,9 +420,76 @@ int cobalt_clock_register(struct xnclock *clock, const cpumask_t *affinity,
 }
 EXPORT_SYMBOL_GPL(cobalt_clock_register);
 
+/**
+ * @brief Publish the vDSO conversion parameters of an external clock.
+ *
+ * This service lets applications read the external @a clock from
+ * user space without issuing any syscall, provided its time may be
+ * expressed as a linear function of the core cycle counter
+ * (i.e. xnclock_core_read_raw()), as follows:
+ *
+ * ns = @a base_ns + (((cycles - @a base_cycles) & @a mask) * @a mult) >> @a shift
+ *
+ * Clocks using xnclock_core_read_cycles() as their read_raw handler
+ * need not call this service: Cobalt publishes their parameters when
+ * they are registered, set or adjusted. Other drivers must refresh
+ * the parameters each time the clock is set or adjusted. Calling
+ * cobalt_clock_invalidate_vdso() reverts the applications to the
+ * clock_gettime() syscall.
+ *
+ * @param clock The clock to publish, previously registered with
+ * cobalt_clock_register().
+ *
+ * @param base_cycles The core cycle count at @a base_ns.
+ *
+ * @param base_ns The clock time at @a base_cycles.
+ *
+ * @param mask The valid bits of a cycle count difference.
+ *
+ * @param mult The cycles to nanoseconds multiplier.
+ *
+ * @param shift The cycles to nanoseconds shift.
+ *
+ * @coretags{unrestricted}
+ */
+void cobalt_clock_update_vdso(struct xnclock *clock,
+			      xnticks_t base_cycles, xnticks_t base_ns,
+			      xnticks_t mask, u32 mult, u32 shift)
+{
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	__update_vdso(clock, base_cycles, base_ns, mask, mult, shift);
+	xnlock_put_irqrestore(&nklock, s);
+}
+EXPORT_SYMBOL_GPL(cobalt_clock_update_vdso);
+
+/**
+ * @brief Withdraw the vDSO conversion parameters of an external clock.
+ *
+ * @param clock The clock to withdraw from the vDSO.
+ *
+ * @coretags{unrestricted}
+ */
+void cobalt_clock_invalidate_vdso(struct xnclock *clock)
+{
+	struct xnvdso_clock_data *data = &nkvdso->ext_clocks[clock->id];
+	urwstate_t tmp;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	unsynced_write_block(&tmp, &data->lock)
+		data->live = 0;
+
+	xnlock_put_irqrestore(&nklock, s);
+}
+EXPORT_SYMBOL_GPL(cobalt_clock_invalidate_vdso);
+
 void cobalt_clock_deregister(struct xnclock *clock)
 {
 	trace_cobalt_clock_deregister(clock->name, clock->id);
+	cobalt_clock_invalidate_vdso(clock);
 	clear_bit(clock->id, cobalt_clock_extids);
 	smp_mb__after_atomic();
 	external_clocks[clock->id] = NULL;
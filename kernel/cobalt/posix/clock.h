@@ -133,6 +133,12 @@ int cobalt_clock_register(struct xnclock *clock,
 
 void cobalt_clock_deregister(struct xnclock *clock);
 
+void cobalt_clock_update_vdso(struct xnclock *clock,
+			      xnticks_t base_cycles, xnticks_t base_ns,
+			      xnticks_t mask, u32 mult, u32 shift);
+
+void cobalt_clock_invalidate_vdso(struct xnclock *clock);
+
 struct xnclock *cobalt_clock_find(clockid_t clock_id);
 
 extern DECLARE_BITMAP(cobalt_clock_extids, COBALT_MAX_EXTCLOCKS);
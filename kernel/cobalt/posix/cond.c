@@ -174,7 +174,11 @@ static inline int cobalt_cond_timedwait_prologue(struct xnthread *cur,
 
 	/* There are three possible wakeup conditions :
 	   - cond_signal / cond_broadcast, no status bit is set, and the function
-	     should return 0 ;
+	     should return 0. We have been moved to the mutex wait queue
+	     by the signaling thread then granted the mutex, so the
+	     epilogue does not block. Our timeout was cancelled upon
+	     requeuing, so XNTIMEO can't be raised after we have been
+	     signaled ;
 	   - timeout, the status XNTIMEO is set, and the function should return
 	     ETIMEDOUT ;
 	   - pthread_kill, the status bit XNBREAK is set, but ignored, the
@@ -377,32 +381,42 @@ COBALT_SYSCALL(cond_wait_epilogue, primary,
 	return err;
 }
 
-int cobalt_cond_deferred_signals(struct cobalt_cond *cond)
+/*
+ * Called on behalf of curr, the owner of cond->mutex, which is about
+ * to release it. Instead of waking up the signaled threads, which
+ * would only have them block again on the mutex, move them to the
+ * mutex wait queue: the mutex release then hands it over to the
+ * first of them, which will pass it to the next one when unlocking,
+ * and so on (wait morphing). Should the requeue fail, fall back to
+ * waking them up, so that no signal is ever lost.
+ */
+int cobalt_cond_deferred_signals(struct xnthread *curr,
+				 struct cobalt_cond *cond)
 {
 	struct cobalt_cond_state *state;
 	__u32 pending_signals;
-	int need_resched;
+	int need_resched, nr;
 
 	state = cond->state;
 	pending_signals = state->pending_signals;
+	if (pending_signals == 0)
+		return 0;
 
-	switch(pending_signals) {
-	default:
+	nr = pending_signals == ~0U ? INT_MAX : (int)pending_signals;
+	if (xnsynch_requeue_sleepers(&cond->synchbase,
+				     &cond->mutex->synchbase, curr, nr) > 0 ||
+	    !xnsynch_pended_p(&cond->synchbase)) {
 		state->pending_signals = 0;
-		need_resched = xnsynch_wakeup_many_sleepers(&cond->synchbase,
-							    pending_signals);
-		break;
+		return 0;
+	}
 
-	case ~0U:
+	if (pending_signals == ~0U)
 		need_resched =
 			xnsynch_flush(&cond->synchbase, 0) == XNSYNCH_RESCHED;
-		state->pending_signals = 0;
-		break;
-
-	case 0:
-		need_resched = 0;
-		break;
-	}
+	else
+		need_resched = xnsynch_wakeup_many_sleepers(&cond->synchbase,
+							    pending_signals);
+	state->pending_signals = 0;
 
 	return need_resched;
 }
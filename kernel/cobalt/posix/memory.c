@@ -254,8 +254,15 @@ static struct rtdm_device sysmem_device = {
 
 static inline void init_vdso(void)
 {
+	int n;
+
 	nkvdso->features = XNVDSO_FEATURES;
 	nkvdso->wallclock_offset = nkclock.wallclock_offset;
+
+	for (n = 0; n < COBALT_MAX_EXTCLOCKS; n++) {
+		unsynced_rw_init(&nkvdso->ext_clocks[n].lock);
+		nkvdso->ext_clocks[n].live = 0;
+	}
 }
 
 int cobalt_memdev_init(void)
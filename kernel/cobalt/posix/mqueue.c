@@ -19,9 +19,11 @@
 #include <stdarg.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
+#include <linux/log2.h>
 #include <linux/sched.h>
 #include <cobalt/kernel/select.h>
 #include <rtdm/fd.h>
+#include <cobalt/uapi/mqueue.h>
 #include "internal.h"
 #include "thread.h"
 #include "signal.h"
@@ -46,6 +48,8 @@ struct cobalt_mq {
 	struct list_head queued;
 	struct list_head avail;
 	int nrqueued;
+	/* COBALT_MQ_FASTPATH: messages live in a shared ring instead. */
+	struct cobalt_mq_ring ring;
 
 	/* mq_notify */
 	struct siginfo si;
@@ -99,10 +103,62 @@ static inline void mq_msg_free(struct cobalt_mq *mq, struct cobalt_msg * msg)
 	list_add(&msg->link, &mq->avail); /* For earliest re-use of the block. */
 }
 
+static inline bool mq_ring_p(struct cobalt_mq *mq)
+{
+	return mq->ring.state != NULL;
+}
+
+static int mq_ring_init(struct cobalt_mq *mq, struct mq_attr *attr)
+{
+	struct cobalt_umm *umm = &cobalt_ppd_get(1)->umm;
+	struct cobalt_mq_state *state;
+	struct cobalt_mq_slot *slot;
+	unsigned long nslots;
+	u32 slotsz, size, n;
+
+	nslots = roundup_pow_of_two(attr->mq_maxmsg);
+	slotsz = ALIGN(sizeof(*slot) + attr->mq_msgsize, sizeof(u64));
+	if ((u64)nslots * slotsz + sizeof(*state) > U32_MAX)
+		return -ENOSPC;
+
+	size = sizeof(*state) + nslots * slotsz;
+	state = cobalt_umm_alloc(umm, size);
+	if (state == NULL)
+		return -ENOSPC;
+
+	atomic_set(&state->head, 0);
+	atomic_set(&state->tail, 0);
+	atomic_set(&state->rwaiters, 0);
+	atomic_set(&state->swaiters, 0);
+	state->flags = 0;
+	state->nslots = nslots;
+	state->slotsz = slotsz;
+	state->msgsize = attr->mq_msgsize;
+
+	INIT_LIST_HEAD(&mq->avail);
+	mq->ring.state = state;
+	mq->ring.mask = nslots - 1;
+	mq->ring.slotsz = slotsz;
+	mq->ring.msgsize = attr->mq_msgsize;
+
+	for (n = 0; n < nslots; n++) {
+		slot = cobalt_mq_slot(&mq->ring, n);
+		atomic_set(&slot->seq, n);
+	}
+
+	attr->mq_maxmsg = nslots;
+	mq->memsize = 0;
+	mq->mem = NULL;
+
+	return 0;
+}
+
 static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 {
 	unsigned i, msgsize, memsize;
+	struct mq_attr _attr;
 	char *mem;
+	int ret;
 
 	if (attr == NULL)
 		attr = &default_attr;
@@ -115,6 +171,22 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 			return -EINVAL;
 	}
 
+	mq->ring.state = NULL;
+
+	/*
+	 * Only honour the fast path bit if mq_flags is otherwise
+	 * clean, POSIX applications may leave it uninitialized.
+	 */
+	if ((attr->mq_flags & COBALT_MQ_FASTPATH) &&
+	    (attr->mq_flags & ~(COBALT_MQ_FASTPATH | O_NONBLOCK)) == 0) {
+		_attr = *attr;
+		ret = mq_ring_init(mq, &_attr);
+		if (ret)
+			return ret;
+		attr = &_attr;
+		goto init;
+	}
+
 	msgsize = attr->mq_msgsize + sizeof(struct cobalt_msg);
 
 	/* Align msgsize on natural boundary. */
@@ -132,10 +204,6 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 		return -ENOSPC;
 
 	mq->memsize = memsize;
-	INIT_LIST_HEAD(&mq->queued);
-	mq->nrqueued = 0;
-	xnsynch_init(&mq->receivers, XNSYNCH_PRIO, NULL);
-	xnsynch_init(&mq->senders, XNSYNCH_PRIO, NULL);
 	mq->mem = mem;
 
 	/* Fill the pool. */
@@ -144,7 +212,11 @@ static inline int mq_init(struct cobalt_mq *mq, const struct mq_attr *attr)
 		struct cobalt_msg *msg = (struct cobalt_msg *) (mem + i * msgsize);
 		mq_msg_free(mq, msg);
 	}
-
+init:
+	INIT_LIST_HEAD(&mq->queued);
+	mq->nrqueued = 0;
+	xnsynch_init(&mq->receivers, XNSYNCH_PRIO, NULL);
+	xnsynch_init(&mq->senders, XNSYNCH_PRIO, NULL);
 	mq->attr = *attr;
 	mq->target = NULL;
 	xnselect_init(&mq->read_select);
@@ -169,7 +241,10 @@ static inline void mq_destroy(struct cobalt_mq *mq)
 	xnselect_destroy(&mq->read_select); /* Reschedules. */
 	xnselect_destroy(&mq->write_select); /* Ditto. */
 	xnregistry_remove(mq->handle);
-	xnheap_vfree(mq->mem);
+	if (mq_ring_p(mq))
+		cobalt_umm_free(&cobalt_ppd_get(1)->umm, mq->ring.state);
+	else
+		xnheap_vfree(mq->mem);
 	kfree(mq);
 }
 
@@ -194,6 +269,97 @@ static int mq_unref(struct cobalt_mq *mq)
 	return mq_unref_inner(mq, s);
 }
 
+static inline void mq_ring_set_kick(struct cobalt_mq *mq)
+{
+	struct cobalt_mq_state *state = mq->ring.state;
+
+	WRITE_ONCE(state->flags, state->flags | COBALT_MQ_KICK);
+	smp_mb();
+}
+
+/* nklock held, irqs off. */
+static void mq_ring_notify(struct cobalt_mq *mq)
+{
+	struct cobalt_sigpending *sigp;
+
+	if (cobalt_mq_empty_p(&mq->ring)) {
+		xnselect_signal(&mq->read_select, 0);
+	} else {
+		xnselect_signal(&mq->read_select, 1);
+		if (mq->target && !xnsynch_pended_p(&mq->receivers)) {
+			sigp = cobalt_signal_alloc();
+			if (sigp) {
+				cobalt_copy_siginfo(SI_MESGQ, &sigp->si, &mq->si);
+				if (cobalt_signal_send(mq->target, sigp, 0) <= 0)
+					cobalt_signal_free(sigp);
+			}
+			mq->target = NULL;
+		}
+	}
+
+	xnselect_signal(&mq->write_select, !cobalt_mq_full_p(&mq->ring));
+}
+
+/*
+ * Let waiters know about a state change of the ring: a message was
+ * sent (@sent) or a slot was freed.
+ */
+static void mq_ring_kick(struct cobalt_mq *mq, bool sent)
+{
+	struct xnsynch *synch = sent ? &mq->receivers : &mq->senders;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (xnsynch_pended_p(synch))
+		xnsynch_wakeup_one_sleeper(synch);
+
+	mq_ring_notify(mq);
+	xnsched_run();
+
+	xnlock_put_irqrestore(&nklock, s);
+}
+
+static inline void mq_ring_post(struct cobalt_mq *mq, bool sent)
+{
+	struct cobalt_mq_state *state = mq->ring.state;
+
+	smp_mb();
+	if (atomic_read(sent ? &state->rwaiters : &state->swaiters) ||
+	    (READ_ONCE(state->flags) & COBALT_MQ_KICK))
+		mq_ring_kick(mq, sent);
+}
+
+/*
+ * Sleep until the ring is not full (@send) or not empty anymore,
+ * nklock held, irqs off.
+ */
+static int mq_ring_wait(struct cobalt_mq *mq, bool send,
+			xnticks_t to, xntmode_t tmode)
+{
+	struct cobalt_mq_state *state = mq->ring.state;
+	atomic_t *waiters = send ? &state->swaiters : &state->rwaiters;
+	int ret = 0;
+
+	atomic_inc(waiters);
+	smp_mb();
+
+	if (send ? cobalt_mq_full_p(&mq->ring) : cobalt_mq_empty_p(&mq->ring))
+		ret = xnsynch_sleep_on(send ? &mq->senders : &mq->receivers,
+				       to, tmode);
+
+	atomic_dec(waiters);
+
+	if (ret & XNBREAK)
+		return -EINTR;
+	if (ret & XNTIMEO)
+		return -ETIMEDOUT;
+	if (ret & XNRMID)
+		return -EBADF;
+
+	return 0;
+}
+
 static void mqd_close(struct rtdm_fd *fd)
 {
 	struct cobalt_mqd *mqd = container_of(fd, struct cobalt_mqd, fd);
@@ -223,6 +389,13 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 	xnlock_get_irqsave(&nklock, s);
 	mq = mqd->mq;
 
+	/*
+	 * The fast path must now tell us about every state change,
+	 * for updating the selectors.
+	 */
+	if (mq_ring_p(mq))
+		mq_ring_set_kick(mq);
+
 	switch(type) {
 	case XNSELECT_READ:
 		err = -EBADF;
@@ -231,6 +404,7 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->read_select, binding,
 				selector, type, index,
+				mq_ring_p(mq) ? !cobalt_mq_empty_p(&mq->ring) :
 				!list_empty(&mq->queued));
 		if (err)
 			goto unlock_and_error;
@@ -243,6 +417,7 @@ mqd_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 		err = xnselect_bind(&mq->write_select, binding,
 				selector, type, index,
+				mq_ring_p(mq) ? !cobalt_mq_full_p(&mq->ring) :
 				!list_empty(&mq->avail));
 		if (err)
 			goto unlock_and_error;
@@ -672,7 +847,14 @@ static inline int mq_getattr(struct cobalt_mqd *mqd, struct mq_attr *attr)
 	*attr = mq->attr;
 	xnlock_get_irqsave(&nklock, s);
 	attr->mq_flags = rtdm_fd_flags(&mqd->fd);
-	attr->mq_curmsgs = mq->nrqueued;
+	if (mq_ring_p(mq)) {
+		attr->mq_flags |= COBALT_MQ_FASTPATH;
+		attr->mq_curmsgs = clamp_t(int,
+				atomic_read(&mq->ring.state->head) -
+				atomic_read(&mq->ring.state->tail),
+				0, mq->attr.mq_maxmsg);
+	} else
+		attr->mq_curmsgs = mq->nrqueued;
 	xnlock_put_irqrestore(&nklock, s);
 
 	return 0;
@@ -719,6 +901,8 @@ mq_notify(struct cobalt_mqd *mqd, unsigned index, const struct sigevent *evp)
 		 */
 		mq->si.si_pid = task_pid_nr(current);
 		mq->si.si_uid = get_current_uuid();
+		if (mq_ring_p(mq))
+			mq_ring_set_kick(mq);
 	}
 
 	xnlock_put_irqrestore(&nklock, s);
@@ -887,6 +1071,158 @@ static inline int mq_fetch_timeout(struct timespec64 *ts,
 		cobalt_copy_from_user(ts, u_ts, sizeof(*ts));
 }
 
+static int mq_ring_fetch_timeout(xnticks_t *to, xntmode_t *tmode,
+				 const void __user *u_ts,
+				 int (*fetch_timeout)(struct timespec64 *ts,
+						      const void __user *u_ts))
+{
+	struct timespec64 ts;
+	int ret;
+
+	ret = fetch_timeout(&ts, u_ts);
+	if (ret)
+		return ret;
+
+	if ((unsigned long)ts.tv_nsec >= ONE_BILLION)
+		return -EINVAL;
+
+	*to = ts2ns(&ts) + 1;
+	*tmode = XN_REALTIME;
+
+	return 0;
+}
+
+static int mq_ring_send(struct cobalt_mqd *mqd,
+			const void __user *u_buf, size_t len,
+			unsigned int prio, const void __user *u_ts,
+			int (*fetch_timeout)(struct timespec64 *ts,
+					     const void __user *u_ts))
+{
+	struct cobalt_mq *mq = mqd->mq;
+	struct cobalt_mq_slot *slot;
+	xntmode_t tmode = XN_RELATIVE;
+	xnticks_t to = XN_INFINITE;
+	unsigned int flags;
+	__u32 pos;
+	int ret;
+	spl_t s;
+
+	flags = rtdm_fd_flags(&mqd->fd) & COBALT_PERMS_MASK;
+	if (flags != O_WRONLY && flags != O_RDWR)
+		return -EBADF;
+
+	if (len > mq->attr.mq_msgsize)
+		return -EMSGSIZE;
+
+	for (;;) {
+		ret = cobalt_mq_claim_send(&mq->ring, &slot, &pos);
+		if (ret == 0)
+			break;
+		if (ret != -EAGAIN)
+			return ret;	/* Ring trashed by user space. */
+
+		if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
+			return -EAGAIN;
+
+		if (fetch_timeout) {
+			ret = mq_ring_fetch_timeout(&to, &tmode,
+						    u_ts, fetch_timeout);
+			if (ret)
+				return ret;
+			fetch_timeout = NULL;
+			continue;
+		}
+
+		xnlock_get_irqsave(&nklock, s);
+		ret = mq_ring_wait(mq, true, to, tmode);
+		xnlock_put_irqrestore(&nklock, s);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * The slot is ours, a failed copy still has to be published,
+	 * receivers will skip it.
+	 */
+	ret = cobalt_copy_from_user(slot->data, u_buf, len);
+	slot->len = ret ? COBALT_MQ_VOID : len;
+	slot->prio = prio;
+	cobalt_mq_commit_send(slot, pos);
+	mq_ring_post(mq, true);
+
+	return ret;
+}
+
+static int mq_ring_receive(struct cobalt_mqd *mqd,
+			   void __user *u_buf, ssize_t *lenp,
+			   unsigned int *priop, const void __user *u_ts,
+			   int (*fetch_timeout)(struct timespec64 *ts,
+						const void __user *u_ts))
+{
+	struct cobalt_mq *mq = mqd->mq;
+	struct cobalt_mq_slot *slot;
+	xntmode_t tmode = XN_RELATIVE;
+	xnticks_t to = XN_INFINITE;
+	unsigned int flags;
+	__u32 pos, len;
+	int ret;
+	spl_t s;
+
+	flags = rtdm_fd_flags(&mqd->fd) & COBALT_PERMS_MASK;
+	if (flags != O_RDONLY && flags != O_RDWR)
+		return -EBADF;
+
+	if (*lenp < mq->attr.mq_msgsize)
+		return -EMSGSIZE;
+
+	for (;;) {
+		ret = cobalt_mq_claim_receive(&mq->ring, &slot, &pos);
+		if (ret == 0) {
+			len = READ_ONCE(slot->len);
+			if (len != COBALT_MQ_VOID)
+				break;
+			cobalt_mq_commit_receive(&mq->ring, slot, pos);
+			mq_ring_post(mq, false);
+			continue;
+		}
+		if (ret != -EAGAIN)
+			return ret;	/* Ring trashed by user space. */
+
+		if (rtdm_fd_flags(&mqd->fd) & O_NONBLOCK)
+			return -EAGAIN;
+
+		if (fetch_timeout) {
+			ret = mq_ring_fetch_timeout(&to, &tmode,
+						    u_ts, fetch_timeout);
+			if (ret)
+				return ret;
+			fetch_timeout = NULL;
+			continue;
+		}
+
+		xnlock_get_irqsave(&nklock, s);
+		ret = mq_ring_wait(mq, false, to, tmode);
+		xnlock_put_irqrestore(&nklock, s);
+		if (ret)
+			return ret;
+	}
+
+	/* Shared memory, don't trust the length. */
+	if (len > mq->ring.msgsize)
+		len = mq->ring.msgsize;
+
+	*priop = READ_ONCE(slot->prio);
+	ret = cobalt_copy_to_user(u_buf, slot->data, len);
+	cobalt_mq_commit_receive(&mq->ring, slot, pos);
+	mq_ring_post(mq, false);
+	if (ret)
+		return ret;
+
+	*lenp = len;
+
+	return 0;
+}
+
 int __cobalt_mq_timedsend(mqd_t uqd, const void __user *u_buf, size_t len,
 			  unsigned int prio, const void __user *u_ts,
 			  int (*fetch_timeout)(struct timespec64 *ts,
@@ -911,6 +1247,11 @@ int __cobalt_mq_timedsend(mqd_t uqd, const void __user *u_buf, size_t len,
 	}
 
 	trace_cobalt_mq_send(uqd, u_buf, len, prio);
+	if (mq_ring_p(mqd->mq)) {
+		ret = mq_ring_send(mqd, u_buf, len, prio, u_ts, fetch_timeout);
+		goto out;
+	}
+
 	msg = mq_timedsend_inner(mqd, len, u_ts, fetch_timeout);
 	if (IS_ERR(msg)) {
 		ret = PTR_ERR(msg);
@@ -960,6 +1301,14 @@ int __cobalt_mq_timedreceive(mqd_t uqd, void __user *u_buf,
 		goto fail;
 	}
 
+	if (mq_ring_p(mqd->mq)) {
+		ret = mq_ring_receive(mqd, u_buf, lenp, &prio,
+				      u_ts, fetch_timeout);
+		if (ret)
+			goto fail;
+		goto done;
+	}
+
 	msg = mq_timedrcv_inner(mqd, *lenp, u_ts, fetch_timeout);
 	if (IS_ERR(msg)) {
 		ret = PTR_ERR(msg);
@@ -977,7 +1326,7 @@ int __cobalt_mq_timedreceive(mqd_t uqd, void __user *u_buf,
 	ret = mq_finish_rcv(mqd, msg);
 	if (ret)
 		goto fail;
-
+done:
 	cobalt_mqd_put(mqd);
 
 	if (u_prio && __xn_put_user(prio, u_prio))
@@ -1008,3 +1357,43 @@ COBALT_SYSCALL(mq_timedreceive, primary,
 
 	return ret ?: cobalt_copy_to_user(u_len, &len, sizeof(*u_len));
 }
+
+COBALT_SYSCALL(mq_ring, current, (mqd_t uqd, __u32 __user *u_offset))
+{
+	struct cobalt_mqd *mqd;
+	__u32 offset = 0;
+	int ret = 0;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	if (mq_ring_p(mqd->mq))
+		offset = cobalt_umm_offset(&cobalt_ppd_get(1)->umm,
+					   mqd->mq->ring.state);
+	else
+		ret = -ENOENT;
+
+	cobalt_mqd_put(mqd);
+
+	return ret ?: cobalt_copy_to_user(u_offset, &offset, sizeof(offset));
+}
+
+COBALT_SYSCALL(mq_kick, current, (mqd_t uqd, int sent))
+{
+	struct cobalt_mqd *mqd;
+	int ret = 0;
+
+	mqd = cobalt_mqd_get(uqd);
+	if (IS_ERR(mqd))
+		return PTR_ERR(mqd);
+
+	if (mq_ring_p(mqd->mq))
+		mq_ring_kick(mqd->mq, sent);
+	else
+		ret = -EINVAL;
+
+	cobalt_mqd_put(mqd);
+
+	return ret;
+}
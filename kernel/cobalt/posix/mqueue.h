@@ -71,4 +71,8 @@ COBALT_SYSCALL_DECL(mq_timedreceive,
 COBALT_SYSCALL_DECL(mq_notify,
 		    (mqd_t fd, const struct sigevent *__user evp));
 
+COBALT_SYSCALL_DECL(mq_ring, (mqd_t uqd, __u32 __user *u_offset));
+
+COBALT_SYSCALL_DECL(mq_kick, (mqd_t uqd, int sent));
+
 #endif /* !_COBALT_POSIX_MQUEUE_H */
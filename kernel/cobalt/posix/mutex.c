@@ -58,6 +58,9 @@ static int cobalt_mutex_init_inner(struct cobalt_mutex_shadow *shadow,
 
 	state->flags = (attr->type == PTHREAD_MUTEX_ERRORCHECK
 			? COBALT_MUTEX_ERRORCHECK : 0);
+	state->owner_window = COBALT_MUTEX_NOWINDOW;
+	atomic_set(&state->spin_hits, 0);
+	atomic_set(&state->spin_misses, 0);
 	mutex->attr = *attr;
 	INIT_LIST_HEAD(&mutex->conds);
 
@@ -68,6 +71,25 @@ static int cobalt_mutex_init_inner(struct cobalt_mutex_shadow *shadow,
 	return 0;
 }
 
+/*
+ * Publish the user window of the new owner of an adaptive mutex,
+ * which contenders look at for deciding whether to spin.
+ */
+static inline void mutex_track_owner(struct cobalt_mutex *mutex,
+				     struct xnthread *curr)
+{
+	struct cobalt_mutex_state *state;
+
+	if (mutex->attr.type != PTHREAD_MUTEX_ADAPTIVE_NP ||
+	    curr->u_window == NULL)
+		return;
+
+	state = container_of(mutex->synchbase.fastlock,
+			     struct cobalt_mutex_state, owner);
+	state->owner_window = cobalt_umm_offset(&cobalt_kernel_ppd.umm,
+						curr->u_window);
+}
+
 /* must be called with nklock locked, interrupts off. */
 int __cobalt_mutex_acquire_unchecked(struct xnthread *cur,
 				     struct cobalt_mutex *mutex,
@@ -90,6 +112,8 @@ int __cobalt_mutex_acquire_unchecked(struct xnthread *cur,
 		return -EINVAL;
 	}
 
+	mutex_track_owner(mutex, cur);
+
 	return 0;
 }
 
@@ -124,7 +148,7 @@ int cobalt_mutex_release(struct xnthread *curr,
 		if (!list_empty(&mutex->conds)) {
 			list_for_each_entry(cond, &mutex->conds, mutex_link)
 				need_resched |=
-				cobalt_cond_deferred_signals(cond);
+				cobalt_cond_deferred_signals(curr, cond);
 		}
 	}
 	need_resched |= xnsynch_release(&mutex->synchbase, curr);
@@ -187,6 +211,7 @@ redo:
 	ret = -EBUSY;
 	switch(mutex->attr.type) {
 	case PTHREAD_MUTEX_NORMAL:
+	case PTHREAD_MUTEX_ADAPTIVE_NP:
 		/* Attempting to relock a normal mutex, deadlock. */
 		if (IS_ENABLED(XENO_OPT_DEBUG_USER))
 			printk(XENO_WARNING
@@ -333,7 +358,8 @@ COBALT_SYSCALL(mutex_trylock, primary,
 	xnthread_commit_ceiling(curr);
 
 	ret = xnsynch_try_acquire(&mutex->synchbase);
-
+	if (ret == 0)
+		mutex_track_owner(mutex, curr);
 out:
 	xnlock_put_irqrestore(&nklock, s);
 
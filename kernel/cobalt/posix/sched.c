@@ -111,6 +111,18 @@ cobalt_sched_policy_param(union xnsched_policy_param *param,
 		param->quota.tgid = param_ex->sched_quota_group;
 		sched_class = &xnsched_class_quota;
 		break;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	case SCHED_EDF:
+		param->edf.prio = param_ex->sched_priority;
+		param->edf.runtime = u_ts2ns(&param_ex->sched_edf_runtime);
+		param->edf.deadline = u_ts2ns(&param_ex->sched_edf_deadline);
+		param->edf.period = u_ts2ns(&param_ex->sched_edf_period);
+		/* Implicit deadline if unspecified. */
+		if (param->edf.deadline == XN_INFINITE)
+			param->edf.deadline = param->edf.period;
+		sched_class = &xnsched_class_edf;
+		break;
 #endif
 	default:
 		return NULL;
@@ -132,6 +144,7 @@ COBALT_SYSCALL(sched_minprio, current, (int policy))
 	case SCHED_SPORADIC:
 	case SCHED_TP:
 	case SCHED_QUOTA:
+	case SCHED_EDF:
 		ret = XNSCHED_FIFO_MIN_PRIO;
 		break;
 	case SCHED_COBALT:
@@ -160,6 +173,7 @@ COBALT_SYSCALL(sched_maxprio, current, (int policy))
 	case SCHED_SPORADIC:
 	case SCHED_TP:
 	case SCHED_QUOTA:
+	case SCHED_EDF:
 		ret = XNSCHED_FIFO_MAX_PRIO;
 		break;
 	case SCHED_COBALT:
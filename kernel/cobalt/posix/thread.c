@@ -337,6 +337,14 @@ int __cobalt_thread_getschedparam_ex(struct cobalt_thread *thread,
 		goto out;
 	}
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	if (base_class == &xnsched_class_edf) {
+		u_ns2ts(&param_ex->sched_edf_runtime, base_thread->edf->param.runtime);
+		u_ns2ts(&param_ex->sched_edf_deadline, base_thread->edf->param.deadline);
+		u_ns2ts(&param_ex->sched_edf_period, base_thread->edf->param.period);
+		goto out;
+	}
+#endif
 
 out:
 	xnlock_put_irqrestore(&nklock, s);
@@ -925,6 +933,17 @@ const char *cobalt_trace_parse_sched_params(struct trace_seq *p, int policy,
 				 params->sched_priority,
 				 params->sched_tp_partition);
 		break;
+	case SCHED_EDF:
+		trace_seq_printf(p, "priority=%d, runtime=(%ld.%09ld), "
+				 "deadline=(%ld.%09ld), period=(%ld.%09ld)",
+				 params->sched_priority,
+				 params->sched_edf_runtime.tv_sec,
+				 params->sched_edf_runtime.tv_nsec,
+				 params->sched_edf_deadline.tv_sec,
+				 params->sched_edf_deadline.tv_nsec,
+				 params->sched_edf_period.tv_sec,
+				 params->sched_edf_period.tv_nsec);
+		break;
 	case SCHED_NORMAL:
 		break;
 	case SCHED_SPORADIC:
@@ -85,30 +85,10 @@ nanosecs_abs_t rtdm_clock_read_monotonic(void);
  * @{
  */
 
-/**
- * @brief Initialise and start a real-time task
- *
- * After initialising a task, the task handle remains valid and can be
- * passed to RTDM services until either rtdm_task_destroy() or
- * rtdm_task_join() was invoked.
- *
- * @param[in,out] task Task handle
- * @param[in] name Optional task name
- * @param[in] task_proc Procedure to be executed by the task
- * @param[in] arg Custom argument passed to @c task_proc() on entry
- * @param[in] priority Priority of the task, see also
- * @ref rtdmtaskprio "Task Priority Range"
- * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
- * mode. Waiting for the first and subsequent periodic events is
- * done using rtdm_task_wait_period().
- *
- * @return 0 on success, otherwise negative error code
- *
- * @coretags{secondary-only, might-switch}
- */
-int rtdm_task_init(rtdm_task_t *task, const char *name,
-		   rtdm_task_proc_t task_proc, void *arg,
-		   int priority, nanosecs_rel_t period)
+static int __rtdm_task_init(rtdm_task_t *task, const char *name,
+			    rtdm_task_proc_t task_proc, void *arg,
+			    int priority, nanosecs_rel_t period,
+			    const cpumask_t *affinity)
 {
 	union xnsched_policy_param param;
 	struct xnthread_start_attr sattr;
@@ -121,7 +101,7 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	iattr.name = name;
 	iattr.flags = 0;
 	iattr.personality = &xenomai_personality;
-	iattr.affinity = CPU_MASK_ALL;
+	iattr.affinity = *affinity;
 	param.rt.prio = priority;
 
 	err = xnthread_init(task, &iattr, &xnsched_class_rt, &param);
@@ -155,8 +135,73 @@ int rtdm_task_init(rtdm_task_t *task, const char *name,
 	return err;
 }
 
+/**
+ * @brief Initialise and start a real-time task
+ *
+ * After initialising a task, the task handle remains valid and can be
+ * passed to RTDM services until either rtdm_task_destroy() or
+ * rtdm_task_join() was invoked.
+ *
+ * @param[in,out] task Task handle
+ * @param[in] name Optional task name
+ * @param[in] task_proc Procedure to be executed by the task
+ * @param[in] arg Custom argument passed to @c task_proc() on entry
+ * @param[in] priority Priority of the task, see also
+ * @ref rtdmtaskprio "Task Priority Range"
+ * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
+ * mode. Waiting for the first and subsequent periodic events is
+ * done using rtdm_task_wait_period().
+ *
+ * @return 0 on success, otherwise negative error code
+ *
+ * @coretags{secondary-only, might-switch}
+ */
+int rtdm_task_init(rtdm_task_t *task, const char *name,
+		   rtdm_task_proc_t task_proc, void *arg,
+		   int priority, nanosecs_rel_t period)
+{
+	return __rtdm_task_init(task, name, task_proc, arg,
+				priority, period, &CPU_MASK_ALL);
+}
+
 EXPORT_SYMBOL_GPL(rtdm_task_init);
 
+/**
+ * @brief Initialise and start a real-time task pinned to a CPU
+ *
+ * Same as rtdm_task_init(), except that the task is bound to @a cpu
+ * for its whole lifetime.
+ *
+ * @param[in,out] task Task handle
+ * @param[in] name Optional task name
+ * @param[in] task_proc Procedure to be executed by the task
+ * @param[in] arg Custom argument passed to @c task_proc() on entry
+ * @param[in] priority Priority of the task, see also
+ * @ref rtdmtaskprio "Task Priority Range"
+ * @param[in] period Period in nanoseconds of a cyclic task, 0 for non-cyclic
+ * mode.
+ * @param[in] cpu CPU the task should run on, which must be part of
+ * the real-time CPU set.
+ *
+ * @return 0 on success, otherwise negative error code. -EINVAL is
+ * returned if @a cpu is not available to the real-time core.
+ *
+ * @coretags{secondary-only, might-switch}
+ */
+int rtdm_task_init_on_cpu(rtdm_task_t *task, const char *name,
+			  rtdm_task_proc_t task_proc, void *arg,
+			  int priority, nanosecs_rel_t period, int cpu)
+{
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_online(cpu) ||
+	    !xnsched_supported_cpu(cpu))
+		return -EINVAL;
+
+	return __rtdm_task_init(task, name, task_proc, arg,
+				priority, period, cpumask_of(cpu));
+}
+
+EXPORT_SYMBOL_GPL(rtdm_task_init_on_cpu);
+
 #ifdef DOXYGEN_CPP /* Only used for doxygen doc generation */
 /**
  * @brief Destroy a real-time task
@@ -1189,6 +1234,48 @@ void rtdm_sem_up(rtdm_sem_t *sem)
 
 EXPORT_SYMBOL_GPL(rtdm_sem_up);
 
+/**
+ * @brief Increment a semaphore by several units at once
+ *
+ * This function has the same effect as calling rtdm_sem_up() @a count
+ * times in a row, except that the caller is rescheduled at most once,
+ * after all waiters which could be satisfied were woken up.
+ *
+ * @param[in,out] sem Semaphore handle as returned by rtdm_sem_init()
+ * @param[in] count Number of units to add
+ *
+ * @coretags{unrestricted, might-switch}
+ */
+void rtdm_sem_up_count(rtdm_sem_t *sem, unsigned int count)
+{
+	int resched = 0;
+	spl_t s;
+
+	trace_cobalt_driver_sem_up(sem);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	for (; count > 0; count--) {
+		if (!xnsynch_wakeup_one_sleeper(&sem->synch_base))
+			break;
+		resched = 1;
+	}
+
+	if (count > 0) {
+		if (sem->value == 0 &&
+		    xnselect_signal(&sem->select_block, 1))
+			resched = 1;
+		sem->value += count;
+	}
+
+	if (resched)
+		xnsched_run();
+
+	xnlock_put_irqrestore(&nklock, s);
+}
+
+EXPORT_SYMBOL_GPL(rtdm_sem_up_count);
+
 /**
  * @brief Bind a selector to a semaphore
  *
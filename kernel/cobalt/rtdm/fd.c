@@ -24,6 +24,7 @@
 #include <linux/mm.h>
 #include <linux/poll.h>
 #include <linux/kthread.h>
+#include <linux/log2.h>
 #include <linux/fdtable.h>
 #include <cobalt/kernel/registry.h>
 #include <cobalt/kernel/lock.h>
@@ -42,10 +43,8 @@ DEFINE_PRIVATE_XNLOCK(fdtree_lock);
 static LIST_HEAD(rtdm_fd_cleanup_queue);
 static struct semaphore rtdm_fd_cleanup_sem;
 
-struct rtdm_fd_index {
-	struct xnid id;
-	struct rtdm_fd *fd;
-};
+/* Initial size of a per-process descriptor table. */
+#define RTDM_FD_TABLE_MIN  64
 
 static int enosys(void)
 {
@@ -57,23 +56,50 @@ static int eadv(void)
 	return -EADV;
 }
 
-static inline struct rtdm_fd_index *
-fetch_fd_index(struct cobalt_ppd *p, int ufd)
+/* fdtree_lock held, irqs off. */
+static inline struct rtdm_fd *fetch_fd(struct cobalt_ppd *p, int ufd)
 {
-	struct xnid *id = xnid_fetch(&p->fds, ufd);
-	if (id == NULL)
+	if ((unsigned int)ufd >= p->nr_fds)
 		return NULL;
 
-	return container_of(id, struct rtdm_fd_index, id);
+	return p->fds[ufd];
 }
 
-static struct rtdm_fd *fetch_fd(struct cobalt_ppd *p, int ufd)
+/*
+ * Grow the descriptor table of @p so that it may index @ufd. We
+ * allocate and free from the regular kernel, the table is swapped
+ * under fdtree_lock, so that lookups never observe it half-built.
+ */
+static int grow_fd_table(struct cobalt_ppd *p, int ufd)
 {
-	struct rtdm_fd_index *idx = fetch_fd_index(p, ufd);
-	if (idx == NULL)
-		return NULL;
+	struct rtdm_fd **table, **old;
+	unsigned int nr;
+	spl_t s;
+
+	secondary_mode_only();
+
+	nr = max_t(unsigned int, roundup_pow_of_two(ufd + 1),
+		   RTDM_FD_TABLE_MIN);
+	table = kvcalloc(nr, sizeof(*table), GFP_KERNEL);
+	if (table == NULL)
+		return -ENOMEM;
+
+	xnlock_get_irqsave(&fdtree_lock, s);
 
-	return idx->fd;
+	old = p->fds;
+	if (nr > p->nr_fds) {
+		if (old)
+			memcpy(table, old, p->nr_fds * sizeof(*table));
+		p->fds = table;
+		p->nr_fds = nr;
+	} else
+		old = table;	/* Someone else grew it meanwhile. */
+
+	xnlock_put_irqrestore(&fdtree_lock, s);
+
+	kvfree(old);
+
+	return 0;
 }
 
 #define assign_invalid_handler(__handler)				\
@@ -170,26 +196,34 @@ int rtdm_fd_enter(struct rtdm_fd *fd, int ufd, unsigned int magic,
 
 int rtdm_fd_register(struct rtdm_fd *fd, int ufd)
 {
-	struct rtdm_fd_index *idx;
 	struct cobalt_ppd *ppd;
 	spl_t s;
-	int ret = 0;
+	int ret;
+
+	if (ufd < 0)
+		return -EBADF;
 
 	ppd = cobalt_ppd_get(0);
-	idx = kmalloc(sizeof(*idx), GFP_KERNEL);
-	if (idx == NULL)
-		return -ENOMEM;
+redo:
+	xnlock_get_irqsave(&fdtree_lock, s);
 
-	idx->fd = fd;
+	if ((unsigned int)ufd >= ppd->nr_fds) {
+		xnlock_put_irqrestore(&fdtree_lock, s);
+		ret = grow_fd_table(ppd, ufd);
+		if (ret)
+			return ret;
+		goto redo;
+	}
 
-	xnlock_get_irqsave(&fdtree_lock, s);
-	ret = xnid_enter(&ppd->fds, &idx->id, ufd);
-	xnlock_put_irqrestore(&fdtree_lock, s);
-	if (ret < 0) {
-		kfree(idx);
+	if (ppd->fds[ufd])
 		ret = -EBUSY;
+	else {
+		ppd->fds[ufd] = fd;
+		ret = 0;
 	}
 
+	xnlock_put_irqrestore(&fdtree_lock, s);
+
 	return ret;
 }
 
@@ -829,17 +863,14 @@ out:
 }
 
 static void
-__fd_close(struct cobalt_ppd *p, struct rtdm_fd_index *idx, spl_t s)
+__fd_close(struct cobalt_ppd *p, int ufd, struct rtdm_fd *fd, spl_t s)
 {
-	xnid_remove(&p->fds, &idx->id);
-	__put_fd(idx->fd, s);
-
-	kfree(idx);
+	p->fds[ufd] = NULL;
+	__put_fd(fd, s);
 }
 
 int rtdm_fd_close(int ufd, unsigned int magic)
 {
-	struct rtdm_fd_index *idx;
 	struct cobalt_ppd *ppd;
 	struct rtdm_fd *fd;
 	spl_t s;
@@ -849,13 +880,8 @@ int rtdm_fd_close(int ufd, unsigned int magic)
 	ppd = cobalt_ppd_get(0);
 
 	xnlock_get_irqsave(&fdtree_lock, s);
-	idx = fetch_fd_index(ppd, ufd);
-	if (idx == NULL)
-		goto eadv;
-
-	fd = idx->fd;
-	if (magic != 0 && fd->magic != magic) {
-eadv:
+	fd = fetch_fd(ppd, ufd);
+	if (fd == NULL || (magic != 0 && fd->magic != magic)) {
 		xnlock_put_irqrestore(&fdtree_lock, s);
 		return -EADV;
 	}
@@ -871,7 +897,7 @@ eadv:
 	 * descriptor was removed from the fdtable if some refs on
 	 * rtdm_fd are still pending.
 	 */
-	__fd_close(ppd, idx, s);
+	__fd_close(ppd, ufd, fd, s);
 	__close_fd(current->files, ufd);
 
 	return 0;
@@ -965,25 +991,29 @@ int rtdm_fd_select(int ufd, struct xnselector *selector,
 	return ret;
 }
 
-static void destroy_fd(void *cookie, struct xnid *id)
+void rtdm_fd_cleanup(struct cobalt_ppd *p)
 {
-	struct cobalt_ppd *p = cookie;
-	struct rtdm_fd_index *idx;
+	struct rtdm_fd *fd;
+	unsigned int ufd;
 	spl_t s;
 
-	idx = container_of(id, struct rtdm_fd_index, id);
-	xnlock_get_irqsave(&fdtree_lock, s);
-	__fd_close(p, idx, 0);
-}
-
-void rtdm_fd_cleanup(struct cobalt_ppd *p)
-{
 	/*
 	 * This is called on behalf of a (userland) task exit handler,
 	 * so we don't have to deal with the regular file descriptors,
 	 * we only have to empty our own index.
 	 */
-	xntree_cleanup(&p->fds, p, destroy_fd);
+	for (ufd = 0; ufd < p->nr_fds; ufd++) {
+		xnlock_get_irqsave(&fdtree_lock, s);
+		fd = p->fds[ufd];
+		if (fd)
+			__fd_close(p, ufd, fd, s);
+		else
+			xnlock_put_irqrestore(&fdtree_lock, s);
+	}
+
+	kvfree(p->fds);
+	p->fds = NULL;
+	p->nr_fds = 0;
 }
 
 void rtdm_fd_init(void)
@@ -0,0 +1,654 @@
+/*
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <cobalt/kernel/sched.h>
+#include <cobalt/kernel/heap.h>
+#include <cobalt/uapi/sched.h>
+
+/*
+ * With this policy, each thread owns a reservation defined by a
+ * runtime budget, a relative deadline and a period. Ready threads
+ * are picked by increasing absolute deadline, the class weighs
+ * more than the RT one so that EDF reservations are served first.
+ *
+ * Budgets are enforced the way a hard constant bandwidth server
+ * (CBS) does: a thread which overruns its budget is held until the
+ * next period of its reservation begins, at which point it receives
+ * a full budget and a postponed deadline. A thread waking up late
+ * in its period with a budget it could not consume before its
+ * current deadline without exceeding its reserved density gets a
+ * fresh reservation, which prevents it from stealing bandwidth
+ * from others.
+ *
+ * The bandwidth (runtime / period) of all reservations hosted by a
+ * CPU is capped to CONFIG_XENO_OPT_SCHED_EDF_BWLIMIT percent,
+ * updates exceeding this limit are denied.
+ */
+
+#define EDF_BW_LIMIT	\
+	((XNSCHED_EDF_BW_UNIT * CONFIG_XENO_OPT_SCHED_EDF_BWLIMIT) / 100)
+
+static inline unsigned long edf_ratio(xnticks_t runtime, xnticks_t span)
+{
+	return (unsigned long)xnarch_div64(runtime << XNSCHED_EDF_BW_SHIFT,
+					   span);
+}
+
+static inline int edf_deadline_before(xnticks_t a, xnticks_t b)
+{
+	return (xnsticks_t)(a - b) < 0;
+}
+
+static void edf_insert(struct xnthread *thread, int head)
+{
+	struct list_head *runnable = &thread->sched->edf.runnable;
+	struct xnthread *pos;
+
+	/*
+	 * Threads with the same deadline are queued in FIFO order,
+	 * unless the caller asks for LIFO (i.e. preemption).
+	 */
+	list_for_each_entry(pos, runnable, edf_link) {
+		if (head) {
+			if (!edf_deadline_before(pos->edf_deadline,
+						 thread->edf_deadline))
+				break;
+		} else if (edf_deadline_before(thread->edf_deadline,
+					       pos->edf_deadline))
+			break;
+	}
+
+	list_add_tail(&thread->edf_link, &pos->edf_link);
+}
+
+static void edf_set_deadline(struct xnthread *thread)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+
+	/*
+	 * A boosted thread runs with the deadline it inherited,
+	 * unless its own one is more urgent. xnsched_edf_trackprio()
+	 * resets the latter when the boost ends.
+	 */
+	if (xnthread_test_state(thread, XNBOOST) &&
+	    edf_deadline_before(thread->edf_deadline, edf->abs_deadline))
+		return;
+
+	thread->edf_deadline = edf->abs_deadline;
+}
+
+static void edf_recharge(struct xnsched_edf_data *edf, xnticks_t now)
+{
+	struct xnthread *thread = edf->thread;
+
+	edf->abs_deadline += edf->param.period;
+	if (!edf_deadline_before(now, edf->abs_deadline))
+		/* We are way behind, restart from now. */
+		edf->abs_deadline = now + edf->param.deadline;
+
+	edf->budget = edf->param.runtime;
+
+	/* Reorder the runqueue if the thread is linked to it. */
+	if (thread->sched_class == &xnsched_class_edf &&
+	    xnthread_test_state(thread, XNREADY) &&
+	    !list_empty(&thread->edf_link)) {
+		list_del(&thread->edf_link);
+		edf_set_deadline(thread);
+		edf_insert(thread, 0);
+	} else
+		edf_set_deadline(thread);
+}
+
+static void edf_replenish_handler(struct xntimer *timer)
+{
+	struct xnsched_edf_data *edf;
+	struct xnthread *thread;
+
+	edf = container_of(timer, struct xnsched_edf_data, repl_timer);
+	thread = edf->thread;
+
+	if (!edf->throttled)
+		return;
+
+	edf->throttled = 0;
+	edf_recharge(edf, xnclock_read_monotonic(&nkclock));
+
+	if (xnthread_test_state(thread, XNHELD))
+		xnthread_resume(thread, XNHELD);
+}
+
+static void edf_budget_handler(struct xntimer *timer)
+{
+	struct xnsched_edf_data *edf;
+	struct xnthread *thread;
+	xnticks_t now, date;
+	int ret;
+
+	edf = container_of(timer, struct xnsched_edf_data, budget_timer);
+	thread = edf->thread;
+	now = xnclock_read_monotonic(&nkclock);
+
+	edf->running = 0;
+	edf->budget = 0;
+
+	/*
+	 * Never hold a thread which is boosted by a PI owner
+	 * claim: we want it to release the resource asap. Postpone
+	 * its deadline instead, charging it a new budget.
+	 */
+	if (xnthread_test_state(thread, XNBOOST)) {
+		edf_recharge(edf, now);
+		xnsched_set_self_resched(thread->sched);
+		return;
+	}
+
+	date = edf->abs_deadline - edf->param.deadline + edf->param.period;
+	edf->throttled = 1;
+	xntimer_set_affinity(&edf->repl_timer, thread->sched);
+	ret = xntimer_start(&edf->repl_timer, date, XN_INFINITE, XN_ABSOLUTE);
+	if (ret == -ETIMEDOUT) {
+		/* Next period already started. */
+		edf->throttled = 0;
+		edf_recharge(edf, now);
+		xnsched_set_self_resched(thread->sched);
+		return;
+	}
+
+	xnthread_suspend(thread, XNHELD, XN_INFINITE, XN_RELATIVE, NULL);
+}
+
+static void edf_resume_activity(struct xnthread *thread)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+	xnticks_t now;
+	int ret;
+
+	if (edf->running || edf->throttled)
+		return;
+
+	now = xnclock_read_monotonic(&nkclock);
+	/*
+	 * We may not throttle a thread which is being switched in,
+	 * so a budget which ran out while the thread was switched
+	 * out is recharged on the spot, postponing its deadline
+	 * (i.e. soft CBS rule).
+	 */
+	if (edf->budget == 0)
+		edf_recharge(edf, now);
+
+	edf->resume_date = now;
+	edf->running = 1;
+	xntimer_set_affinity(&edf->budget_timer, thread->sched);
+	ret = xntimer_start(&edf->budget_timer, now + edf->budget,
+			    XN_INFINITE, XN_ABSOLUTE);
+	if (ret == -ETIMEDOUT) {
+		edf_recharge(edf, now);
+		xntimer_start(&edf->budget_timer, now + edf->budget,
+			      XN_INFINITE, XN_ABSOLUTE);
+	}
+}
+
+static void edf_suspend_activity(struct xnthread *thread)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+	xnticks_t now, consumed;
+
+	if (!edf->running)
+		return;
+
+	xntimer_stop(&edf->budget_timer);
+	edf->running = 0;
+	now = xnclock_read_monotonic(&nkclock);
+	consumed = now - edf->resume_date;
+	if ((xnsticks_t)consumed < 0)
+		consumed = 0;
+
+	edf->budget = consumed >= edf->budget ? 0 : edf->budget - consumed;
+}
+
+static void edf_check_wakeup(struct xnthread *thread)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+	xnticks_t now, left;
+
+	if (edf->throttled || edf->running)
+		return;
+
+	/*
+	 * CBS wakeup rule: keep the current reservation unless the
+	 * remaining budget could not be consumed before the current
+	 * deadline at the reserved density, start a fresh one
+	 * otherwise.
+	 */
+	now = xnclock_read_monotonic(&nkclock);
+	if (edf_deadline_before(now, edf->abs_deadline)) {
+		left = edf->abs_deadline - now;
+		if (edf->budget <= ((left * edf->density) >> XNSCHED_EDF_BW_SHIFT))
+			return;
+	}
+
+	edf->abs_deadline = now + edf->param.deadline;
+	edf->budget = edf->param.runtime;
+	edf_set_deadline(thread);
+}
+
+static void xnsched_edf_init(struct xnsched *sched)
+{
+	INIT_LIST_HEAD(&sched->edf.runnable);
+	sched->edf.bw_sum = 0;
+}
+
+static bool xnsched_edf_setparam(struct xnthread *thread,
+				 const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+	struct xnsched *sched = edf->sched;
+	bool effective;
+	xnticks_t now;
+
+	xnthread_clear_state(thread, XNWEAK);
+	effective = xnsched_set_effective_priority(thread, p->edf.prio);
+
+	sched->edf.bw_sum -= edf->bw;
+	edf->param = p->edf;
+	edf->bw = edf_ratio(p->edf.runtime, p->edf.period);
+	edf->density = edf_ratio(p->edf.runtime, p->edf.deadline);
+	sched->edf.bw_sum += edf->bw;
+
+	/*
+	 * A throttled thread will receive a budget conforming to
+	 * the new parameters from the pending replenishment.
+	 * Otherwise, start a fresh reservation.
+	 */
+	if (!edf->throttled) {
+		if (edf->running)
+			xntimer_stop(&edf->budget_timer);
+		now = xnclock_read_monotonic(&nkclock);
+		edf->abs_deadline = now + p->edf.deadline;
+		edf->budget = p->edf.runtime;
+		if (edf->running) {
+			edf->resume_date = now;
+			xntimer_start(&edf->budget_timer, now + edf->budget,
+				      XN_INFINITE, XN_ABSOLUTE);
+		}
+	}
+
+	if (effective)
+		thread->edf_deadline = edf->abs_deadline;
+
+	return effective;
+}
+
+static void xnsched_edf_getparam(struct xnthread *thread,
+				 union xnsched_policy_param *p)
+{
+	if (thread->edf)
+		p->edf = thread->edf->param;
+	else {
+		p->edf.runtime = 0;
+		p->edf.deadline = 0;
+		p->edf.period = 0;
+	}
+
+	p->edf.prio = thread->cprio;
+	p->edf.abs_deadline = thread->edf_deadline;
+}
+
+static void xnsched_edf_trackprio(struct xnthread *thread,
+				  const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+
+	if (p) {
+		/*
+		 * Inherit the deadline of the waiter, unless our own
+		 * reservation is more urgent.
+		 */
+		thread->cprio = p->edf.prio;
+		thread->edf_deadline = p->edf.abs_deadline;
+		if (edf && edf_deadline_before(edf->abs_deadline,
+					       thread->edf_deadline))
+			thread->edf_deadline = edf->abs_deadline;
+	} else {
+		thread->cprio = thread->bprio;
+		thread->edf_deadline = edf->abs_deadline;
+	}
+}
+
+static void xnsched_edf_protectprio(struct xnthread *thread, int prio)
+{
+	if (prio > XNSCHED_EDF_MAX_PRIO)
+		prio = XNSCHED_EDF_MAX_PRIO;
+
+	thread->cprio = prio;
+}
+
+static int xnsched_edf_chkparam(struct xnthread *thread,
+				const union xnsched_policy_param *p)
+{
+	struct xnsched *sched = thread->sched;
+	unsigned long bw, bw_sum;
+
+	if (p->edf.prio < XNSCHED_EDF_MIN_PRIO ||
+	    p->edf.prio > XNSCHED_EDF_MAX_PRIO)
+		return -EINVAL;
+
+	if (p->edf.runtime == 0 || p->edf.runtime == XN_INFINITE)
+		return -EINVAL;
+
+	if (p->edf.deadline < p->edf.runtime ||
+	    p->edf.period < p->edf.deadline)
+		return -EINVAL;
+
+	/* Admission control. */
+	bw = edf_ratio(p->edf.runtime, p->edf.period);
+	if (thread->base_class == &xnsched_class_edf) {
+		sched = thread->edf->sched;
+		bw_sum = sched->edf.bw_sum - thread->edf->bw;
+	} else
+		bw_sum = sched->edf.bw_sum;
+
+	if (bw_sum + bw > EDF_BW_LIMIT)
+		return -EBUSY;
+
+	return 0;
+}
+
+static int xnsched_edf_declare(struct xnthread *thread,
+			       const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *edf;
+
+	edf = xnmalloc(sizeof(*edf));
+	if (edf == NULL)
+		return -ENOMEM;
+
+	xntimer_init(&edf->budget_timer, &nkclock, edf_budget_handler,
+		     thread->sched, XNTIMER_IGRAVITY);
+	xntimer_set_name(&edf->budget_timer, "edf-budget");
+	xntimer_init(&edf->repl_timer, &nkclock, edf_replenish_handler,
+		     thread->sched, XNTIMER_IGRAVITY);
+	xntimer_set_name(&edf->repl_timer, "edf-replenish");
+
+	edf->abs_deadline = 0;
+	edf->budget = 0;
+	edf->resume_date = 0;
+	edf->bw = 0;
+	edf->density = 0;
+	edf->running = 0;
+	edf->throttled = 0;
+	edf->sched = thread->sched;
+	edf->thread = thread;
+	thread->edf = edf;
+
+	return 0;
+}
+
+static void xnsched_edf_forget(struct xnthread *thread)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+
+	edf->sched->edf.bw_sum -= edf->bw;
+	xntimer_destroy(&edf->budget_timer);
+	xntimer_destroy(&edf->repl_timer);
+
+	/*
+	 * Leaving the class releases a throttled thread, our caller
+	 * will queue it to the new class if nothing else blocks it.
+	 */
+	if (edf->throttled && xnthread_test_state(thread, XNHELD)) {
+		xnthread_clear_state(thread, XNHELD);
+		if (!xnthread_test_state(thread, XNTHREAD_BLOCK_BITS))
+			xnthread_set_state(thread, XNREADY);
+	}
+
+	xnfree(edf);
+	thread->edf = NULL;
+}
+
+static void xnsched_edf_migrate(struct xnthread *thread, struct xnsched *sched)
+{
+	struct xnsched_edf_data *edf = thread->edf;
+	union xnsched_policy_param param;
+
+	/*
+	 * Threads which are only boosted to this class have no
+	 * reservation to move.
+	 */
+	if (thread->base_class != &xnsched_class_edf)
+		return;
+
+	if (sched->edf.bw_sum + edf->bw <= EDF_BW_LIMIT) {
+		edf->sched->edf.bw_sum -= edf->bw;
+		sched->edf.bw_sum += edf->bw;
+		edf->sched = sched;
+		return;
+	}
+
+	/*
+	 * The remote CPU cannot admit our reservation: move the
+	 * thread to the RT class, a subsequent call to
+	 * __xnthread_set_schedparam() may bring it back to EDF
+	 * scheduling if bandwidth becomes available.
+	 */
+	param.rt.prio = thread->cprio;
+	__xnthread_set_schedparam(thread, &xnsched_class_rt, &param);
+}
+
+static void xnsched_edf_enqueue(struct xnthread *thread)
+{
+	if (thread->base_class == &xnsched_class_edf &&
+	    !xnthread_test_state(thread, XNBOOST))
+		edf_check_wakeup(thread);
+
+	edf_insert(thread, 0);
+}
+
+static void xnsched_edf_dequeue(struct xnthread *thread)
+{
+	list_del_init(&thread->edf_link);
+}
+
+static void xnsched_edf_requeue(struct xnthread *thread)
+{
+	edf_insert(thread, 1);
+}
+
+static struct xnthread *xnsched_edf_pick(struct xnsched *sched)
+{
+	struct xnthread *curr = sched->curr, *next = NULL;
+
+	if (!list_empty(&sched->edf.runnable)) {
+		next = list_first_entry(&sched->edf.runnable,
+					struct xnthread, edf_link);
+		list_del_init(&next->edf_link);
+		/*
+		 * Arm the budget timer for the incoming EDF thread,
+		 * which may be the current one if it just joined the
+		 * class.
+		 */
+		if (next->edf)
+			edf_resume_activity(next);
+	}
+
+	/* Charge the outgoing thread for the time it consumed. */
+	if (curr != next && curr->edf)
+		edf_suspend_activity(curr);
+
+	return next;
+}
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+struct xnvfile_directory sched_edf_vfroot;
+
+struct vfile_sched_edf_priv {
+	struct xnthread *curr;
+};
+
+struct vfile_sched_edf_data {
+	int cpu;
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+	int cprio;
+	int throttled;
+	unsigned long bw;
+	xnticks_t runtime;
+	xnticks_t deadline;
+	xnticks_t period;
+};
+
+static struct xnvfile_snapshot_ops vfile_sched_edf_ops;
+
+static struct xnvfile_snapshot vfile_sched_edf = {
+	.privsz = sizeof(struct vfile_sched_edf_priv),
+	.datasz = sizeof(struct vfile_sched_edf_data),
+	.tag = &nkthreadlist_tag,
+	.ops = &vfile_sched_edf_ops,
+};
+
+static int vfile_sched_edf_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_sched_edf_priv *priv = xnvfile_iterator_priv(it);
+	int nrthreads = xnsched_class_edf.nthreads;
+
+	if (nrthreads == 0)
+		return -ESRCH;
+
+	priv->curr = list_first_entry(&nkthreadq, struct xnthread, glink);
+
+	return nrthreads;
+}
+
+static int vfile_sched_edf_next(struct xnvfile_snapshot_iterator *it,
+				void *data)
+{
+	struct vfile_sched_edf_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_sched_edf_data *p = data;
+	struct xnthread *thread;
+
+	if (priv->curr == NULL)
+		return 0;	/* All done. */
+
+	thread = priv->curr;
+	if (list_is_last(&thread->glink, &nkthreadq))
+		priv->curr = NULL;
+	else
+		priv->curr = list_next_entry(thread, glink);
+
+	if (thread->base_class != &xnsched_class_edf)
+		return VFILE_SEQ_SKIP;
+
+	p->cpu = xnsched_cpu(thread->sched);
+	p->pid = xnthread_host_pid(thread);
+	memcpy(p->name, thread->name, sizeof(p->name));
+	p->cprio = thread->cprio;
+	p->throttled = thread->edf->throttled;
+	p->bw = thread->edf->bw;
+	p->runtime = thread->edf->param.runtime;
+	p->deadline = thread->edf->param.deadline;
+	p->period = thread->edf->param.period;
+
+	return 1;
+}
+
+static int vfile_sched_edf_show(struct xnvfile_snapshot_iterator *it,
+				void *data)
+{
+	char rtbuf[16], dlbuf[16], ptbuf[16], bwbuf[16];
+	struct vfile_sched_edf_data *p = data;
+
+	if (p == NULL)
+		xnvfile_printf(it,
+			       "%-3s  %-6s %-4s %-10s %-10s %-10s %-7s %s\n",
+			       "CPU", "PID", "PRI", "RUNTIME", "DEADLINE",
+			       "PERIOD", "BW", "NAME");
+	else {
+		xntimer_format_time(p->runtime, rtbuf, sizeof(rtbuf));
+		xntimer_format_time(p->deadline, dlbuf, sizeof(dlbuf));
+		xntimer_format_time(p->period, ptbuf, sizeof(ptbuf));
+		ksformat(bwbuf, sizeof(bwbuf), "%3lu%%%c",
+			 (p->bw * 100) >> XNSCHED_EDF_BW_SHIFT,
+			 p->throttled ? '*' : ' ');
+
+		xnvfile_printf(it,
+			       "%3u  %-6d %-4d %-10s %-10s %-10s %-7s %s\n",
+			       p->cpu,
+			       p->pid,
+			       p->cprio,
+			       rtbuf,
+			       dlbuf,
+			       ptbuf,
+			       bwbuf,
+			       p->name);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops vfile_sched_edf_ops = {
+	.rewind = vfile_sched_edf_rewind,
+	.next = vfile_sched_edf_next,
+	.show = vfile_sched_edf_show,
+};
+
+static int xnsched_edf_init_vfile(struct xnsched_class *schedclass,
+				  struct xnvfile_directory *vfroot)
+{
+	int ret;
+
+	ret = xnvfile_init_dir(schedclass->name, &sched_edf_vfroot, vfroot);
+	if (ret)
+		return ret;
+
+	return xnvfile_init_snapshot("threads", &vfile_sched_edf,
+				     &sched_edf_vfroot);
+}
+
+static void xnsched_edf_cleanup_vfile(struct xnsched_class *schedclass)
+{
+	xnvfile_destroy_snapshot(&vfile_sched_edf);
+	xnvfile_destroy_dir(&sched_edf_vfroot);
+}
+
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+struct xnsched_class xnsched_class_edf = {
+	.sched_init		=	xnsched_edf_init,
+	.sched_enqueue		=	xnsched_edf_enqueue,
+	.sched_dequeue		=	xnsched_edf_dequeue,
+	.sched_requeue		=	xnsched_edf_requeue,
+	.sched_pick		=	xnsched_edf_pick,
+	.sched_tick		=	NULL,
+	.sched_rotate		=	NULL,
+	.sched_migrate		=	xnsched_edf_migrate,
+	.sched_chkparam		=	xnsched_edf_chkparam,
+	.sched_setparam		=	xnsched_edf_setparam,
+	.sched_getparam		=	xnsched_edf_getparam,
+	.sched_trackprio	=	xnsched_edf_trackprio,
+	.sched_protectprio	=	xnsched_edf_protectprio,
+	.sched_declare		=	xnsched_edf_declare,
+	.sched_forget		=	xnsched_edf_forget,
+	.sched_kick		=	NULL,
+#ifdef CONFIG_XENO_OPT_VFILE
+	.sched_init_vfile	=	xnsched_edf_init_vfile,
+	.sched_cleanup_vfile	=	xnsched_edf_cleanup_vfile,
+#endif
+	.weight			=	XNSCHED_CLASS_WEIGHT(5),
+	.policy			=	SCHED_EDF,
+	.name			=	"edf"
+};
+EXPORT_SYMBOL_GPL(xnsched_class_edf);
@@ -87,6 +87,9 @@ void xnsched_register_classes(void)
 	xnsched_register_class(&xnsched_class_quota);
 #endif
 	xnsched_register_class(&xnsched_class_rt);
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	xnsched_register_class(&xnsched_class_edf);
+#endif
 }
 
 #ifdef CONFIG_XENO_OPT_WATCHDOG
@@ -589,6 +592,7 @@ static void migrate_thread(struct xnthread *thread, struct xnsched *sched)
 	 * result of calling the per-class migration hook.
 	 */
 	thread->sched = sched;
+	xnstat_counter_inc(&thread->stat.mig);
 }
 
 /*
@@ -618,6 +622,102 @@ void xnsched_migrate_passive(struct xnthread *thread, struct xnsched *sched)
 	}
 }
 
+#ifdef CONFIG_XENO_OPT_SCHED_BALANCE
+
+#define BALANCE_WINDOW_NS	10000000	/* 10 ms */
+#define BALANCE_THRESHOLD	(CONFIG_XENO_OPT_SCHED_BALANCE_THRESHOLD * 10)
+
+static inline bool balance_same_domain(int cpu1, int cpu2)
+{
+	int size = CONFIG_XENO_OPT_SCHED_BALANCE_CLUSTER;
+
+	return size == 0 || cpu1 / size == cpu2 / size;
+}
+
+/*
+ * Refresh the load estimate of a CPU, based on the share of time
+ * its root thread did not run since the last sample. nklock held,
+ * interrupts off.
+ */
+static int balance_update_load(struct xnsched *sched, xnticks_t now)
+{
+	xnticks_t idle, span, idle_span, window;
+	int load;
+
+	window = xnclock_core_ns_to_ticks(BALANCE_WINDOW_NS);
+	span = now - sched->balance.last_date;
+	if (span < window)
+		return sched->balance.load;
+
+	idle = xnstat_exectime_get_total(&sched->rootcb.stat.account);
+	if (sched->curr == &sched->rootcb)
+		idle += now - xnstat_exectime_get_last_switch(sched);
+
+	idle_span = idle - sched->balance.last_idle;
+	if (idle_span > span)
+		idle_span = span;
+
+	/* span is at least one window, dividing it first cannot overflow. */
+	load = (int)xnarch_div64(span - idle_span, span / 1000);
+	if (load > 1000)
+		load = 1000;
+	/* Smooth out bursts, the average is weighted 3/4 on history. */
+	sched->balance.load = (sched->balance.load * 3 + load) / 4;
+	sched->balance.last_date = now;
+	sched->balance.last_idle = idle;
+
+	return sched->balance.load;
+}
+
+/**
+ * @internal
+ * @fn int xnsched_balance_target(struct xnthread *thread, int cpu)
+ * @brief Pick the CPU a thread should run on.
+ *
+ * Returns the least loaded real-time CPU @a thread may run on
+ * within the balancing domain of @a cpu, if the load difference
+ * with the latter exceeds the imbalance threshold. Otherwise, @a
+ * cpu is returned.
+ *
+ * @coretags{unrestricted, atomic-entry}
+ */
+int xnsched_balance_target(struct xnthread *thread, int cpu)
+{
+	int load, best_load, best_cpu, _cpu;
+	xnticks_t now;
+
+	if (!xnsched_threading_cpu(cpu))
+		return cpu;
+
+	now = xnstat_exectime_now();
+	load = balance_update_load(xnsched_struct(cpu), now);
+	if (load < BALANCE_THRESHOLD)
+		return cpu;
+
+	best_cpu = cpu;
+	best_load = load;
+
+	for_each_realtime_cpu(_cpu) {
+		if (_cpu == cpu || !xnsched_threading_cpu(_cpu) ||
+		    !cpumask_test_cpu(_cpu, &thread->affinity) ||
+		    !balance_same_domain(cpu, _cpu))
+			continue;
+		load = balance_update_load(xnsched_struct(_cpu), now);
+		if (load < best_load) {
+			best_load = load;
+			best_cpu = _cpu;
+		}
+	}
+
+	/* Moving is pointless unless the imbalance is significant. */
+	if (xnsched_struct(cpu)->balance.load - best_load < BALANCE_THRESHOLD)
+		return cpu;
+
+	return best_cpu;
+}
+
+#endif /* CONFIG_XENO_OPT_SCHED_BALANCE */
+
 #ifdef CONFIG_XENO_OPT_SCALABLE_SCHED
 
 void xnsched_initq(struct xnsched_mlq *q)
@@ -945,6 +1045,11 @@ int ___xnsched_run(struct xnsched *sched)
 	 * store tearing.
 	 */
 	WRITE_ONCE(sched->curr, next);
+	/*
+	 * Tell userland which threads are on a CPU, contenders on
+	 * adaptive mutexes spin only while the owner runs.
+	 */
+	xnthread_switch_window(prev, next);
 	leaving_inband = false;
 
 	if (xnthread_test_state(prev, XNROOT)) {
@@ -1152,6 +1257,7 @@ struct vfile_schedstat_data {
 	unsigned long csw;
 	unsigned long xsc;
 	unsigned long pf;
+	unsigned long mig;
 	xnticks_t exectime_period;
 	xnticks_t account_period;
 	xnticks_t exectime_total;
@@ -1220,6 +1326,7 @@ static int vfile_schedstat_next(struct xnvfile_snapshot_iterator *it,
 	p->csw = xnstat_counter_get(&thread->stat.csw);
 	p->xsc = xnstat_counter_get(&thread->stat.xsc);
 	p->pf = xnstat_counter_get(&thread->stat.pf);
+	p->mig = xnstat_counter_get(&thread->stat.mig);
 	p->sched_class = thread->sched_class;
 	p->cprio = thread->cprio;
 	p->period = xnthread_get_period(thread);
@@ -1265,6 +1372,7 @@ scan_irqs:
 	p->ssw = 0;
 	p->xsc = 0;
 	p->pf = 0;
+	p->mig = 0;
 	p->sched_class = &xnsched_class_idle;
 	p->cprio = 0;
 	p->period = 0;
@@ -1283,10 +1391,10 @@ static int vfile_schedstat_show(struct xnvfile_snapshot_iterator *it,
 
 	if (p == NULL)
 		xnvfile_printf(it,
-			       "%-3s  %-6s %-10s %-10s %-10s %-4s  %-8s  %5s"
+			       "%-3s  %-6s %-10s %-10s %-10s %-4s %-6s  %-8s  %5s"
 			       "  %s\n",
-			       "CPU", "PID", "MSW", "CSW", "XSC", "PF", "STAT", "%CPU",
-			       "NAME");
+			       "CPU", "PID", "MSW", "CSW", "XSC", "PF", "MIG", "STAT",
+			       "%CPU", "NAME");
 	else {
 		if (p->account_period) {
 			while (p->account_period > 0xffffffffUL) {
@@ -1298,10 +1406,10 @@ static int vfile_schedstat_show(struct xnvfile_snapshot_iterator *it,
 					      p->account_period, NULL);
 		}
 		xnvfile_printf(it,
-			       "%3u  %-6d %-10lu %-10lu %-10lu %-4lu  %.8x  %3u.%u"
+			       "%3u  %-6d %-10lu %-10lu %-10lu %-4lu %-6lu  %.8x  %3u.%u"
 			       "  %s%s%s\n",
-			       p->cpu, p->pid, p->ssw, p->csw, p->xsc, p->pf, p->state,
-			       usage / 10, usage % 10,
+			       p->cpu, p->pid, p->ssw, p->csw, p->xsc, p->pf, p->mig,
+			       p->state, usage / 10, usage % 10,
 			       (p->state & XNUSER) ? "" : "[",
 			       p->name,
 			       (p->state & XNUSER) ? "" : "]");
@@ -18,6 +18,7 @@
  */
 #include <stdarg.h>
 #include <linux/signal.h>
+#include <linux/hash.h>
 #include <cobalt/kernel/sched.h>
 #include <cobalt/kernel/synch.h>
 #include <cobalt/kernel/thread.h>
@@ -37,6 +38,140 @@ static inline int get_ceiling_value(struct xnsynch *synch)
 	return *synch->ceiling_ref & PP_CEILING_MASK ?: 1;
 }
 
+#ifdef CONFIG_XENO_OPT_SCALABLE_SYNCH
+
+#if XNSCHED_CORE_NR_PRIO > XNSYNCH_PENDQ_PRIOS
+#error "XNSYNCH_PENDQ_PRIOS is too low"
+#endif
+
+#define PENDQ_HASH_BITS  8
+
+/*
+ * The first sleeper of each level in a priority-ordered pendq is
+ * hashed on the (synch, level) pair, so that the insertion point of
+ * a new sleeper is found in constant time: right before the leader
+ * of the next occupied level, which the level bitmap of the object
+ * gives. All of this is nklock-protected.
+ */
+static struct hlist_head pendq_leaders[1 << PENDQ_HASH_BITS];
+
+static inline struct hlist_head *
+pendq_hash(struct xnsynch *synch, int level)
+{
+	return &pendq_leaders[hash_long((unsigned long)synch + level,
+					PENDQ_HASH_BITS)];
+}
+
+static inline int pendq_level(struct xnthread *thread)
+{
+	int rank = thread->wprio / XNSCHED_CLASS_WEIGHT_FACTOR;
+	int prio = thread->wprio % XNSCHED_CLASS_WEIGHT_FACTOR;
+
+	XENO_BUG_ON(COBALT, thread->wprio < 0 ||
+		    rank >= XNSYNCH_PENDQ_RANKS ||
+		    prio >= XNSYNCH_PENDQ_PRIOS);
+
+	return (XNSYNCH_PENDQ_RANKS - rank) * XNSYNCH_PENDQ_PRIOS - prio - 1;
+}
+
+static struct xnthread *pendq_leader(struct xnsynch *synch, int level)
+{
+	struct xnthread *thread;
+
+	hlist_for_each_entry(thread, pendq_hash(synch, level), pwait.hlink) {
+		if (thread->pwait.synch == synch &&
+		    thread->pwait.level == level)
+			return thread;
+	}
+
+	XENO_BUG(COBALT);
+
+	return NULL;
+}
+
+static void pendq_add(struct xnsynch *synch, struct xnthread *thread)
+{
+	struct xnthread *leader;
+	int level, next;
+
+	if ((synch->status & XNSYNCH_PRIO) == 0) { /* i.e. FIFO */
+		list_add_tail(&thread->plink, &synch->pendq);
+		return;
+	}
+
+	level = pendq_level(thread);
+	thread->pwait.level = level;
+	thread->pwait.synch = synch;
+
+	/* Queue behind the last sleeper of the same level. */
+	next = find_next_bit(synch->levels, XNSYNCH_PENDQ_LEVELS, level + 1);
+	if (next < XNSYNCH_PENDQ_LEVELS) {
+		leader = pendq_leader(synch, next);
+		list_add_tail(&thread->plink, &leader->plink);
+	} else
+		list_add_tail(&thread->plink, &synch->pendq);
+
+	if (!test_bit(level, synch->levels)) {
+		__set_bit(level, synch->levels);
+		hlist_add_head(&thread->pwait.hlink, pendq_hash(synch, level));
+	}
+}
+
+static void pendq_del(struct xnsynch *synch, struct xnthread *thread)
+{
+	struct xnthread *next;
+	int level;
+
+	if ((synch->status & XNSYNCH_PRIO) == 0) {
+		list_del(&thread->plink);
+		return;
+	}
+
+	level = thread->pwait.level;
+	if (list_first_entry(&synch->pendq, struct xnthread, plink) == thread ||
+	    list_prev_entry(thread, plink)->pwait.level != level) {
+		/* Leading its level, hand over to the next sleeper. */
+		hlist_del(&thread->pwait.hlink);
+		next = list_next_entry(thread, plink);
+		if (!list_is_last(&thread->plink, &synch->pendq) &&
+		    next->pwait.level == level)
+			hlist_add_head(&next->pwait.hlink,
+				       pendq_hash(synch, level));
+		else
+			__clear_bit(level, synch->levels);
+	}
+
+	list_del(&thread->plink);
+}
+
+static inline void pendq_init(struct xnsynch *synch)
+{
+	INIT_LIST_HEAD(&synch->pendq);
+	bitmap_zero(synch->levels, XNSYNCH_PENDQ_LEVELS);
+}
+
+#else /* !CONFIG_XENO_OPT_SCALABLE_SYNCH */
+
+static inline void pendq_add(struct xnsynch *synch, struct xnthread *thread)
+{
+	if ((synch->status & XNSYNCH_PRIO) == 0) /* i.e. FIFO */
+		list_add_tail(&thread->plink, &synch->pendq);
+	else /* i.e. priority-sorted */
+		list_add_priff(thread, &synch->pendq, wprio, plink);
+}
+
+static inline void pendq_del(struct xnsynch *synch, struct xnthread *thread)
+{
+	list_del(&thread->plink);
+}
+
+static inline void pendq_init(struct xnsynch *synch)
+{
+	INIT_LIST_HEAD(&synch->pendq);
+}
+
+#endif /* !CONFIG_XENO_OPT_SCALABLE_SYNCH */
+
 struct xnsynch *lookup_lazy_pp(xnhandle_t handle);
 
 /**
@@ -97,7 +232,7 @@ void xnsynch_init(struct xnsynch *synch, int flags, atomic_t *fastlock)
 	synch->cleanup = NULL;	/* for PI/PP only. */
 	synch->wprio = -1;
 	synch->ceiling_ref = NULL;
-	INIT_LIST_HEAD(&synch->pendq);
+	pendq_init(synch);
 
 	if (flags & XNSYNCH_OWNER) {
 		BUG_ON(fastlock == NULL);
@@ -219,10 +354,7 @@ int xnsynch_sleep_on(struct xnsynch *synch, xnticks_t timeout,
 
 	trace_cobalt_synch_sleepon(synch);
 
-	if ((synch->status & XNSYNCH_PRIO) == 0) /* i.e. FIFO */
-		list_add_tail(&thread->plink, &synch->pendq);
-	else /* i.e. priority-sorted */
-		list_add_priff(thread, &synch->pendq, wprio, plink);
+	pendq_add(synch, thread);
 
 	xnthread_suspend(thread, XNPEND, timeout, timeout_mode, synch);
 
@@ -268,7 +400,7 @@ struct xnthread *xnsynch_wakeup_one_sleeper(struct xnsynch *synch)
 
 	trace_cobalt_synch_wakeup(synch);
 	thread = list_first_entry(&synch->pendq, struct xnthread, plink);
-	list_del(&thread->plink);
+	pendq_del(synch, thread);
 	thread->wchan = NULL;
 	xnthread_resume(thread, XNPEND);
 out:
@@ -296,7 +428,7 @@ int xnsynch_wakeup_many_sleepers(struct xnsynch *synch, int nr)
 	list_for_each_entry_safe(thread, tmp, &synch->pendq, plink) {
 		if (nwakeups++ >= nr)
 			break;
-		list_del(&thread->plink);
+		pendq_del(synch, thread);
 		thread->wchan = NULL;
 		xnthread_resume(thread, XNPEND);
 	}
@@ -337,7 +469,7 @@ void xnsynch_wakeup_this_sleeper(struct xnsynch *synch, struct xnthread *sleeper
 	xnlock_get_irqsave(&nklock, s);
 
 	trace_cobalt_synch_wakeup(synch);
-	list_del(&sleeper->plink);
+	pendq_del(synch, sleeper);
 	sleeper->wchan = NULL;
 	xnthread_resume(sleeper, XNPEND);
 
@@ -371,6 +503,27 @@ static void inherit_thread_priority(struct xnthread *owner,
 		xnsynch_requeue_sleeper(owner);
 }
 
+static void boost_owner(struct xnsynch *synch, struct xnthread *owner,
+			struct xnthread *sleeper)
+{
+	raise_boost_flag(owner);
+
+	if (synch->status & XNSYNCH_CLAIMED)
+		list_del(&synch->next); /* owner->boosters */
+	else
+		synch->status |= XNSYNCH_CLAIMED;
+
+	synch->wprio = sleeper->wprio;
+	list_add_priff(synch, &owner->boosters, wprio, next);
+	/*
+	 * sleeper->wprio > owner->wprio implies that synch must be
+	 * leading the booster list after insertion, so we may call
+	 * inherit_thread_priority() for tracking the sleeper's
+	 * priority directly without going through adjust_boost().
+	 */
+	inherit_thread_priority(owner, sleeper);
+}
+
 static void __ceil_owner_priority(struct xnthread *owner, int prio)
 {
 	if (xnthread_test_state(owner, XNZOMBIE))
@@ -672,6 +825,24 @@ int xnsynch_acquire(struct xnsynch *synch, xnticks_t timeout,
 	currh = curr->handle;
 	lockp = xnsynch_fastlock(synch);
 	trace_cobalt_synch_acquire(synch);
+
+	if (unlikely(curr->wwake == synch)) {
+		/*
+		 * xnsynch_requeue_sleepers() moved us to the pend
+		 * queue of this object while we were waiting for
+		 * another one, then the ownership was handed over to
+		 * us, unless it was stolen in the meantime.
+		 */
+		xnlock_get_irqsave(&nklock, s);
+		curr->wwake = NULL;
+		if (synch->owner == curr &&
+		    !xnthread_test_info(curr, XNROBBED)) {
+			xnthread_clear_info(curr, XNWAKEN);
+			goto grab;
+		}
+		xnthread_clear_info(curr, XNWAKEN|XNROBBED);
+		xnlock_put_irqrestore(&nklock, s);
+	}
 redo:
 	/* Basic form of xnsynch_try_acquire(). */
 	h = atomic_cmpxchg(lockp, XN_NO_HANDLE,
@@ -740,7 +911,7 @@ redo:
 	xnsynch_detect_relaxed_owner(synch, curr);
 
 	if ((synch->status & XNSYNCH_PRIO) == 0) { /* i.e. FIFO */
-		list_add_tail(&curr->plink, &synch->pendq);
+		pendq_add(synch, curr);
 		goto block;
 	}
 
@@ -753,30 +924,12 @@ redo:
 			goto grab;
 		}
 
-		list_add_priff(curr, &synch->pendq, wprio, plink);
-
-		if (synch->status & XNSYNCH_PI) {
-			raise_boost_flag(owner);
-
-			if (synch->status & XNSYNCH_CLAIMED)
-				list_del(&synch->next); /* owner->boosters */
-			else
-				synch->status |= XNSYNCH_CLAIMED;
-
-			synch->wprio = curr->wprio;
-			list_add_priff(synch, &owner->boosters, wprio, next);
-			/*
-			 * curr->wprio > owner->wprio implies that
-			 * synch must be leading the booster list
-			 * after insertion, so we may call
-			 * inherit_thread_priority() for tracking
-			 * current's priority directly without going
-			 * through adjust_boost().
-			 */
-			inherit_thread_priority(owner, curr);
-		}
+		pendq_add(synch, curr);
+
+		if (synch->status & XNSYNCH_PI)
+			boost_owner(synch, owner, curr);
 	} else
-		list_add_priff(curr, &synch->pendq, wprio, plink);
+		pendq_add(synch, curr);
 block:
 	xnthread_suspend(curr, XNPEND, timeout, timeout_mode, synch);
 	curr->wwake = NULL;
@@ -863,7 +1016,7 @@ static bool transfer_ownership(struct xnsynch *synch,
 	}
 
 	nextowner = list_first_entry(&synch->pendq, struct xnthread, plink);
-	list_del(&nextowner->plink);
+	pendq_del(synch, nextowner);
 	nextowner->wchan = NULL;
 	nextowner->wwake = synch;
 	set_current_owner_locked(synch, nextowner);
@@ -972,8 +1125,8 @@ void xnsynch_requeue_sleeper(struct xnthread *thread)
 	 * for a lock. This routine propagates the change throughout
 	 * the PI chain if required.
 	 */
-	list_del(&thread->plink);
-	list_add_priff(thread, &synch->pendq, wprio, plink);
+	pendq_del(synch, thread);
+	pendq_add(synch, thread);
 	owner = synch->owner;
 
 	/* Only PI-enabled objects are of interest here. */
@@ -1075,7 +1228,7 @@ int xnsynch_flush(struct xnsynch *synch, int reason)
 	} else {
 		ret = XNSYNCH_RESCHED;
 		list_for_each_entry_safe(sleeper, tmp, &synch->pendq, plink) {
-			list_del(&sleeper->plink);
+			pendq_del(synch, sleeper);
 			xnthread_set_info(sleeper, reason);
 			sleeper->wchan = NULL;
 			xnthread_resume(sleeper, XNPEND);
@@ -1090,6 +1243,102 @@ int xnsynch_flush(struct xnsynch *synch, int reason)
 }
 EXPORT_SYMBOL_GPL(xnsynch_flush);
 
+/**
+ * @fn int xnsynch_requeue_sleepers(struct xnsynch *synch, struct xnsynch *target, struct xnthread *owner, int nr);
+ * @brief Move sleepers to the pend queue of an owned object.
+ *
+ * This service moves up to @a nr threads leading the pending list of
+ * @a synch over to the pending list of @a target, as if they had
+ * called xnsynch_acquire() for the latter, without waking them
+ * up. Each of those threads resumes from its wait on @a synch only
+ * when @a target is handed over to it by xnsynch_release(), at which
+ * point its next call to xnsynch_acquire() for @a target completes
+ * immediately. Any timeout pending on the wait for @a synch is
+ * cancelled for the moved threads, which are deemed to have been
+ * granted @a synch.
+ *
+ * This is typically used for passing the mutex a condition variable
+ * is bound to the signaled threads one after another, instead of
+ * waking them up all at once only to have them contend on that
+ * mutex (i.e. wait morphing).
+ *
+ * @param synch The descriptor address of the synchronization object
+ * the threads are waiting for, which must not track ownership.
+ *
+ * @param target The descriptor address of the synchronization
+ * object the threads should wait for instead, which must track
+ * ownership.
+ *
+ * @param owner The descriptor address of the thread owning @a
+ * target. Since @a target may have been grabbed from user space
+ * without the kernel knowing, its owner is not inferred from the
+ * object state, but passed by the caller, which is usually the
+ * owner itself. Nothing is moved if the fast lock of @a target
+ * does not designate @a owner.
+ *
+ * @param nr The maximum number of threads to move.
+ *
+ * @return The number of threads moved.
+ *
+ * @coretags{unrestricted}
+ */
+int xnsynch_requeue_sleepers(struct xnsynch *synch,
+			     struct xnsynch *target,
+			     struct xnthread *owner, int nr)
+{
+	struct xnthread *thread, *tmp;
+	xnhandle_t h, oldh;
+	int nmoved = 0;
+	atomic_t *lockp;
+	spl_t s;
+
+	XENO_BUG_ON(COBALT, synch->status & XNSYNCH_OWNER);
+	XENO_BUG_ON(COBALT, (target->status & XNSYNCH_OWNER) == 0);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	lockp = xnsynch_fastlock(target);
+	if (list_empty(&synch->pendq) ||
+	    xnsynch_fast_owner_check(lockp, owner->handle))
+		goto out;
+
+	trace_cobalt_synch_requeue(synch);
+
+	/*
+	 * The owner may have grabbed the fast lock from user space,
+	 * in which case target->owner is stale: fix it up the same
+	 * way xnsynch_acquire() does on contention. Then raise the
+	 * claim bit, so that the owner has to go through
+	 * xnsynch_release() for handing over the resource.
+	 */
+	track_owner(target, owner);
+	do {
+		h = atomic_read(lockp);
+		oldh = atomic_cmpxchg(lockp, h, xnsynch_fast_claimed(h));
+	} while (oldh != h);
+
+	list_for_each_entry_safe(thread, tmp, &synch->pendq, plink) {
+		if (nmoved >= nr)
+			break;
+		pendq_del(synch, thread);
+		pendq_add(target, thread);
+		thread->wchan = target;
+		if (xnthread_test_state(thread, XNDELAY)) {
+			xntimer_stop(&thread->rtimer);
+			xnthread_clear_state(thread, XNDELAY);
+		}
+		if ((target->status & XNSYNCH_PI) &&
+		    thread->wprio > owner->wprio)
+			boost_owner(target, owner, thread);
+		nmoved++;
+	}
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return nmoved;
+}
+EXPORT_SYMBOL_GPL(xnsynch_requeue_sleepers);
+
 void xnsynch_forget_sleeper(struct xnthread *thread)
 {				/* nklock held, irqs off */
 	struct xnsynch *synch = thread->wchan;
@@ -1104,7 +1353,7 @@ void xnsynch_forget_sleeper(struct xnthread *thread)
 
 	xnthread_clear_state(thread, XNPEND);
 	thread->wchan = NULL;
-	list_del(&thread->plink); /* synch->pendq */
+	pendq_del(synch, thread);
 
 	/*
 	 * Only a sleeper leaving a PI chain triggers an update.
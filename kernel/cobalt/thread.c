@@ -1829,6 +1829,33 @@ void __xnthread_test_cancel(struct xnthread *curr)
 }
 EXPORT_SYMBOL_GPL(__xnthread_test_cancel);
 
+#ifdef CONFIG_XENO_OPT_SCHED_BALANCE
+
+/*
+ * A thread running in primary mode may not change CPU, so load
+ * balancing has to be applied while current still runs in-band:
+ * moving it over to the target CPU here lets affinity_ok() pick up
+ * the change when current enters the out-of-band stage next.
+ */
+static void balance_current(struct xnthread *thread)
+{
+	int cpu = task_cpu(current), target;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	target = xnsched_balance_target(thread, cpu);
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (target != cpu)
+		set_cpus_allowed_ptr(current, cpumask_of(target));
+}
+
+#else /* !CONFIG_XENO_OPT_SCHED_BALANCE */
+
+static inline void balance_current(struct xnthread *thread) { }
+
+#endif /* !CONFIG_XENO_OPT_SCHED_BALANCE */
+
 /**
  * @internal
  * @fn int xnthread_harden(void);
@@ -1857,6 +1884,8 @@ int xnthread_harden(void)
 
 	trace_cobalt_shadow_gohard(thread);
 
+	balance_current(thread);
+
 	xnthread_clear_sync_window(thread, XNRELAX);
 
 	ret = pipeline_leave_inband();
@@ -2321,6 +2350,12 @@ void xnthread_pin_initial(struct xnthread *thread)
 	if (!cpumask_test_cpu(cpu, &thread->affinity))
 		cpu = cpumask_first(&thread->affinity);
 
+#ifdef CONFIG_XENO_OPT_SCHED_BALANCE
+	xnlock_get_irqsave(&nklock, s);
+	cpu = xnsched_balance_target(thread, cpu);
+	xnlock_put_irqrestore(&nklock, s);
+#endif
+
 	set_cpus_allowed_ptr(p, cpumask_of(cpu));
 	/*
 	 * @thread is still unstarted Xenomai-wise, we are precisely
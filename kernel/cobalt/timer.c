@@ -699,6 +699,215 @@ void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
 	rb_link_node(&holder->link, parent, new);
 	rb_insert_color(&holder->link, &q->root);
 }
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+static inline int wheel_shift(int level)
+{
+	return XNTWHEEL_SHIFT + level * XNTWHEEL_BITS;
+}
+
+void xntimerq_init(xntimerq_t *q)
+{
+	int n;
+
+	INIT_LIST_HEAD(&q->near);
+	INIT_LIST_HEAD(&q->overflow);
+	for (n = 0; n < XNTWHEEL_LEVELS * XNTWHEEL_SLOTS; n++)
+		INIT_LIST_HEAD(&q->slots[n]);
+	memset(q->bitmap, 0, sizeof(q->bitmap));
+	q->base = 0;
+	q->count = 0;
+	q->overflow_min = -1ULL;
+}
+
+static void wheel_hash(xntimerq_t *q, xntimerh_t *holder)
+{
+	xnticks_t date = xntimerh_date(holder);
+	int level, shift, slot;
+
+	/*
+	 * Timers due before the base date of the wheel belong to the
+	 * near list, which is exactly ordered. Otherwise, pick the
+	 * finest level which can hold the timer given the current
+	 * base date, O(1).
+	 */
+	if (date < q->base) {
+		holder->slot = XNTWHEEL_NEAR;
+		xntlist_insert(&q->near, &holder->tl);
+		return;
+	}
+
+	for (level = 0; level < XNTWHEEL_LEVELS; level++) {
+		shift = wheel_shift(level);
+		if ((date >> shift) - (q->base >> shift) < XNTWHEEL_SLOTS) {
+			slot = (level << XNTWHEEL_BITS) |
+				((date >> shift) & XNTWHEEL_MASK);
+			holder->slot = slot;
+			list_add_tail(&holder->tl.link, &q->slots[slot]);
+			q->bitmap[level] |= 1ULL << (slot & XNTWHEEL_MASK);
+			return;
+		}
+	}
+
+	holder->slot = XNTWHEEL_OVERFLOW;
+	list_add_tail(&holder->tl.link, &q->overflow);
+	if (date < q->overflow_min)
+		q->overflow_min = date;
+}
+
+void xntimerq_insert(xntimerq_t *q, xntimerh_t *holder)
+{
+	q->count++;
+	wheel_hash(q, holder);
+}
+
+/*
+ * Move the earliest populated level #0 slot to the near list,
+ * cascading coarser slots down as needed. The invariant is that
+ * every timer hashed to the wheel is due at or after q->base, so
+ * the first populated slot past the one covering q->base at each
+ * level gives us a lower bound of the dates queued there.
+ */
+static bool wheel_advance(xntimerq_t *q)
+{
+	int level, best, shift, idx, slot;
+	xnticks_t lb, best_lb = 0, unit;
+	struct list_head tmpq;
+	xntimerh_t *h, *n;
+	u64 map;
+
+	for (;;) {
+		best = -1;
+		for (level = 0; level < XNTWHEEL_LEVELS; level++) {
+			map = q->bitmap[level];
+			if (map == 0)
+				continue;
+			shift = wheel_shift(level);
+			unit = q->base >> shift;
+			idx = unit & XNTWHEEL_MASK;
+			if (idx)
+				map = (map >> idx) |
+					(map << (XNTWHEEL_SLOTS - idx));
+			lb = (unit + __ffs64(map)) << shift;
+			/* Pick the coarsest level on equal bounds. */
+			if (best < 0 || lb <= best_lb) {
+				best = level;
+				best_lb = lb;
+			}
+		}
+
+		INIT_LIST_HEAD(&tmpq);
+
+		/*
+		 * Overflowed timers may have become closer than the
+		 * best slot as the base date moved forward: rehash
+		 * all of them in this case. This only happens for
+		 * very remote timers, so we don't care much.
+		 */
+		if (q->overflow_min != -1ULL &&
+		    (best < 0 ||
+		     q->overflow_min < best_lb + (1ULL << wheel_shift(best)))) {
+			/*
+			 * Never move the base past the lower bound
+			 * of the best slot, timers already hashed
+			 * there must remain due after the base date.
+			 */
+			lb = q->overflow_min;
+			if (best >= 0 && best_lb < lb)
+				lb = best_lb;
+			if (lb > q->base)
+				q->base = lb;
+			q->overflow_min = -1ULL;
+			list_splice_init(&q->overflow, &tmpq);
+			list_for_each_entry_safe(h, n, &tmpq, tl.link)
+				wheel_hash(q, h);
+			continue;
+		}
+
+		if (best < 0)
+			return false;
+
+		shift = wheel_shift(best);
+		slot = (best << XNTWHEEL_BITS) |
+			((best_lb >> shift) & XNTWHEEL_MASK);
+		list_splice_init(&q->slots[slot], &tmpq);
+		q->bitmap[best] &= ~(1ULL << (slot & XNTWHEEL_MASK));
+
+		if (best == 0) {
+			q->base = best_lb + (1ULL << XNTWHEEL_SHIFT);
+			list_for_each_entry_safe(h, n, &tmpq, tl.link) {
+				h->slot = XNTWHEEL_NEAR;
+				xntlist_insert(&q->near, &h->tl);
+			}
+			return true;
+		}
+
+		if (best_lb > q->base)
+			q->base = best_lb;
+
+		list_for_each_entry_safe(h, n, &tmpq, tl.link)
+			wheel_hash(q, h);
+	}
+}
+
+xntimerh_t *xntimerq_cascade(xntimerq_t *q, xntimerh_t *h)
+{
+	/*
+	 * Refill the near list until we get the heading timer if @h
+	 * is NULL, or the successor of @h otherwise.
+	 */
+	while (wheel_advance(q)) {
+		if (h == NULL)
+			return list_first_entry(&q->near, xntimerh_t, tl.link);
+		if (!list_is_last(&h->tl.link, &q->near))
+			return list_next_entry(h, tl.link);
+	}
+
+	return NULL;
+}
+
+static inline struct list_head *wheel_it_list(xntimerq_t *q, int slot)
+{
+	if (slot < 0)
+		return &q->near;
+
+	if (slot < XNTWHEEL_LEVELS * XNTWHEEL_SLOTS)
+		return &q->slots[slot];
+
+	return &q->overflow;
+}
+
+static xntimerh_t *wheel_it_first(xntimerq_t *q, xntimerq_it_t *it)
+{
+	struct list_head *l;
+
+	for (; it->slot <= XNTWHEEL_LEVELS * XNTWHEEL_SLOTS; it->slot++) {
+		l = wheel_it_list(q, it->slot);
+		if (!list_empty(l))
+			return list_first_entry(l, xntimerh_t, tl.link);
+	}
+
+	return NULL;
+}
+
+xntimerh_t *xntimerq_it_begin(xntimerq_t *q, xntimerq_it_t *it)
+{
+	it->slot = XNTWHEEL_NEAR;
+
+	return wheel_it_first(q, it);
+}
+
+xntimerh_t *xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it,
+			     xntimerh_t *holder)
+{
+	if (!list_is_last(&holder->tl.link, wheel_it_list(q, it->slot)))
+		return list_next_entry(holder, tl.link);
+
+	it->slot++;
+
+	return wheel_it_first(q, it);
+}
+
 #endif
 
 /** @} */
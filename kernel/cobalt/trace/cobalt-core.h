@@ -758,6 +758,11 @@ DEFINE_EVENT(synch_post_event, cobalt_synch_wakeup_many,
 	TP_ARGS(synch)
 );
 
+DEFINE_EVENT(synch_post_event, cobalt_synch_requeue,
+	TP_PROTO(struct xnsynch *synch),
+	TP_ARGS(synch)
+);
+
 DEFINE_EVENT(synch_post_event, cobalt_synch_flush,
 	TP_PROTO(struct xnsynch *synch),
 	TP_ARGS(synch)
@@ -106,6 +106,8 @@
 		__cobalt_symbolic_syscall(mq_timedsend),		\
 		__cobalt_symbolic_syscall(mq_timedreceive),		\
 		__cobalt_symbolic_syscall(mq_notify),			\
+		__cobalt_symbolic_syscall(mq_ring),			\
+		__cobalt_symbolic_syscall(mq_kick),			\
 		__cobalt_symbolic_syscall(sched_minprio),		\
 		__cobalt_symbolic_syscall(sched_maxprio),		\
 		__cobalt_symbolic_syscall(sched_weightprio),		\
@@ -201,6 +203,7 @@ DECLARE_EVENT_CLASS(syscall_exit,
 			 {SCHED_TP, "tp"},			\
 			 {SCHED_QUOTA, "quota"},		\
 			 {SCHED_SPORADIC, "sporadic"},		\
+			 {SCHED_EDF, "edf"},			\
 			 {SCHED_COBALT, "cobalt"},		\
 			 {SCHED_WEAK, "weak"})
 
@@ -145,6 +145,11 @@ struct rtcan_device {
      * by the reception list and therefore is disjunctive with it. */
     struct rtcan_recv               *empty_list;
 
+    /* Index over the reception list, see rtcan_list.h. Exact filters
+     * are chained by hash of their ID, all others in recv_wild. */
+    struct rtcan_recv               *recv_hash[RTCAN_RECV_HASH_SIZE];
+    struct rtcan_recv               *recv_wild;
+
     /* Preallocated array for the list entries. To increase cache
      * locality all list elements are kept in this array. */
     struct rtcan_recv               receivers[RTCAN_MAX_RECEIVERS];
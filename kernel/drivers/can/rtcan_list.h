@@ -23,6 +23,8 @@
 #ifndef __RTCAN_LIST_H_
 #define __RTCAN_LIST_H_
 
+#include <linux/hash.h>
+
 #include "rtcan_socket.h"
 
 
@@ -43,9 +45,33 @@ struct rtcan_recv {
 					     */
     struct rtcan_recv       *next;          /* pointer to next list element
 					     */
+    struct rtcan_recv       *hnext;         /* pointer to next element in
+					     *   the same index chain */
 };
 
 
+/*
+ * Reception index. Filters comparing all the bits of a standard CAN ID
+ * without inversion can only match frames carrying that very ID in
+ * their lower 11 bits, so they are hashed by that value. All other
+ * filters (masked, inverted, catch-all) live in a separate chain
+ * which is walked for every frame.
+ */
+#define RTCAN_RECV_HASH_BITS    8
+#define RTCAN_RECV_HASH_SIZE    (1 << RTCAN_RECV_HASH_BITS)
+
+static inline int rtcan_recv_indexed(can_filter_t *filter)
+{
+    return !(filter->can_mask & CAN_INV_FILTER) &&
+	(filter->can_mask & CAN_SFF_MASK) == CAN_SFF_MASK;
+}
+
+static inline unsigned int rtcan_recv_hash(uint32_t can_id)
+{
+    return hash_32(can_id & CAN_SFF_MASK, RTCAN_RECV_HASH_BITS);
+}
+
+
 /*
  *  Element in a TX wait queue.
  *
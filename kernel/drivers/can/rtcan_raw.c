@@ -135,6 +135,35 @@ static void rtcan_rcv_deliver(struct rtcan_recv *recv_listener,
 }
 
 
+/* Deliver to the listeners of an index chain accepting the frame */
+static inline void rtcan_rcv_chain(struct rtcan_recv *recv_listener,
+				   struct rtcan_skb *skb,
+				   struct rtcan_socket *skip_sock)
+{
+    uint32_t can_id = skb->rb_frame.can_id;
+
+    while (recv_listener != NULL) {
+	if (recv_listener->sock != skip_sock &&
+	    rtcan_accept_msg(can_id, &recv_listener->can_filter)) {
+	    recv_listener->match_count++;
+	    rtcan_rcv_deliver(recv_listener, skb);
+	}
+	recv_listener = recv_listener->hnext;
+    }
+}
+
+
+static inline void rtcan_rcv_dispatch(struct rtcan_device *dev,
+				      struct rtcan_skb *skb,
+				      struct rtcan_socket *skip_sock)
+{
+    uint32_t can_id = skb->rb_frame.can_id;
+
+    rtcan_rcv_chain(dev->recv_hash[rtcan_recv_hash(can_id)], skb, skip_sock);
+    rtcan_rcv_chain(dev->recv_wild, skb, skip_sock);
+}
+
+
 void rtcan_rcv(struct rtcan_device *dev, struct rtcan_skb *skb)
 {
     nanosecs_abs_t timestamp = rtdm_clock_read();
@@ -157,13 +186,7 @@ void rtcan_rcv(struct rtcan_device *dev, struct rtcan_skb *skb)
 	}
     } else {
 	dev->rx_count++;
-	while (recv_listener != NULL) {
-	    if (rtcan_accept_msg(frame->can_id, &recv_listener->can_filter)) {
-		recv_listener->match_count++;
-		rtcan_rcv_deliver(recv_listener, skb);
-	    }
-	    recv_listener = recv_listener->next;
-	}
+	rtcan_rcv_dispatch(dev, skb, NULL);
     }
 }
 
@@ -191,22 +214,12 @@ void rtcan_tx_push(struct rtcan_device *dev, struct rtcan_socket *sock,
 void rtcan_loopback(struct rtcan_device *dev)
 {
     nanosecs_abs_t timestamp = rtdm_clock_read();
-    /* Entry in reception list, begin with head */
-    struct rtcan_recv *recv_listener = dev->recv_list;
-    struct rtcan_rb_frame *frame = &dev->tx_skb.rb_frame;
 
     memcpy((void *)&dev->tx_skb.rb_frame + dev->tx_skb.rb_frame_size,
 	   &timestamp, RTCAN_TIMESTAMP_SIZE);
 
-    while (recv_listener != NULL) {
-	dev->rx_count++;
-	if ((dev->tx_socket != recv_listener->sock) &&
-	    rtcan_accept_msg(frame->can_id, &recv_listener->can_filter)) {
-	    recv_listener->match_count++;
-	    rtcan_rcv_deliver(recv_listener, &dev->tx_skb);
-	}
-	recv_listener = recv_listener->next;
-    }
+    dev->rx_count++;
+    rtcan_rcv_dispatch(dev, &dev->tx_skb, dev->tx_socket);
     dev->tx_socket = NULL;
 }
 
@@ -68,6 +68,38 @@ static inline void rtcan_raw_mount_filter(can_filter_t *recv_filter,
 }
 
 
+static inline struct rtcan_recv **rtcan_raw_index_head(struct rtcan_device *dev,
+						     struct rtcan_recv *recv)
+{
+    if (rtcan_recv_indexed(&recv->can_filter))
+	return &dev->recv_hash[rtcan_recv_hash(recv->can_filter.can_id)];
+
+    return &dev->recv_wild;
+}
+
+
+static void rtcan_raw_index_filter(struct rtcan_device *dev,
+				   struct rtcan_recv *recv)
+{
+    struct rtcan_recv **head = rtcan_raw_index_head(dev, recv);
+
+    recv->hnext = *head;
+    *head = recv;
+}
+
+
+static void rtcan_raw_unindex_filter(struct rtcan_device *dev,
+				     struct rtcan_recv *recv)
+{
+    struct rtcan_recv **pp = rtcan_raw_index_head(dev, recv);
+
+    while (*pp != recv)
+	pp = &(*pp)->hnext;
+    *pp = recv->hnext;
+    recv->hnext = NULL;
+}
+
+
 int rtcan_raw_check_filter(struct rtcan_socket *sock, int ifindex,
 			   struct rtcan_filter_list *flist)
 {
@@ -162,6 +194,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 				   &sock->flist->flist[0]);
 	    last->match_count = 0;
 	    last->sock = sock;
+	    rtcan_raw_index_filter(dev, last);
 	    for (j = 1; j < flistlen; j++) {
 		/* Register remaining filters */
 		last = last->next;
@@ -169,6 +202,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 				       &sock->flist->flist[j]);
 		last->sock = sock;
 		last->match_count = 0;
+		rtcan_raw_index_filter(dev, last);
 	    }
 	    /* Decrease free entries counter by length of filter list */
 	    dev->free_entries -= flistlen;
@@ -179,6 +213,7 @@ int rtcan_raw_add_filter(struct rtcan_socket *sock, int ifindex)
 	    last->can_filter.can_id = last->can_filter.can_mask = 0;
 	    last->sock = sock;
 	    last->match_count = 0;
+	    rtcan_raw_index_filter(dev, last);
 	    /* Decrease free entries counter by 1
 	     * (one filter for all CAN frames) */
 	    dev->free_entries--;
@@ -232,10 +267,14 @@ void rtcan_raw_remove_filter(struct rtcan_socket *sock)
 	    next = first->next;
 	}
 
-	/* Now go to the end of the old filter list */
+	/* Now go to the end of the old filter list, dropping the
+	 * entries from the index on the way */
 	last = next;
-	for (j = 1; j < sock->flistlen; j++)
+	rtcan_raw_unindex_filter(dev, last);
+	for (j = 1; j < sock->flistlen; j++) {
 	    last = last->next;
+	    rtcan_raw_unindex_filter(dev, last);
+	}
 
 	/* Detach found first list entry from reception list */
 	if (first)
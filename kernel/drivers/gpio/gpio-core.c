@@ -22,6 +22,7 @@
 #include <linux/irq.h>
 #include <linux/slab.h>
 #include <linux/err.h>
+#include <linux/bitmap.h>
 #include <rtdm/gpio.h>
 
 struct rtdm_gpio_chan {
@@ -30,51 +31,159 @@ struct rtdm_gpio_chan {
 		is_output : 1,
 	        is_interrupt : 1,
 		want_timestamp : 1;
+	struct rtdm_gpio_ring *ring;
 };
 
+struct rtdm_gpio_chip_chan {
+	DECLARE_BITMAP(requested, RTDM_GPIO_CHIP_MAXLINES);
+	DECLARE_BITMAP(outputs, RTDM_GPIO_CHIP_MAXLINES);
+	DECLARE_BITMAP(irqs, RTDM_GPIO_CHIP_MAXLINES);
+	struct rtdm_gpio_ring ring;
+};
+
+/* Events are copied out to the reader by batches of this size. */
+#define GPIO_RING_BATCH  16
+
 static LIST_HEAD(rtdm_gpio_chips);
 
 static DEFINE_MUTEX(chip_lock);
 
-static int gpio_pin_interrupt(rtdm_irq_t *irqh)
+static void post_pin_event(struct rtdm_gpio_pin *pin, nanosecs_abs_t ts)
 {
-	struct rtdm_gpio_pin *pin;
+	struct rtdm_gpio_chip *rgc = pin->dev.device_data;
+	struct rtdm_gpio_event *e;
+	struct rtdm_gpio_ring *ring;
+	rtdm_lockctx_t s;
 
-	pin = rtdm_irq_get_arg(irqh, struct rtdm_gpio_pin);
+	pin->timestamp = ts;
+
+	rtdm_lock_get_irqsave(&rgc->lock, s);
+
+	ring = pin->ring;
+	if (ring) {
+		/* Overwrite the oldest event if the reader lags behind. */
+		if (ring->head - ring->tail >= RTDM_GPIO_RING_SIZE) {
+			ring->tail++;
+			ring->overrun = 1;
+		}
+		e = &ring->events[ring->head & (RTDM_GPIO_RING_SIZE - 1)];
+		e->timestamp = ts;
+		e->gpio = desc_to_gpio(pin->desc);
+		e->value = gpiod_get_raw_value(pin->desc);
+		e->flags = 0;
+		ring->head++;
+		rtdm_event_signal(&ring->event);
+	}
+
+	rtdm_lock_put_irqrestore(&rgc->lock, s);
 
-	pin->timestamp = rtdm_clock_read_monotonic();
 	rtdm_event_signal(&pin->event);
+}
 
-	return RTDM_IRQ_HANDLED;
+static void attach_pin_ring(struct rtdm_gpio_pin *pin,
+			    struct rtdm_gpio_ring *ring)
+{
+	struct rtdm_gpio_chip *rgc = pin->dev.device_data;
+	rtdm_lockctx_t s;
+
+	rtdm_lock_get_irqsave(&rgc->lock, s);
+	pin->ring = ring;
+	rtdm_lock_put_irqrestore(&rgc->lock, s);
 }
 
-static int request_gpio_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
-			    struct rtdm_gpio_chan *chan,
-			    int trigger)
+static void init_ring(struct rtdm_gpio_ring *ring)
 {
-	int ret, irq_trigger, irq;
+	ring->head = ring->tail = 0;
+	ring->overrun = 0;
+	rtdm_event_init(&ring->event, 0);
+}
 
-	if (trigger & ~GPIO_TRIGGER_MASK)
+static ssize_t read_ring(struct rtdm_fd *fd, struct rtdm_gpio_chip *rgc,
+			 struct rtdm_gpio_ring *ring,
+			 void __user *buf, size_t len)
+{
+	struct rtdm_gpio_event batch[GPIO_RING_BATCH];
+	size_t max, count = 0, n;
+	rtdm_lockctx_t s;
+	int ret;
+
+	max = len / sizeof(batch[0]);
+	if (max == 0)
 		return -EINVAL;
 
-	if (!chan->requested) {
-		ret = gpio_request(gpio, pin->name);
-		if (ret) {
-			if (ret != -EPROBE_DEFER)
-				printk(XENO_ERR 
-				       "can not request GPIO%d\n", gpio);
+	/*
+	 * Wait for the first event, then drain as many as the
+	 * caller can take without blocking again.
+	 */
+	rtdm_lock_get_irqsave(&rgc->lock, s);
+
+	while (ring->head == ring->tail) {
+		rtdm_event_clear(&ring->event);
+		rtdm_lock_put_irqrestore(&rgc->lock, s);
+		if (fd->oflags & O_NONBLOCK)
+			return -EAGAIN;
+		ret = rtdm_event_wait(&ring->event);
+		if (ret)
+			return ret;
+		rtdm_lock_get_irqsave(&rgc->lock, s);
+	}
+
+	for (;;) {
+		for (n = 0; n < GPIO_RING_BATCH && count + n < max &&
+			     ring->tail != ring->head; n++, ring->tail++)
+			batch[n] = ring->events[ring->tail &
+						(RTDM_GPIO_RING_SIZE - 1)];
+		if (ring->overrun && count == 0) {
+			batch[0].flags |= GPIO_EVENT_OVERRUN;
+			ring->overrun = 0;
+		}
+		rtdm_lock_put_irqrestore(&rgc->lock, s);
+
+		ret = rtdm_safe_copy_to_user(fd, buf + count * sizeof(batch[0]),
+					     batch, n * sizeof(batch[0]));
+		if (ret)
 			return ret;
+
+		count += n;
+		if (count >= max)
+			break;
+
+		rtdm_lock_get_irqsave(&rgc->lock, s);
+		if (ring->head == ring->tail) {
+			rtdm_lock_put_irqrestore(&rgc->lock, s);
+			break;
 		}
-		chan->requested = true;
 	}
 
+	return count * sizeof(batch[0]);
+}
+
+static int gpio_pin_interrupt(rtdm_irq_t *irqh)
+{
+	struct rtdm_gpio_pin *pin;
+
+	pin = rtdm_irq_get_arg(irqh, struct rtdm_gpio_pin);
+
+	post_pin_event(pin, rtdm_clock_read_monotonic());
+
+	return RTDM_IRQ_HANDLED;
+}
+
+/*
+ * Returns a negative error code, zero if the GPIO has no IRQ mapping,
+ * or one if its interrupt was hooked.
+ */
+static int hook_pin_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
+			int trigger)
+{
+	int ret, irq_trigger, irq;
+
 	ret = gpio_direction_input(gpio);
 	if (ret) {
 		printk(XENO_ERR "cannot set GPIO%d as input\n", gpio);
-		goto fail;
+		return ret;
 	}
 
-	chan->has_direction = true;
 	gpio_export(gpio, true);
 
 	rtdm_event_clear(&pin->event);
@@ -88,7 +197,7 @@ static int request_gpio_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
 	 */
 	irq = gpio_to_irq(gpio);
 	if (irq < 0)
-		goto done;
+		return 0;
 
 	irq_trigger = 0;
 	if (trigger & GPIO_TRIGGER_EDGE_RISING)
@@ -107,12 +216,39 @@ static int request_gpio_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
 			       0, pin->name, pin);
 	if (ret) {
 		printk(XENO_ERR "cannot request GPIO%d interrupt\n", gpio);
-		goto fail;
+		return ret;
 	}
 
-
 	rtdm_irq_enable(&pin->irqh);
-done:
+
+	return 1;
+}
+
+static int request_gpio_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
+			    struct rtdm_gpio_chan *chan,
+			    int trigger)
+{
+	int ret;
+
+	if (trigger & ~GPIO_TRIGGER_MASK)
+		return -EINVAL;
+
+	if (!chan->requested) {
+		ret = gpio_request(gpio, pin->name);
+		if (ret) {
+			if (ret != -EPROBE_DEFER)
+				printk(XENO_ERR 
+				       "can not request GPIO%d\n", gpio);
+			return ret;
+		}
+		chan->requested = true;
+	}
+
+	ret = hook_pin_irq(gpio, pin, trigger);
+	if (ret < 0)
+		goto fail;
+
+	chan->has_direction = true;
 	chan->is_interrupt = true;
 
 	return 0;
@@ -134,6 +270,39 @@ static void release_gpio_irq(unsigned int gpio, struct rtdm_gpio_pin *pin,
 	chan->requested = false;
 }
 
+static int enable_pin_events(struct rtdm_gpio_pin *pin,
+			     struct rtdm_gpio_chan *chan)
+{
+	struct rtdm_gpio_ring *ring;
+
+	if (chan->ring)
+		return 0;
+
+	ring = kmalloc(sizeof(*ring), GFP_KERNEL);
+	if (ring == NULL)
+		return -ENOMEM;
+
+	init_ring(ring);
+	chan->ring = ring;
+	attach_pin_ring(pin, ring);
+
+	return 0;
+}
+
+static void disable_pin_events(struct rtdm_gpio_pin *pin,
+			       struct rtdm_gpio_chan *chan)
+{
+	struct rtdm_gpio_ring *ring = chan->ring;
+
+	if (ring == NULL)
+		return;
+
+	attach_pin_ring(pin, NULL);
+	chan->ring = NULL;
+	rtdm_event_destroy(&ring->event);
+	kfree(ring);
+}
+
 static int gpio_pin_ioctl_nrt(struct rtdm_fd *fd,
 			      unsigned int request, void *arg)
 {
@@ -195,6 +364,15 @@ static int gpio_pin_ioctl_nrt(struct rtdm_fd *fd,
 			return ret;
 		chan->want_timestamp = !!val;
 		break;
+	case GPIO_RTIOC_EVENTS:
+		ret = rtdm_safe_copy_from_user(fd, &val, arg, sizeof(val));
+		if (ret)
+			return ret;
+		if (val)
+			ret = enable_pin_events(pin, chan);
+		else
+			disable_pin_events(pin, chan);
+		break;
 	default:
 		return -EINVAL;
 	}
@@ -219,6 +397,9 @@ static ssize_t gpio_pin_read_rt(struct rtdm_fd *fd,
 
 	pin = container_of(dev, struct rtdm_gpio_pin, dev);
 
+	if (chan->ring)
+		return read_ring(fd, dev->device_data, chan->ring, buf, len);
+
 	if (chan->want_timestamp) {
 		if (len < sizeof(rdo))
 			return -EINVAL;
@@ -294,6 +475,10 @@ static int gpio_pin_select(struct rtdm_fd *fd, struct xnselector *selector,
 
 	pin = container_of(dev, struct rtdm_gpio_pin, dev);
 
+	if (chan->ring)
+		return rtdm_event_select(&chan->ring->event, selector,
+					 type, index);
+
 	return rtdm_event_select(&pin->event, selector, type, index);
 }
 
@@ -324,10 +509,281 @@ static void gpio_pin_close(struct rtdm_fd *fd)
 	unsigned int gpio = rtdm_fd_minor(fd);
 	struct rtdm_gpio_pin *pin;
 
-	if (chan->requested) {
-		pin = container_of(dev, struct rtdm_gpio_pin, dev);
+	pin = container_of(dev, struct rtdm_gpio_pin, dev);
+	if (chan->requested)
 		release_gpio_irq(gpio, pin, chan);
+
+	disable_pin_events(pin, chan);
+}
+
+static int get_chip_lines(struct rtdm_gpio_chip *rgc,
+			  const struct rtdm_gpio_bits *rgb,
+			  unsigned long *mask, unsigned long *bits)
+{
+	struct gpio_chip *gc = rgc->gc;
+	int n, offset;
+
+	bitmap_zero(mask, RTDM_GPIO_CHIP_MAXLINES);
+	if (bits)
+		bitmap_zero(bits, RTDM_GPIO_CHIP_MAXLINES);
+
+	for (n = 0; n < 64; n++) {
+		if (!(rgb->mask & (1ULL << n)))
+			continue;
+		offset = (int)(rgb->base - gc->base) + n;
+		if (offset < 0 || offset >= gc->ngpio)
+			return -EINVAL;
+		__set_bit(offset, mask);
+		if (bits && (rgb->bits & (1ULL << n)))
+			__set_bit(offset, bits);
+	}
+
+	return 0;
+}
+
+static void release_chip_line(struct rtdm_gpio_chip *rgc,
+			      struct rtdm_gpio_chip_chan *cc, int offset)
+{
+	struct rtdm_gpio_pin *pin = rgc->pins + offset;
+
+	if (test_and_clear_bit(offset, cc->irqs))
+		rtdm_irq_free(&pin->irqh);
+
+	attach_pin_ring(pin, NULL);
+
+	if (test_and_clear_bit(offset, cc->requested)) {
+		clear_bit(offset, cc->outputs);
+		gpio_free(rgc->gc->base + offset);
+	}
+}
+
+static int request_chip_line(struct rtdm_gpio_chip *rgc,
+			     struct rtdm_gpio_chip_chan *cc, int offset)
+{
+	struct rtdm_gpio_pin *pin = rgc->pins + offset;
+	int ret;
+
+	if (test_bit(offset, cc->requested))
+		return 0;
+
+	ret = gpio_request(rgc->gc->base + offset, pin->name);
+	if (ret)
+		return ret;
+
+	__set_bit(offset, cc->requested);
+
+	return 0;
+}
+
+static int gpio_chip_ioctl_rt(struct rtdm_fd *fd,
+			      unsigned int request, void __user *arg);
+
+static int gpio_chip_ioctl_nrt(struct rtdm_fd *fd,
+			       unsigned int request, void *arg)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+	struct rtdm_device *dev = rtdm_fd_device(fd);
+	struct rtdm_gpio_chip *rgc = dev->device_data;
+	DECLARE_BITMAP(mask, RTDM_GPIO_CHIP_MAXLINES);
+	DECLARE_BITMAP(bits, RTDM_GPIO_CHIP_MAXLINES);
+	struct rtdm_gpio_bits rgb;
+	int ret, offset, gpio;
+
+	if (request == GPIO_RTIOC_GET_BITS || request == GPIO_RTIOC_SET_BITS)
+		return gpio_chip_ioctl_rt(fd, request, arg);
+
+	ret = rtdm_safe_copy_from_user(fd, &rgb, arg, sizeof(rgb));
+	if (ret)
+		return ret;
+
+	ret = get_chip_lines(rgc, &rgb, mask, bits);
+	if (ret)
+		return ret;
+
+	if (request == GPIO_RTIOC_CHIP_IRQEN &&
+	    (rgb.trigger & ~GPIO_TRIGGER_MASK))
+		return -EINVAL;
+
+	for_each_set_bit(offset, mask, rgc->gc->ngpio) {
+		gpio = rgc->gc->base + offset;
+		switch (request) {
+		case GPIO_RTIOC_CHIP_DIR_OUT:
+			ret = request_chip_line(rgc, cc, offset);
+			if (ret)
+				return ret;
+			ret = gpio_direction_output(gpio,
+						    test_bit(offset, bits));
+			if (ret)
+				return ret;
+			__set_bit(offset, cc->outputs);
+			break;
+		case GPIO_RTIOC_CHIP_DIR_IN:
+			ret = request_chip_line(rgc, cc, offset);
+			if (ret)
+				return ret;
+			ret = gpio_direction_input(gpio);
+			if (ret)
+				return ret;
+			__clear_bit(offset, cc->outputs);
+			break;
+		case GPIO_RTIOC_CHIP_IRQEN:
+			if (test_bit(offset, cc->irqs))
+				return -EBUSY;
+			ret = request_chip_line(rgc, cc, offset);
+			if (ret)
+				return ret;
+			/*
+			 * Edges from all lines are merged into the
+			 * ring of the chip device.
+			 */
+			attach_pin_ring(rgc->pins + offset, &cc->ring);
+			ret = hook_pin_irq(gpio, rgc->pins + offset,
+					   rgb.trigger);
+			if (ret < 0) {
+				release_chip_line(rgc, cc, offset);
+				return ret;
+			}
+			__clear_bit(offset, cc->outputs);
+			if (ret)
+				__set_bit(offset, cc->irqs);
+			ret = 0;
+			break;
+		case GPIO_RTIOC_CHIP_IRQDIS:
+			if (test_and_clear_bit(offset, cc->irqs))
+				rtdm_irq_free(&rgc->pins[offset].irqh);
+			attach_pin_ring(rgc->pins + offset, NULL);
+			break;
+		case GPIO_RTIOC_CHIP_RELS:
+			release_chip_line(rgc, cc, offset);
+			break;
+		default:
+			return -EINVAL;
+		}
 	}
+
+	return 0;
+}
+
+static int gpio_chip_ioctl_rt(struct rtdm_fd *fd,
+			      unsigned int request, void __user *arg)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+	struct rtdm_device *dev = rtdm_fd_device(fd);
+	struct rtdm_gpio_chip *rgc = dev->device_data;
+	DECLARE_BITMAP(mask, RTDM_GPIO_CHIP_MAXLINES);
+	DECLARE_BITMAP(bits, RTDM_GPIO_CHIP_MAXLINES);
+	struct gpio_chip *gc = rgc->gc;
+	struct rtdm_gpio_bits rgb;
+	int ret, offset, n;
+
+	switch (request) {
+	case GPIO_RTIOC_GET_BITS:
+	case GPIO_RTIOC_SET_BITS:
+		break;
+	default:
+		/* Line setup is done from the in-band stage. */
+		return -ENOSYS;
+	}
+
+	ret = rtdm_safe_copy_from_user(fd, &rgb, arg, sizeof(rgb));
+	if (ret)
+		return ret;
+
+	/* Only SET_BITS takes line values from the caller. */
+	ret = get_chip_lines(rgc, &rgb, mask,
+			     request == GPIO_RTIOC_SET_BITS ? bits : NULL);
+	if (ret)
+		return ret;
+
+	if (request == GPIO_RTIOC_SET_BITS) {
+		if (!bitmap_subset(mask, cc->outputs, gc->ngpio))
+			return -EINVAL;
+		/*
+		 * Update all lines at once if the chip can do so,
+		 * which usually boils down to a single register
+		 * write.
+		 */
+		if (gc->set_multiple)
+			gc->set_multiple(gc, mask, bits);
+		else
+			for_each_set_bit(offset, mask, gc->ngpio)
+				gc->set(gc, offset, test_bit(offset, bits));
+		return 0;
+	}
+
+	if (!bitmap_subset(mask, cc->requested, gc->ngpio))
+		return -EINVAL;
+
+	/*
+	 * Neither ->get_multiple() nor our ->get() loop are required
+	 * to clear the bits of low lines, start from a clean slate.
+	 */
+	bitmap_zero(bits, RTDM_GPIO_CHIP_MAXLINES);
+
+	if (gc->get_multiple) {
+		ret = gc->get_multiple(gc, mask, bits);
+		if (ret)
+			return ret;
+	} else {
+		for_each_set_bit(offset, mask, gc->ngpio) {
+			ret = gc->get(gc, offset);
+			if (ret < 0)
+				return ret;
+			if (ret)
+				__set_bit(offset, bits);
+		}
+	}
+
+	rgb.bits = 0;
+	for (n = 0; n < 64; n++) {
+		offset = (int)(rgb.base - gc->base) + n;
+		if ((rgb.mask & (1ULL << n)) && test_bit(offset, bits))
+			rgb.bits |= 1ULL << n;
+	}
+
+	return rtdm_safe_copy_to_user(fd, arg, &rgb, sizeof(rgb));
+}
+
+static ssize_t gpio_chip_read_rt(struct rtdm_fd *fd,
+				 void __user *buf, size_t len)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+	struct rtdm_device *dev = rtdm_fd_device(fd);
+
+	return read_ring(fd, dev->device_data, &cc->ring, buf, len);
+}
+
+static int gpio_chip_select(struct rtdm_fd *fd, struct xnselector *selector,
+			    unsigned int type, unsigned int index)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+
+	return rtdm_event_select(&cc->ring.event, selector, type, index);
+}
+
+static int gpio_chip_open(struct rtdm_fd *fd, int oflags)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+
+	bitmap_zero(cc->requested, RTDM_GPIO_CHIP_MAXLINES);
+	bitmap_zero(cc->outputs, RTDM_GPIO_CHIP_MAXLINES);
+	bitmap_zero(cc->irqs, RTDM_GPIO_CHIP_MAXLINES);
+	init_ring(&cc->ring);
+
+	return 0;
+}
+
+static void gpio_chip_close(struct rtdm_fd *fd)
+{
+	struct rtdm_gpio_chip_chan *cc = rtdm_fd_to_private(fd);
+	struct rtdm_device *dev = rtdm_fd_device(fd);
+	struct rtdm_gpio_chip *rgc = dev->device_data;
+	int offset;
+
+	for_each_set_bit(offset, cc->requested, rgc->gc->ngpio)
+		release_chip_line(rgc, cc, offset);
+
+	rtdm_event_destroy(&cc->ring.event);
 }
 
 static void delete_pin_devices(struct rtdm_gpio_chip *rgc)
@@ -391,6 +847,64 @@ fail_name:
 	return ret;
 }
 
+static int create_chip_device(struct rtdm_gpio_chip *rgc, int gpio_subclass)
+{
+	struct gpio_chip *gc = rgc->gc;
+	struct rtdm_device *dev;
+	int ret;
+
+	rgc->chip_dev.label = NULL;
+
+	/* Larger chips are served by the pin devices only. */
+	if (gc->ngpio > RTDM_GPIO_CHIP_MAXLINES)
+		return 0;
+
+	rgc->chip_driver.profile_info = (struct rtdm_profile_info)
+		RTDM_PROFILE_INFO(rtdm_gpio_chipdev,
+				  RTDM_CLASS_GPIO,
+				  gpio_subclass,
+				  0);
+	rgc->chip_driver.device_flags = RTDM_NAMED_DEVICE;
+	rgc->chip_driver.device_count = 1;
+	rgc->chip_driver.context_size = sizeof(struct rtdm_gpio_chip_chan);
+	rgc->chip_driver.ops = (struct rtdm_fd_ops){
+		.open		=	gpio_chip_open,
+		.close		=	gpio_chip_close,
+		.ioctl_nrt	=	gpio_chip_ioctl_nrt,
+		.ioctl_rt	=	gpio_chip_ioctl_rt,
+		.read_rt	=	gpio_chip_read_rt,
+		.select		=	gpio_chip_select,
+	};
+
+	rtdm_drv_set_sysclass(&rgc->chip_driver, rgc->devclass);
+
+	dev = &rgc->chip_dev;
+	dev->driver = &rgc->chip_driver;
+	dev->label = kasprintf(GFP_KERNEL, "%s/gpiochip", gc->label);
+	if (dev->label == NULL)
+		return -ENOMEM;
+	dev->device_data = rgc;
+	ret = rtdm_dev_register(dev);
+	if (ret) {
+		kfree(dev->label);
+		dev->label = NULL;
+	}
+
+	return ret;
+}
+
+static void delete_chip_device(struct rtdm_gpio_chip *rgc)
+{
+	struct rtdm_device *dev = &rgc->chip_dev;
+
+	if (dev->label == NULL)
+		return;
+
+	rtdm_dev_unregister(dev);
+	kfree(dev->label);
+	dev->label = NULL;
+}
+
 static char *gpio_pin_devnode(struct device *dev, umode_t *mode)
 {
 	return kasprintf(GFP_KERNEL, "rtdm/%s/%s",
@@ -435,7 +949,17 @@ int rtdm_gpiochip_add(struct rtdm_gpio_chip *rgc,
 
 	ret = create_pin_devices(rgc);
 	if (ret)
-		class_destroy(rgc->devclass);
+		goto fail;
+
+	ret = create_chip_device(rgc, gpio_subclass);
+	if (ret) {
+		delete_pin_devices(rgc);
+		goto fail;
+	}
+
+	return 0;
+fail:
+	class_destroy(rgc->devclass);
 	
 	return ret;
 }
@@ -475,6 +999,7 @@ void rtdm_gpiochip_remove(struct rtdm_gpio_chip *rgc)
 	mutex_lock(&chip_lock);
 	list_del(&rgc->next);
 	mutex_unlock(&chip_lock);
+	delete_chip_device(rgc);
 	delete_pin_devices(rgc);
 	class_destroy(rgc->devclass);
 }
@@ -489,8 +1014,7 @@ int rtdm_gpiochip_post_event(struct rtdm_gpio_chip *rgc,
 		return -EINVAL;
 
 	pin = rgc->pins + offset;
-	pin->timestamp = rtdm_clock_read_monotonic();
-	rtdm_event_signal(&pin->event);
+	post_pin_event(pin, rtdm_clock_read_monotonic());
 	
 	return 0;
 }
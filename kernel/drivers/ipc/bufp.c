@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/time.h>
+#include <linux/mm.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/map.h>
 #include <cobalt/kernel/bufd.h>
@@ -31,6 +32,16 @@
 
 #define BUFP_SOCKET_MAGIC 0xa61a61a6
 
+/*
+ * Buffer shared with user space in SPSC mode, which may outlive the
+ * socket as long as it is mapped.
+ */
+struct bufp_ring {
+	atomic_t refs;
+	struct rtipc_bufp_ring *shared;
+	size_t mapsz;
+};
+
 struct bufp_socket {
 	int magic;
 	struct sockaddr_ipc name;
@@ -38,6 +49,8 @@ struct bufp_socket {
 
 	void *bufmem;
 	size_t bufsz;
+	int spsc;
+	struct bufp_ring *ring;
 	u_long status;
 	xnhandle_t handle;
 	char label[XNOBJECT_NAME_LEN];
@@ -105,6 +118,51 @@ static struct xnpnode_link __bufp_pnode = {
 
 #endif /* !CONFIG_XENO_OPT_VFILE */
 
+static struct bufp_ring *__bufp_create_ring(size_t bufsz)
+{
+	struct bufp_ring *ring;
+
+	ring = kmalloc(sizeof(*ring), GFP_KERNEL);
+	if (ring == NULL)
+		return NULL;
+
+	ring->mapsz = PAGE_ALIGN(RTIPC_BUFP_RING_DATA + bufsz);
+	ring->shared = xnheap_vmalloc(ring->mapsz);
+	if (ring->shared == NULL) {
+		kfree(ring);
+		return NULL;
+	}
+
+	/* This memory is going to be mapped to user space. */
+	memset(ring->shared, 0, ring->mapsz);
+	ring->shared->size = bufsz;
+	atomic_set(&ring->refs, 1);
+
+	return ring;
+}
+
+static void __bufp_put_ring(struct bufp_ring *ring)
+{
+	if (atomic_dec_and_test(&ring->refs)) {
+		xnheap_vfree(ring->shared);
+		kfree(ring);
+	}
+}
+
+static struct rtdm_fd *__bufp_lock_port(int port)
+{
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	rfd = xnmap_fetch_nocheck(portmap, port);
+	if (rfd && rtdm_fd_lock(rfd) < 0)
+		rfd = NULL;
+	cobalt_atomic_leave(s);
+
+	return rfd;
+}
+
 static int bufp_socket(struct rtdm_fd *fd)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
@@ -115,6 +173,8 @@ static int bufp_socket(struct rtdm_fd *fd)
 	sk->peer = nullsa;
 	sk->bufmem = NULL;
 	sk->bufsz = 0;
+	sk->spsc = 0;
+	sk->ring = NULL;
 	sk->rdoff = 0;
 	sk->wroff = 0;
 	sk->fillsz = 0;
@@ -151,7 +211,9 @@ static void bufp_close(struct rtdm_fd *fd)
 		if (sk->handle)
 			xnregistry_remove(sk->handle);
 
-		if (sk->bufmem)
+		if (sk->ring)
+			__bufp_put_ring(sk->ring);
+		else if (sk->bufmem)
 			xnheap_vfree(sk->bufmem);
 	}
 
@@ -290,6 +352,124 @@ out:
 	return ret;
 }
 
+/*
+ * SPSC mode: the indices live in shared memory, and the writer may
+ * update them without entering the kernel. We are the only reader,
+ * so we have nothing to reserve; nklock only serializes the sleep
+ * with the wakeup requests.
+ */
+static ssize_t __bufp_ring_readbuf(struct bufp_socket *sk,
+				   struct xnbufd *bufd,
+				   int flags)
+{
+	struct rtipc_bufp_ring *shared = sk->ring->shared;
+	size_t len, rbytes, n, rdoff;
+	ssize_t ret, xret;
+	rtdm_toseq_t toseq;
+	rtdm_lockctx_t s;
+	u32 head, tail;
+	int resched;
+
+	len = bufd->b_len;
+
+	rtdm_toseq_init(&toseq, sk->rx_timeout);
+
+	tail = READ_ONCE(shared->tail);
+
+	cobalt_atomic_enter(s);
+
+	for (;;) {
+		head = smp_load_acquire(&shared->head);
+		if (head - tail > sk->bufsz) {
+			/* Bogus indices, the writer is misbehaving. */
+			ret = -EIO;
+			goto out;
+		}
+
+		if (head - tail >= len)
+			break;
+
+		if (flags & MSG_DONTWAIT) {
+			ret = -EWOULDBLOCK;
+			goto out;
+		}
+
+		/*
+		 * Tell the writer to kick us once it has published
+		 * more data, then check again.
+		 */
+		WRITE_ONCE(shared->rdwait, len);
+		smp_mb();
+		head = READ_ONCE(shared->head);
+		if (head - tail >= len) {
+			WRITE_ONCE(shared->rdwait, 0);
+			continue;
+		}
+
+		/*
+		 * If the writer is waiting for room at the same time,
+		 * allow for a short read to prevent a deadlock.
+		 */
+		if (head != tail && READ_ONCE(shared->wrwait)) {
+			WRITE_ONCE(shared->rdwait, 0);
+			len = head - tail;
+			break;
+		}
+
+		ret = rtdm_event_timedwait(&sk->i_event,
+					   sk->rx_timeout, &toseq);
+		WRITE_ONCE(shared->rdwait, 0);
+		if (unlikely(ret))
+			goto out;
+	}
+
+	cobalt_atomic_leave(s);
+
+	/*
+	 * The data is consumed in any case: the non-copied portion
+	 * of the message is lost on bad write.
+	 */
+	rdoff = tail & (sk->bufsz - 1);
+	rbytes = ret = len;
+	do {
+		n = min(rbytes, sk->bufsz - rdoff);
+		xret = xnbufd_copy_from_kmem(bufd, sk->bufmem + rdoff, n);
+		if (xret < 0) {
+			ret = -EFAULT;
+			break;
+		}
+		rbytes -= n;
+		rdoff = (rdoff + n) & (sk->bufsz - 1);
+	} while (rbytes > 0);
+
+	cobalt_atomic_enter(s);
+
+	/* Complete our reads before the writer may reuse the room. */
+	smp_store_release(&shared->tail, tail + len);
+	smp_mb();
+
+	resched = 0;
+	if (head - tail == sk->bufsz) /* -> becomes writable */
+		resched |= xnselect_signal(&sk->priv->send_block, POLLOUT);
+
+	if (READ_ONCE(shared->head) == tail + len) /* -> becomes non-readable */
+		resched |= xnselect_signal(&sk->priv->recv_block, 0);
+
+	if (READ_ONCE(shared->wrwait))
+		/* This call rescheds internally. */
+		rtdm_event_pulse(&sk->o_event);
+	else if (resched)
+		xnsched_run();
+
+	cobalt_atomic_leave(s);
+
+	return ret;
+out:
+	cobalt_atomic_leave(s);
+
+	return ret;
+}
+
 static ssize_t __bufp_recvmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      struct sockaddr_ipc *saddr)
@@ -324,11 +504,15 @@ static ssize_t __bufp_recvmsg(struct rtdm_fd *fd,
 		vlen = wrlen >= iov[nvec].iov_len ? iov[nvec].iov_len : wrlen;
 		if (rtdm_fd_is_user(fd)) {
 			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = __bufp_readbuf(sk, &bufd, flags);
+			ret = sk->ring ?
+				__bufp_ring_readbuf(sk, &bufd, flags) :
+				__bufp_readbuf(sk, &bufd, flags);
 			xnbufd_unmap_uread(&bufd);
 		} else {
 			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = __bufp_readbuf(sk, &bufd, flags);
+			ret = sk->ring ?
+				__bufp_ring_readbuf(sk, &bufd, flags) :
+				__bufp_readbuf(sk, &bufd, flags);
 			xnbufd_unmap_kread(&bufd);
 		}
 		if (ret < 0)
@@ -525,6 +709,119 @@ out:
 	return ret;
 }
 
+/*
+ * SPSC mode, see __bufp_ring_readbuf(). We are the only writer, the
+ * caller guarantees it.
+ */
+static ssize_t __bufp_ring_writebuf(struct bufp_socket *rsk,
+				    struct bufp_socket *sk,
+				    struct xnbufd *bufd,
+				    int flags)
+{
+	struct rtipc_bufp_ring *shared = rsk->ring->shared;
+	size_t len, wbytes, n, wroff;
+	ssize_t ret, xret;
+	rtdm_toseq_t toseq;
+	rtdm_lockctx_t s;
+	u32 head, tail;
+	int resched;
+
+	len = bufd->b_len;
+
+	rtdm_toseq_init(&toseq, sk->tx_timeout);
+
+	head = READ_ONCE(shared->head);
+
+	cobalt_atomic_enter(s);
+
+	for (;;) {
+		tail = smp_load_acquire(&shared->tail);
+		if (head - tail > rsk->bufsz) {
+			/* Bogus indices, the reader is misbehaving. */
+			ret = -EIO;
+			goto out;
+		}
+
+		/* No short writes, as in the regular mode. */
+		if (rsk->bufsz - (head - tail) >= len)
+			break;
+
+		if (flags & MSG_DONTWAIT) {
+			ret = -EWOULDBLOCK;
+			goto out;
+		}
+
+		WRITE_ONCE(shared->wrwait, len);
+		smp_mb();
+		tail = READ_ONCE(shared->tail);
+		if (rsk->bufsz - (head - tail) >= len) {
+			WRITE_ONCE(shared->wrwait, 0);
+			continue;
+		}
+
+		/*
+		 * A reader sleeping in the kernel may have to be
+		 * woken up for a short read, see __bufp_ring_readbuf().
+		 */
+		if (READ_ONCE(shared->rdwait))
+			rtdm_event_pulse(&rsk->i_event);
+
+		ret = rtdm_event_timedwait(&rsk->o_event,
+					   sk->tx_timeout, &toseq);
+		WRITE_ONCE(shared->wrwait, 0);
+		if (unlikely(ret))
+			goto out;
+	}
+
+	cobalt_atomic_leave(s);
+
+	/*
+	 * We can't rollback on bad read from user since the room
+	 * is ours already: bluntly clear the unavailable bytes.
+	 */
+	wroff = head & (rsk->bufsz - 1);
+	wbytes = ret = len;
+	do {
+		n = min(wbytes, rsk->bufsz - wroff);
+		xret = ret < 0 ? -EFAULT :
+			xnbufd_copy_to_kmem(rsk->bufmem + wroff, bufd, n);
+		if (xret < 0) {
+			memset(rsk->bufmem + wroff, 0, n);
+			ret = -EFAULT;
+		}
+		wbytes -= n;
+		wroff = (wroff + n) & (rsk->bufsz - 1);
+	} while (wbytes > 0);
+
+	cobalt_atomic_enter(s);
+
+	/* Publish the data before the new head. */
+	smp_store_release(&shared->head, head + len);
+	smp_mb();
+
+	resched = 0;
+	tail = READ_ONCE(shared->tail);
+	if (tail == head) /* -> becomes readable */
+		resched |= xnselect_signal(&rsk->priv->recv_block, POLLIN);
+
+	if (head + len - tail == rsk->bufsz) /* -> becomes non-writable */
+		resched |= xnselect_signal(&rsk->priv->send_block, 0);
+
+	if (READ_ONCE(shared->rdwait))
+		/* This call rescheds internally. */
+		rtdm_event_pulse(&rsk->i_event);
+	else if (resched)
+		xnsched_run();
+
+	cobalt_atomic_leave(s);
+
+	return ret;
+out:
+	cobalt_atomic_leave(s);
+
+	return ret;
+}
+
 static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      const struct sockaddr_ipc *daddr)
@@ -541,11 +838,7 @@ static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 	if (len == 0)
 		return 0;
 
-	cobalt_atomic_enter(s);
-	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
-	if (rfd && rtdm_fd_lock(rfd) < 0)
-		rfd = NULL;
-	cobalt_atomic_leave(s);
+	rfd = __bufp_lock_port(daddr->sipc_port);
 	if (rfd == NULL)
 		return -ECONNRESET;
 
@@ -575,11 +868,15 @@ static ssize_t __bufp_sendmsg(struct rtdm_fd *fd,
 		vlen = rdlen >= iov[nvec].iov_len ? iov[nvec].iov_len : rdlen;
 		if (rtdm_fd_is_user(fd)) {
 			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = __bufp_writebuf(rsk, sk, &bufd, flags);
+			ret = rsk->ring ?
+				__bufp_ring_writebuf(rsk, sk, &bufd, flags) :
+				__bufp_writebuf(rsk, sk, &bufd, flags);
 			xnbufd_unmap_uread(&bufd);
 		} else {
 			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = __bufp_writebuf(rsk, sk, &bufd, flags);
+			ret = rsk->ring ?
+				__bufp_ring_writebuf(rsk, sk, &bufd, flags) :
+				__bufp_writebuf(rsk, sk, &bufd, flags);
 			xnbufd_unmap_kread(&bufd);
 		}
 		if (ret < 0)
@@ -702,10 +999,28 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 	if (sk->bufsz == 0)
 		return -ENOBUFS;
 
-	sk->bufmem = xnheap_vmalloc(sk->bufsz);
-	if (sk->bufmem == NULL) {
-		ret = -ENOMEM;
-		goto fail;
+	if (sk->spsc) {
+		/*
+		 * The ring indices are free-running 32bit counters,
+		 * which requires a power-of-two size.
+		 */
+		if (sk->bufsz > (1U << 31)) {
+			ret = -EINVAL;
+			goto fail;
+		}
+		sk->bufsz = roundup_pow_of_two(sk->bufsz);
+		sk->ring = __bufp_create_ring(sk->bufsz);
+		if (sk->ring == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+		sk->bufmem = (void *)sk->ring->shared + RTIPC_BUFP_RING_DATA;
+	} else {
+		sk->bufmem = xnheap_vmalloc(sk->bufsz);
+		if (sk->bufmem == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
 	}
 
 	sk->name = *sa;
@@ -717,7 +1032,11 @@ static int __bufp_bind_socket(struct rtipc_private *priv,
 		ret = xnregistry_enter(sk->label, sk,
 				       &sk->handle, &__bufp_pnode.node);
 		if (ret) {
-			xnheap_vfree(sk->bufmem);
+			if (sk->ring) {
+				__bufp_put_ring(sk->ring);
+				sk->ring = NULL;
+			} else
+				xnheap_vfree(sk->bufmem);
 			goto fail;
 		}
 	}
@@ -822,7 +1141,7 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 	struct __kernel_old_timeval tv;
 	rtdm_lockctx_t s;
 	size_t len;
-	int ret;
+	int ret, val;
 
 	ret = rtipc_get_sockoptin(fd, &sopt, arg);
 	if (ret)
@@ -876,6 +1195,20 @@ static int __bufp_setsockopt(struct bufp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case BUFP_SPSC:
+		if (sopt.optlen < sizeof(val))
+			return -EINVAL;
+		if (rtipc_get_arg(fd, &val, sopt.optval, sizeof(val)))
+			return -EFAULT;
+		cobalt_atomic_enter(s);
+		if (test_bit(_BUFP_BOUND, &sk->status) ||
+		    test_bit(_BUFP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->spsc = !!val;
+		cobalt_atomic_leave(s);
+		break;
+
 	case BUFP_LABEL:
 		if (sopt.optlen < sizeof(plabel))
 			return -EINVAL;
@@ -966,6 +1299,43 @@ static int __bufp_getsockopt(struct bufp_socket *sk,
 	return ret;
 }
 
+/*
+ * Wake up the threads sleeping on the ring of the socket, or on the
+ * ring of its default destination, after the caller moved the
+ * indices through the mapping.
+ */
+static int __bufp_kick(struct rtdm_fd *fd)
+{
+	struct bufp_socket *sk = rtipc_fd_to_state(fd), *rsk = sk;
+	struct rtipc_bufp_ring *shared;
+	struct rtdm_fd *rfd = NULL;
+	int ret = 0;
+
+	if (sk->ring == NULL) {
+		if (sk->peer.sipc_port < 0)
+			return -EDESTADDRREQ;
+		rfd = __bufp_lock_port(sk->peer.sipc_port);
+		if (rfd == NULL)
+			return -ECONNRESET;
+		rsk = rtipc_fd_to_state(rfd);
+	}
+
+	if (rsk->ring) {
+		shared = rsk->ring->shared;
+		smp_mb();
+		if (READ_ONCE(shared->rdwait))
+			rtdm_event_pulse(&rsk->i_event);
+		if (READ_ONCE(shared->wrwait))
+			rtdm_event_pulse(&rsk->o_event);
+	} else
+		ret = -EOPNOTSUPP;
+
+	if (rfd)
+		rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
 static int __bufp_ioctl(struct rtdm_fd *fd,
 			unsigned int request, void *arg)
 {
@@ -1017,6 +1387,10 @@ static int __bufp_ioctl(struct rtdm_fd *fd,
 		ret = -ENOTCONN;
 		break;
 
+	case BUFP_RTIOC_KICK:
+		ret = __bufp_kick(fd);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -1041,6 +1415,18 @@ static int bufp_ioctl(struct rtdm_fd *fd,
 	return ret;
 }
 
+static inline size_t __bufp_fillsz(struct bufp_socket *sk)
+{
+	struct rtipc_bufp_ring *shared;
+
+	if (sk->ring == NULL)
+		return sk->fillsz;
+
+	shared = sk->ring->shared;
+
+	return (u32)(READ_ONCE(shared->head) - READ_ONCE(shared->tail));
+}
+
 static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
@@ -1048,7 +1434,7 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 	unsigned int mask = 0;
 	struct rtdm_fd *rfd;
 
-	if (test_bit(_BUFP_BOUND, &sk->status) && sk->fillsz > 0)
+	if (test_bit(_BUFP_BOUND, &sk->status) && __bufp_fillsz(sk) > 0)
 		mask |= POLLIN;
 
 	/*
@@ -1061,7 +1447,7 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 		rfd = xnmap_fetch_nocheck(portmap, sk->peer.sipc_port);
 		if (rfd) {
 			rsk = rtipc_fd_to_state(rfd);
-			if (rsk->fillsz < rsk->bufsz)
+			if (__bufp_fillsz(rsk) < rsk->bufsz)
 				mask |= POLLOUT;
 		}
 	} else
@@ -1070,6 +1456,66 @@ static unsigned int bufp_pollstate(struct rtdm_fd *fd) /* atomic */
 	return mask;
 }
 
+static void bufp_ring_vmopen(struct vm_area_struct *vma)
+{
+	struct bufp_ring *ring = vma->vm_private_data;
+
+	atomic_inc(&ring->refs);
+}
+
+static void bufp_ring_vmclose(struct vm_area_struct *vma)
+{
+	__bufp_put_ring(vma->vm_private_data);
+}
+
+static struct vm_operations_struct bufp_ring_vmops = {
+	.open = bufp_ring_vmopen,
+	.close = bufp_ring_vmclose,
+};
+
+/*
+ * Map the ring of the socket, or the ring of its default destination
+ * if it has none.
+ */
+static int bufp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct bufp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd = NULL;
+	struct bufp_ring *ring;
+	int ret;
+
+	ring = sk->ring;
+	if (ring == NULL) {
+		if (sk->peer.sipc_port < 0)
+			return -EDESTADDRREQ;
+		rfd = __bufp_lock_port(sk->peer.sipc_port);
+		if (rfd == NULL)
+			return -ECONNRESET;
+		rsk = rtipc_fd_to_state(rfd);
+		ring = rsk->ring;
+	}
+
+	if (ring == NULL)
+		ret = -ENXIO;
+	else if (vma->vm_pgoff != 0 ||
+		 vma->vm_end - vma->vm_start > ring->mapsz)
+		ret = -EINVAL;
+	else {
+		ret = rtdm_mmap_vmem(vma, ring->shared);
+		if (ret == 0) {
+			atomic_inc(&ring->refs);
+			vma->vm_ops = &bufp_ring_vmops;
+			vma->vm_private_data = ring;
+		}
+	}
+
+	if (rfd)
+		rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
 static int bufp_init(void)
 {
 	portmap = xnmap_create(CONFIG_XENO_OPT_BUFP_NRPORT, 0, 0);
@@ -1098,5 +1544,6 @@ struct rtipc_protocol bufp_proto_driver = {
 		.write = bufp_write,
 		.ioctl = bufp_ioctl,
 		.pollstate = bufp_pollstate,
+		.mmap = bufp_mmap,
 	}
 };
@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/poll.h>
 #include <linux/time.h>
+#include <linux/mm.h>
 #include <cobalt/kernel/heap.h>
 #include <cobalt/kernel/bufd.h>
 #include <cobalt/kernel/map.h>
@@ -39,6 +40,27 @@ struct iddp_message {
 	char data[];
 };
 
+struct iddp_zcslot {
+	struct rtdm_fd *owner;	/* Holder, NULL if free or queued. */
+	struct iddp_message mbuf;
+};
+
+/*
+ * Zero-copy pool, carved into fixed-size buffers. The pool is
+ * referenced by the socket it belongs to, by the sockets allocating
+ * buffers from it, and by every user mapping.
+ */
+struct iddp_zcpool {
+	atomic_t refs;
+	void *mem;
+	size_t size;
+	size_t bufsz;
+	unsigned int nbufs;
+	struct list_head freeq;
+	struct iddp_zcslot *slots;
+	rtdm_waitqueue_t waitq;
+};
+
 struct iddp_socket {
 	int magic;
 	struct sockaddr_ipc name;
@@ -48,6 +70,9 @@ struct iddp_socket {
 	rtdm_waitqueue_t *poolwaitq;
 	rtdm_waitqueue_t privwaitq;
 	size_t poolsz;
+	size_t zcbufsz;
+	struct iddp_zcpool *zcpool; /* Local zero-copy pool. */
+	struct iddp_zcpool *zcpeer; /* Pool we allocate buffers from. */
 	rtdm_sem_t insem;
 	struct list_head inq;
 	u_long status;
@@ -109,6 +134,138 @@ static inline void __iddp_init_mbuf(struct iddp_message *mbuf, size_t len)
 	INIT_LIST_HEAD(&mbuf->next);
 }
 
+static inline struct iddp_zcslot *__iddp_mbuf_slot(struct iddp_message *mbuf)
+{
+	return container_of(mbuf, struct iddp_zcslot, mbuf);
+}
+
+static inline char *__iddp_mbuf_data(struct iddp_socket *sk,
+				     struct iddp_message *mbuf)
+{
+	struct iddp_zcpool *pool = sk->zcpool;
+
+	if (pool == NULL)
+		return mbuf->data;
+
+	return pool->mem + (__iddp_mbuf_slot(mbuf) - pool->slots) * pool->bufsz;
+}
+
+static inline struct iddp_zcslot *__iddp_zcslot(struct iddp_zcpool *pool,
+						u32 offset)
+{
+	unsigned int n = offset / pool->bufsz;
+
+	return n < pool->nbufs ? pool->slots + n : NULL;
+}
+
+static inline u32 __iddp_zcoffset(struct iddp_zcpool *pool,
+				  struct iddp_zcslot *slot)
+{
+	return (slot - pool->slots) * pool->bufsz;
+}
+
+/* nklock held, irqs off. */
+static inline void __iddp_put_zcslot(struct iddp_zcpool *pool,
+				     struct iddp_zcslot *slot)
+{
+	slot->owner = NULL;
+	list_add(&slot->mbuf.next, &pool->freeq);
+}
+
+static struct iddp_zcpool *__iddp_create_zcpool(size_t poolsz, size_t bufsz)
+{
+	struct iddp_zcpool *pool;
+	unsigned int n;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (pool == NULL)
+		return NULL;
+
+	pool->size = PAGE_ALIGN(poolsz);
+	pool->bufsz = bufsz;
+	pool->nbufs = pool->size / bufsz;
+	pool->slots = kcalloc(pool->nbufs, sizeof(*pool->slots), GFP_KERNEL);
+	if (pool->slots == NULL)
+		goto fail_slots;
+
+	pool->mem = xnheap_vmalloc(pool->size);
+	if (pool->mem == NULL)
+		goto fail_mem;
+
+	/* This memory is going to be mapped to user space. */
+	memset(pool->mem, 0, pool->size);
+	INIT_LIST_HEAD(&pool->freeq);
+	for (n = 0; n < pool->nbufs; n++)
+		list_add_tail(&pool->slots[n].mbuf.next, &pool->freeq);
+
+	rtdm_waitqueue_init(&pool->waitq);
+	atomic_set(&pool->refs, 1);
+
+	return pool;
+
+fail_mem:
+	kfree(pool->slots);
+fail_slots:
+	kfree(pool);
+
+	return NULL;
+}
+
+static void __iddp_put_zcpool(struct iddp_zcpool *pool)
+{
+	if (!atomic_dec_and_test(&pool->refs))
+		return;
+
+	rtdm_waitqueue_destroy(&pool->waitq);
+	xnheap_vfree(pool->mem);
+	kfree(pool->slots);
+	kfree(pool);
+}
+
+/*
+ * Return the buffers @fd still holds to @pool, then drop the
+ * reference @fd had on it.
+ */
+static void __iddp_release_zcpool(struct rtdm_fd *fd,
+				  struct iddp_zcpool *pool)
+{
+	struct iddp_zcslot *slot;
+	rtdm_lockctx_t s;
+	unsigned int n;
+
+	for (n = 0; n < pool->nbufs; n++) {
+		slot = pool->slots + n;
+		cobalt_atomic_enter(s);
+		if (slot->owner == fd)
+			__iddp_put_zcslot(pool, slot);
+		cobalt_atomic_leave(s);
+	}
+
+	rtdm_waitqueue_broadcast(&pool->waitq);
+	__iddp_put_zcpool(pool);
+}
+
+static struct iddp_message *__iddp_get_mbuf(struct iddp_socket *sk,
+					    size_t len)
+{
+	struct iddp_zcpool *pool = sk->zcpool;
+	struct iddp_message *mbuf = NULL;
+	rtdm_lockctx_t s;
+
+	if (pool == NULL)
+		return xnheap_alloc(sk->bufpool, len + sizeof(*mbuf));
+
+	cobalt_atomic_enter(s);
+	if (!list_empty(&pool->freeq)) {
+		mbuf = list_first_entry(&pool->freeq,
+					struct iddp_message, next);
+		list_del(&mbuf->next);
+	}
+	cobalt_atomic_leave(s);
+
+	return mbuf;
+}
+
 static struct iddp_message *
 __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 		  nanosecs_rel_t timeout, int flags, int *pret)
@@ -118,10 +275,15 @@ __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 	rtdm_lockctx_t s;
 	int ret = 0;
 
+	if (sk->zcpool && len > sk->zcpool->bufsz) {
+		*pret = -EMSGSIZE;
+		return NULL;
+	}
+
 	rtdm_toseq_init(&timeout_seq, timeout);
 
 	for (;;) {
-		mbuf = xnheap_alloc(sk->bufpool, len + sizeof(*mbuf));
+		mbuf = __iddp_get_mbuf(sk, len);
 		if (mbuf) {
 			__iddp_init_mbuf(mbuf, len);
 			break;
@@ -155,10 +317,32 @@ __iddp_alloc_mbuf(struct iddp_socket *sk, size_t len,
 static void __iddp_free_mbuf(struct iddp_socket *sk,
 			     struct iddp_message *mbuf)
 {
-	xnheap_free(sk->bufpool, mbuf);
+	rtdm_lockctx_t s;
+
+	if (sk->zcpool) {
+		cobalt_atomic_enter(s);
+		__iddp_put_zcslot(sk->zcpool, __iddp_mbuf_slot(mbuf));
+		cobalt_atomic_leave(s);
+	} else
+		xnheap_free(sk->bufpool, mbuf);
+
 	rtdm_waitqueue_broadcast(sk->poolwaitq);
 }
 
+static struct rtdm_fd *__iddp_lock_port(int port)
+{
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+
+	cobalt_atomic_enter(s);
+	rfd = xnmap_fetch_nocheck(portmap, port);
+	if (rfd && rtdm_fd_lock(rfd) < 0)
+		rfd = NULL;
+	cobalt_atomic_leave(s);
+
+	return rfd;
+}
+
 static int iddp_socket(struct rtdm_fd *fd)
 {
 	struct rtipc_private *priv = rtdm_fd_to_private(fd);
@@ -170,6 +354,9 @@ static int iddp_socket(struct rtdm_fd *fd)
 	sk->bufpool = &cobalt_heap;
 	sk->poolwaitq = &poolwaitq;
 	sk->poolsz = 0;
+	sk->zcbufsz = 0;
+	sk->zcpool = NULL;
+	sk->zcpeer = NULL;
 	sk->status = 0;
 	sk->handle = 0;
 	sk->rx_timeout = RTDM_TIMEOUT_INFINITE;
@@ -196,6 +383,9 @@ static void iddp_close(struct rtdm_fd *fd)
 	rtdm_sem_destroy(&sk->insem);
 	rtdm_waitqueue_destroy(&sk->privwaitq);
 
+	if (sk->zcpeer)
+		__iddp_release_zcpool(fd, sk->zcpeer);
+
 	if (test_bit(_IDDP_BOUND, &sk->status)) {
 		if (sk->handle)
 			xnregistry_remove(sk->handle);
@@ -204,12 +394,17 @@ static void iddp_close(struct rtdm_fd *fd)
 			xnmap_remove(portmap, sk->name.sipc_port);
 			cobalt_atomic_leave(s);
 		}
+		if (sk->zcpool) {
+			/* Unread datagrams live in the pool. */
+			__iddp_release_zcpool(fd, sk->zcpool);
+			goto out;
+		}
 		if (sk->bufpool != &cobalt_heap) {
 			poolmem = xnheap_get_membase(&sk->privpool);
 			poolsz = xnheap_get_size(&sk->privpool);
 			xnheap_destroy(&sk->privpool);
 			xnheap_vfree(poolmem);
-			return;
+			goto out;
 		}
 	}
 
@@ -219,10 +414,34 @@ static void iddp_close(struct rtdm_fd *fd)
 		list_del(&mbuf->next);
 		xnheap_free(&cobalt_heap, mbuf);
 	}
-
+out:
 	kfree(sk);
+}
 
-	return;
+static ssize_t __iddp_recv_zcbuf(struct rtdm_fd *fd,
+				 struct iddp_socket *sk,
+				 struct iddp_message *mbuf,
+				 struct iovec *iov, size_t rdoff, size_t len)
+{
+	struct iddp_zcslot *slot = __iddp_mbuf_slot(mbuf);
+	struct iddp_zcpool *pool = sk->zcpool;
+	struct rtipc_iddp_zcbuf zc;
+
+	/* The caller owns the buffer from now on. */
+	zc.offset = __iddp_zcoffset(pool, slot) + rdoff;
+	zc.len = len;
+	zc.from = mbuf->from;
+	zc.flags = 0;
+
+	if (rtipc_put_arg(fd, iov[0].iov_base, &zc, sizeof(zc))) {
+		__iddp_free_mbuf(sk, mbuf);
+		return -EFAULT;
+	}
+
+	iov[0].iov_base += sizeof(zc);
+	iov[0].iov_len -= sizeof(zc);
+
+	return len;
 }
 
 static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
@@ -238,10 +457,18 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 	nanosecs_rel_t timeout;
 	struct xnbufd bufd;
 	rtdm_lockctx_t s;
+	char *data;
 
 	if (!test_bit(_IDDP_BOUND, &sk->status))
 		return -EAGAIN;
 
+	if (flags & MSG_ZEROCOPY) {
+		if (sk->zcpool == NULL)
+			return -EOPNOTSUPP;
+		if (iov[0].iov_len < sizeof(struct rtipc_iddp_zcbuf))
+			return -EINVAL;
+	}
+
 	maxlen = rtdm_get_iov_flatlen(iov, iovlen);
 	if (maxlen == 0)
 		return 0;
@@ -278,12 +505,13 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 		saddr->sipc_family = AF_RTIPC;
 		saddr->sipc_port = mbuf->from;
 	}
-	if (maxlen >= len) {
+	if (maxlen >= len || (flags & MSG_ZEROCOPY)) {
 		list_del(&mbuf->next);
 		dofree = 1;
 		if (list_empty(&sk->inq)) /* -> non-readable */
 			xnselect_signal(&priv->recv_block, 0);
-
+		if (flags & MSG_ZEROCOPY)
+			__iddp_mbuf_slot(mbuf)->owner = fd;
 	} else {
 		/* Buffer is only partially read: repost. */
 		mbuf->rdoff += maxlen;
@@ -296,6 +524,11 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 
 	cobalt_atomic_leave(s);
 
+	if (flags & MSG_ZEROCOPY)
+		return __iddp_recv_zcbuf(fd, sk, mbuf, iov, rdoff, len);
+
+	data = __iddp_mbuf_data(sk, mbuf);
+
 	/* Now, write "len" bytes from mbuf->data to the vector cells */
 	for (nvec = 0, wrlen = len; nvec < iovlen && wrlen > 0; nvec++) {
 		if (iov[nvec].iov_len == 0)
@@ -303,11 +536,11 @@ static ssize_t __iddp_recvmsg(struct rtdm_fd *fd,
 		vlen = wrlen >= iov[nvec].iov_len ? iov[nvec].iov_len : wrlen;
 		if (rtdm_fd_is_user(fd)) {
 			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_from_kmem(&bufd, mbuf->data + rdoff, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, data + rdoff, vlen);
 			xnbufd_unmap_uread(&bufd);
 		} else {
 			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_from_kmem(&bufd, mbuf->data + rdoff, vlen);
+			ret = xnbufd_copy_from_kmem(&bufd, data + rdoff, vlen);
 			xnbufd_unmap_kread(&bufd);
 		}
 		if (ret < 0)
@@ -331,7 +564,7 @@ static ssize_t iddp_recvmsg(struct rtdm_fd *fd,
 	struct sockaddr_ipc saddr;
 	ssize_t ret;
 
-	if (flags & ~MSG_DONTWAIT)
+	if (flags & ~(MSG_DONTWAIT | MSG_ZEROCOPY))
 		return -EINVAL;
 
 	if (msg->msg_name) {
@@ -375,6 +608,79 @@ static ssize_t iddp_read(struct rtdm_fd *fd, void *buf, size_t len)
 	return __iddp_recvmsg(fd, &iov, 1, 0, NULL);
 }
 
+/* nklock held, irqs off. */
+static void __iddp_post_mbuf(struct iddp_socket *sk, struct iddp_socket *rsk,
+			     struct iddp_message *mbuf, int flags)
+{
+	/*
+	 * CAUTION: we must remain atomic from the moment we signal
+	 * POLLIN, until sem_up has happened.
+	 */
+	if (list_empty(&rsk->inq)) /* -> readable */
+		xnselect_signal(&rsk->priv->recv_block, POLLIN);
+
+	mbuf->from = sk->name.sipc_port;
+
+	if (flags & MSG_OOB)
+		list_add(&mbuf->next, &rsk->inq);
+	else
+		list_add_tail(&mbuf->next, &rsk->inq);
+
+	rtdm_sem_up(&rsk->insem); /* Will resched. */
+}
+
+/*
+ * Pass the ownership of a buffer from the zero-copy pool of @rsk,
+ * which the sender must hold, to the receiver.
+ */
+static ssize_t __iddp_send_zcbuf(struct rtdm_fd *fd,
+				 struct iddp_socket *sk,
+				 struct iddp_socket *rsk,
+				 struct iovec *iov, int flags)
+{
+	struct iddp_zcpool *pool = rsk->zcpool;
+	struct rtipc_iddp_zcbuf zc;
+	struct iddp_zcslot *slot;
+	rtdm_lockctx_t s;
+	size_t rdoff;
+
+	if (pool == NULL)
+		return -EOPNOTSUPP;
+
+	if (iov[0].iov_len < sizeof(zc))
+		return -EINVAL;
+
+	if (rtipc_get_arg(fd, &zc, iov[0].iov_base, sizeof(zc)))
+		return -EFAULT;
+
+	slot = __iddp_zcslot(pool, zc.offset);
+	if (slot == NULL)
+		return -EINVAL;
+
+	rdoff = zc.offset - __iddp_zcoffset(pool, slot);
+	if (zc.len == 0 || zc.len > pool->bufsz - rdoff)
+		return -EINVAL;
+
+	cobalt_atomic_enter(s);
+
+	if (slot->owner != fd) {
+		cobalt_atomic_leave(s);
+		return -EINVAL;
+	}
+
+	slot->owner = NULL;
+	slot->mbuf.rdoff = rdoff;
+	slot->mbuf.len = rdoff + zc.len;
+	__iddp_post_mbuf(sk, rsk, &slot->mbuf, flags);
+
+	cobalt_atomic_leave(s);
+
+	iov[0].iov_base += sizeof(zc);
+	iov[0].iov_len -= sizeof(zc);
+
+	return zc.len;
+}
+
 static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 			      struct iovec *iov, int iovlen, int flags,
 			      const struct sockaddr_ipc *daddr)
@@ -387,16 +693,13 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 	struct rtdm_fd *rfd;
 	struct xnbufd bufd;
 	rtdm_lockctx_t s;
+	char *data;
 
 	len = rtdm_get_iov_flatlen(iov, iovlen);
 	if (len == 0)
 		return 0;
 
-	cobalt_atomic_enter(s);
-	rfd = xnmap_fetch_nocheck(portmap, daddr->sipc_port);
-	if (rfd && rtdm_fd_lock(rfd) < 0)
-		rfd = NULL;
-	cobalt_atomic_leave(s);
+	rfd = __iddp_lock_port(daddr->sipc_port);
 	if (rfd == NULL)
 		return -ECONNRESET;
 
@@ -406,12 +709,20 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 		return -ECONNREFUSED;
 	}
 
+	if (flags & MSG_ZEROCOPY) {
+		len = __iddp_send_zcbuf(fd, sk, rsk, iov, flags);
+		rtdm_fd_unlock(rfd);
+		return len;
+	}
+
 	mbuf = __iddp_alloc_mbuf(rsk, len, sk->tx_timeout, flags, &ret);
 	if (unlikely(ret)) {
 		rtdm_fd_unlock(rfd);
 		return ret;
 	}
 
+	data = __iddp_mbuf_data(rsk, mbuf);
+
 	/* Now, move "len" bytes to mbuf->data from the vector cells */
 	for (nvec = 0, rdlen = len, wroff = 0;
 	     nvec < iovlen && rdlen > 0; nvec++) {
@@ -420,11 +731,11 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 		vlen = rdlen >= iov[nvec].iov_len ? iov[nvec].iov_len : rdlen;
 		if (rtdm_fd_is_user(fd)) {
 			xnbufd_map_uread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_to_kmem(mbuf->data + wroff, &bufd, vlen);
+			ret = xnbufd_copy_to_kmem(data + wroff, &bufd, vlen);
 			xnbufd_unmap_uread(&bufd);
 		} else {
 			xnbufd_map_kread(&bufd, iov[nvec].iov_base, vlen);
-			ret = xnbufd_copy_to_kmem(mbuf->data + wroff, &bufd, vlen);
+			ret = xnbufd_copy_to_kmem(data + wroff, &bufd, vlen);
 			xnbufd_unmap_kread(&bufd);
 		}
 		if (ret < 0)
@@ -436,23 +747,7 @@ static ssize_t __iddp_sendmsg(struct rtdm_fd *fd,
 	}
 
 	cobalt_atomic_enter(s);
-
-	/*
-	 * CAUTION: we must remain atomic from the moment we signal
-	 * POLLIN, until sem_up has happened.
-	 */
-	if (list_empty(&rsk->inq)) /* -> readable */
-		xnselect_signal(&rsk->priv->recv_block, POLLIN);
-
-	mbuf->from = sk->name.sipc_port;
-
-	if (flags & MSG_OOB)
-		list_add(&mbuf->next, &rsk->inq);
-	else
-		list_add_tail(&mbuf->next, &rsk->inq);
-
-	rtdm_sem_up(&rsk->insem); /* Will resched. */
-
+	__iddp_post_mbuf(sk, rsk, mbuf, flags);
 	cobalt_atomic_leave(s);
 
 	rtdm_fd_unlock(rfd);
@@ -476,7 +771,7 @@ static ssize_t iddp_sendmsg(struct rtdm_fd *fd,
 	struct sockaddr_ipc daddr;
 	ssize_t ret;
 
-	if (flags & ~(MSG_OOB | MSG_DONTWAIT))
+	if (flags & ~(MSG_OOB | MSG_DONTWAIT | MSG_ZEROCOPY))
 		return -EINVAL;
 
 	if (msg->msg_name) {
@@ -569,7 +864,24 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 	 * setsockopt() before we got there.
 	 */
 	poolsz = sk->poolsz;
-	if (poolsz > 0) {
+	if (sk->zcbufsz > 0) {
+		if (PAGE_ALIGN(poolsz) < sk->zcbufsz ||
+		    PAGE_ALIGN(poolsz) > U32_MAX) {
+			ret = -EINVAL;
+			goto fail;
+		}
+		if (sk->zcpeer) {
+			ret = -EXDEV;
+			goto fail;
+		}
+		sk->zcpool = __iddp_create_zcpool(poolsz, sk->zcbufsz);
+		if (sk->zcpool == NULL) {
+			ret = -ENOMEM;
+			goto fail;
+		}
+		sk->poolwaitq = &sk->zcpool->waitq;
+		poolsz = 0;
+	} else if (poolsz > 0) {
 		poolsz = PAGE_ALIGN(poolsz);
 		poolmem = xnheap_vmalloc(poolsz);
 		if (poolmem == NULL) {
@@ -599,6 +911,9 @@ static int __iddp_bind_socket(struct rtdm_fd *fd,
 			if (poolsz > 0) {
 				xnheap_destroy(&sk->privpool);
 				xnheap_vfree(poolmem);
+			} else if (sk->zcpool) {
+				__iddp_put_zcpool(sk->zcpool);
+				sk->zcpool = NULL;
 			}
 			goto fail;
 		}
@@ -758,6 +1073,21 @@ static int __iddp_setsockopt(struct iddp_socket *sk,
 		cobalt_atomic_leave(s);
 		break;
 
+	case IDDP_ZCBUFSZ:
+		ret = rtipc_get_length(fd, &len, sopt.optval, sopt.optlen);
+		if (ret)
+			return ret;
+		if (len == 0 || len > U32_MAX)
+			return -EINVAL;
+		cobalt_atomic_enter(s);
+		if (test_bit(_IDDP_BOUND, &sk->status) ||
+		    test_bit(_IDDP_BINDING, &sk->status))
+			ret = -EALREADY;
+		else
+			sk->zcbufsz = ALIGN(len, L1_CACHE_BYTES);
+		cobalt_atomic_leave(s);
+		break;
+
 	case IDDP_LABEL:
 		if (sopt.optlen < sizeof(plabel))
 			return -EINVAL;
@@ -792,6 +1122,7 @@ static int __iddp_getsockopt(struct iddp_socket *sk,
 	struct rtipc_port_label plabel;
 	struct __kernel_old_timeval tv;
 	rtdm_lockctx_t s;
+	size_t zcbufsz;
 	socklen_t len;
 	int ret;
 
@@ -842,6 +1173,14 @@ static int __iddp_getsockopt(struct iddp_socket *sk,
 			return -EFAULT;
 		break;
 
+	case IDDP_ZCBUFSZ:
+		if (len < sizeof(zcbufsz))
+			return -EINVAL;
+		zcbufsz = sk->zcbufsz;
+		if (rtipc_put_arg(fd, sopt.optval, &zcbufsz, sizeof(zcbufsz)))
+			return -EFAULT;
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -849,6 +1188,109 @@ static int __iddp_getsockopt(struct iddp_socket *sk,
 	return ret;
 }
 
+static int __iddp_zcalloc(struct rtdm_fd *fd, void *arg)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state, *rsk;
+	struct rtipc_iddp_zcbuf zc;
+	struct iddp_message *mbuf;
+	struct iddp_zcpool *pool;
+	struct iddp_zcslot *slot;
+	struct rtdm_fd *rfd;
+	rtdm_lockctx_t s;
+	int ret = 0;
+
+	if (rtipc_get_arg(fd, &zc, arg, sizeof(zc)))
+		return -EFAULT;
+
+	if (sk->peer.sipc_port < 0)
+		return -EDESTADDRREQ;
+
+	rfd = __iddp_lock_port(sk->peer.sipc_port);
+	if (rfd == NULL)
+		return -ECONNRESET;
+
+	rsk = rtipc_fd_to_state(rfd);
+	pool = rsk->zcpool;
+	if (pool == NULL) {
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	/*
+	 * Stick to a single pool, so that we know which one to
+	 * return the buffers we hold to when closing.
+	 */
+	cobalt_atomic_enter(s);
+	if (sk->zcpeer == NULL) {
+		if (sk->zcpool && sk->zcpool != pool)
+			ret = -EXDEV;
+		else {
+			atomic_inc(&pool->refs);
+			sk->zcpeer = pool;
+		}
+	} else if (sk->zcpeer != pool)
+		ret = -EXDEV;
+	cobalt_atomic_leave(s);
+	if (ret)
+		goto out;
+
+	mbuf = __iddp_alloc_mbuf(rsk, 0, sk->tx_timeout,
+				 zc.flags & MSG_DONTWAIT, &ret);
+	if (unlikely(ret))
+		goto out;
+
+	slot = __iddp_mbuf_slot(mbuf);
+	slot->owner = fd;
+	zc.offset = __iddp_zcoffset(pool, slot);
+	zc.len = pool->bufsz;
+	zc.from = -1;
+
+	if (rtipc_put_arg(fd, arg, &zc, sizeof(zc))) {
+		__iddp_free_mbuf(rsk, mbuf);
+		ret = -EFAULT;
+	}
+out:
+	rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
+static int __iddp_zcfree(struct rtdm_fd *fd, void *arg)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state;
+	struct rtipc_iddp_zcbuf zc;
+	struct iddp_zcpool *pool;
+	struct iddp_zcslot *slot;
+	rtdm_lockctx_t s;
+	int ret = 0;
+
+	if (rtipc_get_arg(fd, &zc, arg, sizeof(zc)))
+		return -EFAULT;
+
+	/* We may only hold buffers from a single pool. */
+	pool = sk->zcpool ?: sk->zcpeer;
+	if (pool == NULL)
+		return -EINVAL;
+
+	slot = __iddp_zcslot(pool, zc.offset);
+	if (slot == NULL)
+		return -EINVAL;
+
+	cobalt_atomic_enter(s);
+	if (slot->owner == fd)
+		__iddp_put_zcslot(pool, slot);
+	else
+		ret = -EINVAL;
+	cobalt_atomic_leave(s);
+
+	if (ret == 0)
+		rtdm_waitqueue_broadcast(&pool->waitq);
+
+	return ret;
+}
+
 static int __iddp_ioctl(struct rtdm_fd *fd,
 			unsigned int request, void *arg)
 {
@@ -900,6 +1342,14 @@ static int __iddp_ioctl(struct rtdm_fd *fd,
 		ret = -ENOTCONN;
 		break;
 
+	case IDDP_RTIOC_ZCALLOC:
+		ret = __iddp_zcalloc(fd, arg);
+		break;
+
+	case IDDP_RTIOC_ZCFREE:
+		ret = __iddp_zcfree(fd, arg);
+		break;
+
 	default:
 		ret = -EINVAL;
 	}
@@ -913,6 +1363,12 @@ static int iddp_ioctl(struct rtdm_fd *fd,
 	int ret;
 
 	switch (request) {
+	case IDDP_RTIOC_ZCALLOC:
+		/* May block waiting for a buffer. */
+		if (!rtdm_in_rt_context())
+			return -ENOSYS;	/* Try upgrading to RT */
+		ret = __iddp_ioctl(fd, request, arg);
+		break;
 	COMPAT_CASE(_RTIOC_BIND):
 		if (rtdm_in_rt_context())
 			return -ENOSYS;	/* Try downgrading to NRT */
@@ -972,6 +1428,66 @@ static unsigned int iddp_pollstate(struct rtdm_fd *fd) /* atomic */
 	return mask;
 }
 
+static void iddp_zcpool_vmopen(struct vm_area_struct *vma)
+{
+	struct iddp_zcpool *pool = vma->vm_private_data;
+
+	atomic_inc(&pool->refs);
+}
+
+static void iddp_zcpool_vmclose(struct vm_area_struct *vma)
+{
+	__iddp_put_zcpool(vma->vm_private_data);
+}
+
+static struct vm_operations_struct iddp_zcpool_vmops = {
+	.open = iddp_zcpool_vmopen,
+	.close = iddp_zcpool_vmclose,
+};
+
+/*
+ * Map the zero-copy pool of the socket, or the pool of its default
+ * destination if it has none.
+ */
+static int iddp_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtipc_private *priv = rtdm_fd_to_private(fd);
+	struct iddp_socket *sk = priv->state, *rsk;
+	struct rtdm_fd *rfd = NULL;
+	struct iddp_zcpool *pool;
+	int ret;
+
+	pool = sk->zcpool;
+	if (pool == NULL) {
+		if (sk->peer.sipc_port < 0)
+			return -EDESTADDRREQ;
+		rfd = __iddp_lock_port(sk->peer.sipc_port);
+		if (rfd == NULL)
+			return -ECONNRESET;
+		rsk = rtipc_fd_to_state(rfd);
+		pool = rsk->zcpool;
+	}
+
+	if (pool == NULL)
+		ret = -ENXIO;
+	else if (vma->vm_pgoff != 0 ||
+		 vma->vm_end - vma->vm_start > pool->size)
+		ret = -EINVAL;
+	else {
+		ret = rtdm_mmap_vmem(vma, pool->mem);
+		if (ret == 0) {
+			atomic_inc(&pool->refs);
+			vma->vm_ops = &iddp_zcpool_vmops;
+			vma->vm_private_data = pool;
+		}
+	}
+
+	if (rfd)
+		rtdm_fd_unlock(rfd);
+
+	return ret;
+}
+
 struct rtipc_protocol iddp_proto_driver = {
 	.proto_name = "iddp",
 	.proto_statesz = sizeof(struct iddp_socket),
@@ -986,5 +1502,6 @@ struct rtipc_protocol iddp_proto_driver = {
 		.write = iddp_write,
 		.ioctl = iddp_ioctl,
 		.pollstate = iddp_pollstate,
+		.mmap = iddp_mmap,
 	}
 };
@@ -57,6 +57,8 @@ struct rtipc_protocol {
 		int (*ioctl)(struct rtdm_fd *fd,
 			     unsigned int request, void *arg);
 		unsigned int (*pollstate)(struct rtdm_fd *fd);
+		int (*mmap)(struct rtdm_fd *fd,
+			    struct vm_area_struct *vma);
 	} proto_ops;
 };
 
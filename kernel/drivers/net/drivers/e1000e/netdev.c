@@ -682,6 +682,9 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 	int cleaned_count = 0;
 	bool data_received = false;
 	unsigned int total_rx_bytes = 0, total_rx_packets = 0;
+	struct rtskb_burst burst;
+
+	rtskb_burst_init(&burst);
 
 	i = rx_ring->next_to_clean;
 	rx_desc = E1000_RX_DESC_EXT(*rx_ring, i);
@@ -753,7 +756,7 @@ static bool e1000_clean_rx_irq(struct e1000_adapter *adapter,
 
 		skb->protocol = rt_eth_type_trans(skb, netdev);
 		skb->time_stamp = *time_stamp;
-		rtnetif_rx(skb);
+		rtskb_burst_add(&burst, skb);
 		data_received = true;
 
 next_desc:
@@ -774,6 +777,8 @@ next_desc:
 	}
 	rx_ring->next_to_clean = i;
 
+	rtnetif_rx_burst(&burst);
+
 	cleaned_count = e1000_desc_unused(rx_ring);
 	if (cleaned_count)
 		adapter->alloc_rx_buf(adapter, cleaned_count, GFP_ATOMIC);
@@ -4898,8 +4898,11 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 	unsigned int total_bytes = 0, total_packets = 0;
 	u16 cleaned_count = igb_desc_unused(rx_ring);
 	nanosecs_abs_t time_stamp = rtdm_clock_read();
+	struct rtskb_burst burst;
 	struct rtskb *skb;
 
+	rtskb_burst_init(&burst);
+
 	while (likely(total_packets < budget)) {
 		union e1000_adv_rx_desc *rx_desc;
 
@@ -4942,7 +4945,7 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 		/* populate checksum, timestamp, VLAN, and protocol */
 		igb_process_skb_fields(rx_ring, rx_desc, skb);
 
-		rtnetif_rx(skb);
+		rtskb_burst_add(&burst, skb);
 
 		/* reset skb pointer */
 		skb = NULL;
@@ -4951,6 +4954,8 @@ static bool igb_clean_rx_irq(struct igb_q_vector *q_vector, const int budget)
 		total_packets++;
 	}
 
+	rtnetif_rx_burst(&burst);
+
 	rx_ring->rx_stats.packets += total_packets;
 	rx_ring->rx_stats.bytes += total_bytes;
 	q_vector->rx.total_packets += total_packets;
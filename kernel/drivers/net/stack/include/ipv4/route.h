@@ -36,6 +36,14 @@ struct dest_route {
 	struct rtnet_device *rtdev;
 };
 
+/* Last output route of a socket, see rt_ip_route_output_cached() */
+struct dest_route_cache {
+	struct dest_route rt;
+	u32 daddr;
+	u32 saddr;
+	unsigned int genid;
+};
+
 int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
 			 struct rtnet_device *rtdev);
 void rt_ip_route_del_all(struct rtnet_device *rtdev);
@@ -53,6 +61,13 @@ int rt_ip_route_del_host(u32 addr, struct rtnet_device *rtdev);
 int rt_ip_route_get_host(u32 addr, char *if_name, unsigned char *dev_addr,
 			 struct rtnet_device *rtdev);
 int rt_ip_route_output(struct dest_route *rt_buf, u32 daddr, u32 saddr);
+int rt_ip_route_output_cached(struct dest_route_cache *cache,
+			      struct dest_route *rt_buf, u32 daddr, u32 saddr);
+
+static inline void rt_ip_route_cache_init(struct dest_route_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+}
 
 int __init rt_ip_routing_init(void);
 void rt_ip_routing_release(void);
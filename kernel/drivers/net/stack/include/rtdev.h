@@ -114,6 +114,7 @@ struct rtnet_device {
 	__u32 broadcast_ip; /* broadcast IP in network order */
 
 	rtdm_event_t *stack_event;
+	struct rtnet_rxq *rxq; /* stack manager queue this device feeds */
 
 	rtdm_mutex_t xmit_mutex; /* protects xmit routine        */
 	rtdm_lock_t rtdev_lock; /* management lock              */
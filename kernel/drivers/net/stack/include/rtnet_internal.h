@@ -55,10 +55,8 @@ struct rtnet_device;
     struct rtnet_device *rtdev;
 };*/
 
+/* RX queues and their stack tasks are private to stack_mgr.c */
 struct rtnet_mgr {
-	rtdm_task_t task;
-	/*    MBX     mbx;*/
-	rtdm_event_t event;
 };
 
 extern struct rtnet_mgr STACK_manager;
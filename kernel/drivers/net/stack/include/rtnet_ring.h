@@ -0,0 +1,90 @@
+/***
+ *
+ *  include/rtnet_ring.h - shared memory socket rings
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#ifndef __RTNET_RING_H_
+#define __RTNET_RING_H_
+
+#include <linux/mm.h>
+#include <rtdm/net.h>
+#include <rtskb.h>
+
+struct rtsocket;
+
+struct rtsocket_ring {
+	void *mem; /* vmalloc'ed slot area, mapped to user */
+	size_t size;
+	unsigned int frame_size;
+	unsigned int rx_frames;
+	unsigned int tx_frames;
+
+	rtdm_lock_t rx_lock; /* serializes RX producers */
+	unsigned int rx_head; /* next RX slot to fill */
+	unsigned long rx_delivered;
+	unsigned long rx_drops;
+	atomic_t rx_waiters;
+	rtdm_event_t rx_event;
+
+	rtdm_lock_t tx_lock;
+	unsigned int tx_head; /* next TX slot to send */
+};
+
+static inline struct rtnet_ring_slot *
+rt_socket_ring_slot(struct rtsocket_ring *ring, unsigned int n)
+{
+	return ring->mem + (size_t)n * ring->frame_size;
+}
+
+static inline void *rt_socket_ring_data(struct rtnet_ring_slot *slot)
+{
+	return (void *)slot + RTNET_RING_DATA_OFFSET;
+}
+
+static inline size_t rt_socket_ring_room(struct rtsocket_ring *ring)
+{
+	return ring->frame_size - RTNET_RING_DATA_OFFSET;
+}
+
+int rt_socket_ring_setup(struct rtdm_fd *fd, const struct rtnet_ring_req *req);
+
+void rt_socket_ring_release(struct rtsocket *sock);
+
+int rt_socket_ring_wait(struct rtdm_fd *fd, unsigned int n);
+
+int rt_socket_ring_stats(struct rtdm_fd *fd, struct rtnet_ring_stats *stats);
+
+int rt_socket_ring_select(struct rtsocket_ring *ring,
+			  rtdm_selector_t *selector, unsigned int fd_index);
+
+int rt_socket_ring_rx(struct rtsocket_ring *ring, struct rtskb *skb,
+		      const void *start, size_t len, const void *addr,
+		      size_t addrlen);
+
+struct rtnet_ring_slot *rt_socket_ring_tx_claim(struct rtsocket_ring *ring);
+
+static inline void rt_socket_ring_tx_done(struct rtnet_ring_slot *slot,
+					  int err)
+{
+	smp_mb();
+	WRITE_ONCE(slot->status, err ? RTNET_RING_ERROR : RTNET_RING_KERNEL);
+}
+
+int rt_socket_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma);
+
+#endif /* __RTNET_RING_H_ */
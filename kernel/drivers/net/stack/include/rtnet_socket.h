@@ -34,6 +34,9 @@
 #include <rtdm/net.h>
 #include <rtdm/driver.h>
 #include <stack_mgr.h>
+#include <ipv4/route.h>
+
+struct rtsocket_ring;
 
 struct rtsocket {
 	unsigned short protocol;
@@ -56,6 +59,8 @@ struct rtsocket {
 
 	unsigned long flags;
 
+	struct rtsocket_ring *ring; /* optional shared memory ring */
+
 	union {
 		/* IP specific */
 		struct {
@@ -67,6 +72,8 @@ struct rtsocket {
 			int reg_index; /* index in port registry */
 			u8 tos;
 			u8 state;
+
+			struct dest_route_cache route; /* last output route */
 		} inet;
 
 		/* packet socket specific */
@@ -89,6 +96,8 @@ int rtnet_put_arg(struct rtdm_fd *fd, void *dst, const void *src, size_t len);
 #define rt_socket_reference(sock) rtdm_fd_lock(rt_socket_fd(sock))
 #define rt_socket_dereference(sock) rtdm_fd_unlock(rt_socket_fd(sock))
 
+void rt_stack_rx_signal(struct rtsocket *sock, struct rtskb *skb);
+
 int rt_socket_init(struct rtdm_fd *fd, unsigned short protocol);
 
 void rt_socket_cleanup(struct rtdm_fd *fd);
@@ -69,6 +69,41 @@ static inline void rtdev_unlock_pack(struct rtpacket_type *pt)
 	module_put(pt->owner);
 }
 
+/***
+ * rtskb bursts: frames collected by a driver during one interrupt,
+ * handed over to the stack in one go. All rtskbs of a burst must
+ * come from the same device.
+ */
+struct rtskb_burst {
+	struct rtskb *first;
+	struct rtskb *last;
+	unsigned int len;
+};
+
+static inline void rtskb_burst_init(struct rtskb_burst *burst)
+{
+	burst->first = NULL;
+	burst->last = NULL;
+	burst->len = 0;
+}
+
+static inline void rtskb_burst_add(struct rtskb_burst *burst,
+				   struct rtskb *skb)
+{
+	skb->next = NULL;
+	if (burst->last)
+		burst->last->next = skb;
+	else
+		burst->first = skb;
+	burst->last = skb;
+	burst->len++;
+}
+
+static inline bool rtskb_burst_empty(const struct rtskb_burst *burst)
+{
+	return burst->first == NULL;
+}
+
 void rt_stack_connect(struct rtnet_device *rtdev, struct rtnet_mgr *mgr);
 void rt_stack_disconnect(struct rtnet_device *rtdev);
 
@@ -80,6 +115,7 @@ int rt_stack_mgr_init(struct rtnet_mgr *mgr);
 void rt_stack_mgr_delete(struct rtnet_mgr *mgr);
 
 void rtnetif_rx(struct rtskb *skb);
+void rtnetif_rx_burst(struct rtskb_burst *burst);
 
 static inline void rtnetif_tx(struct rtnet_device *rtdev)
 {
@@ -22,7 +22,7 @@
  *
  */
 
-#include <linux/moduleparam.h>
+#include <linux/seqlock.h>
 #include <net/ip.h>
 
 #include <rtnet_internal.h>
@@ -69,30 +69,47 @@ static int allocated_host_routes;
 static struct host_route *host_hash_tbl[HOST_HASH_TBL_SIZE];
 static DEFINE_RTDM_LOCK(host_table_lock);
 
+/*
+ * Bumped on every change to the routing tables, so that cached
+ * lookup results can be validated without searching again. Changes
+ * to host routes are accounted for under host_table_lock.
+ */
+static atomic_t route_genid = ATOMIC_INIT(1);
+
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
-#if (CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES &                               \
-     (CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES - 1))
-#error CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES must be power of 2
-#endif
-#if CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES < 256
-#define NET_HASH_TBL_SIZE 64
-#else
-#define NET_HASH_TBL_SIZE                                                      \
-	((CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES / 256) * 64)
-#endif
-#define NET_HASH_KEY_MASK (NET_HASH_TBL_SIZE - 1)
-#define NET_HASH_KEY_SHIFT 8
+/*
+ * Network routes are indexed by a path-compressed binary trie keyed
+ * on the destination prefix (host byte order), so that the longest
+ * matching prefix is found in at most 33 steps, regardless of the
+ * number of routes. A node either carries the route for its prefix
+ * or only joins two subtrees, hence twice as many nodes as routes
+ * are always enough.
+ */
+struct net_route_node {
+	struct net_route_node *child[2];
+	struct net_route *route;
+	u32 prefix;
+	unsigned int len;
+};
+
+#define NET_ROUTE_NODES (2 * CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES)
 
 static struct net_route net_routes[CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES];
 static struct net_route *free_net_route;
+static struct net_route *net_route_list;
 static int allocated_net_routes;
-static struct net_route *net_hash_tbl[NET_HASH_TBL_SIZE + 1];
-static unsigned int net_hash_key_shift = NET_HASH_KEY_SHIFT;
+static struct net_route_node net_route_nodes[NET_ROUTE_NODES];
+static struct net_route_node *free_net_route_node;
+static int allocated_net_route_nodes;
+static struct net_route_node *net_route_trie;
 static DEFINE_RTDM_LOCK(net_table_lock);
 
-module_param(net_hash_key_shift, uint, 0444);
-MODULE_PARM_DESC(net_hash_key_shift, "destination right shift for "
-				     "network hash key (default: 8)");
+/*
+ * Readers walk the trie locklessly and retry if a writer changed it
+ * meanwhile. Nodes and routes come from static pools, so a reader
+ * racing with an update may see stale data, but never freed memory.
+ */
+static seqcount_t net_route_seq = SEQCNT_ZERO(net_route_seq);
 #endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
 /***
@@ -101,10 +118,6 @@ MODULE_PARM_DESC(net_hash_key_shift, "destination right shift for "
 #ifdef CONFIG_XENO_OPT_VFILE
 static int rtnet_ipv4_route_show(struct xnvfile_regular_iterator *it, void *d)
 {
-#ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
-	u32 mask;
-#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
-
 	xnvfile_printf(it,
 		       "Host routes allocated/total:\t%d/%d\n"
 		       "Host hash table size:\t\t%d\n",
@@ -113,16 +126,17 @@ static int rtnet_ipv4_route_show(struct xnvfile_regular_iterator *it, void *d)
 		       HOST_HASH_TBL_SIZE);
 
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
-	mask = NET_HASH_KEY_MASK << net_hash_key_shift;
 	xnvfile_printf(it,
 		       "Network routes allocated/total:\t%d/%d\n"
-		       "Network hash table size:\t%d\n"
-		       "Network hash key shift/mask:\t%d/%08X\n",
+		       "Network trie nodes used/total:\t%d/%d\n",
 		       allocated_net_routes,
 		       CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES,
-		       NET_HASH_TBL_SIZE, net_hash_key_shift, mask);
+		       allocated_net_route_nodes, NET_ROUTE_NODES);
 #endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
+	xnvfile_printf(it, "Route generation:\t\t%u\n",
+		       (unsigned int)atomic_read(&route_genid));
+
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_ROUTER
 	xnvfile_printf(it, "IP Router:\t\t\tyes\n");
 #else
@@ -323,12 +337,10 @@ static struct xnvfile_lock_ops rtnet_ipv4_net_route_lock_ops = {
 };
 
 struct rtnet_ipv4_net_route_priv {
-	unsigned key;
 	struct net_route *entry_ptr;
 };
 
 struct rtnet_ipv4_net_route_data {
-	int key;
 	u32 dest_net_ip;
 	u32 dest_net_mask;
 	u32 gw_ip;
@@ -357,8 +369,7 @@ static void *rtnet_ipv4_net_route_begin(struct xnvfile_snapshot_iterator *it)
 		return VFILE_SEQ_EMPTY;
 	}
 
-	priv->key = -1;
-	priv->entry_ptr = NULL;
+	priv->entry_ptr = net_route_list;
 	return data;
 }
 
@@ -375,16 +386,9 @@ static int rtnet_ipv4_net_route_next(struct xnvfile_snapshot_iterator *it,
 	struct rtnet_ipv4_net_route_priv *priv = xnvfile_iterator_priv(it);
 	struct rtnet_ipv4_net_route_data *p = data;
 
-	if (priv->entry_ptr == NULL) {
-		if (++priv->key >= NET_HASH_TBL_SIZE + 1)
-			return 0;
-
-		priv->entry_ptr = net_hash_tbl[priv->key];
-		if (priv->entry_ptr == NULL)
-			return VFILE_SEQ_SKIP;
-	}
+	if (priv->entry_ptr == NULL)
+		return 0;
 
-	p->key = priv->key;
 	p->dest_net_ip = priv->entry_ptr->dest_net_ip;
 	p->dest_net_mask = priv->entry_ptr->dest_net_mask;
 	p->gw_ip = priv->entry_ptr->gw_ip;
@@ -400,22 +404,13 @@ static int rtnet_ipv4_net_route_show(struct xnvfile_snapshot_iterator *it,
 	struct rtnet_ipv4_net_route_data *p = data;
 
 	if (p == NULL) {
-		xnvfile_printf(it, "Hash\tDestination\tMask\t\t\tGateway\n");
+		xnvfile_printf(it, "Destination\tMask\t\t\tGateway\n");
 		return 0;
 	}
 
-	if (p->key < NET_HASH_TBL_SIZE)
-		xnvfile_printf(it,
-			       "%02X\t%u.%u.%u.%-3u\t%u.%u.%u.%-3u"
-			       "\t\t%u.%u.%u.%-3u\n",
-			       p->key, NIPQUAD(p->dest_net_ip),
-			       NIPQUAD(p->dest_net_mask), NIPQUAD(p->gw_ip));
-	else
-		xnvfile_printf(it,
-			       "*\t%u.%u.%u.%-3u\t%u.%u.%u.%-3u\t\t"
-			       "%u.%u.%u.%-3u\n",
-			       NIPQUAD(p->dest_net_ip),
-			       NIPQUAD(p->dest_net_mask), NIPQUAD(p->gw_ip));
+	xnvfile_printf(it, "%u.%u.%u.%-3u\t%u.%u.%u.%-3u\t\t%u.%u.%u.%-3u\n",
+		       NIPQUAD(p->dest_net_ip), NIPQUAD(p->dest_net_mask),
+		       NIPQUAD(p->gw_ip));
 
 	return 0;
 }
@@ -565,9 +560,15 @@ int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
 	while (rt != NULL) {
 		if ((rt->dest_host.ip == addr) &&
 		    (rt->dest_host.rtdev->local_ip == rtdev->local_ip)) {
-			rt->dest_host.rtdev = rtdev;
-			memcpy(rt->dest_host.dev_addr, dev_addr,
-			       rtdev->addr_len);
+			/* ARP refreshes usually leave the route unchanged */
+			if (rt->dest_host.rtdev != rtdev ||
+			    memcmp(rt->dest_host.dev_addr, dev_addr,
+				   rtdev->addr_len)) {
+				rt->dest_host.rtdev = rtdev;
+				memcpy(rt->dest_host.dev_addr, dev_addr,
+				       rtdev->addr_len);
+				atomic_inc(&route_genid);
+			}
 
 			if (new_route)
 				rt_free_host_route(new_route);
@@ -583,6 +584,7 @@ int rt_ip_route_add_host(u32 addr, unsigned char *dev_addr,
 	if (new_route) {
 		new_route->next = host_hash_tbl[key];
 		host_hash_tbl[key] = new_route;
+		atomic_inc(&route_genid);
 
 		rtdm_lock_put_irqrestore(&host_table_lock, context);
 	} else {
@@ -622,6 +624,7 @@ int rt_ip_route_del_host(u32 addr, struct rtnet_device *rtdev)
 			*last_ptr = rt->next;
 
 			rt_free_host_route(rt);
+			atomic_inc(&route_genid);
 
 			xnvfile_touch_tag(&host_route_tag);
 
@@ -662,6 +665,7 @@ void rt_ip_route_del_all(struct rtnet_device *rtdev)
 				*last_host_ptr = host_rt->next;
 
 				rt_free_host_route(host_rt);
+				atomic_inc(&route_genid);
 
 				rtdm_lock_put_irqrestore(&host_table_lock,
 							 context);
@@ -718,21 +722,18 @@ int rt_ip_route_get_host(u32 addr, char *if_name, unsigned char *dev_addr,
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
 /***
  *  rt_alloc_net_route - allocates new network route
+ *
+ *  Note: must be called with net_table_lock held
  */
 static inline struct net_route *rt_alloc_net_route(void)
 {
-	rtdm_lockctx_t context;
 	struct net_route *rt;
 
-	rtdm_lock_get_irqsave(&net_table_lock, context);
-
 	if ((rt = free_net_route) != NULL) {
 		free_net_route = rt->next;
 		allocated_net_routes++;
 	}
 
-	rtdm_lock_put_irqrestore(&net_table_lock, context);
-
 	return rt;
 }
 
@@ -745,7 +746,211 @@ static inline void rt_free_net_route(struct net_route *rt)
 {
 	rt->next = free_net_route;
 	free_net_route = rt;
-	allocated_host_routes--;
+	allocated_net_routes--;
+}
+
+/***
+ *  rt_net_prefix_mask - returns the host order mask of a prefix length
+ */
+static inline u32 rt_net_prefix_mask(unsigned int len)
+{
+	return len ? ~0U << (32 - len) : 0;
+}
+
+/***
+ *  rt_net_prefix_bit - returns the bit of @key which follows @len bits
+ */
+static inline unsigned int rt_net_prefix_bit(u32 key, unsigned int len)
+{
+	return (key >> (31 - len)) & 1;
+}
+
+/***
+ *  rt_net_prefix_common - returns the length of the common prefix of @a
+ *  and @b, up to @len bits
+ */
+static inline unsigned int rt_net_prefix_common(u32 a, u32 b, unsigned int len)
+{
+	unsigned int common = 32 - fls(a ^ b);
+
+	return min(common, len);
+}
+
+/***
+ *  rt_alloc_net_route_node - allocates new trie node
+ *
+ *  Note: must be called with net_table_lock held
+ */
+static struct net_route_node *rt_alloc_net_route_node(u32 prefix,
+						      unsigned int len)
+{
+	struct net_route_node *node = free_net_route_node;
+
+	free_net_route_node = node->child[0];
+	allocated_net_route_nodes++;
+
+	node->child[0] = NULL;
+	node->child[1] = NULL;
+	node->route = NULL;
+	node->prefix = prefix & rt_net_prefix_mask(len);
+	node->len = len;
+
+	return node;
+}
+
+/***
+ *  rt_free_net_route_node - releases trie node
+ *
+ *  Note: must be called with net_table_lock held
+ */
+static void rt_free_net_route_node(struct net_route_node *node)
+{
+	node->child[0] = free_net_route_node;
+	free_net_route_node = node;
+	allocated_net_route_nodes--;
+}
+
+/***
+ *  rt_net_route_insert - links a new route into the trie
+ *
+ *  Note: must be called with net_table_lock held and net_route_seq
+ *  write-locked, at least two trie nodes must be available
+ */
+static void rt_net_route_insert(struct net_route *rt, unsigned int len)
+{
+	struct net_route_node **link = &net_route_trie;
+	struct net_route_node *node, *new, *glue;
+	u32 key = ntohl(rt->dest_net_ip);
+	unsigned int common = 0;
+
+	while ((node = *link) != NULL) {
+		common = rt_net_prefix_common(node->prefix, key,
+					      min(node->len, len));
+		if (common < node->len)
+			break;
+
+		if (node->len == len) {
+			/* prefix already known as a branching point */
+			node->route = rt;
+			return;
+		}
+
+		link = &node->child[rt_net_prefix_bit(key, node->len)];
+	}
+
+	new = rt_alloc_net_route_node(key, len);
+	new->route = rt;
+
+	if (node != NULL) {
+		if (common == len)
+			/* the new prefix covers the current subtree */
+			new->child[rt_net_prefix_bit(node->prefix, len)] = node;
+		else {
+			/* both prefixes diverge, join them */
+			glue = rt_alloc_net_route_node(key, common);
+			glue->child[rt_net_prefix_bit(key, common)] = new;
+			glue->child[rt_net_prefix_bit(node->prefix, common)] =
+				node;
+			new = glue;
+		}
+	}
+
+	*link = new;
+}
+
+/***
+ *  rt_net_route_remove - unlinks a route from the trie
+ *
+ *  Note: must be called with net_table_lock held and net_route_seq
+ *  write-locked
+ */
+static void rt_net_route_remove(struct net_route *rt, unsigned int len)
+{
+	struct net_route_node **link = &net_route_trie;
+	struct net_route_node **parent_link = NULL;
+	struct net_route_node *node, *parent = NULL, *child;
+	u32 key = ntohl(rt->dest_net_ip);
+
+	while ((node = *link) != NULL && node->len < len) {
+		parent_link = link;
+		parent = node;
+		link = &node->child[rt_net_prefix_bit(key, node->len)];
+	}
+
+	if (node == NULL || node->route != rt)
+		return;
+
+	node->route = NULL;
+
+	/* keep the node as long as it joins two subtrees */
+	if (node->child[0] != NULL && node->child[1] != NULL)
+		return;
+
+	child = node->child[0] ? node->child[0] : node->child[1];
+	*link = child;
+	rt_free_net_route_node(node);
+
+	/* a route-less parent has no purpose once left with one subtree */
+	if (child == NULL && parent != NULL && parent->route == NULL) {
+		*parent_link = parent->child[0] ? parent->child[0] :
+						  parent->child[1];
+		rt_free_net_route_node(parent);
+	}
+}
+
+/***
+ *  rt_net_route_lookup - finds the gateway of the longest matching
+ *  network route
+ *
+ *  Note: lockless, may run concurrently with updates of the trie
+ */
+static int rt_net_route_lookup(u32 daddr, u32 *gw_ip)
+{
+	struct net_route_node *node;
+	struct net_route *rt;
+	u32 key = ntohl(daddr);
+	unsigned int seq, len;
+	int last_len, found;
+	u32 gw;
+
+	do {
+		seq = raw_read_seqcount_begin(&net_route_seq);
+		found = 0;
+		gw = 0;
+		last_len = -1;
+
+		node = READ_ONCE(net_route_trie);
+		while (node != NULL) {
+			/*
+			 * Prefixes get longer on each step, unless we race
+			 * with a writer, in which case we retry anyway.
+			 */
+			len = READ_ONCE(node->len);
+			if (len > 32 || (int)len <= last_len)
+				break;
+			last_len = len;
+
+			if ((key & rt_net_prefix_mask(len)) !=
+			    READ_ONCE(node->prefix))
+				break;
+
+			rt = READ_ONCE(node->route);
+			if (rt != NULL) {
+				gw = READ_ONCE(rt->gw_ip);
+				found = 1;
+			}
+
+			if (len == 32)
+				break;
+
+			node = READ_ONCE(node->child[rt_net_prefix_bit(key, len)]);
+		}
+	} while (read_seqcount_retry(&net_route_seq, seq));
+
+	if (found)
+		*gw_ip = gw;
+
+	return found;
 }
 
 /***
@@ -756,60 +961,53 @@ int rt_ip_route_add_net(u32 addr, u32 mask, u32 gw_addr)
 	rtdm_lockctx_t context;
 	struct net_route *new_route;
 	struct net_route *rt;
-	struct net_route **last_ptr;
-	unsigned int key;
-	u32 shifted_mask;
+	u32 host_mask = ntohl(mask);
 
-	addr &= mask;
-
-	if ((new_route = rt_alloc_net_route()) != NULL) {
-		new_route->dest_net_ip = addr;
-		new_route->dest_net_mask = mask;
-		new_route->gw_ip = gw_addr;
-	}
+	/* longest prefix matching requires contiguous masks */
+	if (~host_mask & (~host_mask + 1))
+		return -EINVAL;
 
-	shifted_mask = NET_HASH_KEY_MASK << net_hash_key_shift;
-	if ((mask & shifted_mask) == shifted_mask)
-		key = (ntohl(addr) >> net_hash_key_shift) & NET_HASH_KEY_MASK;
-	else
-		key = NET_HASH_TBL_SIZE;
-	last_ptr = &net_hash_tbl[key];
+	addr &= mask;
 
 	rtdm_lock_get_irqsave(&net_table_lock, context);
 
 	xnvfile_touch_tag(&net_route_tag);
 
-	rt = net_hash_tbl[key];
-	while (rt != NULL) {
+	for (rt = net_route_list; rt != NULL; rt = rt->next)
 		if ((rt->dest_net_ip == addr) && (rt->dest_net_mask == mask)) {
+			raw_write_seqcount_begin(&net_route_seq);
 			rt->gw_ip = gw_addr;
-
-			if (new_route)
-				rt_free_net_route(new_route);
+			atomic_inc(&route_genid);
+			raw_write_seqcount_end(&net_route_seq);
 
 			rtdm_lock_put_irqrestore(&net_table_lock, context);
 
 			return 0;
 		}
 
-		last_ptr = &rt->next;
-		rt = rt->next;
-	}
-
-	if (new_route) {
-		new_route->next = *last_ptr;
-		*last_ptr = new_route;
-
-		rtdm_lock_put_irqrestore(&net_table_lock, context);
-
-		return 0;
-	} else {
+	if (allocated_net_route_nodes + 2 > NET_ROUTE_NODES ||
+	    (new_route = rt_alloc_net_route()) == NULL) {
 		rtdm_lock_put_irqrestore(&net_table_lock, context);
 
 		/*ERRMSG*/ rtdm_printk(
 			"RTnet: no more network routes available\n");
 		return -ENOBUFS;
 	}
+
+	new_route->dest_net_ip = addr;
+	new_route->dest_net_mask = mask;
+	new_route->gw_ip = gw_addr;
+	new_route->next = net_route_list;
+	net_route_list = new_route;
+
+	raw_write_seqcount_begin(&net_route_seq);
+	rt_net_route_insert(new_route, hweight32(mask));
+	atomic_inc(&route_genid);
+	raw_write_seqcount_end(&net_route_seq);
+
+	rtdm_lock_put_irqrestore(&net_table_lock, context);
+
+	return 0;
 }
 
 /***
@@ -820,25 +1018,22 @@ int rt_ip_route_del_net(u32 addr, u32 mask)
 	rtdm_lockctx_t context;
 	struct net_route *rt;
 	struct net_route **last_ptr;
-	unsigned int key;
-	u32 shifted_mask;
 
 	addr &= mask;
 
-	shifted_mask = NET_HASH_KEY_MASK << net_hash_key_shift;
-	if ((mask & shifted_mask) == shifted_mask)
-		key = (ntohl(addr) >> net_hash_key_shift) & NET_HASH_KEY_MASK;
-	else
-		key = NET_HASH_TBL_SIZE;
-	last_ptr = &net_hash_tbl[key];
-
 	rtdm_lock_get_irqsave(&net_table_lock, context);
 
-	rt = net_hash_tbl[key];
+	last_ptr = &net_route_list;
+	rt = net_route_list;
 	while (rt != NULL) {
 		if ((rt->dest_net_ip == addr) && (rt->dest_net_mask == mask)) {
 			*last_ptr = rt->next;
 
+			raw_write_seqcount_begin(&net_route_seq);
+			rt_net_route_remove(rt, hweight32(mask));
+			atomic_inc(&route_genid);
+			raw_write_seqcount_end(&net_route_seq);
+
 			rt_free_net_route(rt);
 
 			xnvfile_touch_tag(&net_route_tag);
@@ -874,7 +1069,6 @@ int rt_ip_route_output(struct dest_route *rt_buf, u32 daddr, u32 saddr)
 #else
 #define DADDR real_daddr
 
-	struct net_route *net_rt;
 	int lookup_gw = 1;
 	u32 real_daddr = daddr;
 
@@ -925,54 +1119,68 @@ restart:
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING
 	if (lookup_gw) {
 		lookup_gw = 0;
-		key = (ntohl(daddr) >> net_hash_key_shift) & NET_HASH_KEY_MASK;
-
-		rtdm_lock_get_irqsave(&net_table_lock, context);
 
-		net_rt = net_hash_tbl[key];
-		while (net_rt != NULL) {
-			if (net_rt->dest_net_ip ==
-			    (daddr & net_rt->dest_net_mask)) {
-				daddr = net_rt->gw_ip;
+		if (rt_net_route_lookup(daddr, &daddr))
+			/* start over, now using the gateway ip as destination */
+			goto restart;
+	}
+#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
-				rtdm_lock_put_irqrestore(&net_table_lock,
-							 context);
+	/*ERRMSG*/ rtdm_printk("RTnet: host %u.%u.%u.%u unreachable\n",
+			       NIPQUAD(daddr));
+	return -EHOSTUNREACH;
+}
 
-				/* start over, now using the gateway ip as destination */
-				goto restart;
-			}
+/***
+ *  rt_ip_route_output_cached - looks up output route, reusing the result
+ *  stored in @cache as long as the routing tables did not change
+ *
+ *  Note: increments refcount on returned rtdev in rt_buf
+ */
+int rt_ip_route_output_cached(struct dest_route_cache *cache,
+			      struct dest_route *rt_buf, u32 daddr, u32 saddr)
+{
+	rtdm_lockctx_t context;
+	unsigned int genid;
+	int err;
 
-			net_rt = net_rt->next;
-		}
+	/*
+	 * The cache holds no reference on the device, host_table_lock
+	 * keeps it from going away until we got one: removing its
+	 * routes bumps the generation under that lock.
+	 */
+	rtdm_lock_get_irqsave(&host_table_lock, context);
 
-		rtdm_lock_put_irqrestore(&net_table_lock, context);
+	genid = atomic_read(&route_genid);
+	if (likely(cache->genid == genid && cache->rt.rtdev != NULL &&
+		   cache->daddr == daddr && cache->saddr == saddr) &&
+	    rtdev_reference(cache->rt.rtdev)) {
+		*rt_buf = cache->rt;
 
-		/* last try: no hash key */
-		rtdm_lock_get_irqsave(&net_table_lock, context);
+		rtdm_lock_put_irqrestore(&host_table_lock, context);
 
-		net_rt = net_hash_tbl[NET_HASH_TBL_SIZE];
-		while (net_rt != NULL) {
-			if (net_rt->dest_net_ip ==
-			    (daddr & net_rt->dest_net_mask)) {
-				daddr = net_rt->gw_ip;
+		return 0;
+	}
 
-				rtdm_lock_put_irqrestore(&net_table_lock,
-							 context);
+	rtdm_lock_put_irqrestore(&host_table_lock, context);
 
-				/* start over, now using the gateway ip as destination */
-				goto restart;
-			}
+	err = rt_ip_route_output(rt_buf, daddr, saddr);
+	if (err)
+		return err;
 
-			net_rt = net_rt->next;
-		}
+	rtdm_lock_get_irqsave(&host_table_lock, context);
 
-		rtdm_lock_put_irqrestore(&net_table_lock, context);
+	/* do not keep a result which may already be outdated */
+	if (atomic_read(&route_genid) == genid) {
+		cache->rt = *rt_buf;
+		cache->daddr = daddr;
+		cache->saddr = saddr;
+		cache->genid = genid;
 	}
-#endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
-	/*ERRMSG*/ rtdm_printk("RTnet: host %u.%u.%u.%u unreachable\n",
-			       NIPQUAD(daddr));
-	return -EHOSTUNREACH;
+	rtdm_lock_put_irqrestore(&host_table_lock, context);
+
+	return 0;
 }
 
 #ifdef CONFIG_XENO_DRIVERS_NET_RTIPV4_ROUTER
@@ -1032,6 +1240,10 @@ int __init rt_ip_routing_init(void)
 	for (i = 0; i < CONFIG_XENO_DRIVERS_NET_RTIPV4_NET_ROUTES - 2; i++)
 		net_routes[i].next = &net_routes[i + 1];
 	free_net_route = &net_routes[0];
+
+	for (i = 0; i < NET_ROUTE_NODES - 1; i++)
+		net_route_nodes[i].child[0] = &net_route_nodes[i + 1];
+	free_net_route_node = &net_route_nodes[0];
 #endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_NETROUTING */
 
 #ifdef CONFIG_XENO_OPT_VFILE
@@ -1055,3 +1267,4 @@ EXPORT_SYMBOL_GPL(rt_ip_route_add_host);
 EXPORT_SYMBOL_GPL(rt_ip_route_del_host);
 EXPORT_SYMBOL_GPL(rt_ip_route_del_all);
 EXPORT_SYMBOL_GPL(rt_ip_route_output);
+EXPORT_SYMBOL_GPL(rt_ip_route_output_cached);
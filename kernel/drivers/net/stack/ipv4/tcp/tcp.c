@@ -64,14 +64,40 @@ MODULE_PARM_DESC(counter_start, "start value of per-socket packet counter "
 
 #endif /* CONFIG_XENO_DRIVERS_NET_RTIPV4_TCP_ERROR_INJECTION */
 
+static unsigned int window_size = 16384;
+module_param(window_size, uint, 0664);
+MODULE_PARM_DESC(window_size,
+		 "receive window (bytes) offered to peers, default 16384; larger "
+		 "windows need larger socket pools (socket_rtskbs or "
+		 "RTNET_RTIOC_EXTPOOL)");
+
+/*
+  maximum allowed number of retransmissions
+*/
+static unsigned int max_retransmits = 8;
+module_param(max_retransmits, uint, 0664);
+MODULE_PARM_DESC(max_retransmits,
+		 "max retransmissions of a segment before the connection is "
+		 "dropped, default 8");
+
 struct tcp_sync {
 	u32 seq;
 	u32 ack_seq;
 
 	/* Local window size sent to peer  */
-	u16 window;
-	/* Last received destination peer window size */
-	u16 dst_window;
+	u32 window;
+	/* Part of the peer window which may still be filled */
+	u32 dst_window;
+
+	/* First unacknowledged sequence number */
+	u32 una;
+	/* Last received destination peer window size, scaled */
+	u32 wnd;
+
+	/* RFC 7323 window scaling, shifts apply if wscale_ok is set */
+	u8 rcv_wscale;
+	u8 snd_wscale;
+	u8 wscale_ok;
 };
 
 /*
@@ -80,8 +106,8 @@ struct tcp_sync {
 /* 5 second */
 static const nanosecs_rel_t rt_tcp_connection_timeout = 1000000000ull;
 
-/* retransmission timerwheel timeout */
-static const u64 rt_tcp_retransmit_timeout = 100000000ull;
+/* timerwheel slot length, 2^23 ns = 8.38 ms */
+#define RT_TCP_TIMER_GRANULARITY 23
 
 /*
   keepalive constants
@@ -96,12 +122,15 @@ static const u64 rt_tcp_keepalive_timeout = 7200000000000ull;
 /*
   retransmission timeout
 */
-/* 50 millisecond */
+/* 50 millisecond, used until the first RTT sample is taken */
 static const nanosecs_rel_t rt_tcp_retransmission_timeout = 50000000ull;
-/*
-  maximum allowed number of retransmissions
-*/
-static const unsigned int max_retransmits = 3;
+/* 20 millisecond */
+static const nanosecs_rel_t rt_tcp_rto_min = 20000000ull;
+/* 2 second, also the span of the timerwheel */
+static const nanosecs_rel_t rt_tcp_rto_max = 2000000000ull;
+
+/* upper bound of the congestion window */
+#define RT_TCP_MAX_CWND (65535U << TCP_MAX_WSCALE)
 
 struct tcp_keepalive {
 	u8 enabled;
@@ -148,10 +177,26 @@ struct tcp_socket {
 	nanosecs_rel_t sk_sndtimeo;
 
 	/* retransmission routine data */
-	u32 nacked_first;
 	unsigned int timer_state;
 	struct rtskb_queue retransmit_queue;
 	struct timerwheel_timer timer;
+	nanosecs_abs_t rto_expires;
+
+	/* RTT estimation (RFC 6298) */
+	nanosecs_rel_t srtt;
+	nanosecs_rel_t rttvar;
+	nanosecs_rel_t rto;
+	nanosecs_abs_t rtt_start;
+	u32 rtt_seq;
+	u8 rtt_pending;
+
+	/* congestion control (RFC 5681, RFC 6582) */
+	u8 in_recovery;
+	u8 dupacks;
+	u32 mss;
+	u32 cwnd;
+	u32 ssthresh;
+	u32 recover;
 
 	struct completion fin_handshake;
 	rtdm_nrtsig_t close_sig;
@@ -299,6 +344,199 @@ static inline u32 rt_tcp_compute_ack_seq(struct tcphdr *th, u32 len)
 	return ack_seq;
 }
 
+/* sequence number following the segment held by skb */
+static inline u32 rt_tcp_skb_end_seq(struct rtskb *skb)
+{
+	struct tcphdr *th = skb->h.th;
+	u32 len = skb->tail - skb->h.raw - (th->doff << 2);
+
+	return ntohl(th->seq) + len + th->syn + th->fin;
+}
+
+/* window field value to send, the window of SYN segments is never scaled */
+static inline u16 rt_tcp_adv_window(struct tcp_socket *ts, int syn)
+{
+	u32 window = ts->sync.window;
+
+	if (!syn && ts->sync.wscale_ok)
+		window >>= ts->sync.rcv_wscale;
+
+	return min_t(u32, window, 65535U);
+}
+
+static inline u32 rt_tcp_peer_window(struct tcp_socket *ts, struct tcphdr *th)
+{
+	u32 window = ntohs(th->window);
+
+	if (!th->syn && ts->sync.wscale_ok)
+		window <<= ts->sync.snd_wscale;
+
+	return window;
+}
+
+static void rt_tcp_checksum(struct tcp_socket *ts, struct tcphdr *th, u32 len)
+{
+	th->check = 0;
+	th->check = tcp_v4_check(len, ts->saddr, ts->daddr,
+				 csum_partial(th, len, 0));
+}
+
+/***
+ *  rt_tcp_update_dst_window - compute how much may be sent (socket locked)
+ *
+ *  Data in flight is bounded by the peer window, the congestion window
+ *  and the socket pool, which has to hold a copy of each segment in the
+ *  retransmission queue next to the one being transmitted.
+ */
+static void rt_tcp_update_dst_window(struct tcp_socket *ts)
+{
+	u32 flight = ts->sync.seq - ts->sync.una;
+	u32 limit = min(ts->sync.wnd, ts->cwnd);
+
+	limit = min(limit, (ts->sock.pool_size / 2) * ts->mss);
+	ts->sync.dst_window = limit > flight ? limit - flight : 0;
+}
+
+/***
+ *  rt_tcp_init_window - reset per-connection sending and receiving state
+ *  @ts: rttcp socket, locked
+ *  @rtdev: device the connection goes through
+ */
+static void rt_tcp_init_window(struct tcp_socket *ts,
+			       struct rtnet_device *rtdev)
+{
+	u32 window = min(window_size, RT_TCP_MAX_CWND);
+	u8 wscale = 0;
+
+	while ((window >> wscale) > 65535)
+		wscale++;
+
+	ts->mss = rtdev->get_mtu(rtdev, ts->sock.priority) -
+		  sizeof(struct iphdr) - sizeof(struct tcphdr);
+
+	ts->sync.window = window;
+	ts->sync.dst_window = 0;
+	ts->sync.wnd = 0;
+	ts->sync.rcv_wscale = wscale;
+	ts->sync.snd_wscale = 0;
+	/* offer scaling, cleared if the peer does not */
+	ts->sync.wscale_ok = 1;
+
+	ts->srtt = 0;
+	ts->rttvar = 0;
+	ts->rto = rt_tcp_retransmission_timeout;
+	ts->rtt_pending = 0;
+
+	ts->cwnd = 0;
+	ts->ssthresh = RT_TCP_MAX_CWND;
+	ts->dupacks = 0;
+	ts->in_recovery = 0;
+}
+
+static inline u8 rt_tcp_syn_options_len(struct tcp_socket *ts)
+{
+	/* MSS, then NOP and window scale to keep 32-bit alignment */
+	return ts->sync.wscale_ok ? TCPOLEN_MSS + 1 + TCPOLEN_WINDOW :
+				    TCPOLEN_MSS;
+}
+
+static void rt_tcp_build_syn_options(struct tcp_socket *ts, u8 *ptr)
+{
+	*ptr++ = TCPOPT_MSS;
+	*ptr++ = TCPOLEN_MSS;
+	*ptr++ = ts->mss >> 8;
+	*ptr++ = ts->mss & 0xff;
+
+	if (ts->sync.wscale_ok) {
+		*ptr++ = TCPOPT_NOP;
+		*ptr++ = TCPOPT_WINDOW;
+		*ptr++ = TCPOLEN_WINDOW;
+		*ptr = ts->sync.rcv_wscale;
+	}
+}
+
+/***
+ *  rt_tcp_parse_syn_options - apply the options of a received SYN
+ *  @ts: rttcp socket, locked
+ *  @th: SYN or SYN|ACK header
+ *
+ *  A peer which sends no MSS option is assumed to use our own, since
+ *  RTnet peers have never sent any.
+ */
+static void rt_tcp_parse_syn_options(struct tcp_socket *ts, struct tcphdr *th)
+{
+	int length = (th->doff << 2) - sizeof(struct tcphdr);
+	const u8 *ptr = (const u8 *)(th + 1);
+	int opcode, opsize, wscale = -1;
+	u32 mss;
+
+	while (length > 0) {
+		opcode = *ptr++;
+		if (opcode == TCPOPT_EOL)
+			break;
+		if (opcode == TCPOPT_NOP) {
+			length--;
+			continue;
+		}
+
+		if (length < 2)
+			break;
+		opsize = *ptr++;
+		if (opsize < 2 || opsize > length)
+			break;
+
+		if (opcode == TCPOPT_MSS && opsize == TCPOLEN_MSS) {
+			mss = (ptr[0] << 8) | ptr[1];
+			if (mss && mss < ts->mss)
+				ts->mss = mss;
+		} else if (opcode == TCPOPT_WINDOW &&
+			   opsize == TCPOLEN_WINDOW)
+			wscale = min_t(int, ptr[0], TCP_MAX_WSCALE);
+
+		ptr += opsize - 2;
+		length -= opsize;
+	}
+
+	if (wscale >= 0 && ts->sync.wscale_ok) {
+		ts->sync.snd_wscale = wscale;
+		return;
+	}
+
+	/* no scaling on either side, the window has to fit in 16 bits */
+	ts->sync.wscale_ok = 0;
+	ts->sync.rcv_wscale = 0;
+	ts->sync.window = min_t(u32, ts->sync.window, 65535U);
+}
+
+/***
+ *  rt_tcp_rtt_sample - update the retransmission timeout (RFC 6298)
+ *  @ts: rttcp socket, locked
+ *  @rtt: measured round-trip time
+ */
+static void rt_tcp_rtt_sample(struct tcp_socket *ts, nanosecs_rel_t rtt)
+{
+	nanosecs_rel_t delta;
+
+	if (rtt <= 0)
+		rtt = 1;
+
+	if (ts->srtt == 0) {
+		ts->srtt = rtt;
+		ts->rttvar = rtt >> 1;
+	} else {
+		delta = rtt - ts->srtt;
+		if (delta < 0)
+			delta = -delta;
+		/* alpha = 1/8, beta = 1/4 */
+		ts->rttvar += (delta >> 2) - (ts->rttvar >> 2);
+		ts->srtt += (rtt >> 3) - (ts->srtt >> 3);
+	}
+
+	ts->rto = ts->srtt + max_t(nanosecs_rel_t, ts->rttvar << 2,
+				   1 << RT_TCP_TIMER_GRANULARITY);
+	ts->rto = clamp(ts->rto, rt_tcp_rto_min, rt_tcp_rto_max);
+}
+
 static void rt_tcp_keepalive_start(struct tcp_socket *ts)
 {
 	if (ts->tcp_state == TCP_ESTABLISHED) {
@@ -421,9 +659,59 @@ static void rt_tcp_socket_validate(struct tcp_socket *ts)
 		rt_tcp_keepalive_start(ts);
 	}
 
+	/* initial congestion window (RFC 6928) */
+	ts->cwnd = min(10 * ts->mss, max(2 * ts->mss, 14600U));
+
 	rtdm_event_init(&ts->send_evt, 0);
 }
 
+static void rt_tcp_retransmit_timer_start(struct tcp_socket *ts)
+{
+	ts->rto_expires = rtdm_clock_read_monotonic() + ts->rto;
+	timerwheel_add_timer(&ts->timer, ts->rto);
+}
+
+/***
+ *  rt_tcp_retransmit_clone - copy the first unacknowledged segment for
+ *  retransmission (socket locked)
+ *  @ts: rttcp socket
+ */
+static struct rtskb *rt_tcp_retransmit_clone(struct tcp_socket *ts)
+{
+	struct tcphdr *th;
+	struct rtskb *skb;
+
+	/* warning, rtskb_clone is under lock */
+	skb = rtskb_clone(ts->retransmit_queue.first, &ts->sock.skb_pool);
+	if (skb == NULL)
+		return NULL;
+
+	/* refresh what changed since the first transmission */
+	th = skb->h.th;
+	if (th->ack)
+		th->ack_seq = htonl(ts->sync.ack_seq);
+	th->window = htons(rt_tcp_adv_window(ts, th->syn));
+	rt_tcp_checksum(ts, th, skb->tail - skb->h.raw);
+
+	/* Karn's algorithm, no RTT sample across a retransmission */
+	ts->rtt_pending = 0;
+
+	return skb;
+}
+
+static void rt_tcp_retransmit_xmit(struct rtskb *skb)
+{
+	if (skb == NULL) {
+		rtdm_printk("rttcp: cann't clone skb for retransmission\n");
+		return;
+	}
+
+	if (unlikely(rtdev_xmit(skb) != 0)) {
+		kfree_rtskb(skb);
+		rtdm_printk("rttcp: packet retransmission failed\n");
+	}
+}
+
 /***
  *  rt_tcp_retransmit_handler - timerwheel handler to process a retransmission
  *  @data: pointer to a rttcp socket structure
@@ -431,42 +719,30 @@ static void rt_tcp_socket_validate(struct tcp_socket *ts)
 static void rt_tcp_retransmit_handler(void *data)
 {
 	struct tcp_socket *ts = (struct tcp_socket *)data;
-	struct rtskb *skb;
 	rtdm_lockctx_t context;
+	nanosecs_abs_t now;
+	struct rtskb *skb;
+	u32 flight;
 	int signal;
 
 	rtdm_lock_get_irqsave(&ts->socket_lock, context);
 
-	if (unlikely(rtskb_queue_empty(&ts->retransmit_queue))) {
-		/* handled, but retransmission queue is empty */
-		rtdm_lock_get_irqsave(&ts->socket_lock, context);
-		rtdm_printk("rttcp: bug in RT TCP retransmission routine\n");
+	if (ts->tcp_state == TCP_CLOSE ||
+	    rtskb_queue_empty(&ts->retransmit_queue)) {
+		/* socket is already closed, or everything got acked meanwhile */
+		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 		return;
 	}
 
-	if (ts->tcp_state == TCP_CLOSE) {
-		/* socket is already closed */
+	/* the timer was pushed back by an ACK since it was queued */
+	now = rtdm_clock_read_monotonic();
+	if (now < ts->rto_expires) {
+		timerwheel_add_timer(&ts->timer, ts->rto_expires - now);
 		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 		return;
 	}
 
-	if (ts->timer_state) {
-		/* more tries */
-		ts->timer_state--;
-		timerwheel_add_timer(&ts->timer, rt_tcp_retransmission_timeout);
-
-		/* warning, rtskb_clone is under lock */
-		skb = rtskb_clone(ts->retransmit_queue.first,
-				  &ts->sock.skb_pool);
-		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-
-		/* BUG, window changes are not respected */
-		if (unlikely(rtdev_xmit(skb)) != 0) {
-			kfree_rtskb(skb);
-			rtdm_printk(
-				"rttcp: packet retransmission from timer failed\n");
-		}
-	} else {
+	if (ts->timer_state == 0) {
 		ts->timer_state = max_retransmits;
 
 		/* report about connection lost */
@@ -478,77 +754,150 @@ static void rt_tcp_retransmit_handler(void *data)
 
 		/* retransmission queue will be cleaned up in rt_tcp_socket_destruct */
 		rtdm_printk("rttcp: connection is lost by NACK timeout\n");
+		return;
 	}
+
+	/* more tries */
+	ts->timer_state--;
+
+	/* restart from one segment and back off (RFC 5681, RFC 6298) */
+	flight = ts->sync.seq - ts->sync.una;
+	ts->ssthresh = max(flight / 2, 2 * ts->mss);
+	ts->cwnd = ts->mss;
+	ts->dupacks = 0;
+	ts->in_recovery = 0;
+	ts->rto = min(ts->rto * 2, rt_tcp_rto_max);
+	rt_tcp_update_dst_window(ts);
+
+	rt_tcp_retransmit_timer_start(ts);
+	skb = rt_tcp_retransmit_clone(ts);
+
+	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+
+	rt_tcp_retransmit_xmit(skb);
 }
 
 /***
- *  rt_tcp_retransmit_ack - remove skbs from retransmission queue on ACK
+ *  rt_tcp_retransmit_ack - process an ACK against the retransmission queue
  *  @ts: rttcp socket
- *  @ack_seq: received ACK sequence value
+ *  @th: received TCP header
+ *  @data_len: length of the received TCP payload
+ *
+ *  Acknowledged skbs are released and the congestion window is grown;
+ *  the third duplicate ACK triggers a fast retransmission followed by
+ *  NewReno recovery.
  */
-static void rt_tcp_retransmit_ack(struct tcp_socket *ts, u32 ack_seq)
+static void rt_tcp_retransmit_ack(struct tcp_socket *ts, struct tcphdr *th,
+				  u32 data_len)
 {
-	struct rtskb *skb;
+	u32 ack_seq = ntohl(th->ack_seq);
+	struct rtskb *resend = NULL;
+	struct rtskb_queue acked;
 	rtdm_lockctx_t context;
+	struct rtskb *skb;
+	u32 acked_len;
+
+	rtskb_queue_init(&acked);
 
 	rtdm_lock_get_irqsave(&ts->socket_lock, context);
 
-	/*
-      ACK, but retransmission queue is empty
-      This could happen on repeated ACKs
-    */
-	if (rtskb_queue_empty(&ts->retransmit_queue)) {
+	if (ts->tcp_state == TCP_CLOSE) {
+		/* warn about queue safety in race with anyone,
+		   who closes the socket */
 		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 		return;
 	}
 
 	/*
-      Check ts->nacked_first value firstly to ensure that
-      skb for retransmission is present in the queue, otherwise
-      retransmission queue will be drained completely
-    */
-	if (!rt_tcp_before(ts->nacked_first, ack_seq)) {
+	  ACK, but retransmission queue is empty
+	  This could happen on repeated ACKs
+	*/
+	if (rtskb_queue_empty(&ts->retransmit_queue)) {
+		if (rt_tcp_after(ack_seq, ts->sync.una))
+			ts->sync.una = ack_seq;
 		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 		return;
 	}
 
-	if (timerwheel_remove_timer(&ts->timer) != 0) {
-		/* already timed out */
-		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		return;
-	}
+	if (rt_tcp_before(ack_seq, ts->sync.una)) {
+		/* nothing new acknowledged, check for a duplicate ACK */
+		if (ack_seq != ts->sync.una || data_len || th->syn || th->fin ||
+		    rt_tcp_peer_window(ts, th) != ts->sync.wnd) {
+			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+			return;
+		}
 
-dequeue_loop:
-	if (ts->tcp_state == TCP_CLOSE) {
-		/* warn about queue safety in race with anyone,
-	   who closes the socket */
-		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		return;
-	}
+		if (ts->in_recovery) {
+			/* every duplicate ACK means a segment left the network */
+			ts->cwnd = min(ts->cwnd + ts->mss, RT_TCP_MAX_CWND);
+		} else if (++ts->dupacks == 3) {
+			/* fast retransmit */
+			ts->ssthresh = max((ts->sync.seq - ts->sync.una) / 2,
+					   2 * ts->mss);
+			ts->cwnd = ts->ssthresh + 3 * ts->mss;
+			ts->recover = ts->sync.seq;
+			ts->in_recovery = 1;
+			resend = rt_tcp_retransmit_clone(ts);
+			rt_tcp_retransmit_timer_start(ts);
+		}
 
-	if ((skb = __rtskb_dequeue(&ts->retransmit_queue)) == NULL) {
-		ts->timer_state = max_retransmits;
 		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+
+		if (resend)
+			rt_tcp_retransmit_xmit(resend);
 		return;
 	}
 
-	if (rt_tcp_before(ts->nacked_first, ack_seq)) {
-		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		kfree_rtskb(skb);
-		rtdm_lock_get_irqsave(&ts->socket_lock, context);
-		goto dequeue_loop;
+	acked_len = ack_seq - ts->sync.una;
+	ts->sync.una = ack_seq;
+	ts->dupacks = 0;
+	ts->timer_state = max_retransmits;
+
+	if (ts->rtt_pending && rt_tcp_after(ack_seq, ts->rtt_seq)) {
+		rt_tcp_rtt_sample(ts, rtdm_clock_read_monotonic() -
+					      ts->rtt_start);
+		ts->rtt_pending = 0;
 	}
 
-	/* Put NACKed skb back to queue */
-	/* BUG, need to respect half-acknowledged packets */
-	ts->nacked_first = ntohl(skb->h.th->seq) + 1;
+	/* BUG, half-acknowledged packets are kept as a whole */
+	while ((skb = ts->retransmit_queue.first) != NULL &&
+	       rt_tcp_before(rt_tcp_skb_end_seq(skb), ack_seq))
+		__rtskb_queue_tail(&acked, __rtskb_dequeue(&ts->retransmit_queue));
 
-	__rtskb_queue_head(&ts->retransmit_queue, skb);
+	if (ts->in_recovery) {
+		if (rt_tcp_after(ack_seq, ts->recover)) {
+			/* full ACK, deflate the window */
+			ts->in_recovery = 0;
+			ts->cwnd = ts->ssthresh;
+		} else {
+			/* partial ACK, the next segment got lost too */
+			ts->cwnd -= min(ts->cwnd - ts->mss, acked_len);
+			ts->cwnd += ts->mss;
+			if (skb != NULL)
+				resend = rt_tcp_retransmit_clone(ts);
+		}
+	} else if (ts->cwnd < ts->ssthresh)
+		/* slow start */
+		ts->cwnd += min(acked_len, ts->mss);
+	else
+		/* congestion avoidance */
+		ts->cwnd += max(ts->mss * ts->mss / ts->cwnd, 1U);
+
+	ts->cwnd = min(ts->cwnd, RT_TCP_MAX_CWND);
 
-	/* Have more packages in retransmission queue, restart the timer */
-	timerwheel_add_timer(&ts->timer, rt_tcp_retransmission_timeout);
+	if (skb != NULL)
+		/* Have more packages in retransmission queue, restart the timer */
+		rt_tcp_retransmit_timer_start(ts);
+	else
+		timerwheel_remove_timer(&ts->timer);
 
 	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+
+	if (resend)
+		rt_tcp_retransmit_xmit(resend);
+
+	while ((skb = __rtskb_dequeue(&acked)) != NULL)
+		kfree_rtskb(skb);
 }
 
 /***
@@ -558,13 +907,18 @@ dequeue_loop:
  */
 static void rt_tcp_retransmit_send(struct tcp_socket *ts, struct rtskb *skb)
 {
+	if (!ts->rtt_pending) {
+		/* time this segment */
+		ts->rtt_pending = 1;
+		ts->rtt_seq = rt_tcp_skb_end_seq(skb);
+		ts->rtt_start = rtdm_clock_read_monotonic();
+	}
+
 	if (rtskb_queue_empty(&ts->retransmit_queue)) {
 		/* retransmission queue is empty */
-		ts->nacked_first = ntohl(skb->h.th->seq) + 1;
-
 		__rtskb_queue_tail(&ts->retransmit_queue, skb);
 
-		timerwheel_add_timer(&ts->timer, rt_tcp_retransmission_timeout);
+		rt_tcp_retransmit_timer_start(ts);
 	} else {
 		/* retransmission queue is not empty */
 		__rtskb_queue_tail(&ts->retransmit_queue, skb);
@@ -611,10 +965,9 @@ static int rt_ip_build_frame(struct rtskb *skb, struct rtsocket *sk,
 }
 
 static void rt_tcp_build_header(struct tcp_socket *ts, struct rtskb *skb,
-				__be32 flags, u8 is_keepalive)
+				__be32 flags, u8 optlen, u8 is_keepalive)
 {
-	u32 wcheck;
-	u8 tcphdrlen = 20;
+	u8 tcphdrlen = 20 + optlen;
 	u8 iphdrlen = 20;
 	struct tcphdr *th;
 
@@ -629,23 +982,17 @@ static void rt_tcp_build_header(struct tcp_socket *ts, struct rtskb *skb,
 
 	tcp_flag_word(th) = flags;
 	th->ack_seq = htonl(ts->sync.ack_seq);
-	th->window = htons(ts->sync.window);
+	th->window = htons(rt_tcp_adv_window(ts, th->syn));
 
-	th->doff = tcphdrlen >> 2; /* No options for now */
+	th->doff = tcphdrlen >> 2; /* options on SYN segments only */
 	th->res1 = 0;
-	th->check = 0;
 	th->urg_ptr = 0;
 
-	/* compute checksum */
-	wcheck = csum_partial(th, tcphdrlen, 0);
-
-	if (skb->len - tcphdrlen - iphdrlen) {
-		wcheck = csum_partial(skb->data + tcphdrlen + iphdrlen,
-				      skb->len - tcphdrlen - iphdrlen, wcheck);
-	}
+	if (optlen)
+		rt_tcp_build_syn_options(ts, (u8 *)(th + 1));
 
-	th->check =
-		tcp_v4_check(skb->len - iphdrlen, ts->saddr, ts->daddr, wcheck);
+	/* compute checksum */
+	rt_tcp_checksum(ts, th, skb->len - iphdrlen);
 }
 
 static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
@@ -665,9 +1012,17 @@ static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
 	u32 hh_len = (rtdev->hard_header_len + 15) & ~15;
 	u32 prio = (volatile unsigned int)sk->priority;
 	u32 mtu = rtdev->get_mtu(rtdev, prio);
+	u8 optlen = 0;
 
 	u8 *data = NULL;
 
+	if (flags & TCP_FLAG_SYN)
+		optlen = rt_tcp_syn_options_len(ts);
+
+	/* used local phy MTU value */
+	if (data_len > mtu - 40 - optlen)
+		data_len = mtu - 40 - optlen;
+
 	if ((skb = alloc_rtskb(mtu + hh_len + 15, &sk->skb_pool)) == NULL) {
 		rtdm_printk(
 			"rttcp: no more elements in skb_pool for allocation\n");
@@ -680,7 +1035,8 @@ static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
 	iph = (struct iphdr *)rtskb_put(skb, 20); /* length of IP header */
 	skb->nh.iph = iph;
 
-	th = (struct tcphdr *)rtskb_put(skb, 20); /* length of TCP header */
+	/* length of TCP header */
+	th = (struct tcphdr *)rtskb_put(skb, 20 + optlen);
 	skb->h.th = th;
 
 	if (data_len) { /* check for available place */
@@ -692,10 +1048,6 @@ static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
 		}
 	}
 
-	/* used local phy MTU value */
-	if (data_len > mtu)
-		data_len = mtu;
-
 	skb->rtdev = rtdev;
 	skb->priority = prio;
 
@@ -703,7 +1055,7 @@ static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
        this should be done at upper level */
 
 	rtdm_lock_get_irqsave(&ts->socket_lock, context);
-	rt_tcp_build_header(ts, skb, flags, is_keepalive);
+	rt_tcp_build_header(ts, skb, flags, optlen, is_keepalive);
 
 	if ((ret = rt_ip_build_frame(skb, sk, rt, iph)) != 0) {
 		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
@@ -732,7 +1084,7 @@ static int rt_tcp_segment(struct dest_route *rt, struct tcp_socket *ts,
 		ts->sync.seq++;
 
 	ts->sync.seq += data_len;
-	ts->sync.dst_window -= data_len;
+	rt_tcp_update_dst_window(ts);
 
 	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 
@@ -867,29 +1219,42 @@ static struct rtsocket *rt_tcp_dest_socket(struct rtskb *skb)
 	return skb->sk;
 }
 
-static void rt_tcp_window_update(struct tcp_socket *ts, u16 window)
+static void rt_tcp_window_update(struct tcp_socket *ts, struct tcphdr *th)
 {
 	rtdm_lockctx_t context;
+	int signal;
 
 	rtdm_lock_get_irqsave(&ts->socket_lock, context);
 
-	if (ts->sync.dst_window) {
-		ts->sync.dst_window = window;
-		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		if (!window) {
-			/* clear send event status */
-			rtdm_event_clear(&ts->send_evt);
-		}
-	} else {
-		if (window) {
-			ts->sync.dst_window = window;
-			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-			/* set send event status */
-			rtdm_event_signal(&ts->send_evt);
-		} else {
-			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		}
-	}
+	ts->sync.wnd = rt_tcp_peer_window(ts, th);
+	rt_tcp_update_dst_window(ts);
+	signal = ts->is_valid && ts->sync.dst_window;
+
+	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+
+	/* set send event status */
+	if (signal)
+		rtdm_event_signal(&ts->send_evt);
+}
+
+/***
+ *  rt_tcp_window_open - return consumed bytes to the receive window
+ *  @ts: rttcp socket
+ *  @len: number of bytes passed to the reader
+ */
+static void rt_tcp_window_open(struct tcp_socket *ts, u32 len)
+{
+	rtdm_lockctx_t context;
+	int closed;
+
+	rtdm_lock_get_irqsave(&ts->socket_lock, context);
+	closed = rt_tcp_adv_window(ts, 0) == 0;
+	ts->sync.window += len;
+	closed = closed && rt_tcp_adv_window(ts, 0);
+	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+
+	if (closed)
+		rt_tcp_send(ts, TCP_FLAG_ACK); /* window update */
 }
 
 /***
@@ -936,6 +1301,7 @@ static void rt_tcp_rcv(struct rtskb *skb)
 		ts->sync.ack_seq = rt_tcp_compute_ack_seq(th, data_len);
 
 		if (th->syn && th->ack) {
+			rt_tcp_parse_syn_options(ts, th);
 			rt_tcp_socket_validate(ts);
 			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 			rtdm_event_signal(&ts->conn_evt);
@@ -958,7 +1324,7 @@ static void rt_tcp_rcv(struct rtskb *skb)
 
 	/* OR-list of conditions to be satisfied:
      *
-     * th->ack && rt_tcp_after(ts->nacked_first, ntohl(th->ack_seq))
+     * th->ack && rt_tcp_after(ts->sync.una, ntohl(th->ack_seq))
      * th->ack && th->rst && ...
      * th->syn && (ts->tcp_state == TCP_LISTEN ||
 		   ts->tcp_state == TCP_SYN_SENT)
@@ -1030,6 +1396,14 @@ static void rt_tcp_rcv(struct rtskb *skb)
 		}
 	}
 
+	/* out of order data, a duplicate ACK asks for the missing segment */
+	if (data_len && seq != ts->sync.ack_seq &&
+	    ts->tcp_state == TCP_ESTABLISHED) {
+		rtdm_lock_put_irqrestore(&ts->socket_lock, context);
+		rt_tcp_send(ts, TCP_FLAG_ACK);
+		goto feed;
+	}
+
 	ts->sync.ack_seq = rt_tcp_compute_ack_seq(th, data_len);
 
 	if (th->fin) {
@@ -1084,7 +1458,9 @@ static void rt_tcp_rcv(struct rtskb *skb)
 			ts->daddr = skb->nh.iph->saddr;
 			ts->dport = th->source;
 			ts->sync.seq = rt_tcp_initial_seq();
-			ts->sync.window = 4096;
+			ts->sync.una = ts->sync.seq;
+			rt_tcp_init_window(ts, skb->rtdev);
+			rt_tcp_parse_syn_options(ts, th);
 			ts->tcp_state = TCP_SYN_RECV;
 			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 
@@ -1104,7 +1480,7 @@ static void rt_tcp_rcv(struct rtskb *skb)
 		/* Check ack sequence */
 		if (rt_tcp_before(ts->sync.seq + 1, ntohl(th->ack_seq))) {
 			rtdm_printk("rttcp: unexpected ACK %u %u %u\n",
-				    ts->sync.seq, ts->nacked_first,
+				    ts->sync.seq, ts->sync.una,
 				    ntohl(th->ack_seq));
 			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 			goto drop;
@@ -1146,7 +1522,7 @@ static void rt_tcp_rcv(struct rtskb *skb)
 	}
 
 	/* Send ACK */
-	ts->sync.window -= data_len;
+	ts->sync.window -= min(ts->sync.window, data_len);
 	rtdm_lock_put_irqrestore(&ts->socket_lock, context);
 	rt_tcp_send(ts, TCP_FLAG_ACK);
 
@@ -1155,22 +1531,22 @@ static void rt_tcp_rcv(struct rtskb *skb)
 
 	/* inform retransmission subsystem about arrived ack */
 	if (th->ack) {
-		rt_tcp_retransmit_ack(ts, ntohl(th->ack_seq));
+		rt_tcp_retransmit_ack(ts, th, data_len);
 	}
 
 	rt_tcp_keepalive_feed(ts);
-	rt_tcp_window_update(ts, ntohs(th->window));
+	rt_tcp_window_update(ts, th);
 
 	return;
 
 feed:
 	/* inform retransmission subsystem about arrived ack */
 	if (th->ack) {
-		rt_tcp_retransmit_ack(ts, ntohl(th->ack_seq));
+		rt_tcp_retransmit_ack(ts, th, data_len);
 	}
 
 	rt_tcp_keepalive_feed(ts);
-	rt_tcp_window_update(ts, ntohs(th->window));
+	rt_tcp_window_update(ts, th);
 
 drop:
 	kfree_rtskb(skb);
@@ -1190,8 +1566,14 @@ static int rt_tcp_window_send(struct tcp_socket *ts, u32 data_len, u8 *data_ptr)
 	u32 dst_window = ts->sync.dst_window;
 	int ret;
 
+	/* wait for the next ACK */
+	if (dst_window == 0)
+		return 0;
+
 	if (data_len > dst_window)
 		data_len = dst_window;
+	if (data_len > ts->mss)
+		data_len = ts->mss;
 
 	if ((ret = rt_tcp_segment(&ts->rt, ts, TCP_FLAG_ACK, data_len, data_ptr,
 				  0)) < 0) {
@@ -1559,8 +1941,8 @@ static int rt_tcp_connect(struct rtdm_fd *fd, struct tcp_socket *ts,
 
 	ts->sync.seq = rt_tcp_initial_seq();
 	ts->sync.ack_seq = 0;
-	ts->sync.window = 4096;
-	ts->sync.dst_window = 0;
+	ts->sync.una = ts->sync.seq;
+	rt_tcp_init_window(ts, rt.rtdev);
 
 	ts->tcp_state = TCP_SYN_SENT;
 
@@ -2001,18 +2383,7 @@ static ssize_t rt_tcp_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 				kfree_rtskb(first_skb); /* or store the data? */
 				return -EFAULT;
 			}
-			rtdm_lock_get_irqsave(&ts->socket_lock, context);
-			if (ts->sync.window) {
-				ts->sync.window += block_size;
-				rtdm_lock_put_irqrestore(&ts->socket_lock,
-							 context);
-			} else {
-				ts->sync.window = block_size;
-				rtdm_lock_put_irqrestore(&ts->socket_lock,
-							 context);
-				rt_tcp_send(ts,
-					    TCP_FLAG_ACK); /* window update */
-			}
+			rt_tcp_window_open(ts, block_size);
 
 			__rtskb_pull(skb, block_size);
 			__rtskb_push(first_skb, sizeof(struct tcphdr));
@@ -2027,15 +2398,7 @@ static ssize_t rt_tcp_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 			kfree_rtskb(first_skb); /* or store the data? */
 			return -EFAULT;
 		}
-		rtdm_lock_get_irqsave(&ts->socket_lock, context);
-		if (ts->sync.window) {
-			ts->sync.window += block_size;
-			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-		} else {
-			ts->sync.window = block_size;
-			rtdm_lock_put_irqrestore(&ts->socket_lock, context);
-			rt_tcp_send(ts, TCP_FLAG_ACK); /* window update */
-		}
+		rt_tcp_window_open(ts, block_size);
 
 		if ((skb = skb->next) != NULL) {
 			user_buf += data_len;
@@ -2389,9 +2752,9 @@ int __init rt_tcp_init(void)
 	rtdm_lock_init(&rst_socket.socket_lock);
 
 	/*
-     * 100 ms forwarding timer with 8.38 ms slots
+     * forwarding timer covering the largest RTO with 8.38 ms slots
      */
-	ret = timerwheel_init(100000000ull, 23);
+	ret = timerwheel_init(rt_tcp_rto_max, RT_TCP_TIMER_GRANULARITY);
 	if (ret < 0) {
 		rtdm_printk("rttcp: cann't initialize timerwheel task: %d\n",
 			    -ret);
@@ -79,7 +79,13 @@ int timerwheel_add_timer(struct timerwheel_timer *timer, nanosecs_rel_t expires)
 	rtdm_lockctx_t context;
 	int slot;
 
-	slot = expires >> wheel.interval_base;
+	/*
+	 * Round up, the current slot is only visited again after a full
+	 * rotation. The timer fires within one interval before expiry.
+	 */
+	slot = (expires + wheel.interval - 1) >> wheel.interval_base;
+	if (slot == 0)
+		slot = 1;
 
 	if (slot >= wheel.slots)
 		return -EINVAL;
@@ -188,8 +194,8 @@ int __init timerwheel_init(nanosecs_rel_t timeout, unsigned int granularity)
 
 	wheel.timeout = timeout;
 	wheel.interval_base = granularity;
-	wheel.slots = (timeout >> granularity) + 1;
 	wheel.interval = (1 << granularity);
+	wheel.slots = ((timeout + wheel.interval - 1) >> granularity) + 1;
 	wheel.current_slot = 0;
 
 	wheel.ring =
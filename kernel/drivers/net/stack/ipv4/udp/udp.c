@@ -37,6 +37,7 @@
 #include <rtnet_port.h>
 #include <rtnet_iovec.h>
 #include <rtnet_socket.h>
+#include <rtnet_ring.h>
 #include <ipv4/ip_fragment.h>
 #include <ipv4/ip_output.h>
 #include <ipv4/ip_sock.h>
@@ -284,6 +285,7 @@ int rt_udp_socket(struct rtdm_fd *fd)
 	sock->prot.inet.saddr = INADDR_ANY;
 	sock->prot.inet.state = TCP_CLOSE;
 	sock->prot.inet.tos = 0;
+	rt_ip_route_cache_init(&sock->prot.inet.route);
 
 	rtdm_lock_get_irqsave(&udp_socket_base_lock, context);
 
@@ -352,12 +354,17 @@ void rt_udp_close(struct rtdm_fd *fd)
 	rt_socket_cleanup(fd);
 }
 
+static int rt_udp_ring_send(struct rtdm_fd *fd, struct rtsocket *sock);
+
 int rt_udp_ioctl(struct rtdm_fd *fd, unsigned int request, void __user *arg)
 {
 	struct rtsocket *sock = rtdm_fd_to_private(fd);
 	const struct _rtdm_setsockaddr_args *setaddr;
 	struct _rtdm_setsockaddr_args _setaddr;
 
+	if (request == RTNET_RTIOC_RING_SEND)
+		return rt_udp_ring_send(fd, sock);
+
 	/* fast path for common socket IOCTLs */
 	if (_IOC_TYPE(request) == RTIOC_TYPE_NETWORK)
 		return rt_socket_common_ioctl(fd, request, arg);
@@ -521,9 +528,26 @@ struct udpfakehdr {
 	struct rtdm_fd *fd;
 	struct iovec *iov;
 	int iovlen;
+	const void *buf; /* kernel source, replaces iov if set */
 	u32 wcheck;
 };
 
+static int rt_udp_read_frag(struct udpfakehdr *ufh, unsigned char *to,
+			    unsigned int len)
+{
+	int ret;
+
+	if (ufh->buf) {
+		memcpy(to, ufh->buf, len);
+		ufh->buf += len;
+		return 0;
+	}
+
+	ret = rtnet_read_from_iov(ufh->fd, ufh->iov, ufh->iovlen, to, len);
+
+	return ret < 0 ? ret : 0;
+}
+
 /***
  *
  */
@@ -534,16 +558,12 @@ static int rt_udp_getfrag(const void *p, unsigned char *to, unsigned int offset,
 	int ret;
 
 	// We should optimize this function a bit (copy+csum...)!
-	if (offset) {
-		ret = rtnet_read_from_iov(ufh->fd, ufh->iov, ufh->iovlen, to,
-					  fraglen);
-		return ret < 0 ? ret : 0;
-	}
+	if (offset)
+		return rt_udp_read_frag(ufh, to, fraglen);
 
-	ret = rtnet_read_from_iov(ufh->fd, ufh->iov, ufh->iovlen,
-				  to + sizeof(struct udphdr),
-				  fraglen - sizeof(struct udphdr));
-	if (ret < 0)
+	ret = rt_udp_read_frag(ufh, to + sizeof(struct udphdr),
+			       fraglen - sizeof(struct udphdr));
+	if (ret)
 		return ret;
 
 	/* Checksum of the complete data part of the UDP message: */
@@ -568,61 +588,30 @@ static int rt_udp_getfrag(const void *p, unsigned char *to, unsigned int offset,
 }
 
 /***
- *  rt_udp_sendmsg
+ *  rt_udp_xmit - send @len bytes described by @ufh to @sin, or to the
+ *  connected peer if NULL
  */
-ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
+static int rt_udp_xmit(struct rtsocket *sock, struct udpfakehdr *ufh,
+		       const struct sockaddr_in *sin, size_t len,
 		       int msg_flags)
 {
-	struct rtsocket *sock = rtdm_fd_to_private(fd);
-	size_t len;
-	int ulen;
-	struct sockaddr_in _sin, *sin;
-	struct udpfakehdr ufh;
 	struct dest_route rt;
+	rtdm_lockctx_t context;
 	u32 saddr;
 	u32 daddr;
 	u16 dport;
+	int ulen;
 	int err;
-	rtdm_lockctx_t context;
-	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
-	if (msg_flags & MSG_OOB) /* Mirror BSD error message compatibility */
-		return -EOPNOTSUPP;
-
-	if (msg_flags & ~(MSG_DONTROUTE | MSG_DONTWAIT))
-		return -EINVAL;
-
-	if (msg->msg_iovlen < 0)
-		return -EINVAL;
-
-	if (msg->msg_iovlen == 0)
-		return 0;
-
-	err = rtdm_get_iovec(fd, &iov, msg, iov_fast);
-	if (err)
-		return err;
-
-	len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
-	if ((len < 0) ||
-	    (len > 0xFFFF - sizeof(struct iphdr) - sizeof(struct udphdr))) {
-		err = -EMSGSIZE;
-		goto out;
-	}
+	if (len > 0xFFFF - sizeof(struct iphdr) - sizeof(struct udphdr))
+		return -EMSGSIZE;
 
 	ulen = len + sizeof(struct udphdr);
 
-	if (msg->msg_name && msg->msg_namelen == sizeof(*sin)) {
-		sin = rtnet_get_arg(fd, &_sin, msg->msg_name, sizeof(_sin));
-		if (IS_ERR(sin)) {
-			err = PTR_ERR(sin);
-			goto out;
-		}
-
+	if (sin) {
 		if (sin->sin_family != AF_INET &&
-		    sin->sin_family != AF_UNSPEC) {
-			err = -EINVAL;
-			goto out;
-		}
+		    sin->sin_family != AF_UNSPEC)
+			return -EINVAL;
 
 		daddr = sin->sin_addr.s_addr;
 		dport = sin->sin_port;
@@ -633,8 +622,7 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
 		if (sock->prot.inet.state != TCP_ESTABLISHED) {
 			rtdm_lock_put_irqrestore(&udp_socket_base_lock,
 						 context);
-			err = -ENOTCONN;
-			goto out;
+			return -ENOTCONN;
 		}
 
 		daddr = sock->prot.inet.daddr;
@@ -642,42 +630,131 @@ ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
 	}
 
 	saddr = sock->prot.inet.saddr;
-	ufh.uh.source = sock->prot.inet.sport;
+	ufh->uh.source = sock->prot.inet.sport;
 
 	rtdm_lock_put_irqrestore(&udp_socket_base_lock, context);
 
-	if ((daddr | dport) == 0) {
-		err = -EINVAL;
-		goto out;
-	}
+	if ((daddr | dport) == 0)
+		return -EINVAL;
 
-	/* get output route */
-	err = rt_ip_route_output(&rt, daddr, saddr);
+	/* get output route, usually the one of the previous packet */
+	err = rt_ip_route_output_cached(&sock->prot.inet.route, &rt, daddr,
+					saddr);
 	if (err)
-		goto out;
+		return err;
 
 	/* we found a route, remember the routing dest-addr could be the netmask */
-	ufh.saddr = saddr != INADDR_ANY ? saddr : rt.rtdev->local_ip;
-	ufh.daddr = daddr;
-	ufh.uh.dest = dport;
-	ufh.uh.len = htons(ulen);
-	ufh.uh.check = 0;
+	ufh->saddr = saddr != INADDR_ANY ? saddr : rt.rtdev->local_ip;
+	ufh->daddr = daddr;
+	ufh->uh.dest = dport;
+	ufh->uh.len = htons(ulen);
+	ufh->uh.check = 0;
+	ufh->wcheck = 0;
+
+	err = rt_ip_build_xmit(sock, rt_udp_getfrag, ufh, ulen, &rt,
+			       msg_flags);
+
+	/* Drop the reference obtained in rt_ip_route_output_cached() */
+	rtdev_dereference(rt.rtdev);
+
+	return err;
+}
+
+/***
+ *  rt_udp_sendmsg
+ */
+ssize_t rt_udp_sendmsg(struct rtdm_fd *fd, const struct user_msghdr *msg,
+		       int msg_flags)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	size_t len;
+	struct sockaddr_in _sin, *sin = NULL;
+	struct udpfakehdr ufh;
+	int err;
+	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
+
+	if (msg_flags & MSG_OOB) /* Mirror BSD error message compatibility */
+		return -EOPNOTSUPP;
+
+	if (msg_flags & ~(MSG_DONTROUTE | MSG_DONTWAIT))
+		return -EINVAL;
+
+	if (msg->msg_iovlen < 0)
+		return -EINVAL;
+
+	if (msg->msg_iovlen == 0)
+		return 0;
+
+	err = rtdm_get_iovec(fd, &iov, msg, iov_fast);
+	if (err)
+		return err;
+
+	len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
+
+	if (msg->msg_name && msg->msg_namelen == sizeof(*sin)) {
+		sin = rtnet_get_arg(fd, &_sin, msg->msg_name, sizeof(_sin));
+		if (IS_ERR(sin)) {
+			err = PTR_ERR(sin);
+			goto out;
+		}
+	}
+
 	ufh.fd = fd;
 	ufh.iov = iov;
 	ufh.iovlen = msg->msg_iovlen;
-	ufh.wcheck = 0;
-
-	err = rt_ip_build_xmit(sock, rt_udp_getfrag, &ufh, ulen, &rt,
-			       msg_flags);
+	ufh.buf = NULL;
 
-	/* Drop the reference obtained in rt_ip_route_output() */
-	rtdev_dereference(rt.rtdev);
+	err = rt_udp_xmit(sock, &ufh, sin, len, msg_flags);
 out:
 	rtdm_drop_iovec(iov, iov_fast);
 
 	return err ?: len;
 }
 
+/***
+ *  rt_udp_ring_send - send the pending slots of the TX ring
+ */
+static int rt_udp_ring_send(struct rtdm_fd *fd, struct rtsocket *sock)
+{
+	struct rtsocket_ring *ring = sock->ring;
+	struct rtnet_ring_slot *slot;
+	struct sockaddr_in _sin, *sin;
+	struct udpfakehdr ufh;
+	int sent = 0, err;
+	size_t len;
+
+	if (ring == NULL || ring->tx_frames == 0)
+		return -EINVAL;
+
+	ufh.fd = fd;
+	ufh.iov = NULL;
+	ufh.iovlen = 0;
+
+	while ((slot = rt_socket_ring_tx_claim(ring)) != NULL) {
+		/* The slot is shared with user space, snapshot it. */
+		len = READ_ONCE(slot->len);
+		sin = NULL;
+		if (READ_ONCE(slot->addrlen) == sizeof(_sin)) {
+			memcpy(&_sin, slot->addr, sizeof(_sin));
+			sin = &_sin;
+		}
+
+		if (len > rt_socket_ring_room(ring))
+			err = -EMSGSIZE;
+		else {
+			ufh.buf = rt_socket_ring_data(slot);
+			err = rt_udp_xmit(sock, &ufh, sin, len, 0);
+		}
+
+		rt_socket_ring_tx_done(slot, err);
+		if (err)
+			return sent ?: err;
+		sent++;
+	}
+
+	return sent;
+}
+
 /***
  *  rt_udp_check
  */
@@ -724,6 +801,25 @@ struct rtsocket *rt_udp_dest_socket(struct rtskb *skb)
 	return skb->sk;
 }
 
+/***
+ *  rt_udp_ring_rcv - store a datagram into the socket RX ring
+ */
+static void rt_udp_ring_rcv(struct rtsocket *sock, struct rtskb *skb)
+{
+	struct udphdr *uh = skb->h.uh;
+	struct sockaddr_in sin;
+
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = uh->source;
+	sin.sin_addr.s_addr = skb->nh.iph->saddr;
+
+	rt_socket_ring_rx(sock->ring, skb, (void *)uh + sizeof(struct udphdr),
+			  ntohs(uh->len) - sizeof(struct udphdr), &sin,
+			  sizeof(sin));
+	kfree_rtskb(skb);
+}
+
 /***
  *  rt_udp_rcv
  */
@@ -734,9 +830,15 @@ void rt_udp_rcv(struct rtskb *skb)
 	void *callback_arg;
 	rtdm_lockctx_t context;
 
+	if (sock->ring) {
+		rt_udp_ring_rcv(sock, skb);
+		goto notify;
+	}
+
 	rtskb_queue_tail(&sock->incoming, skb);
-	rtdm_sem_up(&sock->pending_sem);
+	rt_stack_rx_signal(sock, skb);
 
+notify:
 	rtdm_lock_get_irqsave(&sock->param_lock, context);
 	callback_func = sock->callback_func;
 	callback_arg = sock->callback_arg;
@@ -785,6 +887,7 @@ static struct rtdm_driver udp_driver = {
         .recvmsg_rt =   rt_udp_recvmsg,
         .sendmsg_rt =   rt_udp_sendmsg,
         .select =       rt_socket_select_bind,
+        .mmap =         rt_socket_mmap,
     },
 };
 
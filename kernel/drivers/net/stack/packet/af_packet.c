@@ -28,10 +28,62 @@
 
 #include <rtnet_iovec.h>
 #include <rtnet_socket.h>
+#include <rtnet_ring.h>
 #include <stack_mgr.h>
 
 MODULE_LICENSE("GPL");
 
+static void rt_packet_fill_sll(struct sockaddr_ll *sll, struct rtskb *rtskb)
+{
+	struct rtnet_device *rtdev = rtskb->rtdev;
+
+	memset(sll, 0, sizeof(*sll));
+	sll->sll_family = AF_PACKET;
+	sll->sll_hatype = rtdev->type;
+	sll->sll_protocol = rtskb->protocol;
+	sll->sll_pkttype = rtskb->pkt_type;
+	sll->sll_ifindex = rtdev->ifindex;
+
+	/* Ethernet specific - we rather need some parse handler here */
+	memcpy(sll->sll_addr, rtskb->mac.ethernet->h_source, ETH_ALEN);
+	sll->sll_halen = ETH_ALEN;
+}
+
+static inline bool rt_packet_is_raw(struct rtsocket *sock)
+{
+	return rtdm_fd_to_context(rt_socket_fd(sock))->device->driver->socket_type !=
+		SOCK_DGRAM;
+}
+
+/***
+ *  rt_packet_ring_rcv - copy a frame to the RX ring of the socket,
+ *  which does not need to own the rtskb for this.
+ */
+static int rt_packet_ring_rcv(struct rtsocket *sock, struct rtskb *skb,
+			      struct rtpacket_type *pt)
+{
+	unsigned char *start = skb->data;
+	struct sockaddr_ll sll;
+
+	/* Include the header in raw delivery */
+	if (rt_packet_is_raw(sock))
+		start = skb->mac.raw;
+
+	rt_packet_fill_sll(&sll, skb);
+	rt_socket_ring_rx(sock->ring, skb, start, skb->tail - start, &sll,
+			  sizeof(sll));
+
+#ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
+	/* Listeners of all protocols only get a copy. */
+	if (pt->type == htons(ETH_P_ALL))
+		return 0;
+#endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
+
+	kfree_rtskb(skb);
+
+	return 0;
+}
+
 /***
  *  rt_packet_rcv
  */
@@ -47,6 +99,9 @@ static int rt_packet_rcv(struct rtskb *skb, struct rtpacket_type *pt)
 	if (unlikely((ifindex != 0) && (ifindex != skb->rtdev->ifindex)))
 		return -EUNATCH;
 
+	if (sock->ring)
+		return rt_packet_ring_rcv(sock, skb, pt);
+
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
 	if (pt->type == htons(ETH_P_ALL)) {
 		struct rtskb *clone_skb = rtskb_clone(skb, &sock->skb_pool);
@@ -61,7 +116,7 @@ static int rt_packet_rcv(struct rtskb *skb, struct rtpacket_type *pt)
 	}
 
 	rtskb_queue_tail(&sock->incoming, skb);
-	rtdm_sem_up(&sock->pending_sem);
+	rt_stack_rx_signal(sock, skb);
 
 	rtdm_lock_get_irqsave(&sock->param_lock, context);
 	callback_func = sock->callback_func;
@@ -255,6 +310,135 @@ static void rt_packet_close(struct rtdm_fd *fd)
 	rt_socket_cleanup(fd);
 }
 
+/*
+ * Allocate an rtskb for sending @len bytes through @rtdev to @sll, or
+ * to the bound peer if NULL. Link layer header is set up, payload is
+ * left to the caller.
+ */
+static struct rtskb *rt_packet_alloc_skb(struct rtsocket *sock,
+					 struct rtnet_device *rtdev,
+					 unsigned short proto,
+					 struct sockaddr_ll *sll, size_t len,
+					 int *err)
+{
+	bool raw = rt_packet_is_raw(sock);
+	struct rtskb *rtskb;
+	int hdr_len;
+
+	rtskb = alloc_rtskb(rtdev->hard_header_len + len, &sock->skb_pool);
+	if (rtskb == NULL) {
+		*err = -ENOBUFS;
+		return NULL;
+	}
+
+	/* If an RTmac discipline is active, this becomes a pure sanity check to
+       avoid writing beyond rtskb boundaries. The hard check is then performed
+       upon rtdev_xmit() by the discipline's xmit handler. */
+	if (len > rtdev->mtu + (raw ? rtdev->hard_header_len : 0)) {
+		*err = -EMSGSIZE;
+		goto fail;
+	}
+
+	if ((sll != NULL) && (sll->sll_halen != rtdev->addr_len)) {
+		*err = -EINVAL;
+		goto fail;
+	}
+
+	rtskb_reserve(rtskb, rtdev->hard_header_len);
+
+	rtskb->rtdev = rtdev;
+	rtskb->priority = sock->priority;
+
+	if (rtdev->hard_header) {
+		hdr_len = rtdev->hard_header(rtskb, rtdev, ntohs(proto),
+					     sll ? sll->sll_addr : NULL, NULL,
+					     len);
+		if (raw) {
+			rtskb->tail = rtskb->data;
+			rtskb->len = 0;
+		} else if (hdr_len < 0) {
+			*err = -EINVAL;
+			goto fail;
+		}
+	}
+
+	return rtskb;
+
+fail:
+	kfree_rtskb(rtskb);
+	return NULL;
+}
+
+/***
+ *  rt_packet_ring_send - send the pending slots of the TX ring
+ */
+static int rt_packet_ring_send(struct rtdm_fd *fd, struct rtsocket *sock)
+{
+	struct rtsocket_ring *ring = sock->ring;
+	struct rtnet_ring_slot *slot;
+	struct sockaddr_ll _sll, *sll;
+	struct rtnet_device *rtdev;
+	struct rtskb *rtskb;
+	unsigned short proto;
+	int ifindex, sent = 0, err;
+	size_t len;
+
+	if (ring == NULL || ring->tx_frames == 0)
+		return -EINVAL;
+
+	while ((slot = rt_socket_ring_tx_claim(ring)) != NULL) {
+		/* The slot is shared with user space, snapshot it. */
+		len = READ_ONCE(slot->len);
+		if (READ_ONCE(slot->addrlen) == 0) {
+			ifindex = sock->prot.packet.ifindex;
+			proto = sock->prot.packet.packet_type.type;
+			sll = NULL;
+		} else {
+			memcpy(&_sll, slot->addr, sizeof(_sll));
+			sll = &_sll;
+			if (slot->addrlen < sizeof(struct sockaddr_ll) ||
+			    ((sll->sll_family != AF_PACKET) &&
+			     (sll->sll_family != AF_UNSPEC))) {
+				err = -EINVAL;
+				goto next;
+			}
+			ifindex = sll->sll_ifindex;
+			proto = sll->sll_protocol;
+		}
+
+		if (len > rt_socket_ring_room(ring)) {
+			err = -EMSGSIZE;
+			goto next;
+		}
+
+		if ((rtdev = rtdev_get_by_index(ifindex)) == NULL) {
+			err = -ENODEV;
+			goto next;
+		}
+
+		rtskb = rt_packet_alloc_skb(sock, rtdev, proto, sll, len, &err);
+		if (rtskb) {
+			memcpy(rtskb_put(rtskb, len), rt_socket_ring_data(slot),
+			       len);
+			if ((rtdev->flags & IFF_UP) != 0)
+				err = rtdev_xmit(rtskb);
+			else {
+				kfree_rtskb(rtskb);
+				err = -ENETDOWN;
+			}
+		}
+
+		rtdev_dereference(rtdev);
+	next:
+		rt_socket_ring_tx_done(slot, err);
+		if (err)
+			return sent ?: err;
+		sent++;
+	}
+
+	return sent;
+}
+
 /***
  *  rt_packet_ioctl
  */
@@ -267,6 +451,9 @@ static int rt_packet_ioctl(struct rtdm_fd *fd, unsigned int request,
 	const struct _rtdm_getsockaddr_args *getaddr;
 	struct _rtdm_getsockaddr_args _getaddr;
 
+	if (request == RTNET_RTIOC_RING_SEND)
+		return rt_packet_ring_send(fd, sock);
+
 	/* fast path for common socket IOCTLs */
 	if (_IOC_TYPE(request) == RTIOC_TYPE_NETWORK)
 		return rt_socket_common_ioctl(fd, request, arg);
@@ -339,17 +526,7 @@ static ssize_t rt_packet_recvmsg(struct rtdm_fd *fd, struct user_msghdr *msg,
 
 	/* copy the address if required. */
 	if (msg->msg_name) {
-		struct rtnet_device *rtdev = rtskb->rtdev;
-		memset(&sll, 0, sizeof(sll));
-		sll.sll_family = AF_PACKET;
-		sll.sll_hatype = rtdev->type;
-		sll.sll_protocol = rtskb->protocol;
-		sll.sll_pkttype = rtskb->pkt_type;
-		sll.sll_ifindex = rtdev->ifindex;
-
-		/* Ethernet specific - we rather need some parse handler here */
-		memcpy(sll.sll_addr, rtskb->mac.ethernet->h_source, ETH_ALEN);
-		sll.sll_halen = ETH_ALEN;
+		rt_packet_fill_sll(&sll, rtskb);
 		ret = rtnet_put_arg(fd, msg->msg_name, &sll, sizeof(sll));
 		if (ret)
 			goto fail;
@@ -412,8 +589,7 @@ static ssize_t rt_packet_sendmsg(struct rtdm_fd *fd,
 	struct rtnet_device *rtdev;
 	struct rtskb *rtskb;
 	unsigned short proto;
-	unsigned char *addr;
-	int ifindex;
+	int ifindex, err;
 	ssize_t ret;
 	struct iovec iov_fast[RTDM_IOV_FASTMAX], *iov;
 
@@ -437,7 +613,6 @@ static ssize_t rt_packet_sendmsg(struct rtdm_fd *fd,
 	   the user has to do so. */
 		ifindex = sock->prot.packet.ifindex;
 		proto = sock->prot.packet.packet_type.type;
-		addr = NULL;
 		sll = NULL;
 	} else {
 		sll = rtnet_get_arg(fd, &_sll, msg->msg_name, sizeof(_sll));
@@ -458,7 +633,6 @@ static ssize_t rt_packet_sendmsg(struct rtdm_fd *fd,
 
 		ifindex = sll->sll_ifindex;
 		proto = sll->sll_protocol;
-		addr = sll->sll_addr;
 	}
 
 	if ((rtdev = rtdev_get_by_index(ifindex)) == NULL) {
@@ -467,49 +641,12 @@ static ssize_t rt_packet_sendmsg(struct rtdm_fd *fd,
 	}
 
 	len = rtdm_get_iov_flatlen(iov, msg->msg_iovlen);
-	rtskb = alloc_rtskb(rtdev->hard_header_len + len, &sock->skb_pool);
+	rtskb = rt_packet_alloc_skb(sock, rtdev, proto, sll, len, &err);
 	if (rtskb == NULL) {
-		ret = -ENOBUFS;
+		ret = err;
 		goto out;
 	}
 
-	/* If an RTmac discipline is active, this becomes a pure sanity check to
-       avoid writing beyond rtskb boundaries. The hard check is then performed
-       upon rtdev_xmit() by the discipline's xmit handler. */
-	if (len >
-	    rtdev->mtu +
-		    ((rtdm_fd_to_context(fd)->device->driver->socket_type ==
-		      SOCK_RAW) ?
-			     rtdev->hard_header_len :
-			     0)) {
-		ret = -EMSGSIZE;
-		goto err;
-	}
-
-	if ((sll != NULL) && (sll->sll_halen != rtdev->addr_len)) {
-		ret = -EINVAL;
-		goto err;
-	}
-
-	rtskb_reserve(rtskb, rtdev->hard_header_len);
-
-	rtskb->rtdev = rtdev;
-	rtskb->priority = sock->priority;
-
-	if (rtdev->hard_header) {
-		int hdr_len;
-
-		ret = -EINVAL;
-		hdr_len = rtdev->hard_header(rtskb, rtdev, ntohs(proto), addr,
-					     NULL, len);
-		if (rtdm_fd_to_context(fd)->device->driver->socket_type !=
-		    SOCK_DGRAM) {
-			rtskb->tail = rtskb->data;
-			rtskb->len = 0;
-		} else if (hdr_len < 0)
-			goto err;
-	}
-
 	ret = rtnet_read_from_iov(fd, iov, msg->msg_iovlen,
 				  rtskb_put(rtskb, len), len);
 
@@ -553,6 +690,7 @@ static struct rtdm_driver packet_proto_drv = {
 	.recvmsg_rt =   rt_packet_recvmsg,
 	.sendmsg_rt =   rt_packet_sendmsg,
 	.select =       rt_socket_select_bind,
+	.mmap =         rt_socket_mmap,
     },
 };
 
@@ -581,6 +719,7 @@ static struct rtdm_driver raw_packet_proto_drv = {
 	.recvmsg_rt =   rt_packet_recvmsg,
 	.sendmsg_rt =   rt_packet_sendmsg,
 	.select =       rt_socket_select_bind,
+	.mmap =         rt_socket_mmap,
     },
 };
 
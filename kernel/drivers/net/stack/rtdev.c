@@ -270,6 +270,7 @@ void rtdev_destroy(struct rtnet_device *rtdev)
 	rtskb_pool_release(&rtdev->dev_pool);
 	rtskb_pool_shrink(&global_pool, rtdev->add_rtskbs);
 	rtdev->stack_event = NULL;
+	rtdev->rxq = NULL;
 	rtdm_mutex_destroy(&rtdev->xmit_mutex);
 }
 EXPORT_SYMBOL_GPL(rtdev_destroy);
@@ -36,6 +36,7 @@
 #include <rtnet_internal.h>
 #include <rtnet_iovec.h>
 #include <rtnet_socket.h>
+#include <rtnet_ring.h>
 #include <ipv4/protocol.h>
 
 #define SKB_POOL_CLOSED 0
@@ -76,6 +77,7 @@ int rt_socket_init(struct rtdm_fd *fd, unsigned short protocol)
 
 	sock->flags = 0;
 	sock->callback_func = NULL;
+	sock->ring = NULL;
 
 	rtskb_queue_init(&sock->incoming);
 
@@ -113,6 +115,8 @@ void rt_socket_cleanup(struct rtdm_fd *fd)
 
 	rtdm_sem_destroy(&sock->pending_sem);
 
+	rt_socket_ring_release(sock);
+
 	mutex_lock(&sock->pool_nrt_lock);
 
 	set_bit(SKB_POOL_CLOSED, &sock->flags);
@@ -136,6 +140,9 @@ int rt_socket_common_ioctl(struct rtdm_fd *fd, int request, void __user *arg)
 	unsigned int _val;
 	const nanosecs_rel_t *timeout;
 	nanosecs_rel_t _timeout;
+	const struct rtnet_ring_req *ring_req;
+	struct rtnet_ring_req _ring_req;
+	struct rtnet_ring_stats ring_stats;
 	rtdm_lockctx_t context;
 
 	switch (request) {
@@ -210,6 +217,27 @@ int rt_socket_common_ioctl(struct rtdm_fd *fd, int request, void __user *arg)
 
 		break;
 
+	case RTNET_RTIOC_RING:
+		ring_req = rtnet_get_arg(fd, &_ring_req, arg, sizeof(_ring_req));
+		if (IS_ERR(ring_req))
+			return PTR_ERR(ring_req);
+		ret = rt_socket_ring_setup(fd, ring_req);
+		break;
+
+	case RTNET_RTIOC_RING_WAIT:
+		val = rtnet_get_arg(fd, &_val, arg, sizeof(_val));
+		if (IS_ERR(val))
+			return PTR_ERR(val);
+		ret = rt_socket_ring_wait(fd, *val);
+		break;
+
+	case RTNET_RTIOC_RING_STATS:
+		ret = rt_socket_ring_stats(fd, &ring_stats);
+		if (ret == 0)
+			ret = rtnet_put_arg(fd, arg, &ring_stats,
+					    sizeof(ring_stats));
+		break;
+
 	default:
 		ret = -EOPNOTSUPP;
 		break;
@@ -357,6 +385,10 @@ int rt_socket_select_bind(struct rtdm_fd *fd, rtdm_selector_t *selector,
 
 	switch (type) {
 	case XNSELECT_READ:
+		/* Frames go to the ring instead of the incoming queue. */
+		if (sock->ring)
+			return rt_socket_ring_select(sock->ring, selector,
+						     fd_index);
 		return rtdm_sem_select(&sock->pending_sem, selector,
 				       XNSELECT_READ, fd_index);
 	default:
@@ -0,0 +1,304 @@
+/***
+ *
+ *  stack/socket_ring.c - shared memory socket rings
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ */
+
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+
+#include <rtnet_internal.h>
+#include <rtnet_socket.h>
+#include <rtnet_ring.h>
+
+/***
+ *  rt_socket_ring_setup - attach a shared memory ring to a socket
+ */
+int rt_socket_ring_setup(struct rtdm_fd *fd, const struct rtnet_ring_req *req)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	struct rtsocket_ring *ring;
+	rtdm_lockctx_t context;
+	u64 size;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (req->frame_size < RTNET_RING_DATA_OFFSET + RTNET_RING_ALIGN ||
+	    req->frame_size % RTNET_RING_ALIGN ||
+	    req->rx_frames + req->tx_frames == 0)
+		return -EINVAL;
+
+	size = (u64)req->frame_size * ((u64)req->rx_frames + req->tx_frames);
+	if (size > RTNET_RING_MAX_SIZE)
+		return -EINVAL;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (ring == NULL)
+		return -ENOMEM;
+
+	ring->size = PAGE_ALIGN(size);
+	ring->mem = vmalloc_user(ring->size);
+	if (ring->mem == NULL) {
+		kfree(ring);
+		return -ENOMEM;
+	}
+
+	ring->frame_size = req->frame_size;
+	ring->rx_frames = req->rx_frames;
+	ring->tx_frames = req->tx_frames;
+	rtdm_lock_init(&ring->rx_lock);
+	rtdm_lock_init(&ring->tx_lock);
+	atomic_set(&ring->rx_waiters, 0);
+	rtdm_event_init(&ring->rx_event, 0);
+
+	rtdm_lock_get_irqsave(&sock->param_lock, context);
+	if (sock->ring == NULL) {
+		sock->ring = ring;
+		ring = NULL;
+	}
+	rtdm_lock_put_irqrestore(&sock->param_lock, context);
+
+	if (ring) {
+		rtdm_event_destroy(&ring->rx_event);
+		vfree(ring->mem);
+		kfree(ring);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+/***
+ *  rt_socket_ring_release - detach the ring of a closing socket
+ *
+ *  Pages mapped to user space are reference counted by the MM, so
+ *  existing mappings remain valid until unmapped.
+ */
+void rt_socket_ring_release(struct rtsocket *sock)
+{
+	struct rtsocket_ring *ring = sock->ring;
+
+	if (ring == NULL)
+		return;
+
+	sock->ring = NULL;
+	rtdm_event_destroy(&ring->rx_event);
+	vfree(ring->mem);
+	kfree(ring);
+}
+
+/***
+ *  rt_socket_ring_wait - wait for RX slot @n to be handed over
+ */
+int rt_socket_ring_wait(struct rtdm_fd *fd, unsigned int n)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	struct rtsocket_ring *ring = sock->ring;
+	struct rtnet_ring_slot *slot;
+	int ret;
+
+	if (ring == NULL || n >= ring->rx_frames)
+		return -EINVAL;
+
+	slot = rt_socket_ring_slot(ring, n);
+
+	atomic_inc(&ring->rx_waiters);
+
+	for (;;) {
+		smp_mb();
+		if (READ_ONCE(slot->status) == RTNET_RING_USER) {
+			ret = 0;
+			break;
+		}
+		ret = rtdm_event_timedwait(&ring->rx_event, sock->timeout,
+					   NULL);
+		if (ret) {
+			if (ret == -EIDRM)
+				ret = -EBADF; /* socket has been closed */
+			break;
+		}
+	}
+
+	atomic_dec(&ring->rx_waiters);
+
+	return ret;
+}
+
+/***
+ *  rt_socket_ring_stats - read the RX counters of the ring
+ */
+int rt_socket_ring_stats(struct rtdm_fd *fd, struct rtnet_ring_stats *stats)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	struct rtsocket_ring *ring = sock->ring;
+	rtdm_lockctx_t context;
+
+	if (ring == NULL)
+		return -EINVAL;
+
+	rtdm_lock_get_irqsave(&ring->rx_lock, context);
+	stats->rx_delivered = ring->rx_delivered;
+	stats->rx_drops = ring->rx_drops;
+	rtdm_lock_put_irqrestore(&ring->rx_lock, context);
+
+	return 0;
+}
+
+/***
+ *  rt_socket_ring_select - bind a selector to the RX side of the ring
+ *
+ *  The RX event is pending from the time a frame is handed over to an
+ *  application which emptied the ring, until rt_socket_ring_wait()
+ *  finds its slot empty.
+ */
+int rt_socket_ring_select(struct rtsocket_ring *ring,
+			  rtdm_selector_t *selector, unsigned int fd_index)
+{
+	return rtdm_event_select(&ring->rx_event, selector, XNSELECT_READ,
+				 fd_index);
+}
+
+/***
+ *  rt_socket_ring_rx - copy @len bytes of the rtskb chain @skb, from
+ *  @start within the first buffer, into the next RX slot. The caller
+ *  keeps ownership of @skb. Returns -ENOBUFS if the application lags
+ *  behind.
+ */
+int rt_socket_ring_rx(struct rtsocket_ring *ring, struct rtskb *skb,
+		      const void *start, size_t len, const void *addr,
+		      size_t addrlen)
+{
+	struct rtnet_ring_slot *slot, *prev;
+	rtdm_lockctx_t context;
+	size_t room, chunk;
+	bool was_empty;
+	void *data;
+
+	if (unlikely(ring->rx_frames == 0))
+		return -ENOBUFS;
+
+	rtdm_lock_get_irqsave(&ring->rx_lock, context);
+
+	slot = rt_socket_ring_slot(ring, ring->rx_head);
+	if (READ_ONCE(slot->status) != RTNET_RING_KERNEL) {
+		ring->rx_drops++;
+		rtdm_lock_put_irqrestore(&ring->rx_lock, context);
+		return -ENOBUFS;
+	}
+
+	/* Slot contents must not be written before we saw it free. */
+	smp_mb();
+
+	/*
+	 * Slots are handed over and given back in order: if the one
+	 * we filled last was given back, the application emptied the
+	 * ring and may be waiting in select()/poll().
+	 */
+	prev = rt_socket_ring_slot(ring, (ring->rx_head ? ring->rx_head :
+					  ring->rx_frames) - 1);
+	was_empty = READ_ONCE(prev->status) != RTNET_RING_USER;
+
+	slot->len = len;
+	slot->tstamp = skb->time_stamp;
+	slot->flags = 0;
+	slot->addrlen = min(addrlen, sizeof(slot->addr));
+	memcpy(slot->addr, addr, slot->addrlen);
+
+	room = rt_socket_ring_room(ring);
+	if (len > room) {
+		len = room;
+		slot->flags |= RTNET_RING_TRUNC;
+	}
+
+	data = rt_socket_ring_data(slot);
+	chunk = min_t(size_t, skb->tail - (unsigned char *)start, len);
+	memcpy(data, start, chunk);
+	data += chunk;
+	len -= chunk;
+
+	/* Remaining IP fragments, if any */
+	for (skb = skb->next; skb && len > 0; skb = skb->next) {
+		chunk = min_t(size_t, skb->len, len);
+		memcpy(data, skb->data, chunk);
+		data += chunk;
+		len -= chunk;
+	}
+
+	smp_wmb();
+	WRITE_ONCE(slot->status, RTNET_RING_USER);
+
+	if (++ring->rx_head == ring->rx_frames)
+		ring->rx_head = 0;
+	ring->rx_delivered++;
+
+	rtdm_lock_put_irqrestore(&ring->rx_lock, context);
+
+	smp_mb();
+	if (was_empty || atomic_read(&ring->rx_waiters))
+		rtdm_event_signal(&ring->rx_event);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(rt_socket_ring_rx);
+
+/***
+ *  rt_socket_ring_tx_claim - pick the next TX slot ready for sending,
+ *  to be released by rt_socket_ring_tx_done().
+ */
+struct rtnet_ring_slot *rt_socket_ring_tx_claim(struct rtsocket_ring *ring)
+{
+	struct rtnet_ring_slot *slot = NULL;
+	rtdm_lockctx_t context;
+
+	if (ring->tx_frames == 0)
+		return NULL;
+
+	rtdm_lock_get_irqsave(&ring->tx_lock, context);
+
+	slot = rt_socket_ring_slot(ring, ring->rx_frames + ring->tx_head);
+	if (READ_ONCE(slot->status) == RTNET_RING_SEND) {
+		if (++ring->tx_head == ring->tx_frames)
+			ring->tx_head = 0;
+		/* Read the slot contents only after its status. */
+		smp_rmb();
+	} else
+		slot = NULL;
+
+	rtdm_lock_put_irqrestore(&ring->tx_lock, context);
+
+	return slot;
+}
+EXPORT_SYMBOL_GPL(rt_socket_ring_tx_claim);
+
+/***
+ *  rt_socket_mmap - map the ring of a socket
+ */
+int rt_socket_mmap(struct rtdm_fd *fd, struct vm_area_struct *vma)
+{
+	struct rtsocket *sock = rtdm_fd_to_private(fd);
+	struct rtsocket_ring *ring = sock->ring;
+
+	if (ring == NULL)
+		return -ENXIO;
+
+	if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start != ring->size)
+		return -EINVAL;
+
+	return rtdm_mmap_vmem(vma, ring->mem);
+}
+EXPORT_SYMBOL_GPL(rt_socket_mmap);
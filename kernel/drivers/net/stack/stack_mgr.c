@@ -23,21 +23,65 @@
  */
 
 #include <linux/moduleparam.h>
+#include <linux/rculist.h>
 
 #include <rtdev.h>
 #include <rtnet_internal.h>
 #include <rtskb_fifo.h>
+#include <rtnet_socket.h>
 #include <stack_mgr.h>
 
+#define RTNET_MAX_RX_QUEUES 16
+
 static unsigned int stack_mgr_prio = RTNET_DEF_STACK_PRIORITY;
 module_param(stack_mgr_prio, uint, 0444);
 MODULE_PARM_DESC(stack_mgr_prio, "Priority of the stack manager task");
 
+static unsigned int rx_queues = 1;
+module_param(rx_queues, uint, 0444);
+MODULE_PARM_DESC(rx_queues, "Number of stack manager RX queues (default 1, "
+			    "max " __stringify(RTNET_MAX_RX_QUEUES) ")");
+
+static int rx_queue_cpus[RTNET_MAX_RX_QUEUES];
+static int rx_queue_cpus_nr;
+module_param_array(rx_queue_cpus, int, &rx_queue_cpus_nr, 0444);
+MODULE_PARM_DESC(rx_queue_cpus, "CPU each RX queue task is pinned to, "
+				"e.g. rx_queue_cpus=2,3");
+
 #if (CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE &                                    \
      (CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE - 1)) != 0
 #error CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE must be power of 2!
 #endif
-static DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+
+/*
+ * Each RX queue owns a FIFO fed by the devices attached to it, and a
+ * stack task draining that FIFO. Devices are spread over the queues
+ * at connection time, so that several NICs can be processed in
+ * parallel on different CPUs. Counters are only updated by the
+ * single writer of each field (the driver IRQ under the FIFO write
+ * lock for drops, the queue task for the rest).
+ */
+struct rtnet_rxq {
+	DECLARE_RTSKB_FIFO(rx, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+	rtdm_event_t event;
+	rtdm_task_t task;
+	int cpu;
+	atomic_t devices;
+	unsigned long packets;
+	unsigned long drops;
+	nanosecs_rel_t lat_max;
+	u64 lat_sum;
+	/* Sockets to wake up at the end of the burst being delivered. */
+	struct {
+		struct rtsocket *sock;
+		unsigned int count;
+	} rx_signal[CONFIG_XENO_DRIVERS_NET_RX_BURST];
+	unsigned int rx_nsignal;
+};
+
+static struct rtnet_rxq *rxq_table;
+static unsigned int rxq_count;
+static atomic_t rxq_next = ATOMIC_INIT(0);
 
 struct list_head rt_packets[RTPACKET_HASH_TBL_SIZE];
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
@@ -45,6 +89,87 @@ struct list_head rt_packets_all;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 DEFINE_RTDM_LOCK(rt_packets_lock);
 
+/*
+ * Protocol handlers are looked up locklessly on the receive path:
+ * writers still serialize on rt_packets_lock and publish list updates
+ * with the _rcu list helpers, readers walk the lists with hard irqs
+ * off while their per-CPU sequence is odd. rtdev_remove_pack() waits
+ * for the CPUs caught in a walk to leave it before returning, so that
+ * the caller may release the entry safely.
+ */
+struct rt_packets_reader {
+	unsigned long seq;
+} ____cacheline_aligned_in_smp;
+
+static DEFINE_PER_CPU(struct rt_packets_reader, rt_packets_readers);
+
+static inline void rt_packets_read_begin(struct rt_packets_reader *r)
+{
+	WRITE_ONCE(r->seq, r->seq + 1);
+	smp_mb();
+}
+
+static inline void rt_packets_read_end(struct rt_packets_reader *r)
+{
+	smp_mb();
+	WRITE_ONCE(r->seq, r->seq + 1);
+}
+
+static void rt_packets_sync(void)
+{
+	struct rt_packets_reader *r;
+	unsigned long seq;
+	int cpu;
+
+	smp_mb();
+
+	for_each_online_cpu (cpu) {
+		r = per_cpu_ptr(&rt_packets_readers, cpu);
+		seq = READ_ONCE(r->seq);
+		if (!(seq & 1))
+			continue;
+		while (READ_ONCE(r->seq) == seq)
+			cpu_relax();
+	}
+}
+
+/*
+ * Return the first handler of @head matching @type past the @skip
+ * first matches, with its trylock() held. @skip is updated for
+ * resuming the walk after the handler ran. A concurrent update of
+ * the list may cause one handler to be missed or visited twice,
+ * which is harmless while sockets are being (un)bound.
+ */
+static struct rtpacket_type *rt_packets_grab(struct list_head *head,
+					     unsigned short type,
+					     unsigned int *skip)
+{
+	struct rtpacket_type *pt_entry, *found = NULL;
+	struct rt_packets_reader *r;
+	rtdm_lockctx_t context;
+	unsigned int n = 0;
+
+	rtdm_lock_irqsave(context);
+	r = raw_cpu_ptr(&rt_packets_readers);
+	rt_packets_read_begin(r);
+
+	list_for_each_entry_lockless (pt_entry, head, list_entry) {
+		if (pt_entry->type != type || n++ < *skip)
+			continue;
+		if (pt_entry->trylock(pt_entry)) {
+			found = pt_entry;
+			break;
+		}
+	}
+
+	rt_packets_read_end(r);
+	rtdm_lock_irqrestore(context);
+
+	*skip = n;
+
+	return found;
+}
+
 /***
  *  rtdev_add_pack:         add protocol (Layer 3)
  *  @pt:                    the new protocol
@@ -66,12 +191,12 @@ int __rtdev_add_pack(struct rtpacket_type *pt, struct module *module)
 
 	if (pt->type == htons(ETH_P_ALL))
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
-		list_add_tail(&pt->list_entry, &rt_packets_all);
+		list_add_tail_rcu(&pt->list_entry, &rt_packets_all);
 #else /* !CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 		ret = -EINVAL;
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 	else
-		list_add_tail(
+		list_add_tail_rcu(
 			&pt->list_entry,
 			&rt_packets[ntohs(pt->type) & RTPACKET_HASH_KEY_MASK]);
 
@@ -85,6 +210,8 @@ EXPORT_SYMBOL_GPL(__rtdev_add_pack);
 /***
  *  rtdev_remove_pack:  remove protocol (Layer 3)
  *  @pt:                protocol
+ *
+ *  On return, no RX path can grab @pt anymore.
  */
 void rtdev_remove_pack(struct rtpacket_type *pt)
 {
@@ -93,8 +220,10 @@ void rtdev_remove_pack(struct rtpacket_type *pt)
 	RTNET_ASSERT(pt != NULL, return;);
 
 	rtdm_lock_get_irqsave(&rt_packets_lock, context);
-	list_del(&pt->list_entry);
+	list_del_rcu(&pt->list_entry);
 	rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+
+	rt_packets_sync();
 }
 
 EXPORT_SYMBOL_GPL(rtdev_remove_pack);
@@ -107,17 +236,77 @@ EXPORT_SYMBOL_GPL(rtdev_remove_pack);
  */
 void rtnetif_rx(struct rtskb *skb)
 {
+	struct rtnet_rxq *rxq;
+
 	RTNET_ASSERT(skb != NULL, return;);
 	RTNET_ASSERT(skb->rtdev != NULL, return;);
 
-	if (unlikely(rtskb_fifo_insert_inirq(&rx.fifo, skb) < 0)) {
+	rxq = skb->rtdev->rxq ?: &rxq_table[0];
+
+	rtdm_lock_get(&rxq->rx.fifo.write_lock);
+	if (unlikely(__rtskb_fifo_insert(&rxq->rx.fifo, skb) < 0)) {
+		rxq->drops++;
+		rtdm_lock_put(&rxq->rx.fifo.write_lock);
 		rtdm_printk("RTnet: dropping packet in %s()\n", __FUNCTION__);
 		kfree_rtskb(skb);
+		return;
 	}
+	rtdm_lock_put(&rxq->rx.fifo.write_lock);
 }
 
 EXPORT_SYMBOL_GPL(rtnetif_rx);
 
+/***
+ *  rtnetif_rx_burst: same as rtnetif_rx() for a whole burst of
+ *  rtskbs, taking the FIFO lock once. The burst is reset on return.
+ *
+ *  @burst - the packets, all received from the same device
+ */
+void rtnetif_rx_burst(struct rtskb_burst *burst)
+{
+	struct rtskb *skb = burst->first, *next;
+	struct rtnet_rxq *rxq;
+	unsigned int dropped = 0;
+
+	if (unlikely(skb == NULL))
+		return;
+
+	RTNET_ASSERT(skb->rtdev != NULL, return;);
+
+	rxq = skb->rtdev->rxq ?: &rxq_table[0];
+
+	rtdm_lock_get(&rxq->rx.fifo.write_lock);
+
+	for (; skb; skb = next) {
+		next = skb->next;
+		skb->next = NULL;
+		if (unlikely(__rtskb_fifo_insert(&rxq->rx.fifo, skb) < 0)) {
+			skb->next = next;
+			break;
+		}
+	}
+
+	for (next = skb; next; next = next->next)
+		dropped++;
+	rxq->drops += dropped;
+
+	rtdm_lock_put(&rxq->rx.fifo.write_lock);
+
+	if (unlikely(dropped)) {
+		rtdm_printk("RTnet: dropping %u packets in %s()\n", dropped,
+			    __FUNCTION__);
+		for (; skb; skb = next) {
+			next = skb->next;
+			skb->next = NULL;
+			kfree_rtskb(skb);
+		}
+	}
+
+	rtskb_burst_init(burst);
+}
+
+EXPORT_SYMBOL_GPL(rtnetif_rx_burst);
+
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK)
 #define __DELIVER_PREFIX
 #else /* !CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK */
@@ -126,10 +315,9 @@ EXPORT_SYMBOL_GPL(rtnetif_rx);
 
 __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 {
-	unsigned short hash;
 	struct rtpacket_type *pt_entry;
-	rtdm_lockctx_t context;
 	struct rtnet_device *rtdev = rtskb->rtdev;
+	unsigned int skip;
 	int err;
 	int eth_p_all_hit = 0;
 
@@ -137,44 +325,26 @@ __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 
 	rtskb->nh.raw = rtskb->data;
 
-	rtdm_lock_get_irqsave(&rt_packets_lock, context);
-
 #ifdef CONFIG_XENO_DRIVERS_NET_ETH_P_ALL
-	eth_p_all_hit = 0;
-	list_for_each_entry (pt_entry, &rt_packets_all, list_entry) {
-		if (!pt_entry->trylock(pt_entry))
-			continue;
-		rtdm_lock_put_irqrestore(&rt_packets_lock, context);
-
+	skip = 0;
+	while ((pt_entry = rt_packets_grab(&rt_packets_all, htons(ETH_P_ALL),
+					   &skip))) {
 		pt_entry->handler(rtskb, pt_entry);
-
-		rtdm_lock_get_irqsave(&rt_packets_lock, context);
 		pt_entry->unlock(pt_entry);
 		eth_p_all_hit = 1;
 	}
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 
-	hash = ntohs(rtskb->protocol) & RTPACKET_HASH_KEY_MASK;
-
-	list_for_each_entry (pt_entry, &rt_packets[hash], list_entry)
-		if (pt_entry->type == rtskb->protocol) {
-			if (!pt_entry->trylock(pt_entry))
-				continue;
-			rtdm_lock_put_irqrestore(&rt_packets_lock, context);
-
-			err = pt_entry->handler(rtskb, pt_entry);
-
-			rtdm_lock_get_irqsave(&rt_packets_lock, context);
-			pt_entry->unlock(pt_entry);
-
-			if (likely(!err)) {
-				rtdm_lock_put_irqrestore(&rt_packets_lock,
-							 context);
-				return;
-			}
-		}
-
-	rtdm_lock_put_irqrestore(&rt_packets_lock, context);
+	skip = 0;
+	while ((pt_entry = rt_packets_grab(
+			&rt_packets[ntohs(rtskb->protocol) &
+				    RTPACKET_HASH_KEY_MASK],
+			rtskb->protocol, &skip))) {
+		err = pt_entry->handler(rtskb, pt_entry);
+		pt_entry->unlock(pt_entry);
+		if (likely(!err))
+			return;
+	}
 
 	/* Don't warn if ETH_P_ALL listener were present or when running in
        promiscuous mode (RTcap). */
@@ -186,31 +356,127 @@ __DELIVER_PREFIX void rt_stack_deliver(struct rtskb *rtskb)
 	kfree_rtskb(rtskb);
 }
 
+/***
+ *  rt_stack_rx_signal: wake up the readers of @sock for the packet
+ *  @skb it just received. When called from the stack manager task
+ *  delivering a burst, this is deferred to the end of the burst, so
+ *  that the socket is signaled once for all the packets it got.
+ */
+void rt_stack_rx_signal(struct rtsocket *sock, struct rtskb *skb)
+{
+	struct rtnet_rxq *rxq = skb->rtdev ? skb->rtdev->rxq : NULL;
+	unsigned int n;
+
+	/* Loopback delivers from the sender's context. */
+	if (rxq == NULL || rtdm_task_current() != &rxq->task)
+		goto signal;
+
+	for (n = 0; n < rxq->rx_nsignal; n++) {
+		if (rxq->rx_signal[n].sock == sock) {
+			rxq->rx_signal[n].count++;
+			return;
+		}
+	}
+
+	if (n == ARRAY_SIZE(rxq->rx_signal) || rt_socket_reference(sock))
+		goto signal;
+
+	rxq->rx_signal[n].sock = sock;
+	rxq->rx_signal[n].count = 1;
+	rxq->rx_nsignal++;
+	return;
+signal:
+	rtdm_sem_up(&sock->pending_sem);
+}
+
+EXPORT_SYMBOL_GPL(rt_stack_rx_signal);
+
+static void rt_stack_deliver_burst(struct rtnet_rxq *rxq,
+				   struct rtskb_burst *burst)
+{
+	struct rtskb *rtskb, *next;
+	struct rtsocket *sock;
+	unsigned int n;
+
+	for (rtskb = burst->first; rtskb; rtskb = next) {
+		next = rtskb->next;
+		rtskb->next = NULL;
+		rt_stack_deliver(rtskb);
+	}
+
+	rtskb_burst_init(burst);
+
+	for (n = 0; n < rxq->rx_nsignal; n++) {
+		sock = rxq->rx_signal[n].sock;
+		rtdm_sem_up_count(&sock->pending_sem, rxq->rx_signal[n].count);
+		rt_socket_dereference(sock);
+	}
+
+	rxq->rx_nsignal = 0;
+}
+
 #if IS_ENABLED(CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK)
 EXPORT_SYMBOL_GPL(rt_stack_deliver);
 #endif /* CONFIG_XENO_DRIVERS_NET_DRV_LOOPBACK */
 
+static inline void rt_stack_account(struct rtnet_rxq *rxq,
+				    struct rtskb *rtskb)
+{
+	nanosecs_rel_t lat;
+
+	rxq->packets++;
+
+	/* Drivers stamp rtskbs from their IRQ handler, if at all. */
+	if (rtskb->time_stamp == 0)
+		return;
+
+	lat = rtdm_clock_read() - rtskb->time_stamp;
+	if (lat < 0)
+		return;
+
+	rxq->lat_sum += lat;
+	if (lat > rxq->lat_max)
+		rxq->lat_max = lat;
+}
+
 static void rt_stack_mgr_task(void *arg)
 {
-	rtdm_event_t *mgr_event = &((struct rtnet_mgr *)arg)->event;
+	struct rtnet_rxq *rxq = arg;
+	struct rtskb_burst burst;
 	struct rtskb *rtskb;
 
+	rtskb_burst_init(&burst);
+
 	while (!rtdm_task_should_stop()) {
-		if (rtdm_event_wait(mgr_event) < 0)
+		if (rtdm_event_wait(&rxq->event) < 0)
 			break;
 
 		/* we are the only reader => no locking required */
-		while ((rtskb = __rtskb_fifo_remove(&rx.fifo)))
-			rt_stack_deliver(rtskb);
+		while ((rtskb = __rtskb_fifo_remove(&rxq->rx.fifo))) {
+			rt_stack_account(rxq, rtskb);
+			rtskb_burst_add(&burst, rtskb);
+			if (burst.len >= CONFIG_XENO_DRIVERS_NET_RX_BURST)
+				rt_stack_deliver_burst(rxq, &burst);
+		}
+
+		if (!rtskb_burst_empty(&burst))
+			rt_stack_deliver_burst(rxq, &burst);
 	}
 }
 
 /***
- *  rt_stack_connect
+ *  rt_stack_connect: attach @rtdev to one of the RX queues of @mgr,
+ *  round-robin.
  */
 void rt_stack_connect(struct rtnet_device *rtdev, struct rtnet_mgr *mgr)
 {
-	rtdev->stack_event = &mgr->event;
+	struct rtnet_rxq *rxq;
+
+	rxq = &rxq_table[(unsigned int)(atomic_inc_return(&rxq_next) - 1) %
+			 rxq_count];
+	atomic_inc(&rxq->devices);
+	rtdev->rxq = rxq;
+	rtdev->stack_event = &rxq->event;
 }
 
 EXPORT_SYMBOL_GPL(rt_stack_connect);
@@ -220,19 +486,121 @@ EXPORT_SYMBOL_GPL(rt_stack_connect);
  */
 void rt_stack_disconnect(struct rtnet_device *rtdev)
 {
+	if (rtdev->rxq)
+		atomic_dec(&rtdev->rxq->devices);
 	rtdev->stack_event = NULL;
+	rtdev->rxq = NULL;
 }
 
 EXPORT_SYMBOL_GPL(rt_stack_disconnect);
 
+#ifdef CONFIG_XENO_OPT_VFILE
+static void *rt_stack_rxq_begin(struct xnvfile_regular_iterator *it)
+{
+	return it->pos > rxq_count ? NULL : (void *)(long)(it->pos + 1);
+}
+
+static void *rt_stack_rxq_next(struct xnvfile_regular_iterator *it)
+{
+	if (++it->pos > rxq_count)
+		return NULL;
+
+	return (void *)(long)(it->pos + 1);
+}
+
+static int rt_stack_rxq_show(struct xnvfile_regular_iterator *it, void *data)
+{
+	struct rtnet_rxq *rxq;
+	unsigned long packets;
+	u64 avg;
+
+	if (data == (void *)1L) {
+		xnvfile_printf(it, "Queue\tCPU\tDevices\tPackets\t\tDrops"
+				   "\tLatAvg(ns)\tLatMax(ns)\n");
+		return 0;
+	}
+
+	rxq = &rxq_table[(long)data - 2];
+	packets = READ_ONCE(rxq->packets);
+	avg = packets ? div64_u64(READ_ONCE(rxq->lat_sum), packets) : 0;
+
+	xnvfile_printf(it, "%ld\t", (long)data - 2);
+	if (rxq->cpu < 0)
+		xnvfile_printf(it, "any\t");
+	else
+		xnvfile_printf(it, "%d\t", rxq->cpu);
+	xnvfile_printf(it, "%d\t%-10lu\t%lu\t%-10llu\t%lld\n",
+		       atomic_read(&rxq->devices), packets,
+		       READ_ONCE(rxq->drops), avg,
+		       (long long)READ_ONCE(rxq->lat_max));
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops rt_stack_rxq_vfile_ops = {
+	.begin = rt_stack_rxq_begin,
+	.next = rt_stack_rxq_next,
+	.show = rt_stack_rxq_show,
+};
+
+static struct xnvfile_regular rt_stack_rxq_vfile = {
+	.ops = &rt_stack_rxq_vfile_ops,
+};
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+/*
+ * Pick the CPU of queue @n: the one given by the user if any, else
+ * spread multiple queues over the online CPUs. A single queue is not
+ * pinned, which matches the legacy behavior.
+ */
+static int rt_stack_rxq_cpu(unsigned int n)
+{
+	unsigned int i = 0;
+	int cpu;
+
+	if (n < rx_queue_cpus_nr)
+		return rx_queue_cpus[n];
+
+	if (rxq_count == 1)
+		return -1;
+
+	n %= num_online_cpus();
+	for_each_online_cpu (cpu)
+		if (i++ == n)
+			return cpu;
+
+	return -1;
+}
+
+static void rt_stack_rxq_cleanup(unsigned int n)
+{
+	struct rtnet_rxq *rxq;
+
+	while (n-- > 0) {
+		rxq = &rxq_table[n];
+		rtdm_event_destroy(&rxq->event);
+		rtdm_task_destroy(&rxq->task);
+	}
+
+	kfree(rxq_table);
+	rxq_table = NULL;
+}
+
 /***
  *  rt_stack_mgr_init
  */
 int rt_stack_mgr_init(struct rtnet_mgr *mgr)
 {
-	int i;
-
-	rtskb_fifo_init(&rx.fifo, CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+	struct rtnet_rxq *rxq;
+	char name[32];
+	unsigned int n;
+	int i, ret;
+
+	if (rx_queues < 1 || rx_queues > RTNET_MAX_RX_QUEUES) {
+		printk("RTnet: rx_queues must be within [1-%d]\n",
+		       RTNET_MAX_RX_QUEUES);
+		return -EINVAL;
+	}
 
 	for (i = 0; i < RTPACKET_HASH_TBL_SIZE; i++)
 		INIT_LIST_HEAD(&rt_packets[i]);
@@ -240,10 +608,55 @@ int rt_stack_mgr_init(struct rtnet_mgr *mgr)
 	INIT_LIST_HEAD(&rt_packets_all);
 #endif /* CONFIG_XENO_DRIVERS_NET_ETH_P_ALL */
 
-	rtdm_event_init(&mgr->event, 0);
+	rxq_table = kcalloc(rx_queues, sizeof(*rxq_table), GFP_KERNEL);
+	if (rxq_table == NULL)
+		return -ENOMEM;
+
+	rxq_count = rx_queues;
+
+	for (n = 0; n < rxq_count; n++) {
+		rxq = &rxq_table[n];
+		rtskb_fifo_init(&rxq->rx.fifo,
+				CONFIG_XENO_DRIVERS_NET_RX_FIFO_SIZE);
+		rtdm_event_init(&rxq->event, 0);
+		atomic_set(&rxq->devices, 0);
+		rxq->cpu = rt_stack_rxq_cpu(n);
+
+		if (rxq_count == 1)
+			strcpy(name, "rtnet-stack");
+		else
+			snprintf(name, sizeof(name), "rtnet-stack/%u", n);
+
+		if (rxq->cpu < 0)
+			ret = rtdm_task_init(&rxq->task, name,
+					     rt_stack_mgr_task, rxq,
+					     stack_mgr_prio, 0);
+		else
+			ret = rtdm_task_init_on_cpu(&rxq->task, name,
+						    rt_stack_mgr_task, rxq,
+						    stack_mgr_prio, 0,
+						    rxq->cpu);
+		if (ret) {
+			printk("RTnet: cannot start RX queue %u on CPU %d\n",
+			       n, rxq->cpu);
+			rtdm_event_destroy(&rxq->event);
+			goto fail;
+		}
+	}
 
-	return rtdm_task_init(&mgr->task, "rtnet-stack", rt_stack_mgr_task, mgr,
-			      stack_mgr_prio, 0);
+#ifdef CONFIG_XENO_OPT_VFILE
+	ret = xnvfile_init_regular("rx_queues", &rt_stack_rxq_vfile,
+				   &rtnet_proc_root);
+	if (ret)
+		goto fail;
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+	return 0;
+
+fail:
+	rt_stack_rxq_cleanup(n);
+
+	return ret;
 }
 
 /***
@@ -251,6 +664,8 @@ int rt_stack_mgr_init(struct rtnet_mgr *mgr)
  */
 void rt_stack_mgr_delete(struct rtnet_mgr *mgr)
 {
-	rtdm_event_destroy(&mgr->event);
-	rtdm_task_destroy(&mgr->task);
+#ifdef CONFIG_XENO_OPT_VFILE
+	xnvfile_destroy_regular(&rt_stack_rxq_vfile);
+#endif /* CONFIG_XENO_OPT_VFILE */
+	rt_stack_rxq_cleanup(rxq_count);
 }
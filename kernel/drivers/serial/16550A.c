@@ -96,6 +96,10 @@ struct rt_16550_context {
 	char in_buf[IN_BUFFER_SIZE];	/* RX ring buffer */
 	volatile unsigned long in_lock;	/* single-reader lock */
 	uint64_t *in_history;		/* RX timestamp buffer */
+	nanosecs_rel_t in_idle_ns;	/* RX idle batching delay, 0 if off */
+	nanosecs_abs_t in_last;		/* monotonic date of last RX byte */
+	int in_idle;			/* line went idle under reader */
+	rtdm_timer_t in_idle_timer;	/* RX idle detection timer */
 
 	int out_head;			/* TX ring buffer, head pointer */
 	int out_tail;			/* TX ring buffer, tail pointer */
@@ -113,11 +117,14 @@ struct rt_16550_context {
 	int mcr_status;			/* MCR cache */
 	int status;			/* cache for LSR + soft-states */
 	int saved_errors;		/* error cache for RTIOC_GET_STATUS */
+
+	struct rtser_stats stats;	/* per-port counters */
 };
 
 static const struct rtser_config default_config = {
 	0xFFFF, RTSER_DEF_BAUD, RTSER_DEF_PARITY, RTSER_DEF_BITS,
-	RTSER_DEF_STOPB, RTSER_DEF_HAND, RTSER_DEF_FIFO_DEPTH, 0,
+	RTSER_DEF_STOPB, RTSER_DEF_HAND, RTSER_DEF_FIFO_DEPTH,
+	RTSER_DEF_RX_IDLE,
 	RTSER_DEF_TIMEOUT, RTSER_DEF_TIMEOUT, RTSER_DEF_TIMEOUT,
 	RTSER_DEF_TIMESTAMP_HISTORY, RTSER_DEF_EVENT_MASK, RTSER_DEF_RS485
 };
@@ -206,9 +213,39 @@ static void rt_16550_tx_fill(struct rt_16550_context *ctx)
 			rt_16550_reg_out(mode, base, THR, c);
 			ctx->out_head &= (OUT_BUFFER_SIZE - 1);
 		}
+		ctx->stats.tx_bytes += ctx->tx_fifo - count;
 	}
 }
 
+static void rt_16550_rx_idle(rtdm_timer_t *timer)
+{
+	struct rt_16550_context *ctx =
+		container_of(timer, struct rt_16550_context, in_idle_timer);
+
+	/*
+	 * No byte arrived for in_idle_ns while a reader was waiting:
+	 * hand it over what we have. We run with nklock held, so
+	 * ctx->lock must not be taken here; the reader sorts things
+	 * out under its protection.
+	 */
+	ctx->in_idle = 1;
+	ctx->stats.rx_idle_wakeups++;
+	rtdm_event_signal(&ctx->in_event);
+}
+
+/* Duration of a character on the line, including start/parity/stop bits. */
+static nanosecs_rel_t rt_16550_char_time(const struct rtser_config *config)
+{
+	int bits = 1 + 5 + config->data_bits + 1;
+
+	if (config->parity != RTSER_NO_PARITY)
+		bits++;
+	if (config->stop_bits)
+		bits++;
+
+	return div_u64(1000000000ULL * bits, config->baud_rate);
+}
+
 static inline void rt_16550_stat_interrupt(struct rt_16550_context *ctx)
 {
 	unsigned long base = ctx->base_addr;
@@ -245,11 +282,13 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 		if (iir == IIR_RX) {
 			rbytes += rt_16550_rx_interrupt(ctx, &timestamp);
 			events |= RTSER_EVENT_RXPEND;
+			ctx->stats.rx_irqs++;
 		} else if (iir == IIR_STAT)
 			rt_16550_stat_interrupt(ctx);
-		else if (iir == IIR_TX)
+		else if (iir == IIR_TX) {
 			rt_16550_tx_fill(ctx);
-		else if (iir == IIR_MODEM) {
+			ctx->stats.tx_irqs++;
+		} else if (iir == IIR_MODEM) {
 			modem = rt_16550_reg_in(mode, base, MSR);
 			if (modem & (modem << 4))
 				events |= RTSER_EVENT_MODEMHI;
@@ -260,13 +299,29 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 		ret = RTDM_IRQ_HANDLED;
 	}
 
+	if (ret == RTDM_IRQ_HANDLED)
+		ctx->stats.irqs++;
+	ctx->stats.rx_bytes += rbytes;
+
 	if (ctx->in_nwait > 0) {
 		if ((ctx->in_nwait <= rbytes) || ctx->status) {
 			ctx->in_nwait = 0;
+			ctx->stats.rx_wakeups++;
+			if (ctx->in_idle_ns)
+				rtdm_timer_stop(&ctx->in_idle_timer);
 			rtdm_event_signal(&ctx->in_event);
-		} else
+		} else {
 			ctx->in_nwait -= rbytes;
-	}
+			/* Restart the idle detection on each new burst. */
+			if (rbytes && ctx->in_idle_ns) {
+				ctx->in_last = rtdm_clock_read_monotonic();
+				rtdm_timer_start(&ctx->in_idle_timer,
+						 ctx->in_idle_ns, 0,
+						 RTDM_TIMERMODE_RELATIVE);
+			}
+		}
+	} else if (rbytes && ctx->in_idle_ns)
+		ctx->in_last = rtdm_clock_read_monotonic();
 
 	if (ctx->status) {
 		events |= RTSER_EVENT_ERRPEND;
@@ -349,6 +404,17 @@ static int rt_16550_set_config(struct rt_16550_context *ctx,
 				 FCR_FIFO | ctx->config.fifo_depth);
 	}
 
+	if (config->config_mask & RTSER_SET_RX_IDLE)
+		ctx->config.rx_idle = config->rx_idle;
+
+	if (config->config_mask & (RTSER_SET_RX_IDLE |
+				   RTSER_SET_PARITY |
+				   RTSER_SET_DATA_BITS |
+				   RTSER_SET_STOP_BITS |
+				   RTSER_SET_BAUD))
+		ctx->in_idle_ns = ctx->config.rx_idle * /* char times */
+			rt_16550_char_time(&ctx->config);
+
 	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 	/* Timeout manipulation is not atomic. The user is supposed to take
@@ -434,6 +500,7 @@ void rt_16550_cleanup_ctx(struct rt_16550_context *ctx)
 	rtdm_event_destroy(&ctx->out_event);
 	rtdm_event_destroy(&ctx->ioc_event);
 	rtdm_mutex_destroy(&ctx->out_lock);
+	rtdm_timer_destroy(&ctx->in_idle_timer);
 }
 
 int rt_16550_open(struct rtdm_fd *fd, int oflags)
@@ -452,6 +519,8 @@ int rt_16550_open(struct rtdm_fd *fd, int oflags)
 	rtdm_event_init(&ctx->out_event, 0);
 	rtdm_event_init(&ctx->ioc_event, 0);
 	rtdm_mutex_init(&ctx->out_lock);
+	rtdm_timer_init(&ctx->in_idle_timer, rt_16550_rx_idle,
+			rtdm_fd_device(fd)->name);
 
 	rt_16550_init_io_ctx(dev_id, ctx);
 
@@ -463,6 +532,9 @@ int rt_16550_open(struct rtdm_fd *fd, int oflags)
 	ctx->in_nwait = 0;
 	ctx->in_lock = 0;
 	ctx->in_history = NULL;
+	ctx->in_idle_ns = 0;
+	ctx->in_last = 0;
+	ctx->in_idle = 0;
 
 	ctx->out_head = 0;
 	ctx->out_tail = 0;
@@ -472,6 +544,7 @@ int rt_16550_open(struct rtdm_fd *fd, int oflags)
 	ctx->ioc_event_lock = 0;
 	ctx->status = 0;
 	ctx->saved_errors = 0;
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
 
 	rt_16550_set_config(ctx, &default_config, &dummy);
 
@@ -530,6 +603,7 @@ void rt_16550_close(struct rtdm_fd *fd)
 	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 	rtdm_irq_free(&ctx->irq_handle);
+	rtdm_timer_stop(&ctx->in_idle_timer);
 
 	rt_16550_cleanup_ctx(ctx);
 
@@ -587,6 +661,10 @@ int rt_16550_ioctl(struct rtdm_fd *fd, unsigned int request, void *arg)
 			/* invalid baudrate for this port */
 			return -EINVAL;
 
+		if ((config->config_mask & RTSER_SET_RX_IDLE) &&
+		    config->rx_idle < 0)
+			return -EINVAL;
+
 		if (config->config_mask & RTSER_SET_TIMESTAMP_HISTORY) {
 			/*
 			 * Reflect the call to non-RT as we will likely
@@ -745,6 +823,21 @@ int rt_16550_ioctl(struct rtdm_fd *fd, unsigned int request, void *arg)
 		break;
 	}
 
+	case RTSER_RTIOC_GET_STATS: {
+		struct rtser_stats stats;
+
+		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+		stats = ctx->stats;
+		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+		if (rtdm_fd_is_user(fd))
+			err = rtdm_safe_copy_to_user(fd, arg, &stats,
+						     sizeof(stats));
+		else
+			memcpy(arg, &stats, sizeof(stats));
+		break;
+	}
+
 	case RTIOC_PURGE: {
 		int fcr = 0;
 
@@ -812,6 +905,8 @@ ssize_t rt_16550_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 
 	rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 
+	ctx->in_idle = 0;
+
 	while (1) {
 		/* switch on error interrupt - the user is ready to listen */
 		if ((ctx->ier_status & IER_STAT) == 0) {
@@ -890,6 +985,9 @@ ssize_t rt_16550_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 			if (nbyte == 0)
 				break; /* All requested bytes read. */
 
+			if (ctx->in_idle)
+				break; /* Line went idle, return what we have. */
+
 			continue;
 		}
 
@@ -899,6 +997,20 @@ ssize_t rt_16550_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 			   returned by rtdm_event_wait[_until] */
 			break;
 
+		if (ctx->in_idle_ns && read > 0) {
+			nanosecs_rel_t idle = rtdm_clock_read_monotonic() -
+				ctx->in_last;
+			/*
+			 * We drained a partial block: wait for more
+			 * only until the line has been idle long enough.
+			 */
+			if (idle >= ctx->in_idle_ns)
+				break;
+			rtdm_timer_start(&ctx->in_idle_timer,
+					 ctx->in_idle_ns - idle, 0,
+					 RTDM_TIMERMODE_RELATIVE);
+		}
+
 		ctx->in_nwait = nbyte;
 
 		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
@@ -929,6 +1041,9 @@ ssize_t rt_16550_read(struct rtdm_fd *fd, void *buf, size_t nbyte)
 		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 	}
 
+	if (ctx->in_idle_ns)
+		rtdm_timer_stop(&ctx->in_idle_timer);
+
 	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 break_unlocked:
@@ -19,6 +19,7 @@
 #include <linux/module.h>
 #include <rtdm/driver.h>
 #include <rtdm/testing.h>
+#include <xenomai/posix/clock.h>
 
 MODULE_DESCRIPTION("RTDM test helper module");
 MODULE_AUTHOR("Jan Kiszka <jan.kiszka@web.de>");
@@ -41,6 +42,65 @@ struct rtdm_actor_context {
 	} args;
 };
 
+/*
+ * External clock ticking on the core counter, with an offset of its
+ * own. Only meant to be read and set, timers cannot be armed on it.
+ */
+static clockid_t test_clock_id;
+
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+
+static xnsticks_t test_clock_offset;
+
+static xnticks_t test_clock_read_monotonic(struct xnclock *clock)
+{
+	return xnclock_core_read_monotonic() + test_clock_offset;
+}
+
+static int test_clock_set_time(struct xnclock *clock,
+			       const struct timespec64 *ts)
+{
+	test_clock_offset = timespec64_to_ns(ts) -
+		xnclock_core_read_monotonic();
+
+	return 0;
+}
+
+static xnsticks_t test_clock_ns_to_ticks(struct xnclock *clock,
+					 xnsticks_t ns)
+{
+	return xnclock_core_ns_to_ticks(ns);
+}
+
+static xnsticks_t test_clock_ticks_to_ns(struct xnclock *clock,
+					 xnsticks_t ticks)
+{
+	return xnclock_core_ticks_to_ns(ticks);
+}
+
+static xnsticks_t test_clock_ticks_to_ns_rounded(struct xnclock *clock,
+						 xnsticks_t ticks)
+{
+	return xnclock_core_ticks_to_ns_rounded(ticks);
+}
+
+#endif /* CONFIG_XENO_OPT_EXTCLOCK */
+
+static struct xnclock test_clock = {
+	.name = "rtdmtest",
+	.resolution = 1,
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+	.ops = {
+		.read_raw = xnclock_core_read_cycles,
+		.read_monotonic = test_clock_read_monotonic,
+		.set_time = test_clock_set_time,
+		.ns_to_ticks = test_clock_ns_to_ticks,
+		.ticks_to_ns = test_clock_ticks_to_ns,
+		.ticks_to_ns_rounded = test_clock_ticks_to_ns_rounded,
+	},
+#endif
+};
+
 static void close_timer_proc(rtdm_timer_t *timer)
 {
 	struct rtdm_basic_context *ctx =
@@ -126,6 +186,10 @@ static int rtdm_basic_ioctl_nrt(struct rtdm_fd *fd,
 		ret = rtdm_safe_copy_to_user(fd, arg, &magic,
 					     sizeof(magic));
 		break;
+	case RTTST_RTIOC_RTDM_GET_EXTCLOCK:
+		ret = rtdm_safe_copy_to_user(fd, arg, &test_clock_id,
+					     sizeof(test_clock_id));
+		break;
 	default:
 		ret = -ENOTTY;
 	}
@@ -267,6 +331,10 @@ static int __init rtdm_test_init(void)
 {
 	int i, ret;
 
+	ret = cobalt_clock_register(&test_clock, NULL, &test_clock_id);
+	if (ret)
+		return ret;
+
 	for (i = 0; i < ARRAY_SIZE(device); i++) {
 		ret = rtdm_dev_register(device + i);
 		if (ret)
@@ -278,6 +346,8 @@ fail:
 	while (i-- > 0)
 		rtdm_dev_unregister(device + i);
 
+	cobalt_clock_deregister(&test_clock);
+
 	return ret;
 }
 
@@ -287,6 +357,8 @@ static void __exit rtdm_test_exit(void)
 
 	for (i = 0; i < ARRAY_SIZE(device); i++)
 		rtdm_dev_unregister(device + i);
+
+	cobalt_clock_deregister(&test_clock);
 }
 
 module_init(rtdm_test_init);
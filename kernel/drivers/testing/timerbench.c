@@ -18,9 +18,11 @@
 
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/semaphore.h>
 #include <cobalt/kernel/trace.h>
 #include <cobalt/kernel/arith.h>
+#include <cobalt/kernel/vfile.h>
 #include <rtdm/testing.h>
 #include <rtdm/driver.h>
 #include <rtdm/compat.h>
@@ -30,6 +32,13 @@ MODULE_AUTHOR("Jan Kiszka <jan.kiszka@web.de>");
 MODULE_VERSION("0.2.1");
 MODULE_LICENSE("GPL");
 
+/* Per-CPU latency distribution, updated by the sampling code. */
+struct rt_tmbench_hdr {
+	__s32 min;
+	__s32 max;
+	__u64 buckets[RTTST_HDR_BUCKETS];
+};
+
 struct rt_tmbench_context {
 	int mode;
 	unsigned int period;
@@ -53,9 +62,117 @@ struct rt_tmbench_context {
 	rtdm_event_t result_event;
 	struct rttst_interm_bench_res result;
 
+	struct rt_tmbench_hdr *hdr;	/* [nr_cpu_ids] */
+	struct list_head next;		/* in bench_list, if hdr != NULL */
+	pid_t pid;			/* process running the bench */
+
 	struct semaphore nrt_mutex;
 };
 
+/* Running benches, for the vfile. */
+static LIST_HEAD(bench_list);
+
+static DEFINE_MUTEX(bench_lock);
+
+static void reset_hdr(struct rt_tmbench_hdr *h)
+{
+	h->min = 10000000;
+	h->max = -10000000;
+	memset(h->buckets, 0, sizeof(h->buckets));
+}
+
+static int alloc_hdr(struct rt_tmbench_context *ctx)
+{
+	int cpu;
+
+	ctx->hdr = vmalloc(nr_cpu_ids * sizeof(*ctx->hdr));
+	if (ctx->hdr == NULL)
+		return -ENOMEM;
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++)
+		reset_hdr(ctx->hdr + cpu);
+
+	mutex_lock(&bench_lock);
+	list_add_tail(&ctx->next, &bench_list);
+	mutex_unlock(&bench_lock);
+
+	return 0;
+}
+
+static void free_hdr(struct rt_tmbench_context *ctx)
+{
+	if (ctx->hdr == NULL)
+		return;
+
+	mutex_lock(&bench_lock);
+	list_del(&ctx->next);
+	mutex_unlock(&bench_lock);
+
+	vfree(ctx->hdr);
+	ctx->hdr = NULL;
+}
+
+static inline void add_hdr(struct rt_tmbench_context *ctx, __s32 dt)
+{
+	struct rt_tmbench_hdr *h = ctx->hdr + raw_smp_processor_id();
+
+	h->buckets[rttst_hdr_index(dt)]++;
+	if (dt > h->max)
+		h->max = dt;
+	if (dt < h->min)
+		h->min = dt;
+}
+
+/*
+ * Snapshot the distribution of a CPU, or of all CPUs if cpu < 0. The
+ * sampling code keeps running meanwhile, so counts may be off by the
+ * few samples taken while we scan.
+ */
+static int get_hdr_stats(struct rt_tmbench_context *ctx,
+			 struct rttst_hdr_stats *stats)
+{
+	struct rt_tmbench_hdr *h, *merged;
+	int cpu, n;
+
+	if (stats->cpu >= (int)nr_cpu_ids || stats->cpu < -1)
+		return -EINVAL;
+
+	if (stats->cpu >= 0) {
+		h = ctx->hdr + stats->cpu;
+		stats->min = h->min;
+		stats->max = h->max;
+		rttst_hdr_fill_stats(stats, h->buckets);
+		if (stats->flags & RTTST_HDR_RESET)
+			reset_hdr(h);
+		return 0;
+	}
+
+	merged = vmalloc(sizeof(*merged));
+	if (merged == NULL)
+		return -ENOMEM;
+
+	reset_hdr(merged);
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+		h = ctx->hdr + cpu;
+		if (h->min < merged->min)
+			merged->min = h->min;
+		if (h->max > merged->max)
+			merged->max = h->max;
+		for (n = 0; n < RTTST_HDR_BUCKETS; n++)
+			merged->buckets[n] += h->buckets[n];
+		if (stats->flags & RTTST_HDR_RESET)
+			reset_hdr(h);
+	}
+
+	stats->min = merged->min;
+	stats->max = merged->max;
+	rttst_hdr_fill_stats(stats, merged->buckets);
+	vfree(merged);
+
+	return 0;
+}
+
 static inline void add_histogram(struct rt_tmbench_context *ctx,
 				 __s32 *histogram, __s32 addval)
 {
@@ -88,8 +205,11 @@ static void eval_inner_loop(struct rt_tmbench_context *ctx, __s32 dt)
 
 	ctx->date += ctx->period;
 
-	if (!ctx->warmup && ctx->histogram_size)
-		add_histogram(ctx, ctx->histogram_avg, dt);
+	if (!ctx->warmup) {
+		if (ctx->histogram_size)
+			add_histogram(ctx, ctx->histogram_avg, dt);
+		add_hdr(ctx, dt);
+	}
 
 	/* Evaluate overruns and adjust next release date.
 	   Beware of signedness! */
@@ -192,6 +312,7 @@ static int rt_tmbench_open(struct rtdm_fd *fd, int oflags)
 	ctx = rtdm_fd_to_private(fd);
 
 	ctx->mode = RTTST_TMBENCH_INVALID;
+	ctx->hdr = NULL;
 	sema_init(&ctx->nrt_mutex, 1);
 
 	return 0;
@@ -216,6 +337,8 @@ static void rt_tmbench_close(struct rtdm_fd *fd)
 		if (ctx->histogram_size)
 			kfree(ctx->histogram_min);
 
+		free_hdr(ctx);
+
 		ctx->mode = RTTST_TMBENCH_INVALID;
 		ctx->histogram_size = 0;
 	}
@@ -270,6 +393,15 @@ static int rt_tmbench_start(struct rtdm_fd *fd,
 		ctx->bucketsize = config->histogram_bucketsize;
 	}
 
+	ctx->pid = task_tgid_nr(current);
+	err = alloc_hdr(ctx);
+	if (err) {
+		if (ctx->histogram_size > 0)
+			kfree(ctx->histogram_min);
+		up(&ctx->nrt_mutex);
+		return err;
+	}
+
 	ctx->result.overall.min = 10000000;
 	ctx->result.overall.max = -10000000;
 	ctx->result.overall.avg = 0;
@@ -292,6 +424,8 @@ static int rt_tmbench_start(struct rtdm_fd *fd,
 				config->priority, 0);
 		if (!err)
 			ctx->mode = RTTST_TMBENCH_TASK;
+		else
+			free_hdr(ctx);
 	} else {
 		rtdm_timer_init(&ctx->timer, timer_proc,
 				rtdm_fd_device(fd)->name);
@@ -431,11 +565,49 @@ static int rt_tmbench_stop(struct rt_tmbench_context *ctx, void *u_res)
 	if (ctx->histogram_size > 0)
 		kfree(ctx->histogram_min);
 
+	free_hdr(ctx);
+
 	up(&ctx->nrt_mutex);
 
 	return ret;
 }
 
+static int rt_tmbench_get_hdr(struct rtdm_fd *fd,
+			      struct rt_tmbench_context *ctx,
+			      void __user *arg)
+{
+	struct rttst_hdr_stats stats;
+	int ret;
+
+	if (rtdm_fd_is_user(fd)) {
+		ret = rtdm_safe_copy_from_user(fd, &stats, arg, sizeof(stats));
+		if (ret)
+			return ret;
+	} else
+		memcpy(&stats, arg, sizeof(stats));
+
+	down(&ctx->nrt_mutex);
+
+	if (ctx->mode < 0 || ctx->hdr == NULL) {
+		up(&ctx->nrt_mutex);
+		return -EINVAL;
+	}
+
+	ret = get_hdr_stats(ctx, &stats);
+
+	up(&ctx->nrt_mutex);
+
+	if (ret)
+		return ret;
+
+	if (rtdm_fd_is_user(fd))
+		return rtdm_safe_copy_to_user(fd, arg, &stats, sizeof(stats));
+
+	memcpy(arg, &stats, sizeof(stats));
+
+	return 0;
+}
+
 static int rt_tmbench_ioctl_nrt(struct rtdm_fd *fd,
 				unsigned int request, void __user *arg)
 {
@@ -452,6 +624,10 @@ static int rt_tmbench_ioctl_nrt(struct rtdm_fd *fd,
 	COMPAT_CASE(RTTST_RTIOC_TMBENCH_STOP):
 		err = rt_tmbench_stop(ctx, arg);
 		break;
+
+	case RTTST_RTIOC_TMBENCH_HDR:
+		err = rt_tmbench_get_hdr(fd, ctx, arg);
+		break;
 	default:
 		err = -ENOSYS;
 	}
@@ -515,13 +691,77 @@ static struct rtdm_device device = {
 	.label = "timerbench",
 };
 
+#ifdef CONFIG_XENO_OPT_VFILE
+
+static int timerbench_vfile_show(struct xnvfile_regular_iterator *it,
+				 void *data)
+{
+	struct rt_tmbench_context *ctx;
+	struct rttst_hdr_stats stats;
+	struct rt_tmbench_hdr *h;
+	int cpu;
+
+	xnvfile_printf(it, "%-5s %-4s %12s %9s %9s %9s %9s %9s %9s %9s\n",
+		       "PID", "CPU", "SAMPLES", "MIN", "P50", "P99",
+		       "P99.9", "P99.99", "P99.999", "MAX");
+
+	mutex_lock(&bench_lock);
+
+	list_for_each_entry(ctx, &bench_list, next) {
+		for (cpu = 0; cpu < nr_cpu_ids; cpu++) {
+			h = ctx->hdr + cpu;
+			stats.min = h->min;
+			stats.max = h->max;
+			rttst_hdr_fill_stats(&stats, h->buckets);
+			if (stats.samples == 0)
+				continue;
+			xnvfile_printf(it, "%-5d %-4d %12llu %9d %9d %9d "
+				       "%9d %9d %9d %9d\n",
+				       ctx->pid, cpu,
+				       stats.samples, stats.min, stats.p50,
+				       stats.p99, stats.p999, stats.p9999,
+				       stats.p99999, stats.max);
+		}
+	}
+
+	mutex_unlock(&bench_lock);
+
+	return 0;
+}
+
+static struct xnvfile_regular_ops timerbench_vfile_ops = {
+	.show = timerbench_vfile_show,
+};
+
+static struct xnvfile_regular timerbench_vfile = {
+	.ops = &timerbench_vfile_ops,
+};
+
+#endif /* CONFIG_XENO_OPT_VFILE */
+
 static int __init __timerbench_init(void)
 {
-	return rtdm_dev_register(&device);
+	int ret;
+
+	ret = rtdm_dev_register(&device);
+	if (ret)
+		return ret;
+
+#ifdef CONFIG_XENO_OPT_VFILE
+	ret = xnvfile_init_regular("timerbench", &timerbench_vfile,
+				   &cobalt_vfroot);
+	if (ret)
+		rtdm_dev_unregister(&device);
+#endif
+
+	return ret;
 }
 
 static void __timerbench_exit(void)
 {
+#ifdef CONFIG_XENO_OPT_VFILE
+	xnvfile_destroy_regular(&timerbench_vfile);
+#endif
 	rtdm_dev_unregister(&device);
 }
 
@@ -16,6 +16,7 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "boilerplate/lock.h"
@@ -23,27 +24,42 @@
 #include "boilerplate/debug.h"
 
 /*
- * Crunching routine borrowed from:
- *
- * lookup2.c, by Bob Jenkins, December 1996, Public Domain.
- * hash(), hash2(), hash3, and mix() are externally useful functions.
- * Routines to test the hash are included if SELF_TEST is defined.
- * You can use this free for any purpose.  It has no warranty.
+ * Crunching routine derived from MurmurHash3 (x86_32 variant), by
+ * Austin Appleby, placed in the public domain. Compared to the
+ * lookup2 mixer we used previously, it processes the key four bytes
+ * at a time and has much better avalanche properties, which matters
+ * now that the low bits of the hash index tables of varying sizes.
  */
 
-#define __mixer(a, b, c) \
-	{					\
-	a -= b; a -= c; a ^= (c>>13);		\
-	b -= c; b -= a; b ^= (a<<8);		\
-	c -= a; c -= b; c ^= (b>>13);		\
-	a -= b; a -= c; a ^= (c>>12);		\
-	b -= c; b -= a; b ^= (a<<16);		\
-	c -= a; c -= b; c ^= (b>>5);		\
-	a -= b; a -= c; a ^= (c>>3);		\
-	b -= c; b -= a; b ^= (a<<10);		\
-	c -= a; c -= b; c ^= (b>>15);		\
+#define HASH_C1  0xcc9e2d51
+#define HASH_C2  0x1b873593
+
+static inline unsigned int rotl32(unsigned int x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline unsigned int scramble(unsigned int k)
+{
+	k *= HASH_C1;
+	k = rotl32(k, 15);
+	k *= HASH_C2;
+
+	return k;
 }
 
+/*
+ * Grow the table when the average chain length exceeds
+ * HASH_GROW_LOAD, shrink it when less than 1/HASH_SHRINK_RATIO of the
+ * slots would be used, never going below the initial size. Each
+ * update drains HASH_MIGRATE_STEP slots from the former array while
+ * a resize is in progress, which is enough to complete a migration
+ * before the next one can be triggered.
+ */
+#define HASH_GROW_LOAD		1
+#define HASH_SHRINK_RATIO	8
+#define HASH_MIGRATE_STEP	4
+
 static inline int store_key(struct hashobj *obj,
 			    const void *key, size_t len,
 			    const struct hash_operations *hops);
@@ -51,53 +67,77 @@ static inline int store_key(struct hashobj *obj,
 static inline void drop_key(struct hashobj *obj,
 			    const struct hash_operations *hops);
 
-#define GOLDEN_HASH_RATIO  0x9e3779b9  /* Arbitrary value. */
+static inline struct hash_bucket *
+alloc_slots(size_t size, const struct hash_operations *hops);
+
+static inline void free_slots(struct hash_bucket *slots,
+			      const struct hash_operations *hops);
 
 unsigned int __hash_key(const void *key, size_t length, unsigned int c)
 {
 	const unsigned char *k = key;
-	unsigned int a, b, len;
+	unsigned int h = c, b, len;
 
 	len = (unsigned int)length;
-	a = b = GOLDEN_HASH_RATIO;
-
-	while (len >= 12) {
-		a += (k[0] +((unsigned int)k[1]<<8) +((unsigned int)k[2]<<16) +((unsigned int)k[3]<<24));
-		b += (k[4] +((unsigned int)k[5]<<8) +((unsigned int)k[6]<<16) +((unsigned int)k[7]<<24));
-		c += (k[8] +((unsigned int)k[9]<<8) +((unsigned int)k[10]<<16)+((unsigned int)k[11]<<24));
-		__mixer(a, b, c);
-		k += 12;
-		len -= 12;
+
+	while (len >= 4) {
+		memcpy(&b, k, sizeof(b));
+		h ^= scramble(b);
+		h = rotl32(h, 13);
+		h = h * 5 + 0xe6546b64;
+		k += 4;
+		len -= 4;
 	}
 
-	c += (unsigned int)length;
+	b = 0;
 
 	switch (len) {
-	case 11: c += ((unsigned int)k[10]<<24);
-	case 10: c += ((unsigned int)k[9]<<16);
-	case 9 : c += ((unsigned int)k[8]<<8);
-	case 8 : b += ((unsigned int)k[7]<<24);
-	case 7 : b += ((unsigned int)k[6]<<16);
-	case 6 : b += ((unsigned int)k[5]<<8);
-	case 5 : b += k[4];
-	case 4 : a += ((unsigned int)k[3]<<24);
-	case 3 : a += ((unsigned int)k[2]<<16);
-	case 2 : a += ((unsigned int)k[1]<<8);
-	case 1 : a += k[0];
+	case 3: b ^= (unsigned int)k[2] << 16;
+		/* fallthrough */
+	case 2: b ^= (unsigned int)k[1] << 8;
+		/* fallthrough */
+	case 1: b ^= k[0];
+		h ^= scramble(b);
 	};
 
-	__mixer(a, b, c);
+	h ^= (unsigned int)length;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
 
-	return c;
+	return h;
 }
 
-void __hash_init(void *heap, struct hash_table *t)
+static unsigned int round_slots(unsigned int size)
+{
+	unsigned int n = 1;
+
+	while (n < size && n < (1U << 31))
+		n <<= 1;
+
+	return n;
+}
+
+void __hash_init_size(void *heap, struct hash_table *t,
+		      unsigned int size)
 {
 	pthread_mutexattr_t mattr;
-	int n;
 
-	for (n = 0; n < HASHSLOTS; n++)
-		__list_init(heap, &t->table[n].obj_list);
+	/*
+	 * Slots are allocated from the heap the keys live in, upon
+	 * first insertion (see grab_slots()), since we cannot assume
+	 * that @heap is ready for serving allocations yet.
+	 */
+	t->table = __moff_nullable(NULL);
+	t->old_table = __moff_nullable(NULL);
+	t->size = 0;
+	t->old_size = 0;
+	t->migrated = 0;
+	t->init_size = round_slots(size);
+	t->count = 0;
+	t->walkers = 0;
 
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
@@ -107,16 +147,148 @@ void __hash_init(void *heap, struct hash_table *t)
 	pthread_mutexattr_destroy(&mattr);
 }
 
-void hash_destroy(struct hash_table *t)
+static struct hash_bucket *get_slots(unsigned int size,
+				     const struct hash_operations *hops)
 {
-	__RT(pthread_mutex_destroy(&t->lock));
+	struct hash_bucket *slots;
+	unsigned int n;
+
+	slots = alloc_slots(size * sizeof(*slots), hops);
+	if (slots == NULL)
+		return NULL;
+
+	for (n = 0; n < size; n++)
+		list_init(&slots[n].obj_list);
+
+	return slots;
 }
 
+static int grab_slots(struct hash_table *t,
+		      const struct hash_operations *hops)
+{
+	struct hash_bucket *slots;
+
+	if (__mptr_nullable(t->table))
+		return 0;
+
+	slots = get_slots(t->init_size, hops);
+	if (slots == NULL)
+		return -ENOMEM;
+
+	t->table = __moff(slots);
+	t->size = t->init_size;
+
+	return 0;
+}
+
+/*
+ * An object lives in the former array until the slot it hashes to
+ * has been migrated, in the current one otherwise. New objects
+ * follow the same rule, so that any key is looked for in a single
+ * bucket.
+ */
 static struct hash_bucket *do_hash(struct hash_table *t,
-				   const void *key, size_t len)
+				   unsigned int hash)
 {
-	unsigned int hash = __hash_key(key, len, 0);
-	return &t->table[hash & (HASHSLOTS-1)];
+	struct hash_bucket *slots;
+	unsigned int n;
+
+	slots = __mptr_nullable(t->old_table);
+	if (slots) {
+		n = hash & (t->old_size - 1);
+		if (n >= t->migrated)
+			return &slots[n];
+	}
+
+	slots = __mptr_nullable(t->table);
+	if (slots == NULL)
+		return NULL;
+
+	return &slots[hash & (t->size - 1)];
+}
+
+static void migrate_slots(struct hash_table *t,
+			  const struct hash_operations *hops)
+{
+	struct hash_bucket *old_slots, *slots, *bucket;
+	struct hashobj *obj, *tmp;
+	int n;
+
+	old_slots = __mptr_nullable(t->old_table);
+	if (old_slots == NULL)
+		return;
+
+	slots = __mptr(t->table);
+
+	for (n = 0; n < HASH_MIGRATE_STEP && t->migrated < t->old_size; n++) {
+		bucket = &old_slots[t->migrated++];
+		if (list_empty(&bucket->obj_list))
+			continue;
+		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
+			list_remove(&obj->link);
+			list_append(&obj->link,
+				    &slots[obj->hash & (t->size - 1)].obj_list);
+		}
+	}
+
+	if (t->migrated == t->old_size) {
+		free_slots(old_slots, hops);
+		t->old_table = __moff_nullable(NULL);
+		t->old_size = 0;
+	}
+}
+
+static void resize_table(struct hash_table *t,
+			 const struct hash_operations *hops)
+{
+	struct hash_bucket *slots;
+	unsigned int size;
+
+	/*
+	 * Walkers drop the lock while running their handler, so the
+	 * slot arrays must stay put until they are done.
+	 */
+	if (t->walkers)
+		return;
+
+	if (__mptr_nullable(t->old_table)) {
+		migrate_slots(t, hops);
+		return;
+	}
+
+	if (t->count > t->size * HASH_GROW_LOAD && t->size < (1U << 31))
+		size = t->size << 1;
+	else if (t->size > t->init_size &&
+		 t->count < t->size / HASH_SHRINK_RATIO)
+		size = t->size >> 1;
+	else
+		return;
+
+	/* Keep going with the current array if we are short of memory. */
+	slots = get_slots(size, hops);
+	if (slots == NULL)
+		return;
+
+	t->old_table = t->table;
+	t->old_size = t->size;
+	t->migrated = 0;
+	t->table = __moff(slots);
+	t->size = size;
+	migrate_slots(t, hops);
+}
+
+/*
+ * Shared slots come from the allocator passed in the hash operations,
+ * which we don't know about at this point. This is a non-issue since
+ * shared tables are never deleted once populated.
+ */
+void hash_destroy(struct hash_table *t)
+{
+	__RT(pthread_mutex_destroy(&t->lock));
+#ifndef CONFIG_XENO_PSHARED
+	free_slots(t->old_table, NULL);
+	free_slots(t->table, NULL);
+#endif
 }
 
 int __hash_enter(struct hash_table *t,
@@ -134,12 +306,21 @@ int __hash_enter(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
+	newobj->hash = __hash_key(key, len, 0);
 	write_lock_nocancel(&t->lock);
 
+	ret = grab_slots(t, hops);
+	if (ret) {
+		drop_key(newobj, hops);
+		goto out;
+	}
+
+	bucket = do_hash(t, newobj->hash);
+
 	if (nodup && !list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(__mptr(obj->key), __mptr(newobj->key),
 					  obj->len) == 0) {
@@ -151,6 +332,8 @@ int __hash_enter(struct hash_table *t,
 	}
 
 	list_append(&newobj->link, &bucket->obj_list);
+	t->count++;
+	resize_table(t, hops);
 out:
 	write_unlock(&t->lock);
 
@@ -164,15 +347,16 @@ int hash_remove(struct hash_table *t, struct hashobj *delobj,
 	struct hashobj *obj;
 	int ret = -ESRCH;
 
-	bucket = do_hash(t, __mptr(delobj->key), delobj->len);
-
 	write_lock_nocancel(&t->lock);
 
-	if (!list_empty(&bucket->obj_list)) {
+	bucket = do_hash(t, delobj->hash);
+	if (bucket && !list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
 			if (obj == delobj) {
 				list_remove_init(&obj->link);
 				drop_key(obj, hops);
+				t->count--;
+				resize_table(t, hops);
 				ret = 0;
 				goto out;
 			}
@@ -189,14 +373,16 @@ struct hashobj *hash_search(struct hash_table *t, const void *key,
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj;
+	unsigned int hash;
 
-	bucket = do_hash(t, key, len);
+	hash = __hash_key(key, len, 0);
 
 	read_lock_nocancel(&t->lock);
 
-	if (!list_empty(&bucket->obj_list)) {
+	bucket = do_hash(t, hash);
+	if (bucket && !list_empty(&bucket->obj_list)) {
 		list_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(__mptr(obj->key), key, len) == 0)
 				goto out;
@@ -209,30 +395,52 @@ out:
 	return obj;
 }
 
-int hash_walk(struct hash_table *t, hash_walk_op walk, void *arg)
+static int walk_slots(struct hash_table *t, struct hash_bucket *slots,
+		      unsigned int size, hash_walk_op walk, void *arg)
 {
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
-	int ret, n;
-
-	read_lock_nocancel(&t->lock);
+	unsigned int n;
+	int ret;
 
-	for (n = 0; n < HASHSLOTS; n++) {
-		bucket = &t->table[n];
+	for (n = 0; n < size; n++) {
+		bucket = &slots[n];
 		if (list_empty(&bucket->obj_list))
 			continue;
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
 			read_unlock(&t->lock);
 			ret = walk(t, obj, arg);
-			if (ret)
-				return __bt(ret);
 			read_lock_nocancel(&t->lock);
+			if (ret)
+				return ret;
 		}
 	}
 
+	return 0;
+}
+
+int hash_walk(struct hash_table *t, hash_walk_op walk, void *arg)
+{
+	struct hash_bucket *slots;
+	int ret = 0;
+
+	read_lock_nocancel(&t->lock);
+
+	t->walkers++;
+
+	slots = __mptr_nullable(t->old_table);
+	if (slots)
+		ret = walk_slots(t, slots, t->old_size, walk, arg);
+
+	slots = __mptr_nullable(t->table);
+	if (ret == 0 && slots)
+		ret = walk_slots(t, slots, t->size, walk, arg);
+
+	t->walkers--;
+
 	read_unlock(&t->lock);
 
-	return 0;
+	return __bt(ret);
 }
 
 #ifdef CONFIG_XENO_PSHARED
@@ -269,6 +477,24 @@ static inline void drop_key(struct hashobj *obj,
 		hops->free((void *)key);
 }
 
+static inline struct hash_bucket *
+alloc_slots(size_t size, const struct hash_operations *hops)
+{
+	void *p;
+
+	p = hops->alloc(size);
+	if (p)
+		assert(__mchk(p));
+
+	return p;
+}
+
+static inline void free_slots(struct hash_bucket *slots,
+			      const struct hash_operations *hops)
+{
+	hops->free(slots);
+}
+
 int __hash_enter_probe(struct hash_table *t,
 		       const void *key, size_t len,
 		       struct hashobj *newobj,
@@ -285,13 +511,22 @@ int __hash_enter_probe(struct hash_table *t,
 	if (ret)
 		return ret;
 
-	bucket = do_hash(t, key, len);
+	newobj->hash = __hash_key(key, len, 0);
 	CANCEL_DEFER(svc);
 	write_lock(&t->lock);
 
+	ret = grab_slots(t, hops);
+	if (ret) {
+		drop_key(newobj, hops);
+		goto out;
+	}
+
+	bucket = do_hash(t, newobj->hash);
+
 	if (!list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(__mptr(obj->key),
 					  __mptr(newobj->key), obj->len) == 0) {
@@ -305,11 +540,14 @@ int __hash_enter_probe(struct hash_table *t,
 				}
 				list_remove_init(&obj->link);
 				drop_key(obj, hops);
+				t->count--;
 			}
 		}
 	}
 
 	list_append(&newobj->link, &bucket->obj_list);
+	t->count++;
+	resize_table(t, hops);
 out:
 	write_unlock(&t->lock);
 	CANCEL_RESTORE(svc);
@@ -324,20 +562,25 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 	struct hash_bucket *bucket;
 	struct hashobj *obj, *tmp;
 	struct service svc;
+	unsigned int hash;
+	int pruned = 0;
 
-	bucket = do_hash(t, key, len);
+	hash = __hash_key(key, len, 0);
 
 	CANCEL_DEFER(svc);
 	write_lock(&t->lock);
 
-	if (!list_empty(&bucket->obj_list)) {
+	bucket = do_hash(t, hash);
+	if (bucket && !list_empty(&bucket->obj_list)) {
 		list_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(__mptr(obj->key), key, len) == 0) {
 				if (!hops->probe(obj)) {
 					list_remove_init(&obj->link);
 					drop_key(obj, hops);
+					t->count--;
+					pruned = 1;
 					continue;
 				}
 				goto out;
@@ -346,19 +589,28 @@ struct hashobj *hash_search_probe(struct hash_table *t,
 	}
 	obj = NULL;
 out:
+	/* Not before we are done with the bucket, it may move. */
+	if (pruned)
+		resize_table(t, hops);
+
 	write_unlock(&t->lock);
 	CANCEL_RESTORE(svc);
 
 	return obj;
 }
 
-void pvhash_init(struct pvhash_table *t)
+void pvhash_init_size(struct pvhash_table *t, unsigned int size)
 {
 	pthread_mutexattr_t mattr;
-	int n;
 
-	for (n = 0; n < HASHSLOTS; n++)
-		pvlist_init(&t->table[n].obj_list);
+	t->table = NULL;
+	t->old_table = NULL;
+	t->size = 0;
+	t->old_size = 0;
+	t->migrated = 0;
+	t->init_size = round_slots(size);
+	t->count = 0;
+	t->walkers = 0;
 
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, mutex_type_attribute);
@@ -368,11 +620,117 @@ void pvhash_init(struct pvhash_table *t)
 	pthread_mutexattr_destroy(&mattr);
 }
 
+void pvhash_destroy(struct pvhash_table *t)
+{
+	__RT(pthread_mutex_destroy(&t->lock));
+	free(t->old_table);
+	free(t->table);
+}
+
+static struct pvhash_bucket *get_pvslots(unsigned int size)
+{
+	struct pvhash_bucket *slots;
+	unsigned int n;
+
+	slots = malloc(size * sizeof(*slots));
+	if (slots == NULL)
+		return NULL;
+
+	for (n = 0; n < size; n++)
+		pvlist_init(&slots[n].obj_list);
+
+	return slots;
+}
+
+static int grab_pvslots(struct pvhash_table *t)
+{
+	if (t->table)
+		return 0;
+
+	t->table = get_pvslots(t->init_size);
+	if (t->table == NULL)
+		return -ENOMEM;
+
+	t->size = t->init_size;
+
+	return 0;
+}
+
 static struct pvhash_bucket *do_pvhash(struct pvhash_table *t,
-				       const void *key, size_t len)
+				       unsigned int hash)
 {
-	unsigned int hash = __hash_key(key, len, 0);
-	return &t->table[hash & (HASHSLOTS-1)];
+	unsigned int n;
+
+	if (t->old_table) {
+		n = hash & (t->old_size - 1);
+		if (n >= t->migrated)
+			return &t->old_table[n];
+	}
+
+	if (t->table == NULL)
+		return NULL;
+
+	return &t->table[hash & (t->size - 1)];
+}
+
+static void migrate_pvslots(struct pvhash_table *t)
+{
+	struct pvhash_bucket *bucket;
+	struct pvhashobj *obj, *tmp;
+	int n;
+
+	if (t->old_table == NULL)
+		return;
+
+	for (n = 0; n < HASH_MIGRATE_STEP && t->migrated < t->old_size; n++) {
+		bucket = &t->old_table[t->migrated++];
+		if (pvlist_empty(&bucket->obj_list))
+			continue;
+		pvlist_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
+			pvlist_remove(&obj->link);
+			pvlist_append(&obj->link,
+				      &t->table[obj->hash & (t->size - 1)].obj_list);
+		}
+	}
+
+	if (t->migrated == t->old_size) {
+		free(t->old_table);
+		t->old_table = NULL;
+		t->old_size = 0;
+	}
+}
+
+static void resize_pvtable(struct pvhash_table *t)
+{
+	struct pvhash_bucket *slots;
+	unsigned int size;
+
+	if (t->walkers)
+		return;
+
+	if (t->old_table) {
+		migrate_pvslots(t);
+		return;
+	}
+
+	if (t->count > t->size * HASH_GROW_LOAD && t->size < (1U << 31))
+		size = t->size << 1;
+	else if (t->size > t->init_size &&
+		 t->count < t->size / HASH_SHRINK_RATIO)
+		size = t->size >> 1;
+	else
+		return;
+
+	slots = get_pvslots(size);
+	if (slots == NULL)
+		return;
+
+	t->old_table = t->table;
+	t->old_size = t->size;
+	t->migrated = 0;
+	t->table = slots;
+	t->size = size;
+	migrate_pvslots(t);
 }
 
 int __pvhash_enter(struct pvhash_table *t,
@@ -383,18 +741,25 @@ int __pvhash_enter(struct pvhash_table *t,
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj;
-	int ret = 0;
+	int ret;
 
 	pvholder_init(&newobj->link);
 	newobj->key = key;
 	newobj->len = len;
-	bucket = do_pvhash(t, key, len);
+	newobj->hash = __hash_key(key, len, 0);
 
 	write_lock_nocancel(&t->lock);
 
+	ret = grab_pvslots(t);
+	if (ret)
+		goto out;
+
+	bucket = do_pvhash(t, newobj->hash);
+
 	if (nodup && !pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != newobj->len)
+			if (obj->hash != newobj->hash ||
+			    obj->len != newobj->len)
 				continue;
 			if (hops->compare(obj->key, newobj->key, len) == 0) {
 				ret = -EEXIST;
@@ -404,6 +769,8 @@ int __pvhash_enter(struct pvhash_table *t,
 	}
 
 	pvlist_append(&newobj->link, &bucket->obj_list);
+	t->count++;
+	resize_pvtable(t);
 out:
 	write_unlock(&t->lock);
 
@@ -417,14 +784,15 @@ int pvhash_remove(struct pvhash_table *t, struct pvhashobj *delobj,
 	struct pvhashobj *obj;
 	int ret = -ESRCH;
 
-	bucket = do_pvhash(t, delobj->key, delobj->len);
-
 	write_lock_nocancel(&t->lock);
 
-	if (!pvlist_empty(&bucket->obj_list)) {
+	bucket = do_pvhash(t, delobj->hash);
+	if (bucket && !pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
 			if (obj == delobj) {
 				pvlist_remove_init(&obj->link);
+				t->count--;
+				resize_pvtable(t);
 				ret = 0;
 				goto out;
 			}
@@ -442,14 +810,16 @@ struct pvhashobj *pvhash_search(struct pvhash_table *t,
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj;
+	unsigned int hash;
 
-	bucket = do_pvhash(t, key, len);
+	hash = __hash_key(key, len, 0);
 
 	read_lock_nocancel(&t->lock);
 
-	if (!pvlist_empty(&bucket->obj_list)) {
+	bucket = do_pvhash(t, hash);
+	if (bucket && !pvlist_empty(&bucket->obj_list)) {
 		pvlist_for_each_entry(obj, &bucket->obj_list, link) {
-			if (obj->len != len)
+			if (obj->hash != hash || obj->len != len)
 				continue;
 			if (hops->compare(obj->key, key, len) == 0)
 				goto out;
@@ -462,30 +832,49 @@ out:
 	return obj;
 }
 
-int pvhash_walk(struct pvhash_table *t,	pvhash_walk_op walk, void *arg)
+static int walk_pvslots(struct pvhash_table *t, struct pvhash_bucket *slots,
+			unsigned int size, pvhash_walk_op walk, void *arg)
 {
 	struct pvhash_bucket *bucket;
 	struct pvhashobj *obj, *tmp;
-	int ret, n;
-
-	read_lock_nocancel(&t->lock);
+	unsigned int n;
+	int ret;
 
-	for (n = 0; n < HASHSLOTS; n++) {
-		bucket = &t->table[n];
+	for (n = 0; n < size; n++) {
+		bucket = &slots[n];
 		if (pvlist_empty(&bucket->obj_list))
 			continue;
 		pvlist_for_each_entry_safe(obj, tmp, &bucket->obj_list, link) {
 			read_unlock(&t->lock);
 			ret = walk(t, obj, arg);
-			if (ret)
-				return __bt(ret);
 			read_lock_nocancel(&t->lock);
+			if (ret)
+				return ret;
 		}
 	}
 
+	return 0;
+}
+
+int pvhash_walk(struct pvhash_table *t,	pvhash_walk_op walk, void *arg)
+{
+	int ret = 0;
+
+	read_lock_nocancel(&t->lock);
+
+	t->walkers++;
+
+	if (t->old_table)
+		ret = walk_pvslots(t, t->old_table, t->old_size, walk, arg);
+
+	if (ret == 0 && t->table)
+		ret = walk_pvslots(t, t->table, t->size, walk, arg);
+
+	t->walkers--;
+
 	read_unlock(&t->lock);
 
-	return 0;
+	return __bt(ret);
 }
 
 #else /* !CONFIG_XENO_PSHARED */
@@ -504,4 +893,16 @@ static inline void drop_key(struct hashobj *obj,
 			    const struct hash_operations *hops)
 { }
 
+static inline struct hash_bucket *
+alloc_slots(size_t size, const struct hash_operations *hops)
+{
+	return malloc(size);
+}
+
+static inline void free_slots(struct hash_bucket *slots,
+			      const struct hash_operations *hops)
+{
+	free(slots);
+}
+
 #endif /* !CONFIG_XENO_PSHARED */
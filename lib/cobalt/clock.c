@@ -27,6 +27,7 @@
 #include <time.h>
 #include <sys/time.h>
 #include <cobalt/uapi/time.h>
+#include <cobalt/arith.h>
 #include <cobalt/ticks.h>
 #include <asm/xenomai/syscall.h>
 #include <asm/xenomai/tsc.h>
@@ -118,6 +119,20 @@ static int __do_clock_host_realtime(struct timespec *ts)
 	unsigned long rem;
 	urwstate_t tmp;
 
+	if (xnvdso_test_feature(cobalt_vdso, XNVDSO_FEAT_HOST_VDSO)) {
+		/*
+		 * Dovetail: the common vDSO may be called from the
+		 * out-of-band stage, but it issues a regular syscall
+		 * when the host clocksource cannot be read from user
+		 * space, which would relax us. There is no telling
+		 * beforehand, so leave primary mode callers to the
+		 * Cobalt syscall, which reads the host clock safely.
+		 */
+		if (!cobalt_is_relaxed())
+			return -1;
+		return __STD(clock_gettime(CLOCK_REALTIME, ts)) ? -1 : 0;
+	}
+
 	if (!xnvdso_test_feature(cobalt_vdso, XNVDSO_FEAT_HOST_REALTIME))
 		return -1;
 
@@ -149,6 +164,46 @@ static int __do_clock_host_realtime(struct timespec *ts)
 	return 0;
 }
 
+static int __do_clock_ext(clockid_t clock_id, struct timespec *ts)
+{
+	uint64_t now, base, mask, cycle_delta, nsec;
+	struct xnvdso_clock_data *data;
+	uint32_t mult, shift, live;
+	unsigned long rem;
+	urwstate_t tmp;
+
+	if (!__COBALT_CLOCK_EXT_P(clock_id) ||
+	    !xnvdso_test_feature(cobalt_vdso, XNVDSO_FEAT_EXT_CLOCKS))
+		return -1;
+
+	data = &cobalt_vdso->ext_clocks[__COBALT_CLOCK_EXT_INDEX(clock_id)];
+
+	unsynced_read_block(&tmp, &data->lock) {
+		live = data->live;
+		now = cobalt_read_tsc();
+		base = data->base_cycles;
+		mask = data->mask;
+		mult = data->mult;
+		shift = data->shift;
+		nsec = data->base_ns;
+	}
+
+	if (!live)
+		return -1;
+
+	/*
+	 * Clocks published by the core are never refreshed unless
+	 * set, so the product may not fit in 64 bits.
+	 */
+	cycle_delta = (now - base) & mask;
+	nsec += xnarch_llmulshft(cycle_delta, mult, shift);
+
+	ts->tv_sec = cobalt_divrem_billion(nsec, &rem);
+	ts->tv_nsec = rem;
+
+	return 0;
+}
+
 /**
  * Read the specified clock.
  *
@@ -162,9 +217,15 @@ static int __do_clock_host_realtime(struct timespec *ts)
  * - CLOCK_HOST_REALTIME, the clock value as seen by the host, typically
  *   Linux. Resolution and precision depend on the host, but it is guaranteed
  *   that both, host and Cobalt, see the same information.
+ * - the identifier of an external clock, the clock value as maintained
+ *   by its driver.
+ *
+ * None of these clocks requires a syscall, provided the Cobalt core
+ * publishes the conversion parameters of @a clock_id in the vDSO
+ * (for external clocks, this depends on the driver).
  *
  * @param clock_id clock identifier, either CLOCK_REALTIME, CLOCK_MONOTONIC,
- *        or CLOCK_HOST_REALTIME;
+ *        CLOCK_HOST_REALTIME or an external clock identifier;
  *
  * @param tp the address where the value of the specified clock will be stored.
  *
@@ -186,7 +247,9 @@ COBALT_IMPL(int, clock_gettime, (clockid_t clock_id, struct timespec *tp))
 
 	switch (clock_id) {
 	case CLOCK_HOST_REALTIME:
-		ret = __do_clock_host_realtime(tp);
+		if (__do_clock_host_realtime(tp) == 0)
+			return 0;
+		ret = -XENOMAI_SYSCALL2(sc_cobalt_clock_gettime, clock_id, tp);
 		break;
 	case CLOCK_MONOTONIC:
 	case CLOCK_MONOTONIC_RAW:
@@ -201,6 +264,8 @@ COBALT_IMPL(int, clock_gettime, (clockid_t clock_id, struct timespec *tp))
 		tp->tv_nsec = rem;
 		return 0;
 	default:
+		if (__do_clock_ext(clock_id, tp) == 0)
+			return 0;
 		ret = -XENOMAI_SYSCALL2(sc_cobalt_clock_gettime, clock_id, tp);
 	}
 
@@ -123,6 +123,11 @@ static const struct option cobalt_options[] = {
 		.name = "print-sync-delay",
 		.has_arg = required_argument,
 	},
+	{
+#define print_percpu_opt	4
+		.name = "print-percpu-size",
+		.has_arg = required_argument,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -343,6 +348,12 @@ static int cobalt_parse_option(int optnum, const char *optarg)
 			return ret;
 		__cobalt_print_syncdelay = value;
 		break;
+	case print_percpu_opt:
+		ret = get_int_arg("--print-percpu-size", optarg, &value, 0);
+		if (ret)
+			return ret;
+		__cobalt_print_percpu_bufsz = value;
+		break;
 	default:
 		/* Paranoid, can't happen. */
 		return -EINVAL;
@@ -357,6 +368,7 @@ static void cobalt_help(void)
 	fprintf(stderr, "--print-buffer-size=<bytes>	size of a print relay buffer (16k)\n");
 	fprintf(stderr, "--print-buffer-count=<num>	number of print relay buffers (4)\n");
 	fprintf(stderr, "--print-sync-delay=<ms>	max delay of output synchronization (100 ms)\n");
+	fprintf(stderr, "--print-percpu-size=<bytes>	size of per-CPU print relay rings, 0 for per-thread buffers (0)\n");
 }
 
 static struct setup_descriptor cobalt_interface = {
@@ -80,6 +80,8 @@ void cobalt_ticks_init(unsigned long long freq);
 
 void cobalt_mutex_init(void);
 
+void cobalt_mq_ring_forget(int fd);
+
 void cobalt_default_condattr_init(void);
 
 int cobalt_xlate_schedparam(int policy,
@@ -18,6 +18,8 @@
 
 #include <errno.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
@@ -39,6 +41,255 @@
  *@{
  */
 
+/*
+ * Descriptors of queues created with COBALT_MQ_FASTPATH, indexed by
+ * mqd in a two-level table which readers walk locklessly. Readers
+ * pin the entry they use, so that mq_close() on another thread can
+ * only release the descriptor once they are done with it. The
+ * generation count is bumped each time an mqd is unbound, so that a
+ * descriptor left over from a previous use of the same fd number is
+ * never picked. mq_close() waits for the last pinning reader to
+ * leave on a condition variable, which that reader signals on its
+ * way out.
+ */
+#define MQ_RING_L2_BITS  10
+#define MQ_RING_L2_SIZE  (1 << MQ_RING_L2_BITS)
+#define MQ_RING_L1_SIZE  256
+#define MQ_RING_MAXFD    (MQ_RING_L1_SIZE * MQ_RING_L2_SIZE)
+
+struct mq_ring_desc {
+	struct cobalt_mq_ring ring;
+	unsigned int gen;
+	int perms;
+};
+
+struct mq_ring_entry {
+	struct mq_ring_desc *desc;
+	unsigned int gen;
+	int users;
+	int draining;
+};
+
+static struct mq_ring_entry *mq_ring_table[MQ_RING_L1_SIZE];
+
+static pthread_mutex_t mq_ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t mq_ring_drained = PTHREAD_COND_INITIALIZER;
+
+static inline struct mq_ring_entry *mq_ring_entry(mqd_t q)
+{
+	struct mq_ring_entry *l2;
+
+	if ((unsigned int)q >= MQ_RING_MAXFD)
+		return NULL;
+
+	l2 = mq_ring_table[q >> MQ_RING_L2_BITS];
+	if (l2 == NULL)
+		return NULL;
+
+	return l2 + (q & (MQ_RING_L2_SIZE - 1));
+}
+
+static inline struct mq_ring_desc *mq_ring_get(mqd_t q)
+{
+	struct mq_ring_entry *e = mq_ring_entry(q);
+	struct mq_ring_desc *desc;
+
+	if (e == NULL || e->desc == NULL)
+		return NULL;
+
+	__sync_fetch_and_add(&e->users, 1); /* Full barrier. */
+	desc = e->desc;
+	if (desc == NULL || desc->gen != e->gen) {
+		__sync_fetch_and_sub(&e->users, 1);
+		return NULL;
+	}
+
+	return desc;
+}
+
+static inline void mq_ring_put(mqd_t q)
+{
+	struct mq_ring_entry *e = mq_ring_entry(q);
+
+	/* Full barrier, pairs with the one in mq_ring_detach(). */
+	if (__sync_sub_and_fetch(&e->users, 1) > 0 || !e->draining)
+		return;
+
+	__RT(pthread_mutex_lock(&mq_ring_lock));
+	__RT(pthread_cond_broadcast(&mq_ring_drained));
+	__RT(pthread_mutex_unlock(&mq_ring_lock));
+}
+
+static void mq_ring_detach(mqd_t q)
+{
+	struct mq_ring_entry *e = mq_ring_entry(q);
+	struct mq_ring_desc *desc;
+
+	if (e == NULL || e->desc == NULL)
+		return;
+
+	__sync_fetch_and_add(&e->gen, 1);
+	desc = __sync_lock_test_and_set(&e->desc, NULL);
+	if (desc == NULL)
+		return;
+
+	/*
+	 * Wait for the readers which got the descriptor before we
+	 * cleared it. The last one out signals mq_ring_drained once
+	 * it sees the draining flag. A regular thread cannot block
+	 * on Cobalt objects, in which case a descriptor still in use
+	 * is left behind rather than freed under its readers.
+	 */
+	e->draining = 1;
+	__sync_synchronize();
+	if (e->users == 0)
+		goto out;
+
+	if (cobalt_get_current() == XN_NO_HANDLE) {
+		e->draining = 0;
+		return;
+	}
+
+	__RT(pthread_mutex_lock(&mq_ring_lock));
+	while (e->users > 0)
+		__RT(pthread_cond_wait(&mq_ring_drained, &mq_ring_lock));
+	__RT(pthread_mutex_unlock(&mq_ring_lock));
+out:
+	e->draining = 0;
+	free(desc);
+}
+
+static void mq_ring_attach(mqd_t q, int oflags)
+{
+	struct mq_ring_entry *l2, *old, *e;
+	struct mq_ring_desc *desc;
+	struct cobalt_mq_state *state;
+	__u32 offset;
+	int ret;
+
+	if ((unsigned int)q >= MQ_RING_MAXFD)
+		return;
+
+	/* Drop what a former owner of this fd number left behind. */
+	mq_ring_detach(q);
+
+	ret = XENOMAI_SYSCALL2(sc_cobalt_mq_ring, q, &offset);
+	if (ret)
+		return;	/* Regular queue. */
+
+	l2 = mq_ring_table[q >> MQ_RING_L2_BITS];
+	if (l2 == NULL) {
+		l2 = calloc(MQ_RING_L2_SIZE, sizeof(*l2));
+		if (l2 == NULL)
+			return;
+		old = __sync_val_compare_and_swap(&mq_ring_table[q >> MQ_RING_L2_BITS],
+						  NULL, l2);
+		if (old) {
+			free(l2);
+			l2 = old;
+		}
+	}
+
+	desc = malloc(sizeof(*desc));
+	if (desc == NULL)
+		return;	/* Syscalls will do. */
+
+	e = l2 + (q & (MQ_RING_L2_SIZE - 1));
+	state = cobalt_umm_shared + offset;
+	desc->ring.state = state;
+	desc->ring.mask = state->nslots - 1;
+	desc->ring.slotsz = state->slotsz;
+	desc->ring.msgsize = state->msgsize;
+	desc->perms = oflags & O_ACCMODE;
+	desc->gen = e->gen;
+	smp_wmb();
+	if (__sync_val_compare_and_swap(&e->desc, NULL, desc))
+		free(desc);	/* Lost a race with a concurrent open. */
+}
+
+void cobalt_mq_ring_forget(int fd)
+{
+	mq_ring_detach(fd);
+}
+
+static inline void mq_ring_post(mqd_t q, struct mq_ring_desc *desc, int sent)
+{
+	struct cobalt_mq_state *state = desc->ring.state;
+
+	smp_mb();
+	if (atomic_read(sent ? &state->rwaiters : &state->swaiters) ||
+	    (state->flags & COBALT_MQ_KICK))
+		XENOMAI_SYSCALL2(sc_cobalt_mq_kick, q, sent);
+}
+
+/*
+ * Send without entering the kernel, unless a waiter has to be
+ * kicked. Returns -EAGAIN if the ring is full, in which case the
+ * caller should issue the syscall, which knows how to wait.
+ */
+static int mq_ring_send(mqd_t q, struct mq_ring_desc *desc,
+			const char *buffer, size_t len, unsigned int prio)
+{
+	struct cobalt_mq_slot *slot;
+	__u32 pos;
+
+	if (desc->perms == O_RDONLY)
+		return -EBADF;
+
+	if (len > desc->ring.msgsize)
+		return -EMSGSIZE;
+
+	if (prio >= MQ_PRIO_MAX)
+		return -EINVAL;
+
+	/* Let the syscall sort out a full or trashed ring. */
+	if (cobalt_mq_claim_send(&desc->ring, &slot, &pos))
+		return -EAGAIN;
+
+	memcpy(slot->data, buffer, len);
+	slot->len = len;
+	slot->prio = prio;
+	cobalt_mq_commit_send(slot, pos);
+	mq_ring_post(q, desc, 1);
+
+	return 0;
+}
+
+static ssize_t mq_ring_receive(mqd_t q, struct mq_ring_desc *desc,
+			       char *buffer, size_t len, unsigned int *prio)
+{
+	struct cobalt_mq_slot *slot;
+	__u32 pos, mlen;
+
+	if (desc->perms == O_WRONLY)
+		return -EBADF;
+
+	if (len < desc->ring.msgsize)
+		return -EMSGSIZE;
+
+	for (;;) {
+		if (cobalt_mq_claim_receive(&desc->ring, &slot, &pos))
+			return -EAGAIN;
+		mlen = slot->len;
+		if (mlen != COBALT_MQ_VOID)
+			break;
+		cobalt_mq_commit_receive(&desc->ring, slot, pos);
+		mq_ring_post(q, desc, 0);
+	}
+
+	if (mlen > desc->ring.msgsize)
+		mlen = desc->ring.msgsize;
+
+	memcpy(buffer, slot->data, mlen);
+	if (prio)
+		*prio = slot->prio;
+	cobalt_mq_commit_receive(&desc->ring, slot, pos);
+	mq_ring_post(q, desc, 0);
+
+	return mlen;
+}
+
 /**
  * @brief Open a message queue
  *
@@ -70,7 +321,16 @@
  * are used when creating a message queue:
  * - @a mq_maxmsg is the maximum number of messages in the queue (128 by
  *   default);
- * - @a mq_msgsize is the maximum size of each message (128 by default).
+ * - @a mq_msgsize is the maximum size of each message (128 by default);
+ * - @a mq_flags may be set to COBALT_MQ_FASTPATH, for storing the
+ *   messages into a ring shared with the kernel, mapped from the
+ *   shared memory heap. Sending to and receiving from such queue
+ *   then completes in user space, unless the caller has to wait for
+ *   room or data. Messages are delivered in FIFO order regardless of
+ *   their priority, and @a mq_maxmsg is rounded up to the next power
+ *   of two. The queue must fit in CONFIG_XENO_OPT_SHARED_HEAPSZ. No
+ *   other bit than O_NONBLOCK may be set in @a mq_flags for this
+ *   flag to be honored.
  *
  * @a name may be any arbitrary string, in which slashes have no particular
  * meaning. However, for portability, using a name which starts with a slash and
@@ -121,6 +381,8 @@ COBALT_IMPL(mqd_t, mq_open, (const char *name, int oflags, ...))
 		return (mqd_t)-1;
 	}
 
+	mq_ring_attach(fd, oflags);
+
 	return (mqd_t)fd;
 }
 
@@ -148,6 +410,8 @@ COBALT_IMPL(int, mq_close, (mqd_t mqd))
 {
 	int err;
 
+	mq_ring_detach(mqd);
+
 	err = XENOMAI_SYSCALL1(sc_cobalt_mq_close, mqd);
 	if (err) {
 		errno = -err;
@@ -278,7 +542,8 @@ COBALT_IMPL(int, mq_setattr, (mqd_t mqd,
 		flags = err;
 	}
 
-	flags = (flags & ~O_NONBLOCK) | (attr->mq_flags & O_NONBLOCK);
+	flags = (flags & ~(O_NONBLOCK | COBALT_MQ_FASTPATH)) |
+		(attr->mq_flags & O_NONBLOCK);
 
 	err = __WRAP(fcntl(mqd, F_SETFL, flags));
 	if (!err)
@@ -328,8 +593,21 @@ COBALT_IMPL(int, mq_setattr, (mqd_t mqd,
  */
 COBALT_IMPL(int, mq_send, (mqd_t q, const char *buffer, size_t len, unsigned prio))
 {
+	struct mq_ring_desc *desc;
 	int err, oldtype;
 
+	desc = mq_ring_get(q);
+	if (desc) {
+		err = mq_ring_send(q, desc, buffer, len, prio);
+		mq_ring_put(q);
+		if (err == 0)
+			return 0;
+		if (err != -EAGAIN) {
+			errno = -err;
+			return -1;
+		}
+	}
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
@@ -385,11 +663,24 @@ COBALT_IMPL(int, mq_timedsend, (mqd_t q,
 				size_t len,
 				unsigned prio, const struct timespec *timeout))
 {
+	struct mq_ring_desc *desc;
 	int err, oldtype;
 
 	if (timeout == NULL)
 		return -EFAULT;
 
+	desc = mq_ring_get(q);
+	if (desc) {
+		err = mq_ring_send(q, desc, buffer, len, prio);
+		mq_ring_put(q);
+		if (err == 0)
+			return 0;
+		if (err != -EAGAIN) {
+			errno = -err;
+			return -1;
+		}
+	}
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedsend,
@@ -447,8 +738,22 @@ COBALT_IMPL(int, mq_timedsend, (mqd_t q,
 COBALT_IMPL(ssize_t, mq_receive, (mqd_t q, char *buffer, size_t len, unsigned *prio))
 {
 	ssize_t rlen = (ssize_t) len;
+	struct mq_ring_desc *desc;
 	int err, oldtype;
 
+	desc = mq_ring_get(q);
+	if (desc) {
+		rlen = mq_ring_receive(q, desc, buffer, len, prio);
+		mq_ring_put(q);
+		if (rlen >= 0)
+			return rlen;
+		if (rlen != -EAGAIN) {
+			errno = -rlen;
+			return -1;
+		}
+		rlen = (ssize_t) len;
+	}
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
@@ -509,11 +814,25 @@ COBALT_IMPL(ssize_t, mq_timedreceive, (mqd_t q,
 				       const struct timespec * __restrict__ timeout))
 {
 	ssize_t rlen = (ssize_t) len;
+	struct mq_ring_desc *desc;
 	int err, oldtype;
 
 	if (timeout == NULL)
 		return -EFAULT;
 
+	desc = mq_ring_get(q);
+	if (desc) {
+		rlen = mq_ring_receive(q, desc, buffer, len, prio);
+		mq_ring_put(q);
+		if (rlen >= 0)
+			return rlen;
+		if (rlen != -EAGAIN) {
+			errno = -rlen;
+			return -1;
+		}
+		rlen = (ssize_t) len;
+	}
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = XENOMAI_SYSCALL5(sc_cobalt_mq_timedreceive,
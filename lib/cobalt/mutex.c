@@ -281,6 +281,68 @@ COBALT_IMPL(int, pthread_mutex_destroy, (pthread_mutex_t *mutex))
 	return -err;
 }
 
+/*
+ * Upper bound on the number of polling rounds a contender on an
+ * adaptive mutex may burn before sleeping in the kernel, so that a
+ * preempted owner never costs more than a few microseconds.
+ */
+#define MUTEX_ADAPTIVE_SPINS  1000
+
+static inline void mutex_track_owner(struct cobalt_mutex_shadow *_mutex)
+{
+	struct cobalt_mutex_state *state;
+
+	if (_mutex->attr.type != PTHREAD_MUTEX_ADAPTIVE_NP)
+		return;
+
+	state = mutex_get_state(_mutex);
+	state->owner_window = (char *)cobalt_get_current_window() -
+		(char *)cobalt_umm_shared;
+}
+
+/*
+ * Spin on a contended adaptive mutex for as long as its owner runs
+ * in primary mode on another CPU, and nobody sleeps on it already
+ * (the kernel hands the lock over to sleepers directly, we could
+ * not grab it anyway). The owner window is published by the last
+ * thread which acquired the mutex, so it may be slightly stale; this
+ * only ever affects the decision to spin, never mutual exclusion.
+ */
+static int mutex_spin_acquire(struct cobalt_mutex_shadow *_mutex,
+			      xnhandle_t cur)
+{
+	struct cobalt_mutex_state *state = mutex_get_state(_mutex);
+	struct xnthread_user_window *owner_window;
+	xnhandle_t h;
+	__u32 winoff;
+	int n;
+
+	for (n = 0; n < MUTEX_ADAPTIVE_SPINS; n++) {
+		h = atomic_read(&state->owner);
+		if (h == XN_NO_HANDLE) {
+			if (xnsynch_fast_acquire(&state->owner, cur) == 0) {
+				mutex_track_owner(_mutex);
+				atomic_add_fetch(&state->spin_hits, 1);
+				return 0;
+			}
+			continue;
+		}
+		if (xnsynch_fast_is_claimed(h))
+			break;
+		winoff = ACCESS_ONCE(state->owner_window);
+		if (winoff == COBALT_MUTEX_NOWINDOW)
+			break;
+		owner_window = cobalt_umm_shared + winoff;
+		if (!ACCESS_ONCE(owner_window->oncpu))
+			break;
+		cpu_relax();
+	}
+
+	atomic_add_fetch(&state->spin_misses, 1);
+
+	return -EAGAIN;
+}
+
 /**
  * Lock a mutex.
  *
@@ -295,6 +357,10 @@ COBALT_IMPL(int, pthread_mutex_destroy, (pthread_mutex_t *mutex))
  * - for mutexes of the @a PTHREAD_MUTEX_RECURSIVE type, this service increments
  *   the lock recursion count and returns 0.
  *
+ * If the mutex is of the @a PTHREAD_MUTEX_ADAPTIVE_NP type and locked
+ * by a thread running on another CPU, the caller briefly spins
+ * waiting for its release before blocking.
+ *
  * @param mutex the mutex to be locked.
  *
  * @return 0 on success
@@ -341,6 +407,11 @@ COBALT_IMPL(int, pthread_mutex_lock, (pthread_mutex_t *mutex))
 			goto protect;
 fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
+		if (ret == -EAGAIN &&
+		    _mutex->attr.type == PTHREAD_MUTEX_ADAPTIVE_NP)
+			ret = mutex_spin_acquire(_mutex, cur);
+		else if (ret == 0)
+			mutex_track_owner(_mutex);
 		if (ret == 0) {
 			_mutex->lockcnt = 1;
 			return 0;
@@ -447,6 +518,11 @@ COBALT_IMPL(int, pthread_mutex_timedlock, (pthread_mutex_t *mutex,
 			goto protect;
 fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
+		if (ret == -EAGAIN &&
+		    _mutex->attr.type == PTHREAD_MUTEX_ADAPTIVE_NP)
+			ret = mutex_spin_acquire(_mutex, cur);
+		else if (ret == 0)
+			mutex_track_owner(_mutex);
 		if (ret == 0) {
 			_mutex->lockcnt = 1;
 			return 0;
@@ -546,6 +622,7 @@ COBALT_IMPL(int, pthread_mutex_trylock, (pthread_mutex_t *mutex))
 fast_path:
 		ret = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
 		if (ret == 0) {
+			mutex_track_owner(_mutex);
 			_mutex->lockcnt = 1;
 			return 0;
 		}
@@ -777,6 +854,47 @@ COBALT_IMPL(int, pthread_mutex_getprioceiling,
 	return 0;
 }
 
+/**
+ * Get the spinning statistics of an adaptive mutex.
+ *
+ * This routine retrieves the number of times a contender acquired
+ * the specified mutex while spinning, and the number of times it
+ * gave up spinning and had to sleep in the kernel instead. Both
+ * counters are cumulated since the mutex was initialized.
+ *
+ * @param mutex the target mutex.
+ *
+ * @param hits on success, the count of successful spins is copied to
+ * this address.
+ *
+ * @param misses on success, the count of spins which fell back to
+ * blocking is copied to this address.
+ *
+ * @return 0 on success;
+ * @return an error number if:
+ * - EINVAL, @a mutex is invalid;
+ * - EINVAL, @a mutex is not of type PTHREAD_MUTEX_ADAPTIVE_NP.
+ *
+ * @apitags{thread-unrestricted}
+ */
+int pthread_mutex_getspinstat_np(pthread_mutex_t *mutex,
+				 unsigned int *hits, unsigned int *misses)
+{
+	struct cobalt_mutex_shadow *_mutex =
+		&((union cobalt_mutex_union *)mutex)->shadow_mutex;
+	struct cobalt_mutex_state *state;
+
+	if (_mutex->magic != COBALT_MUTEX_MAGIC ||
+	    _mutex->attr.type != PTHREAD_MUTEX_ADAPTIVE_NP)
+		return EINVAL;
+
+	state = mutex_get_state(_mutex);
+	*hits = atomic_read(&state->spin_hits);
+	*misses = atomic_read(&state->spin_misses);
+
+	return 0;
+}
+
 /**
  * Initialize a mutex attributes object.
  *
@@ -867,6 +985,12 @@ int pthread_mutexattr_gettype(const pthread_mutexattr_t * attr, int *type);
  * a Cobalt condition variable is safe (see pthread_cond_wait()
  * documentation).
  *
+ * The @a PTHREAD_MUTEX_ADAPTIVE_NP type behaves as @a
+ * PTHREAD_MUTEX_NORMAL, except that a thread contending for the
+ * mutex in primary mode first spins for a bounded time as long as
+ * the current owner is running on another CPU, before sleeping in
+ * the kernel. See pthread_mutex_getspinstat_np().
+ *
  * @param attr an initialized mutex attributes object,
  *
  * @param type value of the @a type attribute.
@@ -20,6 +20,8 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -27,8 +29,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <syslog.h>
+#if HAVE_DECL___RSEQ_OFFSET && HAVE_DECL___RSEQ_SIZE
+#include <sys/rseq.h>
+#define HAVE_RSEQ_CPU_ID 1
+#endif
 #include <boilerplate/atomic.h>
 #include <boilerplate/compiler.h>
+#include <boilerplate/time.h>
 #include <cobalt/tunables.h>
 #include <cobalt/sys/cobalt.h>
 #include "internal.h"
@@ -43,15 +50,51 @@
 
 #define RT_PRINT_MODE_FORMAT		0
 #define RT_PRINT_MODE_FWRITE		1
+#define RT_PRINT_MODE_BINARY		2
+
+#define RT_PRINT_SPEC_MAX		32
+
+#define RT_PRINT_SLOT_SIZE		RT_PRINT_LINE_BREAK
 
 struct entry_head {
 	FILE *dest;
 	uint32_t seq_no;
 	int priority;
+	int mode;
 	size_t len;
 	char data[0];
 } __attribute__((packed));
 
+/*
+ * Argument classes of the conversions supported in binary mode. The
+ * data of a binary entry is the format pointer, followed by the raw
+ * arguments in order of appearance, each taking the size of its
+ * class; strings are copied inline, including the trailing nul.
+ */
+enum print_arg_type {
+	PRINT_ARG_NONE,		/* %% */
+	PRINT_ARG_INT,
+	PRINT_ARG_LONG,
+	PRINT_ARG_LLONG,
+	PRINT_ARG_INTMAX,
+	PRINT_ARG_SIZE,
+	PRINT_ARG_PTRDIFF,
+	PRINT_ARG_DOUBLE,
+	PRINT_ARG_LDOUBLE,
+	PRINT_ARG_STRING,
+	PRINT_ARG_POINTER,
+};
+
+struct print_spec {
+	enum print_arg_type type;
+	/* Number of '*' width/precision arguments. */
+	int stars;
+	/* Precision, -1 if none, -2 if given by argument. */
+	int prec;
+	/* Length of the conversion specification. */
+	size_t len;
+};
+
 struct print_buffer {
 	off_t write_pos;
 
@@ -69,8 +112,34 @@ struct print_buffer {
 	off_t read_pos;
 };
 
+/*
+ * Per-CPU mode: a ring of fixed-size slots is shared by all threads
+ * running on a CPU. seq tells the state of a slot for the lap the
+ * ring index is in: free when equal to the index, published when
+ * equal to the index + 1.
+ */
+struct print_slot {
+	atomic_long_t seq;
+	char entry[RT_PRINT_SLOT_SIZE - sizeof(atomic_long_t)];
+};
+
+struct print_ring {
+	/* Next slot to reserve, shared by the producers. */
+	atomic_long_t tail;
+	/* Next slot to print, owned by the printer. */
+	unsigned long head __attribute__((aligned(64)));
+	unsigned long mask;
+	unsigned long watermark;
+	atomic_t kicked;
+	/* Messages lost to a full ring, reported by the printer. */
+	atomic_long_t drops;
+	struct print_slot *slots;
+};
+
 __weak int __cobalt_print_bufsz = RT_PRINT_DEFAULT_BUFFER;
 
+int __cobalt_print_percpu_bufsz;
+
 int __cobalt_print_bufcount = RT_PRINT_DEFAULT_BUFFERS_COUNT;
 
 int __cobalt_print_syncdelay = RT_PRINT_DEFAULT_SYNCDELAY;
@@ -88,67 +157,272 @@ static atomic_long_t *pool_bitmap;
 static unsigned pool_bitmap_len;
 static unsigned pool_buf_size;
 static unsigned long pool_start, pool_len;
+static struct print_ring *print_rings;
+static int print_nr_rings;
+static sem_t printer_sem;
+static int printer_kickable;
 
 static void release_buffer(struct print_buffer *buffer);
 static void print_buffers(void);
 
-/* *** rt_print API *** */
-
-static int 
-vprint_to_buffer(FILE *stream, int fortify_level, int priority, 
-		 unsigned int mode, size_t sz, const char *format, va_list args)
+/*
+ * Parse the conversion specification starting at @p, which points
+ * at a '%'. Return the address following it, or NULL if we may not
+ * defer it (%n, %m, positional or wide-character arguments), in
+ * which case the caller has to format in place.
+ */
+static const char *parse_print_spec(const char *p, struct print_spec *ps)
 {
-	struct print_buffer *buffer = pthread_getspecific(buffer_key);
-	off_t write_pos, read_pos;
-	struct entry_head *head;
-	int len, str_len;
-	int res = 0;
+	const char *start = p++;
+	int mod = 0;
 
-	if (!buffer) {
-		res = rt_print_init(0, NULL);
-		if (res) {
-			errno = res;
-			return -1;
+	ps->type = PRINT_ARG_INT;
+	ps->stars = 0;
+	ps->prec = -1;
+
+	if (*p == '%') {
+		ps->type = PRINT_ARG_NONE;
+		ps->len = 2;
+		return p + 1;
+	}
+
+	p += strspn(p, "-+ #0'I");
+
+	if (*p == '*') {
+		ps->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p == '$')
+			return NULL;
+	}
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			ps->prec = -2;
+			ps->stars++;
+			p++;
+		} else {
+			ps->prec = 0;
+			while (*p >= '0' && *p <= '9')
+				ps->prec = ps->prec * 10 + *p++ - '0';
 		}
-		buffer = pthread_getspecific(buffer_key);
 	}
 
-	/* Take a snapshot of the ring buffer state */
-	write_pos = buffer->write_pos;
-	read_pos = buffer->read_pos;
-	smp_mb();
+	switch (*p) {
+	case 'h':
+		mod = *p++;
+		if (*p == 'h')
+			p++;
+		break;
+	case 'l':
+		mod = *p++;
+		if (*p == 'l') {
+			ps->type = PRINT_ARG_LLONG;
+			p++;
+		} else
+			ps->type = PRINT_ARG_LONG;
+		break;
+	case 'q':
+	case 'L':
+		mod = *p++;
+		ps->type = PRINT_ARG_LLONG;
+		break;
+	case 'j':
+		mod = *p++;
+		ps->type = PRINT_ARG_INTMAX;
+		break;
+	case 'z':
+	case 'Z':
+		mod = *p++;
+		ps->type = PRINT_ARG_SIZE;
+		break;
+	case 't':
+		mod = *p++;
+		ps->type = PRINT_ARG_PTRDIFF;
+		break;
+	}
 
-	/* Is our write limit the end of the ring buffer? */
-	if (write_pos >= read_pos) {
-		/* Keep a safety margin to the end for at least an empty entry */
-		len = buffer->size - write_pos - sizeof(struct entry_head);
+	switch (*p) {
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		break;
+	case 'c':
+		if (mod && mod != 'l')
+			return NULL;
+		ps->type = PRINT_ARG_INT; /* wint_t is promoted too. */
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		ps->type = mod == 'L' ? PRINT_ARG_LDOUBLE : PRINT_ARG_DOUBLE;
+		break;
+	case 's':
+		if (mod)
+			return NULL;
+		ps->type = PRINT_ARG_STRING;
+		break;
+	case 'p':
+		ps->type = PRINT_ARG_POINTER;
+		break;
+	default:
+		return NULL;
+	}
 
-		/* Special case: We were stuck at the end of the ring buffer
-		   with space left there only for one empty entry. Now
-		   read_pos was moved forward and we can wrap around. */
-		if (len == 0 && read_pos > sizeof(struct entry_head)) {
-			/* Write out empty entry */
-			head = buffer->ring + write_pos;
-			head->seq_no = seq_no;
-			head->priority = 0;
-			head->len = 0;
+	ps->len = ++p - start;
+	if (ps->len >= RT_PRINT_SPEC_MAX)
+		return NULL;
 
-			/* Forward to the ring buffer start */
-			write_pos = 0;
-			len = read_pos - 1;
+	return p;
+}
+
+static inline int put_arg(char **pp, const char *end,
+			  const void *arg, size_t size)
+{
+	if (end - *pp < size)
+		return -1;
+
+	memcpy(*pp, arg, size);
+	*pp += size;
+
+	return 0;
+}
+
+#define encode_arg(__pp, __end, __args, __type)			\
+	({								\
+		__type __arg = va_arg(__args, __type);			\
+		put_arg(__pp, __end, &__arg, sizeof(__arg));		\
+	})
+
+/*
+ * Store the format pointer and the raw arguments to @data. Return
+ * the number of bytes used, or -1 if the arguments cannot be
+ * deferred or do not fit in @len bytes.
+ */
+static int encode_binary_args(char *data, int len,
+			      const char *format, va_list args)
+{
+	char *p = data, *end = data + len;
+	const char *f = format, *str;
+	struct print_spec ps;
+	int n, ret, star = -1;
+	size_t slen;
+
+	if (put_arg(&p, end, &format, sizeof(format)))
+		return -1;
+
+	while ((f = strchr(f, '%')) != NULL) {
+		f = parse_print_spec(f, &ps);
+		if (f == NULL)
+			return -1;
+
+		for (n = 0; n < ps.stars; n++) {
+			star = va_arg(args, int);
+			if (put_arg(&p, end, &star, sizeof(star)))
+				return -1;
 		}
-	} else {
-		/* Our limit is the read_pos ahead of our write_pos. One byte
-		   margin is required to detect a full ring. */
-		len = read_pos - write_pos - 1;
+
+		switch (ps.type) {
+		case PRINT_ARG_NONE:
+			ret = 0;
+			break;
+		case PRINT_ARG_INT:
+			ret = encode_arg(&p, end, args, int);
+			break;
+		case PRINT_ARG_LONG:
+			ret = encode_arg(&p, end, args, long);
+			break;
+		case PRINT_ARG_LLONG:
+			ret = encode_arg(&p, end, args, long long);
+			break;
+		case PRINT_ARG_INTMAX:
+			ret = encode_arg(&p, end, args, intmax_t);
+			break;
+		case PRINT_ARG_SIZE:
+			ret = encode_arg(&p, end, args, size_t);
+			break;
+		case PRINT_ARG_PTRDIFF:
+			ret = encode_arg(&p, end, args, ptrdiff_t);
+			break;
+		case PRINT_ARG_DOUBLE:
+			ret = encode_arg(&p, end, args, double);
+			break;
+		case PRINT_ARG_LDOUBLE:
+			ret = encode_arg(&p, end, args, long double);
+			break;
+		case PRINT_ARG_POINTER:
+			ret = encode_arg(&p, end, args, void *);
+			break;
+		case PRINT_ARG_STRING:
+			/*
+			 * The string may be gone by the time we
+			 * format it, copy it. With a precision, it
+			 * does not have to be nul-terminated.
+			 */
+			str = va_arg(args, const char *);
+			if (str == NULL)
+				str = "(null)";
+			if (ps.prec == -2 && star >= 0)
+				slen = strnlen(str, star);
+			else if (ps.prec >= 0)
+				slen = strnlen(str, ps.prec);
+			else
+				slen = strlen(str);
+			ret = put_arg(&p, end, str, slen);
+			if (ret == 0)
+				ret = put_arg(&p, end, "", 1);
+			break;
+		default:
+			ret = -1;
+		}
+
+		if (ret)
+			return -1;
 	}
 
-	/* Account for head length */
-	len -= sizeof(struct entry_head);
-	if (len < 0)
-		len = 0;
+	return p - data;
+}
 
-	head = buffer->ring + write_pos;
+/*
+ * Fill the payload of an entry with at most *lenp bytes, which is
+ * updated with the actual size on return. *modep is switched to
+ * RT_PRINT_MODE_FORMAT if a binary entry has to be formatted in
+ * place after all.
+ */
+static int fill_entry(struct entry_head *head, int *lenp, FILE *stream,
+		      int fortify_level, unsigned int *modep, size_t sz,
+		      const char *format, va_list args)
+{
+	unsigned int mode = *modep;
+	int len = *lenp, str_len, res = 0;
+	va_list aq;
+
+	if (mode == RT_PRINT_MODE_BINARY) {
+		/*
+		 * Leave the formatting to the printer thread, unless
+		 * the arguments cannot be deferred or do not fit, in
+		 * which case we format in place as usual.
+		 */
+		va_copy(aq, args);
+		res = encode_binary_args(head->data, len, format, aq);
+		va_end(aq);
+		if (res > 0) {
+			len = res;
+			res = 0;
+		} else
+			mode = RT_PRINT_MODE_FORMAT;
+	}
 
 	if (mode == RT_PRINT_MODE_FORMAT) {
 		if (stream != RT_PRINT_SYSLOG_STREAM) {
@@ -194,17 +468,199 @@ vprint_to_buffer(FILE *stream, int fortify_level, int priority,
 				res = len;
 			}
 		}
-	} else if (len >= 1) {
-		str_len = sz;
-		len = (str_len < len) ? str_len : len;
-		memcpy(head->data, format, len);
-	} else
+	} else if (mode == RT_PRINT_MODE_FWRITE) {
+		if (len >= 1) {
+			str_len = sz;
+			len = (str_len < len) ? str_len : len;
+			memcpy(head->data, format, len);
+		} else
+			len = 0;
+	}
+
+	*lenp = len;
+	*modep = mode;
+
+	return res;
+}
+
+static inline void kick_printer(struct print_ring *ring)
+{
+	/* Post once per watermark crossing, the printer rearms. */
+	if (printer_kickable && atomic_cmpxchg(&ring->kicked, 0, 1) == 0)
+		__RT(sem_post(&printer_sem));
+}
+
+/*
+ * Return the current CPU without issuing any syscall, which would
+ * switch a real-time caller to secondary mode: glibc registers a
+ * rseq area for each thread, the kernel keeps its cpu_id field up
+ * to date. Cobalt threads do not migrate while running in primary
+ * mode, so this value is accurate for them too. Returns -1 if no
+ * such source is available.
+ */
+static inline int print_getcpu(void)
+{
+#ifdef HAVE_RSEQ_CPU_ID
+	struct rseq *rs;
+
+	if (__rseq_size == 0)
+		return -1;
+
+	rs = (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+
+	return (int)ACCESS_ONCE(rs->cpu_id); /* < 0 unless registered. */
+#else
+	return -1;
+#endif
+}
+
+/*
+ * The caller reserves a slot in the ring of @cpu. Threads sharing a
+ * CPU may preempt each other, so reservations are lock-free
+ * multi-producer, the printer being the only consumer. Text beyond
+ * the slot size is truncated.
+ */
+static int vprint_to_ring(int cpu, FILE *stream, int fortify_level,
+			  int priority, unsigned int mode, size_t sz,
+			  const char *format, va_list args)
+{
+	struct print_ring *ring;
+	struct print_slot *slot;
+	struct entry_head *head;
+	unsigned long pos, old;
+	uint32_t seq;
+	int len, res;
+	long diff;
+
+	ring = print_rings + cpu % print_nr_rings;
+
+	pos = atomic_long_read(&ring->tail);
+	for (;;) {
+		slot = ring->slots + (pos & ring->mask);
+		diff = atomic_long_read(&slot->seq) - (long)pos;
+		if (diff == 0) {
+			/*
+			 * Draw the sequence number before claiming
+			 * the slot, and draw it again if we lose the
+			 * race for it: this way, the numbers follow
+			 * the order of the slots in the ring, which
+			 * the printer relies on for merging.
+			 */
+			seq = __sync_add_and_fetch(&seq_no, 1);
+			old = atomic_cmpxchg(&ring->tail, pos, pos + 1);
+			if (old == pos)
+				break;
+			pos = old;
+		} else if (diff < 0) {
+			/* The ring is full, drop the message. */
+			atomic_add_fetch(&ring->drops, 1);
+			kick_printer(ring);
+			return 0;
+		} else
+			pos = atomic_long_read(&ring->tail);
+	}
+
+	/* Read the slot state before overwriting its content. */
+	smp_mb();
+
+	head = (struct entry_head *)slot->entry;
+	len = sizeof(slot->entry) - sizeof(*head);
+	res = fill_entry(head, &len, stream, fortify_level,
+			 &mode, sz, format, args);
+	head->seq_no = seq;
+	head->priority = priority;
+	head->mode = mode;
+	head->dest = stream;
+	head->len = len;
+
+	/* All entry data must be written before we publish the slot */
+	smp_wmb();
+	atomic_long_set(&slot->seq, pos + 1);
+	smp_mb();
+
+	if (pos + 1 - ACCESS_ONCE(ring->head) >= ring->watermark)
+		kick_printer(ring);
+
+	return res;
+}
+
+/* *** rt_print API *** */
+
+static int 
+vprint_to_buffer(FILE *stream, int fortify_level, int priority, 
+		 unsigned int mode, size_t sz, const char *format, va_list args)
+{
+	struct print_buffer *buffer = pthread_getspecific(buffer_key);
+	off_t write_pos, read_pos;
+	struct entry_head *head;
+	int len, cpu, res = 0;
+
+	if (print_rings) {
+		cpu = print_getcpu();
+		if (cpu >= 0)
+			return vprint_to_ring(cpu, stream, fortify_level,
+					      priority, mode, sz, format, args);
+		/*
+		 * No cheap way to tell our CPU, fall back to a
+		 * private buffer, which the printer merges with the
+		 * rings.
+		 */
+	}
+
+	if (!buffer) {
+		res = rt_print_init(0, NULL);
+		if (res) {
+			errno = res;
+			return -1;
+		}
+		buffer = pthread_getspecific(buffer_key);
+	}
+
+	/* Take a snapshot of the ring buffer state */
+	write_pos = buffer->write_pos;
+	read_pos = buffer->read_pos;
+	smp_mb();
+
+	/* Is our write limit the end of the ring buffer? */
+	if (write_pos >= read_pos) {
+		/* Keep a safety margin to the end for at least an empty entry */
+		len = buffer->size - write_pos - sizeof(struct entry_head);
+
+		/* Special case: We were stuck at the end of the ring buffer
+		   with space left there only for one empty entry. Now
+		   read_pos was moved forward and we can wrap around. */
+		if (len == 0 && read_pos > sizeof(struct entry_head)) {
+			/* Write out empty entry */
+			head = buffer->ring + write_pos;
+			head->seq_no = seq_no;
+			head->priority = 0;
+			head->len = 0;
+
+			/* Forward to the ring buffer start */
+			write_pos = 0;
+			len = read_pos - 1;
+		}
+	} else {
+		/* Our limit is the read_pos ahead of our write_pos. One byte
+		   margin is required to detect a full ring. */
+		len = read_pos - write_pos - 1;
+	}
+
+	/* Account for head length */
+	len -= sizeof(struct entry_head);
+	if (len < 0)
 		len = 0;
 
+	head = buffer->ring + write_pos;
+
+	res = fill_entry(head, &len, stream, fortify_level,
+			 &mode, sz, format, args);
+
 	/* If we were able to write some text, finalise the entry */
 	if (len > 0) {
 		head->seq_no = ++seq_no;
 		head->priority = priority;
+		head->mode = mode;
 		head->dest = stream;
 		head->len = len;
 
@@ -261,6 +717,41 @@ int __rt_vfprintf_chk(FILE *stream, int level, const char *fmt, va_list args)
 
 #endif
 
+int rt_vfbprintf(FILE *stream, const char *format, va_list args)
+{
+	if (stream == RT_PRINT_SYSLOG_STREAM) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	return vprint_to_buffer(stream, 0, 0,
+				RT_PRINT_MODE_BINARY, 0, format, args);
+}
+
+int (rt_fbprintf)(FILE *stream, const char *format, ...)
+{
+	va_list args;
+	int n;
+
+	va_start(args, format);
+	n = rt_vfbprintf(stream, format, args);
+	va_end(args);
+
+	return n;
+}
+
+int (rt_bprintf)(const char *format, ...)
+{
+	va_list args;
+	int n;
+
+	va_start(args, format);
+	n = rt_vfbprintf(stdout, format, args);
+	va_end(args);
+
+	return n;
+}
+
 int rt_vprintf(const char *format, va_list args)
 {
 	return rt_vfprintf(stdout, format, args);
@@ -576,15 +1067,209 @@ static struct print_buffer *get_next_buffer(void)
 	return buffer;
 }
 
+static inline int get_arg(const char **pp, const char *end,
+			  void *arg, size_t size)
+{
+	if (end - *pp < size)
+		return -1;
+
+	memcpy(arg, *pp, size);
+	*pp += size;
+
+	return 0;
+}
+
+#define print_arg(__dest, __spec, __stars, __w, __arg)			\
+	do {								\
+		switch (__stars) {					\
+		case 0:							\
+			fprintf(__dest, __spec, __arg);			\
+			break;						\
+		case 1:							\
+			fprintf(__dest, __spec, (__w)[0], __arg);	\
+			break;						\
+		default:						\
+			fprintf(__dest, __spec, (__w)[0], (__w)[1], __arg); \
+		}							\
+	} while (0)
+
+#define decode_arg(__pp, __end, __dest, __spec, __stars, __w, __type)	\
+	({								\
+		__type __arg;						\
+		int __ret = get_arg(__pp, __end, &__arg, sizeof(__arg)); \
+		if (__ret == 0)						\
+			print_arg(__dest, __spec, __stars, __w, __arg);	\
+		__ret;							\
+	})
+
+/*
+ * Format a binary entry, which encode_binary_args() has validated
+ * already.
+ */
+static void print_binary_entry(struct entry_head *head)
+{
+	const char *p = head->data, *end = head->data + head->len;
+	const char *format, *f, *next, *str;
+	char spec[RT_PRINT_SPEC_MAX];
+	FILE *dest = head->dest;
+	struct print_spec ps;
+	int n, ret, w[2];
+
+	if (get_arg(&p, end, &format, sizeof(format)))
+		return;
+
+	for (f = format; *f; f = next) {
+		next = strchrnul(f, '%');
+		if (next > f)
+			fwrite(f, next - f, 1, dest);
+		if (*next == '\0')
+			break;
+
+		next = parse_print_spec(next, &ps);
+		if (next == NULL)
+			return;
+		memcpy(spec, next - ps.len, ps.len);
+		spec[ps.len] = '\0';
+
+		for (n = 0; n < ps.stars; n++)
+			if (get_arg(&p, end, &w[n], sizeof(w[n])))
+				return;
+
+		switch (ps.type) {
+		case PRINT_ARG_NONE:
+			fputc('%', dest);
+			ret = 0;
+			break;
+		case PRINT_ARG_INT:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w, int);
+			break;
+		case PRINT_ARG_LONG:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w, long);
+			break;
+		case PRINT_ARG_LLONG:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 long long);
+			break;
+		case PRINT_ARG_INTMAX:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 intmax_t);
+			break;
+		case PRINT_ARG_SIZE:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 size_t);
+			break;
+		case PRINT_ARG_PTRDIFF:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 ptrdiff_t);
+			break;
+		case PRINT_ARG_DOUBLE:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 double);
+			break;
+		case PRINT_ARG_LDOUBLE:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 long double);
+			break;
+		case PRINT_ARG_POINTER:
+			ret = decode_arg(&p, end, dest, spec, ps.stars, w,
+					 void *);
+			break;
+		case PRINT_ARG_STRING:
+			str = p;
+			p += strnlen(p, end - p) + 1;
+			if (p > end)
+				return;
+			print_arg(dest, spec, ps.stars, w, str);
+			ret = 0;
+			break;
+		default:
+			ret = -1;
+		}
+
+		if (ret)
+			return;
+	}
+}
+
+static void print_entry(struct entry_head *head)
+{
+	int ret;
+
+	/* Check if output goes to syslog */
+	if (head->mode == RT_PRINT_MODE_BINARY) {
+		print_binary_entry(head);
+	} else if (head->dest == RT_PRINT_SYSLOG_STREAM) {
+		syslog(head->priority, "%s", head->data);
+	} else {
+		ret = fwrite(head->data, head->len, 1, head->dest);
+		(void)ret;
+	}
+}
+
+/*
+ * Pick the per-CPU ring holding the oldest published entry. This
+ * merge is k-way over the CPUs, regardless of the number of
+ * threads printing.
+ */
+static struct print_ring *get_next_ring(uint32_t *seq_no_r)
+{
+	struct print_ring *ring, *next = NULL;
+	struct entry_head *head;
+	struct print_slot *slot;
+	int n;
+
+	for (n = 0; n < print_nr_rings; n++) {
+		ring = print_rings + n;
+		slot = ring->slots + (ring->head & ring->mask);
+		if (atomic_long_read(&slot->seq) != ring->head + 1)
+			continue;
+		/* Read the slot state before its content. */
+		smp_rmb();
+		head = (struct entry_head *)slot->entry;
+		if (!next || head->seq_no < *seq_no_r) {
+			next = ring;
+			*seq_no_r = head->seq_no;
+		}
+	}
+
+	return next;
+}
+
+static void print_ring_entry(struct print_ring *ring)
+{
+	struct print_slot *slot = ring->slots + (ring->head & ring->mask);
+	struct entry_head *head = (struct entry_head *)slot->entry;
+
+	/* Slots are allowed to be empty, i.e. lost to truncation. */
+	if (head->len)
+		print_entry(head);
+
+	/* Make sure we have read the entry completely before
+	   releasing the slot for the next lap */
+	smp_mb();
+	atomic_long_set(&slot->seq, ring->head + ring->mask + 1);
+	ring->head++;
+}
+
 static void print_buffers(void)
 {
 	struct print_buffer *buffer;
+	struct print_ring *ring;
 	struct entry_head *head;
+	uint32_t ring_seq_no;
 	off_t read_pos;
-	int len, ret;
+	int len, n;
+	long drops;
 
 	while (1) {
 		buffer = get_next_buffer();
+		ring = get_next_ring(&ring_seq_no);
+		if (ring &&
+		    (!buffer || ring_seq_no < get_next_seq_no(buffer))) {
+			print_ring_entry(ring);
+			continue;
+		}
+
 		if (!buffer)
 			break;
 
@@ -594,16 +1279,7 @@ static void print_buffers(void)
 
 		if (len) {
 			/* Print out non-empty entry and proceed */
-			/* Check if output goes to syslog */
-			if (head->dest == RT_PRINT_SYSLOG_STREAM) {
-				syslog(head->priority,
-				       "%s", head->data);
-			} else {
-				ret = fwrite(head->data,
-					     head->len, 1, head->dest);
-				(void)ret;
-			}
-
+			print_entry(head);
 			read_pos += sizeof(*head) + len;
 		} else {
 			/* Emptry entries mark the wrap-around */
@@ -618,21 +1294,47 @@ static void print_buffers(void)
 		/* Enforce the read_pos update before proceeding */
 		smp_wmb();
 	}
+
+	/* Report the losses, then rearm the watermark kicks. */
+	for (n = 0; n < print_nr_rings; n++) {
+		ring = print_rings + n;
+		drops = atomic_long_read(&ring->drops);
+		if (drops) {
+			atomic_sub_fetch(&ring->drops, drops);
+			fprintf(stderr, "[rt_print: %ld message(s) dropped "
+				"on CPU%d]\n", drops, n);
+		}
+		atomic_set(&ring->kicked, 0);
+	}
+	smp_mb();
 }
 
 static void *printer_loop(void *arg)
 {
+	struct timespec now, timeout;
+
 	while (1) {
 		pthread_mutex_lock(&buffer_lock);
 
-		while (buffers == 0)
+		while (buffers == 0 && print_rings == NULL)
 			pthread_cond_wait(&printer_wakeup, &buffer_lock);
 
 		print_buffers();
 
 		pthread_mutex_unlock(&buffer_lock);
 
-		nanosleep(&syncdelay, NULL);
+		if (arg == NULL) {
+			nanosleep(&syncdelay, NULL);
+			continue;
+		}
+
+		/*
+		 * We may be kicked early by a producer crossing the
+		 * watermark of a per-CPU ring.
+		 */
+		__RT(clock_gettime(CLOCK_REALTIME, &now));
+		timespec_add(&timeout, &now, &syncdelay);
+		__RT(sem_timedwait(&printer_sem, &timeout));
 	}
 
 	return NULL;
@@ -640,13 +1342,28 @@ static void *printer_loop(void *arg)
 
 static void spawn_printer_thread(void)
 {
+	struct sched_param param = { .sched_priority = 0 };
 	pthread_attr_t thattr;
 	sigset_t sset, oset;
+	int ret = -1;
 
 	pthread_attr_init(&thattr);
 	sigfillset(&sset);
 	pthread_sigmask(SIG_BLOCK, &sset, &oset);
-	pthread_create(&printer_thread, &thattr, printer_loop, NULL);
+	if (printer_kickable) {
+		/*
+		 * Real-time producers can only wake up a Cobalt
+		 * thread without leaving primary mode, make the
+		 * printer a weakly scheduled one.
+		 */
+		pthread_attr_setinheritsched(&thattr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&thattr, SCHED_OTHER);
+		pthread_attr_setschedparam(&thattr, &param);
+		ret = __RT(pthread_create(&printer_thread, &thattr,
+					  printer_loop, &printer_sem));
+	}
+	if (ret)
+		pthread_create(&printer_thread, &thattr, printer_loop, NULL);
 	pthread_sigmask(SIG_SETMASK, &oset, NULL);
 	pthread_setname_np(printer_thread, "cobalt_printf");
 }
@@ -668,6 +1385,14 @@ void cobalt_print_init_atfork(void)
 	/* re-init to avoid finding it locked by some parent thread */
 	pthread_mutex_init(&buffer_lock, NULL);
 
+	/*
+	 * The content of the per-CPU rings belongs to our parent too,
+	 * cobalt_print_init() sets up fresh ones.
+	 */
+	print_rings = NULL;
+	print_nr_rings = 0;
+	printer_kickable = 0;
+
 	while (*pbuffer) {
 		if (*pbuffer == my_buffer)
 			pbuffer = &(*pbuffer)->next;
@@ -682,6 +1407,47 @@ void cobalt_print_init_atfork(void)
 	spawn_printer_thread();
 }
 
+static void init_print_rings(void)
+{
+	unsigned long nr_slots;
+	struct print_ring *ring;
+	int n, i;
+
+	nr_slots = __cobalt_print_percpu_bufsz / RT_PRINT_SLOT_SIZE;
+	if (nr_slots < 2)
+		early_panic("per-CPU print buffers too small (%d bytes)",
+			    __cobalt_print_percpu_bufsz);
+
+	/* Round down to a power of two. */
+	while (nr_slots & (nr_slots - 1))
+		nr_slots &= nr_slots - 1;
+
+	n = (int)sysconf(_SC_NPROCESSORS_CONF);
+	if (n <= 0)
+		n = 1;
+
+	print_rings = malloc(n * sizeof(*ring));
+	if (print_rings == NULL)
+		early_panic("error allocating per-CPU print buffers");
+
+	for (ring = print_rings; ring < print_rings + n; ring++) {
+		ring->slots = malloc(nr_slots * sizeof(*ring->slots));
+		if (ring->slots == NULL)
+			early_panic("error allocating per-CPU print buffers");
+		for (i = 0; i < nr_slots; i++)
+			atomic_long_set(&ring->slots[i].seq, i);
+		atomic_long_set(&ring->tail, 0);
+		ring->head = 0;
+		ring->mask = nr_slots - 1;
+		ring->watermark = nr_slots / 2;
+		atomic_set(&ring->kicked, 0);
+		atomic_long_set(&ring->drops, 0);
+	}
+
+	print_nr_rings = n;
+	printer_kickable = __RT(sem_init(&printer_sem, 0, 0)) == 0;
+}
+
 void cobalt_print_init(void)
 {
 	unsigned int i;
@@ -692,6 +1458,13 @@ void cobalt_print_init(void)
 	syncdelay.tv_sec  = __cobalt_print_syncdelay / 1000;
 	syncdelay.tv_nsec = (__cobalt_print_syncdelay % 1000) * 1000000;
 
+	/* Per-CPU rings replace the buffer pool. */
+	if (__cobalt_print_percpu_bufsz > 0) {
+		init_print_rings();
+		pool_bitmap_len = 0;
+		goto done;
+	}
+
 	/* Fill the buffer pool */
 	pool_bitmap_len = (__cobalt_print_bufcount+LONG_BIT-1)/LONG_BIT;
 	if (!pool_bitmap_len)
@@ -149,6 +149,8 @@ COBALT_IMPL(int, close, (int fd))
 	int oldtype;
 	int ret;
 
+	cobalt_mq_ring_forget(fd);
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	ret = XENOMAI_SYSCALL1(sc_cobalt_close, fd);
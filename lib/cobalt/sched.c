@@ -258,8 +258,8 @@ COBALT_IMPL(int, sched_setscheduler, (pid_t pid, int policy,
  * assumed.
  *
  * @param policy scheduling policy, one of SCHED_WEAK, SCHED_FIFO,
- * SCHED_COBALT, SCHED_RR, SCHED_SPORADIC, SCHED_TP, SCHED_QUOTA or
- * SCHED_NORMAL;
+ * SCHED_COBALT, SCHED_RR, SCHED_SPORADIC, SCHED_TP, SCHED_QUOTA,
+ * SCHED_EDF or SCHED_NORMAL;
  *
  * @param param_ex address of scheduling parameters. As a special
  * exception, a negative sched_priority value is interpreted as if
@@ -270,6 +270,14 @@ COBALT_IMPL(int, sched_setscheduler, (pid_t pid, int policy,
  * priority levels in the [0..99] range (inclusive). Otherwise,
  * sched_priority must be zero for the SCHED_WEAK policy.
  *
+ * With SCHED_EDF, the thread is given a runtime budget
+ * (sched_edf_runtime) it may consume every period (sched_edf_period)
+ * before a relative deadline (sched_edf_deadline), which defaults to
+ * the period if zero. Threads are run by increasing absolute
+ * deadline, a thread which overruns its budget is held until its
+ * next period begins. sched_priority only matters when resolving
+ * priority inheritance with other policies.
+ *
  * @return 0 on success;
  * @return an error number if:
  * - ESRCH, @a pid is not found;
@@ -278,6 +286,9 @@ COBALT_IMPL(int, sched_setscheduler, (pid_t pid, int policy,
  * - EAGAIN, insufficient memory available from the system heap,
  *   increase CONFIG_XENO_OPT_SYS_HEAPSZ;
  * - EFAULT, @a param_ex is an invalid address;
+ * - EBUSY, with @a policy equal to SCHED_EDF, if the requested
+ *   bandwidth would exceed CONFIG_XENO_OPT_SCHED_EDF_BWLIMIT on the
+ *   CPU the thread runs on;
  *
  * @note
  *
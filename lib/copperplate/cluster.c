@@ -96,6 +96,7 @@
 #include "copperplate/syncobj.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/debug.h"
+#include "copperplate/tunables.h"
 #include "internal.h"
 
 const static struct hash_operations hash_operations;
@@ -142,7 +143,7 @@ redo:
 	if (d == NULL)
 		return __bt(-ENOMEM);
 
-	hash_init(&d->table);
+	hash_init_size(&d->table, __copperplate_setup_data.hash_size);
 	ret = hash_enter(&main_catalog, name, strlen(name), &d->hobj,
 			 &hash_operations);
 	/*
@@ -266,7 +267,7 @@ redo:
 	if (d == NULL)
 		return -ENOMEM;
 
-	hash_init(&d->table);
+	hash_init_size(&d->table, __copperplate_setup_data.hash_size);
 
 	ret = hash_enter(&main_catalog, name, strlen(name), &d->hobj,
 			 &hash_operations);
@@ -412,13 +413,13 @@ const static struct hash_operations hash_operations = {
 
 int pvcluster_init(struct pvcluster *c, const char *name)
 {
-	pvhash_init(&c->table);
+	pvhash_init_size(&c->table, __copperplate_setup_data.hash_size);
 	return 0;
 }
 
 void pvcluster_destroy(struct pvcluster *c)
 {
-	/* nop */
+	pvhash_destroy(&c->table);
 }
 
 int pvcluster_addobj(struct pvcluster *c, const char *name,
@@ -483,8 +484,8 @@ int pvsyncluster_init(struct pvsyncluster *sc, const char *name)
 		return ret;
 
 	/*
-	 * Assuming pvcluster_destroy() is a nop, so we don't need to
-	 * run any finalizer.
+	 * Slots are only allocated upon first insertion, so there is
+	 * nothing pvcluster_destroy() would have to release yet.
 	 */
 	return syncobj_init(&sc->sobj, CLOCK_COPPERPLATE,
 			    SYNCOBJ_FIFO, fnref_null);
@@ -41,6 +41,8 @@ struct copperplate_setup_data __copperplate_setup_data = {
 	.session_label = NULL,
 	.session_root = NULL,
 	.session_gid = USHRT_MAX,
+	.timer_servers = 1,
+	.hash_size = HASHSLOTS,
 };
 
 #ifdef CONFIG_XENO_COBALT
@@ -77,6 +79,16 @@ static const struct option copperplate_options[] = {
 		.flag = &__copperplate_setup_data.shared_registry,
 		.val = 1,
 	},
+	{
+#define timer_servers_opt	5
+		.name = "timer-servers",
+		.has_arg = required_argument,
+	},
+	{
+#define hash_size_opt	6
+		.name = "hash-size",
+		.has_arg = required_argument,
+	},
 	{ /* Sentinel */ }
 };
 
@@ -272,6 +284,18 @@ static int copperplate_parse_option(int optnum, const char *optarg)
 	case regroot_opt:
 		__copperplate_setup_data.registry_root = strdup(optarg);
 		break;
+	case timer_servers_opt:
+		ret = atoi(optarg);
+		if (ret <= 0 || ret > CPU_SETSIZE)
+			return -EINVAL;
+		__copperplate_setup_data.timer_servers = ret;
+		break;
+	case hash_size_opt:
+		ret = atoi(optarg);
+		if (ret <= 0)
+			return -EINVAL;
+		__copperplate_setup_data.hash_size = ret;
+		break;
 	case shared_registry_opt:
 	case no_registry_opt:
 		break;
@@ -290,6 +314,8 @@ static void copperplate_help(void)
         fprintf(stderr, "--shared-registry		enable public access to registry\n");
         fprintf(stderr, "--registry-root=<path>		root path of registry\n");
         fprintf(stderr, "--session=<label>[/<group>]	enable shared session\n");
+        fprintf(stderr, "--timer-servers=<count>		number of timer server threads\n");
+        fprintf(stderr, "--hash-size=<slots>		initial size of object name tables\n");
 }
 
 static struct setup_descriptor copperplate_interface = {
@@ -26,22 +26,59 @@
 #include <limits.h>
 #include <pthread.h>
 #include <semaphore.h>
-#include "boilerplate/list.h"
+#include <sys/sysinfo.h>
+#include "boilerplate/avl.h"
 #include "boilerplate/signal.h"
 #include "boilerplate/lock.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/timerobj.h"
 #include "copperplate/clockobj.h"
 #include "copperplate/debug.h"
+#include "copperplate/tunables.h"
 #include "internal.h"
 
-static pthread_mutex_t svlock;
+/*
+ * A timer server thread runs the handlers of the timers it serves
+ * upon expiry, receiving SIGALRM notifications from the core
+ * timers. There is a single server by default, so that all
+ * handlers are serialized, which is what legacy RTOS applications
+ * usually expect. Several servers may be started with the
+ * --timer-servers option, each pinned to a distinct CPU, in which
+ * case handlers of timers attached to different servers may run
+ * concurrently.
+ */
+struct timerobj_server {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	pid_t pid;
+	int cpu;
+	/* Outstanding timers, by increasing expiry date. */
+	struct avl timers;
+};
+
+static struct timerobj_server *servers;
+
+static int nrservers;
+
+static int server_rr;
+
+static inline int compare_timers(const struct avlh *l, const struct avlh *r)
+{
+	const struct timerobj *tl = container_of(l, struct timerobj, link);
+	const struct timerobj *tr = container_of(r, struct timerobj, link);
+
+	if (timespec_before(&tl->itspec.it_value, &tr->itspec.it_value))
+		return -1;
 
-static pthread_t svthread;
+	return timespec_after(&tl->itspec.it_value, &tr->itspec.it_value);
+}
 
-static pid_t svpid;
+static DECLARE_AVL_SEARCH(search_timer, compare_timers);
 
-static DEFINE_PRIVATE_LIST(svtimers);
+static struct avl_searchops timer_search_ops = {
+	.search = search_timer,
+	.cmp = compare_timers,
+};
 
 #ifdef CONFIG_XENO_COBALT
 
@@ -61,36 +98,45 @@ static inline void timersv_init_corespec(void)
 #endif /* CONFIG_XENO_MERCURY */
 
 /*
- * XXX: at some point, we may consider using a timer wheel instead of
- * a simple linked list to index timers. The latter method is
- * efficient for up to ten outstanding timers or so, which should be
- * enough for most applications. However, there exist poorly designed
- * apps involving dozens of active timers, particularly in the legacy
- * embedded world.
+ * Outstanding timers are indexed in an AVL tree by expiry date,
+ * giving O(log n) insertion and removal. Timers with identical
+ * dates are kept in FIFO order.
  */
 static void timerobj_enqueue(struct timerobj *tmobj)
 {
-	struct timerobj *__tmobj;
+	struct timerobj_server *sv = tmobj->server;
 
-	if (pvlist_empty(&svtimers)) {
-		pvlist_append(&tmobj->next, &svtimers);
-		return;
-	}
+	avlh_init(&tmobj->link);
+	avl_insert_back(&sv->timers, &tmobj->link, &timer_search_ops);
+	tmobj->queued = 1;
+}
 
-	pvlist_for_each_entry_reverse(__tmobj, &svtimers, next) {
-		if (timespec_before_or_same(&__tmobj->itspec.it_value,
-					    &tmobj->itspec.it_value))
-			break;
-	}
+static void timerobj_dequeue(struct timerobj *tmobj)
+{
+	struct timerobj_server *sv = tmobj->server;
 
-	atpvh(&__tmobj->next, &tmobj->next);
+	if (tmobj->queued) {
+		avl_delete(&sv->timers, &tmobj->link);
+		tmobj->queued = 0;
+	}
 }
 
 static int server_prologue(void *arg)
 {
-	svpid = get_thread_pid();
+	struct timerobj_server *sv = arg;
+	cpu_set_t cpuset;
+
+	sv->pid = get_thread_pid();
 	copperplate_set_current_name("timer-internal");
 	timersv_init_corespec();
+
+	if (sv->cpu >= 0) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(sv->cpu, &cpuset);
+		if (sched_setaffinity(0, sizeof(cpuset), &cpuset))
+			warning("cannot pin timer server to CPU%d", sv->cpu);
+	}
+
 	threadobj_set_current(THREADOBJ_IRQCONTEXT);
 
 	return 0;
@@ -100,7 +146,9 @@ static void *timerobj_server(void *arg)
 {
 	void (*handler)(struct timerobj *tmobj);
 	struct timespec now, value, interval;
-	struct timerobj *tmobj, *tmp;
+	struct timerobj_server *sv = arg;
+	struct timerobj *tmobj;
+	struct avlh *h;
 	sigset_t set;
 	int sig, ret;
 
@@ -112,54 +160,84 @@ static void *timerobj_server(void *arg)
 		if (ret && ret != -EINTR)
 			break;
 		/*
-		 * We have a single server thread for now, so handlers
-		 * are fully serialized.
+		 * Handlers of the timers attached to this server are
+		 * fully serialized.
 		 */
-		write_lock_nocancel(&svlock);
+		write_lock_nocancel(&sv->lock);
 
 		__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
 
-		pvlist_for_each_entry_safe(tmobj, tmp, &svtimers, next) {
+		while ((h = avl_head(&sv->timers)) != NULL) {
+			tmobj = container_of(h, struct timerobj, link);
 			value = tmobj->itspec.it_value;
 			interval = tmobj->itspec.it_interval;
 			handler = tmobj->handler;
 			if (timespec_after(&value, &now))
 				break;
-			pvlist_remove_init(&tmobj->next);
+			timerobj_dequeue(tmobj);
 			if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
 				timespec_add(&tmobj->itspec.it_value,
 					     &value, &interval);
 				timerobj_enqueue(tmobj);
 			}
-			write_unlock(&svlock);
+			write_unlock(&sv->lock);
 			handler(tmobj);
-			write_lock_nocancel(&svlock);
+			write_lock_nocancel(&sv->lock);
 		}
 
-		write_unlock(&svlock);
+		write_unlock(&sv->lock);
 	}
 
 	return NULL;
 }
 
-static void timerobj_spawn_server(void)
+static void timerobj_spawn_servers(void)
 {
 	struct corethread_attributes cta;
+	struct timerobj_server *sv;
+	int n;
+
+	for (n = 0; n < nrservers; n++) {
+		sv = servers + n;
+		cta.policy = SCHED_CORE;
+		cta.param_ex.sched_priority = threadobj_irq_prio;
+		cta.prologue = server_prologue;
+		cta.run = timerobj_server;
+		cta.arg = sv;
+		cta.stacksize = PTHREAD_STACK_DEFAULT;
+		cta.detachstate = PTHREAD_CREATE_DETACHED;
+
+		if (__bt(copperplate_create_thread(&cta, &sv->thread))) {
+			sv->thread = 0;
+			/*
+			 * Only hand out timers to the servers which
+			 * did start. If none did, timerobj_init()
+			 * fails on the first one.
+			 */
+			if (n > 0)
+				nrservers = n;
+			return;
+		}
+	}
+}
+
+static struct timerobj_server *pick_server(void)
+{
+	int n;
 
-	cta.policy = SCHED_CORE;
-	cta.param_ex.sched_priority = threadobj_irq_prio;
-	cta.prologue = server_prologue;
-	cta.run = timerobj_server;
-	cta.arg = NULL;
-	cta.stacksize = PTHREAD_STACK_DEFAULT;
-	cta.detachstate = PTHREAD_CREATE_DETACHED;
+	if (nrservers == 1)
+		return servers;
 
-	__bt(copperplate_create_thread(&cta, &svthread));
+	/* Spread timers evenly across the servers. */
+	n = __sync_fetch_and_add(&server_rr, 1);
+
+	return servers + (n % nrservers);
 }
 
 int timerobj_init(struct timerobj *tmobj)
 {
 	static pthread_once_t spawn_once;
+	struct timerobj_server *sv;
 	pthread_mutexattr_t mattr;
 	struct sigevent sev;
 	int ret;
@@ -175,17 +253,19 @@ int timerobj_init(struct timerobj *tmobj)
 	 * very least), and spawning a short-lived thread at each
 	 * timeout expiration to run the handler is just overkill.
 	 */
-	pthread_once(&spawn_once, timerobj_spawn_server);
-	if (!svthread)
+	pthread_once(&spawn_once, timerobj_spawn_servers);
+	sv = pick_server();
+	if (!sv->thread)
 		return __bt(-EAGAIN);
 
 	tmobj->handler = NULL;
-	pvholder_init(&tmobj->next); /* so we may use pvholder_linked() */
+	tmobj->server = sv;
+	tmobj->queued = 0;
 
 	memset(&sev, 0, sizeof(sev));
 	sev.sigev_notify = SIGEV_THREAD_ID;
 	sev.sigev_signo = SIGALRM;
-	sev.sigev_notify_thread_id = svpid;
+	sev.sigev_notify_thread_id = sv->pid;
 
 	ret = __RT(timer_create(CLOCK_COPPERPLATE, &sev, &tmobj->timer));
 	if (ret)
@@ -204,12 +284,11 @@ int timerobj_init(struct timerobj *tmobj)
 
 void timerobj_destroy(struct timerobj *tmobj) /* lock held, dropped */
 {
-	write_lock_nocancel(&svlock);
-
-	if (pvholder_linked(&tmobj->next))
-		pvlist_remove_init(&tmobj->next);
+	struct timerobj_server *sv = tmobj->server;
 
-	write_unlock(&svlock);
+	write_lock_nocancel(&sv->lock);
+	timerobj_dequeue(tmobj);
+	write_unlock(&sv->lock);
 
 	__RT(timer_delete(tmobj->timer));
 	__RT(pthread_mutex_unlock(&tmobj->lock));
@@ -220,6 +299,7 @@ int timerobj_start(struct timerobj *tmobj,
 		   void (*handler)(struct timerobj *tmobj),
 		   struct itimerspec *it) /* lock held, dropped */
 {
+	struct timerobj_server *sv = tmobj->server;
 	int ret = 0;
 
 	/*
@@ -231,11 +311,9 @@ int timerobj_start(struct timerobj *tmobj,
 	 * happens to check the return code then drop the timer
 	 * (again).
 	 */
-	write_lock_nocancel(&svlock);
-
-       if (pvholder_linked(&tmobj->next))
-               pvlist_remove_init(&tmobj->next);
+	write_lock_nocancel(&sv->lock);
 
+	timerobj_dequeue(tmobj);
 	tmobj->handler = handler;
 	tmobj->itspec = *it;
 
@@ -246,7 +324,7 @@ int timerobj_start(struct timerobj *tmobj,
 
 	timerobj_enqueue(tmobj);
 fail:
-	write_unlock(&svlock);
+	write_unlock(&sv->lock);
 	timerobj_unlock(tmobj);
 
 	return ret;
@@ -255,30 +333,76 @@ fail:
 int timerobj_stop(struct timerobj *tmobj) /* lock held, dropped */
 {
 	static const struct itimerspec itimer_stop;
+	struct timerobj_server *sv = tmobj->server;
 
-	write_lock_nocancel(&svlock);
-
-	if (pvholder_linked(&tmobj->next))
-		pvlist_remove_init(&tmobj->next);
+	write_lock_nocancel(&sv->lock);
 
+	timerobj_dequeue(tmobj);
 	__RT(timer_settime(tmobj->timer, 0, &itimer_stop, NULL));
 	tmobj->handler = NULL;
-	write_unlock(&svlock);
+	write_unlock(&sv->lock);
 	timerobj_unlock(tmobj);
 
 	return 0;
 }
 
+static int get_server_cpu(int n)
+{
+	cpu_set_t *affinity = &__base_setup_data.cpu_affinity;
+	int cpu, nrcpus = get_nprocs_conf(), count = 0;
+
+	if (nrcpus > CPU_SETSIZE)
+		nrcpus = CPU_SETSIZE;
+
+	for (cpu = 0; cpu < nrcpus; cpu++)
+		if (CPU_COUNT(affinity) == 0 || CPU_ISSET(cpu, affinity))
+			count++;
+
+	if (count == 0)
+		return -1;
+
+	/*
+	 * Pin the n-th server to the n-th CPU of the affinity set
+	 * (or of all CPUs if none was given), wrapping around if we
+	 * have more servers than CPUs.
+	 */
+	n %= count;
+	for (cpu = 0; cpu < nrcpus; cpu++) {
+		if (CPU_COUNT(affinity) > 0 && !CPU_ISSET(cpu, affinity))
+			continue;
+		if (n-- == 0)
+			break;
+	}
+
+	return cpu;
+}
+
 int timerobj_pkg_init(void)
 {
 	pthread_mutexattr_t mattr;
-	int ret;
+	int ret, n;
+
+	nrservers = __copperplate_setup_data.timer_servers;
+	if (nrservers <= 0)
+		nrservers = 1;
+
+	servers = calloc(nrservers, sizeof(*servers));
+	if (servers == NULL)
+		return -ENOMEM;
 
 	pthread_mutexattr_init(&mattr);
 	pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE);
 	pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
 	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE);
-	ret = __bt(-__RT(pthread_mutex_init(&svlock, &mattr)));
+
+	for (n = 0, ret = 0; n < nrservers; n++) {
+		avl_init(&servers[n].timers);
+		servers[n].cpu = nrservers > 1 ? get_server_cpu(n) : -1;
+		ret = __bt(-__RT(pthread_mutex_init(&servers[n].lock, &mattr)));
+		if (ret)
+			break;
+	}
+
 	pthread_mutexattr_destroy(&mattr);
 
 	return ret;
@@ -52,6 +52,8 @@
 #define MAX_HIST		100
 #define MAX_CYCLES 1000000
 #define DEFAULT_LIMIT 1000
+#define DEFAULT_BURST 16
+#define MAX_BURST 64
 #define DEV_PATH    "/dev/rtdm/"
 #define TRACING_ON  "/sys/kernel/debug/tracing/tracing_on"
 #define TRACING_EVENTS  "/sys/kernel/debug/tracing/events/enable"
@@ -62,6 +64,7 @@
 enum {
 	MODE_LOOPBACK,
 	MODE_REACT,
+	MODE_BURST,
 	MODE_ALL
 };
 
@@ -94,6 +97,13 @@ struct test_info {
 	pthread_t gpio_task;
 	int gpio_intr;
 	int gpio_out;
+	int burst;
+	unsigned long nr_edges;
+	unsigned long lost_edges;
+	unsigned long nr_reads;
+	unsigned long nr_setbits;
+	long long setbits_ns;
+	unsigned long getbits_errors;
 	struct test_stat ts;
 };
 
@@ -121,7 +131,11 @@ static void display_help(void)
 	       "                            must be specified\n"
 	       "-m       --testmode         0 is loopback mode\n"
 	       "                            1 is react mode which works with a latency box,\n"
-	       "                            default=0\n\n"
+	       "                            2 is burst mode, toggling the output through the\n"
+	       "                            chip device and reading edges in bulk,\n"
+	       "                            default=0\n"
+	       "-n       --burst            number of edges per burst in burst mode,\n"
+	       "                            default=16, max=64\n\n"
 
 	       "e.g.     gpiobench -o 20 -i 21 -c pinctrl-bcm2835\n"
 		);
@@ -130,7 +144,7 @@ static void display_help(void)
 static void process_options(int argc, char *argv[])
 {
 	int c = 0;
-	static const char optstring[] = "h:p:m:l:c:b:i:o:q";
+	static const char optstring[] = "h:p:m:l:c:b:i:o:n:q";
 
 	struct option long_options[] = {
 		{ "bracetrace", required_argument, 0, 'b'},
@@ -142,6 +156,7 @@ static void process_options(int argc, char *argv[])
 		{ "intr", required_argument, 0, 'i'},
 		{ "pinctrl", required_argument, 0, 'c'},
 		{ "testmode", required_argument, 0, 'm'},
+		{ "burst", required_argument, 0, 'n'},
 		{ 0, 0, 0, 0},
 	};
 
@@ -181,8 +196,14 @@ static void process_options(int argc, char *argv[])
 			break;
 
 		case 'm':
-			ti.mode = atoi(optarg) >=
-				MODE_REACT ? MODE_REACT : MODE_LOOPBACK;
+			ti.mode = atoi(optarg);
+			if (ti.mode < MODE_LOOPBACK || ti.mode >= MODE_ALL)
+				ti.mode = MODE_LOOPBACK;
+	ti.burst = DEFAULT_BURST;
+			break;
+
+		case 'n':
+			ti.burst = atoi(optarg);
 			break;
 
 		default:
@@ -199,6 +220,10 @@ static void process_options(int argc, char *argv[])
 
 	ti.prio = ti.prio > DEFAULT_PRIO ? DEFAULT_PRIO : ti.prio;
 	ti.max_cycles = ti.max_cycles > MAX_CYCLES ? MAX_CYCLES : ti.max_cycles;
+	if (ti.burst <= 0 || ti.burst > MAX_BURST)
+		ti.burst = DEFAULT_BURST;
+	/* each burst must leave the output line low */
+	ti.burst = (ti.burst + 1) & ~1;
 
 	ti.max_histogram = ti.max_histogram > MAX_HIST ?
 		MAX_HIST : ti.max_histogram;
@@ -284,6 +309,32 @@ static void tracemark(char *fmt, ...)
 	close(tracemark_fd);
 }
 
+static void account_inner(long long inner_diff)
+{
+	if (inner_diff < ti.ts.inner_min)
+		ti.ts.inner_min = inner_diff;
+	if (inner_diff > ti.ts.inner_max)
+		ti.ts.inner_max = inner_diff;
+	ti.ts.inner_avg += (double) inner_diff;
+	if (inner_diff >= ti.max_histogram)
+		ti.ts.inner_hist_overflow++;
+	else
+		ti.ts.inner_hist_array[inner_diff]++;
+}
+
+static void account_outer(long long outer_diff)
+{
+	if (outer_diff < ti.ts.outer_min)
+		ti.ts.outer_min = outer_diff;
+	if (outer_diff > ti.ts.outer_max)
+		ti.ts.outer_max = outer_diff;
+	ti.ts.outer_avg += (double) outer_diff;
+	if (outer_diff >= ti.max_histogram)
+		ti.ts.outer_hist_overflow++;
+	else
+		ti.ts.outer_hist_array[outer_diff]++;
+}
+
 static int rw_gpio(int value, int index)
 {
 	int ret;
@@ -312,25 +363,8 @@ static int rw_gpio(int value, int index)
 	inner_diff = (rdo.timestamp - gpio_write) / 1000;
 	outer_diff = (gpio_read - gpio_write) / 1000;
 
-	if (inner_diff < ti.ts.inner_min)
-		ti.ts.inner_min = inner_diff;
-	if (inner_diff > ti.ts.inner_max)
-		ti.ts.inner_max = inner_diff;
-	ti.ts.inner_avg += (double) inner_diff;
-	if (inner_diff >= ti.max_histogram)
-		ti.ts.inner_hist_overflow++;
-	else
-		ti.ts.inner_hist_array[inner_diff]++;
-
-	if (outer_diff < ti.ts.outer_min)
-		ti.ts.outer_min = outer_diff;
-	if (inner_diff > ti.ts.outer_max)
-		ti.ts.outer_max = outer_diff;
-	ti.ts.outer_avg += (double) outer_diff;
-	if (outer_diff >= ti.max_histogram)
-		ti.ts.outer_hist_overflow++;
-	else
-		ti.ts.outer_hist_array[outer_diff]++;
+	account_inner(inner_diff);
+	account_outer(outer_diff);
 
 	if (ti.quiet == 0)
 		printf("index: %d, inner_diff: %8lld, outer_diff: %8lld\n",
@@ -388,6 +422,132 @@ static void *run_gpiobench_loop(void *cookie)
 	return NULL;
 }
 
+/*
+ * Toggle the output line ti.burst times in a row through the chip
+ * device, then collect the resulting edges from the event ring of
+ * the input pin, reading as many as available per call. The inner
+ * latency is measured for each edge, the outer one is the time
+ * between the last write and the reception of the last edge.
+ */
+static int burst_gpio(int index)
+{
+	struct rtdm_gpio_event events[MAX_BURST];
+	long long wdate[MAX_BURST], t0, t1 = 0, deadline;
+	struct rtdm_gpio_bits rgb;
+	struct timespec timestamp;
+	int k, ret, got = 0;
+
+	rgb.base = ti.gpio_out;
+	rgb.trigger = 0;
+	rgb.mask = 1;
+
+	for (k = 0; k < ti.burst; k++) {
+		rgb.bits = (k & 1) ? GPIO_LOW : GPIO_HIGH;
+		clock_gettime(CLOCK_MONOTONIC, &timestamp);
+		t0 = calc_us(timestamp);
+		ret = ioctl(ti.fd_dev_out, GPIO_RTIOC_SET_BITS, &rgb);
+		if (ret) {
+			printf("ioctl gpio set bits, failed\n");
+			return -1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &timestamp);
+		t1 = calc_us(timestamp);
+		wdate[k] = t0;
+		ti.setbits_ns += t1 - t0;
+		ti.nr_setbits++;
+	}
+
+	/*
+	 * Read the last level written back, seeding the argument
+	 * with the opposite one: GPIO_RTIOC_GET_BITS must not
+	 * return what the caller passed in.
+	 */
+	rgb.bits = (k & 1) ? GPIO_LOW : GPIO_HIGH;
+	ret = ioctl(ti.fd_dev_out, GPIO_RTIOC_GET_BITS, &rgb);
+	if (ret) {
+		printf("ioctl gpio get bits, failed\n");
+		return -1;
+	}
+	if (rgb.bits != ((k & 1) ? GPIO_HIGH : GPIO_LOW)) {
+		ti.getbits_errors++;
+		if (ti.quiet == 0)
+			printf("index: %d, get bits returned %llu\n",
+			       index, (unsigned long long)rgb.bits);
+	}
+
+	/* Give up on missing edges after tracelimit us. */
+	deadline = t1 + (long long)ti.tracelimit * 1000;
+
+	while (got < ti.burst) {
+		ret = read(ti.fd_dev_intr, events + got,
+			   (ti.burst - got) * sizeof(events[0]));
+		clock_gettime(CLOCK_MONOTONIC, &timestamp);
+		t1 = calc_us(timestamp);
+		if (ret > 0) {
+			ti.nr_reads++;
+			got += ret / sizeof(events[0]);
+			continue;
+		}
+		if (errno != EAGAIN) {
+			printf("read GPIO events, failed\n");
+			return -1;
+		}
+		if (t1 > deadline)
+			break;
+	}
+
+	if (got < ti.burst ||
+	    (got && (events[0].flags & GPIO_EVENT_OVERRUN))) {
+		ti.lost_edges += ti.burst - got;
+		if (ti.quiet == 0)
+			printf("index: %d, lost %d edges\n",
+			       index, ti.burst - got);
+		return 0;
+	}
+
+	for (k = 0; k < got; k++)
+		account_inner((events[k].timestamp - wdate[k]) / 1000);
+
+	account_outer((t1 - wdate[got - 1]) / 1000);
+	ti.nr_edges += got;
+
+	if (ti.quiet == 0)
+		printf("index: %d, first edge: %8lld, last edge: %8lld\n",
+		       index, (events[0].timestamp - wdate[0]) / 1000,
+		       (t1 - wdate[got - 1]) / 1000);
+
+	return (t1 - wdate[got - 1]) / 1000;
+}
+
+static void *run_gpiobench_burst(void *cookie)
+{
+	int i, ret;
+
+	printf("----rt task, gpio burst, test run----\n");
+
+	for (i = 0; i < ti.max_cycles; i++) {
+		ti.total_cycles = i;
+		ret = burst_gpio(i);
+		if (ret < 0) {
+			printf("RW GPIO, failed\n");
+			break;
+		} else if (ti.tracelimit && ret > ti.tracelimit) {
+			tracemark("hit latency threshold (%d > %d), index: %d",
+						ret, ti.tracelimit, i);
+			break;
+		}
+
+		thread_msleep(10);
+	}
+
+	if (ti.nr_edges)
+		ti.ts.inner_avg /= ti.nr_edges;
+	if (ti.nr_edges / ti.burst)
+		ti.ts.outer_avg /= ti.nr_edges / ti.burst;
+
+	return NULL;
+}
+
 static void *run_gpiobench_react(void *cookie)
 {
 	int value, ret, i;
@@ -537,6 +697,23 @@ static void print_hist(void)
 	printf("# Max Latencies:");
 	printf(" %05lu", ti.ts.outer_max);
 	printf("\n");
+
+	if (ti.mode != MODE_BURST)
+		return;
+
+	printf("\n");
+	printf("# Burst mode, %d edges per burst\n", ti.burst);
+	printf("# Outer Loop latency is the latency between the last\n"
+	       "# write and the reception of the last edge of a burst\n");
+	printf("# Edges: %lu\n", ti.nr_edges);
+	printf("# Lost edges: %lu\n", ti.lost_edges);
+	if (ti.nr_reads)
+		printf("# Avg edges per read: %.2f\n",
+		       (double)ti.nr_edges / ti.nr_reads);
+	if (ti.nr_setbits)
+		printf("# Avg set_bits duration (ns): %lld\n",
+		       ti.setbits_ns / (long long)ti.nr_setbits);
+	printf("# Get_bits mismatches: %lu\n", ti.getbits_errors);
 }
 
 static void cleanup(void)
@@ -554,7 +731,7 @@ static void cleanup(void)
 	if (ret < 0)
 		printf("can't close gpio_intr device\n");
 
-	if (ti.mode == MODE_LOOPBACK)
+	if (ti.mode != MODE_REACT)
 		print_hist();
 
 }
@@ -569,6 +746,7 @@ static void cleanup_and_exit(int sig)
 int main(int argc, char **argv)
 {
 	struct sigaction sa __attribute__((unused));
+	struct rtdm_gpio_bits rgb;
 	int ret = 0;
 	pthread_attr_t tattr;
 	int trigger, value;
@@ -584,15 +762,35 @@ int main(int argc, char **argv)
 		goto out;
 	}
 
-	sprintf(dev_name, "%s%s/gpio%d",
-		    DEV_PATH, ti.pin_controller, ti.gpio_out);
-	ti.fd_dev_out = open(dev_name, O_RDWR);
-	if (ti.fd_dev_out < 0) {
-		printf("can't open %s\n", dev_name);
-		goto out;
+	if (ti.mode == MODE_BURST) {
+		/* drive the output line through the chip device */
+		sprintf(dev_name, "%s%s/gpiochip",
+			DEV_PATH, ti.pin_controller);
+		ti.fd_dev_out = open(dev_name, O_RDWR);
+		if (ti.fd_dev_out < 0) {
+			printf("can't open %s\n", dev_name);
+			goto out;
+		}
+		rgb.base = ti.gpio_out;
+		rgb.trigger = 0;
+		rgb.mask = 1;
+		rgb.bits = GPIO_LOW;
+		ret = ioctl(ti.fd_dev_out, GPIO_RTIOC_CHIP_DIR_OUT, &rgb);
+		if (ret) {
+			printf("ioctl gpio chip output, failed\n");
+			goto out;
+		}
+	} else {
+		sprintf(dev_name, "%s%s/gpio%d",
+			DEV_PATH, ti.pin_controller, ti.gpio_out);
+		ti.fd_dev_out = open(dev_name, O_RDWR);
+		if (ti.fd_dev_out < 0) {
+			printf("can't open %s\n", dev_name);
+			goto out;
+		}
 	}
 
-	if (ti.gpio_out) {
+	if (ti.gpio_out && ti.mode != MODE_BURST) {
 		value = 0;
 		ret = ioctl(ti.fd_dev_out, GPIO_RTIOC_DIR_OUT, &value);
 		if (ret) {
@@ -603,7 +801,8 @@ int main(int argc, char **argv)
 
 	sprintf(dev_name, "%s%s/gpio%d",
 		    DEV_PATH, ti.pin_controller, ti.gpio_intr);
-	ti.fd_dev_intr = open(dev_name, O_RDWR);
+	ti.fd_dev_intr = open(dev_name, ti.mode == MODE_BURST ?
+			      O_RDWR|O_NONBLOCK : O_RDWR);
 	if (ti.fd_dev_intr < 0) {
 		printf("can't open %s\n", dev_name);
 		goto out;
@@ -619,7 +818,8 @@ int main(int argc, char **argv)
 			goto out;
 		}
 
-		ret = ioctl(ti.fd_dev_intr, GPIO_RTIOC_TS, &value);
+		ret = ioctl(ti.fd_dev_intr, ti.mode == MODE_BURST ?
+			    GPIO_RTIOC_EVENTS : GPIO_RTIOC_TS, &value);
 		if (ret) {
 			printf("ioctl gpio port ts, failed\n");
 			goto out;
@@ -636,6 +836,9 @@ int main(int argc, char **argv)
 	if (ti.mode == MODE_LOOPBACK)
 		ret = pthread_create(&ti.gpio_task, &tattr,
 					run_gpiobench_loop, NULL);
+	else if (ti.mode == MODE_BURST)
+		ret = pthread_create(&ti.gpio_task, &tattr,
+					run_gpiobench_burst, NULL);
 	else
 		ret = pthread_create(&ti.gpio_task, &tattr,
 					run_gpiobench_react, NULL);
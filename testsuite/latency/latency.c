@@ -87,7 +87,8 @@ int histogram_size = HISTOGRAM_CELLS;
 int32_t *histogram_avg = NULL, *histogram_max = NULL, *histogram_min = NULL;
 
 char *do_gnuplot = NULL;
-int do_histogram = 0, do_stats = 0, finished = 0;
+int do_histogram = 0, do_stats = 0, do_percentiles = 0, finished = 0;
+__u64 *hdr_buckets = NULL;	/* log-linear histogram, user task mode */
 int bucketsize = 1000;		/* default = 1000ns, -B <size> to override */
 
 #define need_histo() (do_histogram || do_stats || do_gnuplot)
@@ -198,6 +199,9 @@ static void *latency(void *cookie)
 
 			if (!(finished || warmup) && need_histo())
 				add_histogram(histogram_avg, dt);
+
+			if (!(finished || warmup) && hdr_buckets)
+				hdr_buckets[rttst_hdr_index(dt)]++;
 		}
 
 		if (!warmup) {
@@ -229,6 +233,54 @@ static void *latency(void *cookie)
 	return NULL;
 }
 
+static int get_percentiles(struct rttst_hdr_stats *stats, int cpu)
+{
+	stats->cpu = cpu;
+	stats->flags = 0;
+
+	if (test_mode != USER_TASK)
+		return ioctl(benchdev, RTTST_RTIOC_TMBENCH_HDR, stats);
+
+	if (cpu >= 0)
+		return -1;
+
+	stats->min = gminjitter;
+	stats->max = gmaxjitter;
+	rttst_hdr_fill_stats(stats, hdr_buckets);
+
+	return 0;
+}
+
+static void print_percentiles(const char *tag, const char *label,
+			      const struct rttst_hdr_stats *stats)
+{
+	printf("%s|%5s|%11.3f|%11.3f|%11.3f|%11.3f|%11.3f|%11.3f\n",
+	       tag, label,
+	       (double)stats->p50 / 1000, (double)stats->p90 / 1000,
+	       (double)stats->p99 / 1000, (double)stats->p999 / 1000,
+	       (double)stats->p9999 / 1000, (double)stats->p99999 / 1000);
+}
+
+static void dump_percentiles(void)
+{
+	struct rttst_hdr_stats stats;
+	char label[16];
+	int cpu;
+
+	printf("---|-----|----lat p50|----lat p90|----lat p99|--lat p99.9|-lat p99.99|lat p99.999\n");
+
+	/* Per-CPU figures are only available from the timerbench. */
+	for (cpu = 0; get_percentiles(&stats, cpu) == 0; cpu++) {
+		if (stats.samples == 0)
+			continue;
+		snprintf(label, sizeof(label), "cpu%d", cpu);
+		print_percentiles("RPS", label, &stats);
+	}
+
+	if (get_percentiles(&stats, -1) == 0)
+		print_percentiles("RPS", "all", &stats);
+}
+
 static void *display(void *cookie)
 {
 	char task_name[16];
@@ -332,6 +384,12 @@ static void *display(void *cookie)
 				       "----lat min", "----lat avg",
 				       "----lat max", "-overrun", "---msw",
 				       "---lat best", "--lat worst");
+				if (do_percentiles)
+					printf("RPH|%5s|%11s|%11s|%11s|%11s|%11s|%11s\n",
+					       "-----", "----lat p50",
+					       "----lat p90", "----lat p99",
+					       "--lat p99.9", "-lat p99.99",
+					       "lat p99.999");
 			}
 			printf("RTD|%11.3f|%11.3f|%11.3f|%8d|%6u|%11.3f|%11.3f\n",
 			       (double)minj / 1000,
@@ -340,6 +398,12 @@ static void *display(void *cookie)
 			       goverrun,
 			       max_relaxed,
 			       (double)gminj / 1000, (double)gmaxj / 1000);
+			if (do_percentiles) {
+				struct rttst_hdr_stats stats;
+
+				if (get_percentiles(&stats, -1) == 0)
+					print_percentiles("RTP", "all", &stats);
+			}
 		}
 	}
 
@@ -497,7 +561,12 @@ static void cleanup(void)
 		sem_close(display_sem);
 		sem_unlink(sem_name);
 		gavgjitter /= (test_loops > 1 ? test_loops : 2) - 1;
+		if (do_percentiles)
+			dump_percentiles();
 	} else {
+		/* The timerbench drops its histograms when stopped. */
+		if (do_percentiles)
+			dump_percentiles();
 		overall.histogram_min = histogram_min;
 		overall.histogram_max = histogram_max;
 		overall.histogram_avg = histogram_avg;
@@ -533,6 +602,8 @@ static void cleanup(void)
 		free(histogram_max);
 	if (histogram_min)
 		free(histogram_min);
+	if (hdr_buckets)
+		free(hdr_buckets);
 
 	exit(0);
 }
@@ -612,6 +683,7 @@ void application_usage(void)
 		"-c <cpu>                        pin measuring task down to given CPU\n"
 		"-P <priority>                   task priority (test mode 0 and 1 only)\n"
 		"-b                              break upon mode switch\n"
+		"-Q                              print latency percentiles (p50 to p99.999)\n"
 		);
 }
 
@@ -646,7 +718,7 @@ int main(int argc, char *const *argv)
 	cpu_set_t cpus;
 	sigset_t mask;
 
-	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:b")) != EOF)
+	while ((c = getopt(argc, argv, "g:hp:l:T:qH:B:sD:t:fc:P:bQ")) != EOF)
 		switch (c) {
 		case 'g':
 			do_gnuplot = strdup(optarg);
@@ -720,6 +792,10 @@ int main(int argc, char *const *argv)
 			stop_upon_switch = 1;
 			break;
 
+		case 'Q':
+			do_percentiles = 1;
+			break;
+
 		default:
 			xenomai_usage();
 			exit(2);
@@ -747,6 +823,12 @@ int main(int argc, char *const *argv)
 	if (!(histogram_avg && histogram_max && histogram_min))
 		cleanup();
 
+	if (do_percentiles && test_mode == USER_TASK) {
+		hdr_buckets = calloc(RTTST_HDR_BUCKETS, sizeof(__u64));
+		if (hdr_buckets == NULL)
+			cleanup();
+	}
+
 	if (period_ns == 0)
 		period_ns = CONFIG_XENO_DEFAULT_PERIOD;	/* ns */
 
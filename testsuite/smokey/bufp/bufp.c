@@ -13,15 +13,24 @@
 #include <pthread.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/mman.h>
 #include <smokey/smokey.h>
 #include <rtdm/ipc.h>
 
 smokey_test_plugin(bufp,
 		   SMOKEY_NOARGS,
-		   "Check RTIPC/BUFP protocol."
+		   "Check RTIPC/BUFP protocol, including the SPSC ring mode."
 );
 
 #define BUFP_SVPORT 12
+#define BUFP_RGPORT 13
+#define RING_BUFSZ  3000	/* rounded up to 4096 */
+#define RING_LOOPS  10000
+
+struct ring_record {
+	unsigned long seq;
+	char pad[32];
+};
 
 static pthread_t svtid, cltid;
 
@@ -132,6 +141,159 @@ static void *client(void *arg)
 	return NULL;
 }
 
+static void *ring_writer(void *arg)
+{
+	struct sockaddr_ipc svsaddr;
+	struct rtipc_bufp_ring *ring;
+	struct ring_record rec;
+	unsigned long seq;
+	long ret = 0;
+	int s;
+
+	s = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP);
+	if (s < 0)
+		return (void *)(long)-errno;
+
+	memset(&svsaddr, 0, sizeof(svsaddr));
+	svsaddr.sipc_family = AF_RTIPC;
+	svsaddr.sipc_port = BUFP_RGPORT;
+	if (!__Fassert(connect(s, (struct sockaddr *)&svsaddr,
+			       sizeof(svsaddr)))) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* Map the ring of the server through our default destination. */
+	ring = mmap(NULL, RTIPC_BUFP_RING_DATA + 4096, PROT_READ|PROT_WRITE,
+		    MAP_SHARED, s, 0);
+	if (ring == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+
+	memset(&rec, 0, sizeof(rec));
+	for (seq = 1; seq <= RING_LOOPS; seq++) {
+		rec.seq = seq;
+		if (rtipc_bufp_write(s, ring, &rec, sizeof(rec)) != sizeof(rec)) {
+			ret = -errno;
+			break;
+		}
+	}
+
+	munmap(ring, RTIPC_BUFP_RING_DATA + 4096);
+out:
+	close(s);
+
+	return (void *)ret;
+}
+
+static int check_spsc(void)
+{
+	struct sched_param param = {.sched_priority = 70 };
+	struct sockaddr_ipc saddr;
+	struct rtipc_bufp_ring *ring;
+	struct ring_record rec;
+	pthread_attr_t attr;
+	unsigned long seq;
+	int ret, s, on = 1;
+	pthread_t tid;
+	size_t bufsz;
+	void *status;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_BUFP));
+	if (s < 0)
+		return s;
+
+	bufsz = RING_BUFSZ;
+	ret = smokey_check_errno(setsockopt(s, SOL_BUFP, BUFP_BUFSZ,
+					    &bufsz, sizeof(bufsz)));
+	if (ret)
+		goto out;
+
+	ret = smokey_check_errno(setsockopt(s, SOL_BUFP, BUFP_SPSC,
+					    &on, sizeof(on)));
+	if (ret)
+		goto out;
+
+	memset(&saddr, 0, sizeof(saddr));
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = BUFP_RGPORT;
+	ret = smokey_check_errno(bind(s, (struct sockaddr *)&saddr,
+				      sizeof(saddr)));
+	if (ret)
+		goto out;
+
+	/* Too late to change modes. */
+	if (!__Tassert(setsockopt(s, SOL_BUFP, BUFP_SPSC,
+				  &on, sizeof(on)) == -1 && errno == EALREADY)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ring = mmap(NULL, RTIPC_BUFP_RING_DATA + 4096, PROT_READ|PROT_WRITE,
+		    MAP_SHARED, s, 0);
+	if (ring == MAP_FAILED) {
+		ret = -errno;
+		smokey_warning("mmap: %s", strerror(errno));
+		goto out;
+	}
+
+	if (!__Tassert(ring->size == 4096)) {
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	/*
+	 * Records do not divide the ring size, which exercises the
+	 * wrap-around on both sides, and the writer outpaces us
+	 * regularly, which exercises the kernel fallback.
+	 */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	ret = -pthread_create(&tid, &attr, ring_writer, NULL);
+	pthread_attr_destroy(&attr);
+	if (ret)
+		goto unmap;
+
+	for (seq = 1; seq <= RING_LOOPS; seq++) {
+		/* Mix in the regular receive path every now and then. */
+		if (seq % 100)
+			ret = rtipc_bufp_read(s, ring, &rec, sizeof(rec));
+		else
+			ret = recv(s, &rec, sizeof(rec), 0);
+		if (ret != sizeof(rec)) {
+			ret = ret < 0 ? -errno : -EPROTO;
+			smokey_warning("short read at #%lu", seq);
+			break;
+		}
+		if (rec.seq != seq) {
+			smokey_warning("expected #%lu, got #%lu", seq, rec.seq);
+			ret = -EPROTO;
+			break;
+		}
+		ret = 0;
+	}
+
+	pthread_join(tid, &status);
+	if (ret == 0 && status) {
+		ret = (long)status;
+		smokey_warning("ring writer: %s", strerror(-ret));
+	}
+
+	if (ret == 0)
+		smokey_trace("%s: %d records passed through the ring",
+			     __func__, RING_LOOPS);
+unmap:
+	munmap(ring, RTIPC_BUFP_RING_DATA + 4096);
+out:
+	close(s);
+
+	return ret;
+}
+
 static int run_bufp(struct smokey_test *t, int argc, char *const argv[])
 {
 	struct sched_param svparam = {.sched_priority = 71 };
@@ -170,5 +332,5 @@ static int run_bufp(struct smokey_test *t, int argc, char *const argv[])
 	pthread_cancel(svtid);
 	pthread_join(svtid, NULL);
 
-	return 0;
+	return check_spsc();
 }
@@ -0,0 +1,328 @@
+/*
+ * Name lookup benchmark for copperplate clusters.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <boilerplate/time.h>
+#include <copperplate/heapobj.h>
+#include <copperplate/cluster.h>
+#include <copperplate/tunables.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(hash_lookup,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(objects),
+			   SMOKEY_INT(loops),
+		   ),
+   "Check name indexing in private and shared copperplate clusters\n"
+   "\twhile the underlying hash table is resized, then measure the\n"
+   "\taverage cost of a name lookup for an increasing number of\n"
+   "\tobjects, up to the value of the objects parameter. Each lookup\n"
+   "\tpass is repeated loops times."
+);
+
+#define MIN_OBJECTS	256
+#define NAME_LEN	32
+
+struct test_obj {
+	struct pvclusterobj cobj;
+	char name[NAME_LEN];
+};
+
+static struct test_obj *objs;
+
+static int walk_count;
+
+static int count_obj(struct pvcluster *c, struct pvclusterobj *cobj)
+{
+	walk_count++;
+	return 0;
+}
+
+static unsigned long long elapsed_ns(const struct timespec *start)
+{
+	struct timespec now, delta;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&delta, &now, start);
+
+	return delta.tv_sec * ONE_BILLION + delta.tv_nsec;
+}
+
+static int fill_cluster(struct pvcluster *c, int from, int to)
+{
+	int n, ret;
+
+	for (n = from; n < to; n++) {
+		ret = pvcluster_addobj(c, objs[n].name, &objs[n].cobj);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int check_cluster(struct pvcluster *c, int from, int to)
+{
+	struct pvclusterobj *cobj;
+	int n;
+
+	for (n = from; n < to; n++) {
+		cobj = pvcluster_findobj(c, objs[n].name);
+		if (!__Tassert(cobj == &objs[n].cobj))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int check_resize(int nrobj)
+{
+	int ret, n, next, step = nrobj / 16;
+	struct test_obj dup;
+	struct pvcluster c;
+
+	/*
+	 * Start from a tiny table, so that it has to grow a number of
+	 * times, checking that every object can be found in between,
+	 * including while slots are being migrated.
+	 */
+	pvhash_init_size(&c.table, 4);
+
+	for (n = 0; n < nrobj; n = next) {
+		next = n + step < nrobj ? n + step : nrobj;
+		ret = fill_cluster(&c, n, next);
+		if (ret)
+			return ret;
+		ret = check_cluster(&c, 0, next);
+		if (ret)
+			return ret;
+	}
+
+	strcpy(dup.name, objs[0].name);
+	if (!__Tassert(pvcluster_addobj(&c, dup.name, &dup.cobj) == -EEXIST))
+		return -EINVAL;
+
+	if (!__Tassert(pvcluster_findobj(&c, "no-such-object") == NULL))
+		return -EINVAL;
+
+	walk_count = 0;
+	pvcluster_walk(&c, count_obj);
+	if (!__Tassert(walk_count == nrobj))
+		return -EINVAL;
+
+	/* Drop most objects, the table shrinks as we go. */
+	for (n = 0; n < nrobj - 16; n++) {
+		ret = pvcluster_delobj(&c, &objs[n].cobj);
+		if (ret)
+			return ret;
+		if (!__Tassert(pvcluster_findobj(&c, objs[n].name) == NULL))
+			return -EINVAL;
+	}
+
+	ret = check_cluster(&c, nrobj - 16, nrobj);
+	if (ret)
+		return ret;
+
+	walk_count = 0;
+	pvcluster_walk(&c, count_obj);
+	if (!__Tassert(walk_count == 16))
+		return -EINVAL;
+
+	pvcluster_destroy(&c);
+
+	return 0;
+}
+
+#ifdef CONFIG_XENO_PSHARED
+
+struct shared_obj {
+	struct clusterobj cobj;
+	char name[NAME_LEN];
+};
+
+static int count_shared_obj(struct cluster *c, struct clusterobj *cobj)
+{
+	walk_count++;
+	return 0;
+}
+
+/*
+ * Same drill with a shared cluster, which indexes objects from the
+ * main heap by offset, with slot arrays obtained from xnmalloc().
+ * Lookups discard the objects whose owner is gone, which must let
+ * the table shrink too.
+ */
+static int check_shared(int nrobj)
+{
+	struct shared_obj *sobjs;
+	struct hash_table *t;
+	char name[NAME_LEN];
+	unsigned int peak;
+	struct cluster c;
+	int ret, n;
+
+	sobjs = xnmalloc(nrobj * sizeof(*sobjs));
+	if (sobjs == NULL)
+		return -ENOMEM;
+
+	/* Shared clusters are never deleted, use a fresh one. */
+	snprintf(name, sizeof(name), "smokey.hash.%d", getpid());
+	ret = cluster_init(&c, name);
+	if (ret)
+		goto out;
+
+	t = &c.d->table;
+
+	for (n = 0; n < nrobj; n++) {
+		strcpy(sobjs[n].name, objs[n].name);
+		ret = cluster_addobj(&c, sobjs[n].name, &sobjs[n].cobj);
+		if (ret)
+			goto out;
+	}
+
+	for (n = 0; n < nrobj; n++) {
+		if (!__Tassert(cluster_findobj(&c, sobjs[n].name) ==
+			       &sobjs[n].cobj)) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	peak = t->size;
+	smokey_trace("shared table grown to %u slots", peak);
+
+	/* Pretend that the owner of most objects has exited. */
+	for (n = 0; n < nrobj - 16; n++)
+		sobjs[n].cobj.cnode = INT_MAX;
+
+	for (n = 0; n < nrobj - 16; n++) {
+		if (!__Tassert(cluster_findobj(&c, sobjs[n].name) == NULL)) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	for (n = nrobj - 16; n < nrobj; n++) {
+		if (!__Tassert(cluster_findobj(&c, sobjs[n].name) ==
+			       &sobjs[n].cobj)) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	if (!__Tassert(t->count == 16 &&
+		       (t->size < peak || peak == t->init_size))) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	walk_count = 0;
+	cluster_walk(&c, count_shared_obj);
+	if (!__Tassert(walk_count == 16)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (n = nrobj - 16; n < nrobj; n++)
+		cluster_delobj(&c, &sobjs[n].cobj);
+out:
+	xnfree(sobjs);
+
+	return ret;
+}
+
+#else /* !CONFIG_XENO_PSHARED */
+
+static inline int check_shared(int nrobj)
+{
+	return 0;	/* Same as the private ones. */
+}
+
+#endif /* !CONFIG_XENO_PSHARED */
+
+static int run_bench(int nrobj, int loops)
+{
+	unsigned long long insert_ns, lookup_ns;
+	struct timespec start;
+	struct pvcluster c;
+	int ret, n, count;
+
+	smokey_trace("%10s %12s %12s", "objects", "insert (ns)",
+		     "lookup (ns)");
+
+	for (count = MIN_OBJECTS; count <= nrobj; count *= 2) {
+		pvcluster_init(&c, "smokey.hash");
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ret = fill_cluster(&c, 0, count);
+		insert_ns = elapsed_ns(&start);
+		if (ret)
+			return ret;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (n = 0; n < loops; n++) {
+			ret = check_cluster(&c, 0, count);
+			if (ret)
+				return ret;
+		}
+		lookup_ns = elapsed_ns(&start);
+
+		smokey_trace("%10d %12.1f %12.1f", count,
+			     (double)insert_ns / count,
+			     (double)lookup_ns / ((double)count * loops));
+
+		for (n = 0; n < count; n++)
+			pvcluster_delobj(&c, &objs[n].cobj);
+
+		pvcluster_destroy(&c);
+	}
+
+	return 0;
+}
+
+static int run_hash_lookup(struct smokey_test *t, int argc, char *const argv[])
+{
+	int nrobj = 32768, loops = 10, ret, n;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(hash_lookup, objects))
+		nrobj = SMOKEY_ARG_INT(hash_lookup, objects);
+	if (nrobj < MIN_OBJECTS)
+		nrobj = MIN_OBJECTS;
+
+	if (SMOKEY_ARG_ISSET(hash_lookup, loops))
+		loops = SMOKEY_ARG_INT(hash_lookup, loops);
+	if (loops <= 0)
+		loops = 1;
+
+	objs = calloc(nrobj, sizeof(*objs));
+	if (objs == NULL)
+		return -ENOMEM;
+
+	/* Names look like the ones applications usually pick. */
+	for (n = 0; n < nrobj; n++)
+		snprintf(objs[n].name, sizeof(objs[n].name),
+			 "task-%d", n);
+
+	smokey_trace("initial table size: %u slots",
+		     get_config_tunable(hash_size));
+
+	ret = check_resize(nrobj);
+	if (ret == 0)
+		ret = check_shared(nrobj);
+	if (ret == 0)
+		ret = run_bench(nrobj, loops);
+
+	free(objs);
+
+	return ret;
+}
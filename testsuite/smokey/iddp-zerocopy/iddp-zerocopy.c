@@ -0,0 +1,403 @@
+/*
+ * RTIPC/IDDP zero-copy test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <boilerplate/time.h>
+#include <smokey/smokey.h>
+#include <rtdm/ipc.h>
+
+smokey_test_plugin(iddp_zerocopy,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+   "Check the zero-copy mode of the RTIPC/IDDP protocol. Buffers\n"
+   "\tare passed between two sockets sharing a pool, with copy-mode\n"
+   "\ttransfers to and from the pool checked too. Then the throughput\n"
+   "\tof copy and zero-copy transfers is compared for message sizes\n"
+   "\tfrom 64 bytes to 64 KiB, over the given number of loops."
+);
+
+#define ZC_RXPORT	14
+#define ZC_TXPORT	15
+#define CP_RXPORT	16
+#define ZC_BUFSZ	65536
+#define ZC_NBUFS	16
+#define ZC_POOLSZ	(ZC_BUFSZ * ZC_NBUFS)
+
+static char msgbuf[ZC_BUFSZ + 1];
+
+static int zc_send(int s, struct rtipc_iddp_zcbuf *zc)
+{
+	struct iovec iov = { .iov_base = zc, .iov_len = sizeof(*zc) };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+	return sendmsg(s, &msg, MSG_ZEROCOPY);
+}
+
+static int zc_recv(int s, struct rtipc_iddp_zcbuf *zc)
+{
+	struct iovec iov = { .iov_base = zc, .iov_len = sizeof(*zc) };
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+	return recvmsg(s, &msg, MSG_ZEROCOPY);
+}
+
+static int bind_port(int s, int port)
+{
+	struct sockaddr_ipc saddr;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+
+	return bind(s, (struct sockaddr *)&saddr, sizeof(saddr));
+}
+
+static int connect_port(int s, int port)
+{
+	struct sockaddr_ipc saddr;
+
+	saddr.sipc_family = AF_RTIPC;
+	saddr.sipc_port = port;
+
+	return connect(s, (struct sockaddr *)&saddr, sizeof(saddr));
+}
+
+static int create_socket(size_t poolsz, size_t zcbufsz, int port)
+{
+	int s, ret;
+
+	s = smokey_check_errno(socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP));
+	if (s < 0)
+		return s;
+
+	if (poolsz) {
+		ret = smokey_check_errno(setsockopt(s, SOL_IDDP, IDDP_POOLSZ,
+						    &poolsz, sizeof(poolsz)));
+		if (ret)
+			goto fail;
+	}
+
+	if (zcbufsz) {
+		ret = smokey_check_errno(setsockopt(s, SOL_IDDP, IDDP_ZCBUFSZ,
+						    &zcbufsz, sizeof(zcbufsz)));
+		if (ret)
+			goto fail;
+	}
+
+	ret = smokey_check_errno(bind_port(s, port));
+	if (ret)
+		goto fail;
+
+	return s;
+fail:
+	close(s);
+
+	return ret;
+}
+
+static int check_zerocopy(int rx, int tx, char *rxmem, char *txmem)
+{
+	struct rtipc_iddp_zcbuf zc, rzc, bufs[ZC_NBUFS];
+	int ret, n;
+
+	/* Fill a buffer in place, pass it, read it in place. */
+	zc.flags = 0;
+	ret = smokey_check_errno(ioctl(tx, IDDP_RTIOC_ZCALLOC, &zc));
+	if (ret)
+		return ret;
+	if (!__Tassert(zc.len == ZC_BUFSZ && zc.offset % ZC_BUFSZ == 0))
+		return -EINVAL;
+
+	memset(txmem + zc.offset, 0xa5, 1000);
+	zc.len = 1000;
+	ret = smokey_check_errno(zc_send(tx, &zc));
+	if (ret < 0)
+		return ret;
+	if (!__Tassert(ret == 1000))
+		return -EINVAL;
+
+	/* The sender lost ownership. */
+	if (!__Tassert(zc_send(tx, &zc) < 0 && errno == EINVAL))
+		return -EINVAL;
+
+	ret = smokey_check_errno(zc_recv(rx, &rzc));
+	if (ret < 0)
+		return ret;
+	if (!__Tassert(ret == 1000 && rzc.len == 1000 &&
+		       rzc.offset == zc.offset && rzc.from == ZC_TXPORT))
+		return -EINVAL;
+	if (!__Tassert(rxmem[rzc.offset] == (char)0xa5 &&
+		       rxmem[rzc.offset + 999] == (char)0xa5))
+		return -EINVAL;
+
+	ret = smokey_check_errno(ioctl(rx, IDDP_RTIOC_ZCFREE, &rzc));
+	if (ret)
+		return ret;
+	if (!__Tassert(ioctl(rx, IDDP_RTIOC_ZCFREE, &rzc) < 0 &&
+		       errno == EINVAL))
+		return -EINVAL;
+
+	/* Exhaust the pool, then release everything. */
+	for (n = 0; n < ZC_NBUFS; n++) {
+		bufs[n].flags = MSG_DONTWAIT;
+		ret = smokey_check_errno(ioctl(tx, IDDP_RTIOC_ZCALLOC, &bufs[n]));
+		if (ret)
+			return ret;
+	}
+
+	zc.flags = MSG_DONTWAIT;
+	if (!__Tassert(ioctl(tx, IDDP_RTIOC_ZCALLOC, &zc) < 0 &&
+		       errno == EAGAIN))
+		return -EINVAL;
+
+	for (n = 0; n < ZC_NBUFS; n++) {
+		ret = smokey_check_errno(ioctl(tx, IDDP_RTIOC_ZCFREE, &bufs[n]));
+		if (ret)
+			return ret;
+	}
+
+	/* Copy-mode sends land into the pool. */
+	memset(msgbuf, 0x5a, 100);
+	ret = smokey_check_errno(send(tx, msgbuf, 100, 0));
+	if (ret < 0)
+		return ret;
+
+	ret = smokey_check_errno(zc_recv(rx, &rzc));
+	if (ret < 0)
+		return ret;
+	if (!__Tassert(ret == 100 && rxmem[rzc.offset + 99] == 0x5a))
+		return -EINVAL;
+
+	ret = smokey_check_errno(ioctl(rx, IDDP_RTIOC_ZCFREE, &rzc));
+	if (ret)
+		return ret;
+
+	if (!__Tassert(send(tx, msgbuf, ZC_BUFSZ + 1, 0) < 0 &&
+		       errno == EMSGSIZE))
+		return -EINVAL;
+
+	/* Copy-mode receives read from the pool. */
+	zc.flags = 0;
+	ret = smokey_check_errno(ioctl(tx, IDDP_RTIOC_ZCALLOC, &zc));
+	if (ret)
+		return ret;
+
+	memset(txmem + zc.offset, 0x3c, 200);
+	zc.len = 200;
+	ret = smokey_check_errno(zc_send(tx, &zc));
+	if (ret < 0)
+		return ret;
+
+	memset(msgbuf, 0, 200);
+	ret = smokey_check_errno(recv(rx, msgbuf, sizeof(msgbuf), 0));
+	if (ret < 0)
+		return ret;
+	if (!__Tassert(ret == 200 && msgbuf[199] == 0x3c))
+		return -EINVAL;
+
+	return 0;
+}
+
+static inline unsigned long long elapsed_ns(const struct timespec *start)
+{
+	struct timespec now, delta;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&delta, &now, start);
+
+	return delta.tv_sec * 1000000000ULL + delta.tv_nsec;
+}
+
+static int bench_copy(int rx, int tx, size_t size, int loops,
+		      unsigned long long *ns_r)
+{
+	struct timespec start;
+	int n, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (n = 0; n < loops; n++) {
+		ret = smokey_check_errno(send(tx, msgbuf, size, 0));
+		if (ret < 0)
+			return ret;
+		ret = smokey_check_errno(recv(rx, msgbuf, size, 0));
+		if (ret < 0)
+			return ret;
+	}
+
+	*ns_r = elapsed_ns(&start);
+
+	return 0;
+}
+
+static int bench_zerocopy(int rx, int tx, size_t size, int loops,
+			  unsigned long long *ns_r)
+{
+	struct rtipc_iddp_zcbuf zc;
+	struct timespec start;
+	int n, ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (n = 0; n < loops; n++) {
+		zc.flags = 0;
+		ret = smokey_check_errno(ioctl(tx, IDDP_RTIOC_ZCALLOC, &zc));
+		if (ret)
+			return ret;
+		zc.len = size;
+		ret = smokey_check_errno(zc_send(tx, &zc));
+		if (ret < 0)
+			return ret;
+		ret = smokey_check_errno(zc_recv(rx, &zc));
+		if (ret < 0)
+			return ret;
+		ret = smokey_check_errno(ioctl(rx, IDDP_RTIOC_ZCFREE, &zc));
+		if (ret)
+			return ret;
+	}
+
+	*ns_r = elapsed_ns(&start);
+
+	return 0;
+}
+
+static int run_bench(int rx, int tx, int cprx, int cptx, int loops)
+{
+	unsigned long long cpns, zcns;
+	size_t size;
+	int ret;
+
+	smokey_trace("%8s %12s %12s %12s %12s",
+		     "size", "copy msg/s", "copy MB/s",
+		     "zcopy msg/s", "zcopy MB/s");
+
+	for (size = 64; size <= ZC_BUFSZ; size *= 4) {
+		ret = bench_copy(cprx, cptx, size, loops, &cpns);
+		if (ret)
+			return ret;
+		ret = bench_zerocopy(rx, tx, size, loops, &zcns);
+		if (ret)
+			return ret;
+		smokey_trace("%8zu %12.0f %12.1f %12.0f %12.1f", size,
+			     loops * 1e9 / cpns, loops * size * 1e3 / cpns,
+			     loops * 1e9 / zcns, loops * size * 1e3 / zcns);
+	}
+
+	return 0;
+}
+
+static int run_iddp_zerocopy(struct smokey_test *t,
+			     int argc, char *const argv[])
+{
+	int rx = -1, tx = -1, cprx = -1, cptx = -1, ret, loops = 10000;
+	struct sched_param param = { .sched_priority = 50 };
+	char *rxmem = MAP_FAILED, *txmem = MAP_FAILED;
+	size_t zcbufsz;
+	socklen_t len;
+
+	ret = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+	if (ret < 0) {
+		if (errno == EAFNOSUPPORT)
+			return -ENOSYS;
+	} else
+		close(ret);
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(iddp_zerocopy, loops) &&
+	    SMOKEY_ARG_INT(iddp_zerocopy, loops) > 0)
+		loops = SMOKEY_ARG_INT(iddp_zerocopy, loops);
+
+	ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+	if (ret) {
+		smokey_warning("pthread_setschedparam(SCHED_FIFO, 50) failed");
+		return -ret;
+	}
+
+	rx = create_socket(ZC_POOLSZ, ZC_BUFSZ, ZC_RXPORT);
+	if (rx < 0)
+		return rx;
+
+	len = sizeof(zcbufsz);
+	ret = smokey_check_errno(getsockopt(rx, SOL_IDDP, IDDP_ZCBUFSZ,
+					    &zcbufsz, &len));
+	if (ret)
+		goto out;
+	if (!__Tassert(zcbufsz == ZC_BUFSZ)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	tx = create_socket(0, 0, ZC_TXPORT);
+	if (tx < 0) {
+		ret = tx;
+		goto out;
+	}
+
+	/* No pool to map until connected. */
+	if (!__Tassert(mmap(NULL, ZC_POOLSZ, PROT_READ|PROT_WRITE,
+			    MAP_SHARED, tx, 0) == MAP_FAILED)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = smokey_check_errno(connect_port(tx, ZC_RXPORT));
+	if (ret)
+		goto out;
+
+	rxmem = mmap(NULL, ZC_POOLSZ, PROT_READ|PROT_WRITE,
+		     MAP_SHARED, rx, 0);
+	txmem = mmap(NULL, ZC_POOLSZ, PROT_READ|PROT_WRITE,
+		     MAP_SHARED, tx, 0);
+	if (rxmem == MAP_FAILED || txmem == MAP_FAILED) {
+		ret = -errno;
+		smokey_warning("mmap: %s", strerror(errno));
+		goto out;
+	}
+
+	ret = check_zerocopy(rx, tx, rxmem, txmem);
+	if (ret)
+		goto out;
+
+	cprx = create_socket(ZC_POOLSZ, 0, CP_RXPORT);
+	if (cprx < 0) {
+		ret = cprx;
+		goto out;
+	}
+
+	cptx = create_socket(0, 0, -1);
+	if (cptx < 0) {
+		ret = cptx;
+		goto out;
+	}
+
+	ret = smokey_check_errno(connect_port(cptx, CP_RXPORT));
+	if (ret)
+		goto out;
+
+	ret = run_bench(rx, tx, cprx, cptx, loops);
+out:
+	if (txmem != MAP_FAILED)
+		munmap(txmem, ZC_POOLSZ);
+	if (rxmem != MAP_FAILED)
+		munmap(rxmem, ZC_POOLSZ);
+	if (cptx >= 0)
+		close(cptx);
+	if (cprx >= 0)
+		close(cprx);
+	if (tx >= 0)
+		close(tx);
+	close(rx);
+
+	return ret;
+}
@@ -230,7 +230,13 @@ static int smokey_net_client_loop(struct smokey_net_client *client)
 
 static void *trampoline(void *cookie)
 {
-	int err = smokey_net_client_loop(cookie);
+	struct smokey_net_client *client = cookie;
+	int err;
+
+	if (client->loop)
+		err = client->loop(client);
+	else
+		err = smokey_net_client_loop(client);
 	pthread_exit((void *)(long)err);
 }
 
@@ -260,6 +266,8 @@ int smokey_net_client_run(struct smokey_test *t,
 		}
 	}
 
+	client->duration = duration;
+
 	if (!intf)
 		intf = strcmp(driver, "rt_loopback") ? "rteth0" : "rtlo";
 
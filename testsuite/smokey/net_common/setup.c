@@ -55,6 +55,10 @@ static struct module modules[] = {
 		.option = _CC_COBALT_NET_AF_PACKET,
 		.name = "rtpacket",
 	},
+	{
+		.option = _CC_COBALT_NET_TCP,
+		.name = "rttcp",
+	},
 	{
 		.name = NULL,	/* driver */
 	},
@@ -65,7 +69,8 @@ static struct module modules[] = {
 #define MODID_CFG    2
 #define MODID_UDP    3
 #define MODID_PACKET 4
-#define MODID_DRIVER 5
+#define MODID_TCP    5
+#define MODID_DRIVER 6
 
 static int option_to_modid(int option)
 {
@@ -480,7 +485,9 @@ running:
 			goto err;
 	}
 
-	if (strcmp(driver, "rt_loopback") == 0) {
+	/* The TCP test brings its own loopback peer. */
+	if (strcmp(driver, "rt_loopback") == 0 &&
+		tested_config != _CC_COBALT_NET_TCP) {
 		err  = smokey_check_status(
 			__RT(pthread_create(&loopback_server_tid, NULL,
 						loopback_server,
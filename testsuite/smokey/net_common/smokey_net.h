@@ -32,6 +32,7 @@ struct smokey_net_client {
 		struct sockaddr_in in_peer;
 	};
 	socklen_t peer_len;
+	int duration;
 
 	int (*create_socket)(struct smokey_net_client *client);
 	int (*prepare)(struct smokey_net_client *client,
@@ -40,6 +41,8 @@ struct smokey_net_client {
 	int (*extract)(struct smokey_net_client *client,
 		struct smokey_net_payload *payload,
 		const void *buf, size_t len);
+	/* optional, replaces the round trip test loop */
+	int (*loop)(struct smokey_net_client *client);
 };
 
 int smokey_net_setup(const char *driver, const char *intf, int tested_config,
@@ -6,7 +6,12 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <net/ethernet.h>
@@ -16,6 +21,7 @@
 
 #include <sys/cobalt.h>
 #include <smokey/smokey.h>
+#include <rtdm/net.h>
 #include "smokey_net.h"
 
 smokey_test_plugin(net_packet_raw,
@@ -24,6 +30,7 @@ smokey_test_plugin(net_packet_raw,
 		SMOKEY_STRING(rtnet_interface),
 		SMOKEY_INT(rtnet_rate),
 		SMOKEY_INT(rtnet_duration),
+		SMOKEY_INT(rtnet_ring),
 	),
 	"Check RTnet driver, using raw packets, measuring round trip time\n"
 	"\tand packet losses,\n"
@@ -31,14 +38,19 @@ smokey_test_plugin(net_packet_raw,
 	"\tthe rtnet_interface parameter allows choosing the network interface\n"
 	"\tthe rtnet_rate parameter allows choosing the packet rate\n"
 	"\tthe rtnet_duration parameter allows choosing the test duration\n"
+	"\tthe rtnet_ring parameter switches to measuring the throughput\n"
+	"\tof mmap'ed socket rings with the given number of frames\n"
 	"\tA server on the network must run the smokey_rtnet_server program."
 );
 
 struct raw_packet_client {
 	struct smokey_net_client base;
 	struct ethhdr header;
+	unsigned int ring_frames;
 };
 
+#define RING_FRAME_SIZE 256
+
 static int
 packet_raw_create_socket(struct smokey_net_client *bclient)
 {
@@ -100,6 +112,194 @@ packet_raw_extract(struct smokey_net_client *bclient,
 	return len;
 }
 
+static inline struct rtnet_ring_slot *
+ring_slot(void *mem, unsigned int n)
+{
+	return mem + (size_t)n * RING_FRAME_SIZE;
+}
+
+static inline void *ring_data(struct rtnet_ring_slot *slot)
+{
+	return (void *)slot + RTNET_RING_DATA_OFFSET;
+}
+
+static void ring_report(const char *what, unsigned long long frames,
+			unsigned long long bytes, long long ns)
+{
+	double secs = ns / 1000000000.0;
+
+	smokey_trace("%s: %Lu frames, %.2f frames/s, %.2f KB/s",
+		     what, frames, frames / secs, bytes / secs / 1024);
+}
+
+/*
+ * Throughput test over mmap'ed rings: fill the whole TX ring, push it
+ * with a single RTNET_RTIOC_RING_SEND, then collect the echoed frames
+ * from the RX ring, without copying any frame through recv/send.
+ */
+static int packet_raw_ring_loop(struct smokey_net_client *bclient)
+{
+	struct raw_packet_client *client = (struct raw_packet_client *)bclient;
+	unsigned long long sent = 0, received = 0, bytes = 0, errors = 0;
+	unsigned long long last_received = 0, last_bytes = 0;
+	unsigned int frames = client->ring_frames, rx = 0, tx, n;
+	struct timespec start, now, last_print;
+	struct smokey_net_payload payload, reply;
+	nanosecs_rel_t timeout = 100000000;
+	struct rtnet_ring_stats stats;
+	struct rtnet_ring_slot *slot;
+	struct rtnet_ring_req req;
+	struct sched_param prio;
+	long long elapsed = 0, diff;
+	int sock, err, len;
+	size_t size;
+	void *mem;
+
+	sock = bclient->create_socket(bclient);
+	if (sock < 0)
+		return sock;
+
+	prio.sched_priority = 20;
+	err = smokey_check_status(
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &prio));
+	if (err < 0)
+		goto close;
+
+	req.frame_size = RING_FRAME_SIZE;
+	req.rx_frames = frames;
+	req.tx_frames = frames;
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_RING, &req)));
+	if (err < 0)
+		goto close;
+
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_TIMEOUT, &timeout)));
+	if (err < 0)
+		goto close;
+
+	size = (size_t)RING_FRAME_SIZE * 2 * frames;
+	mem = __RT(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			sock, 0));
+	if (mem == MAP_FAILED) {
+		err = -errno;
+		smokey_warning("mmap(): %s", strerror(errno));
+		goto close;
+	}
+
+	err = smokey_check_errno(
+		__RT(clock_gettime(CLOCK_MONOTONIC, &start)));
+	if (err < 0)
+		goto unmap;
+	last_print = start;
+
+	smokey_trace("\nRing mode, %u frames of %u bytes", frames,
+		     RING_FRAME_SIZE);
+
+	payload.seq = 0;
+	for (;;) {
+		for (n = 0, tx = frames; n < frames; n++, tx++) {
+			slot = ring_slot(mem, tx);
+			if (slot->status == RTNET_RING_ERROR)
+				errors++;
+			payload.seq++;
+			__RT(clock_gettime(CLOCK_MONOTONIC, &payload.ts));
+			len = bclient->prepare(bclient, ring_data(slot),
+					RING_FRAME_SIZE - RTNET_RING_DATA_OFFSET,
+					&payload);
+			if (len < 0) {
+				err = len;
+				goto unmap;
+			}
+			slot->len = len;
+			slot->addrlen = bclient->peer_len;
+			memcpy(slot->addr, &bclient->ll_peer,
+			       bclient->peer_len);
+			__sync_synchronize();
+			slot->status = RTNET_RING_SEND;
+		}
+
+		err = smokey_check_errno(
+			__RT(ioctl(sock, RTNET_RTIOC_RING_SEND)));
+		if (err < 0)
+			goto unmap;
+		sent += err;
+
+		/* Collect the replies to this batch. */
+		for (n = 0; n < (unsigned int)err; n++) {
+			slot = ring_slot(mem, rx);
+			if (slot->status != RTNET_RING_USER) {
+				if (__RT(ioctl(sock, RTNET_RTIOC_RING_WAIT,
+					       &rx)) < 0) {
+					if (errno == ETIMEDOUT)
+						break;
+					err = -errno;
+					smokey_warning("RTNET_RTIOC_RING_WAIT: %s",
+						       strerror(errno));
+					goto unmap;
+				}
+			}
+			__sync_synchronize();
+			if (bclient->extract(bclient, &reply,
+					     ring_data(slot), slot->len) >= 0) {
+				received++;
+				bytes += slot->len;
+			}
+			slot->status = RTNET_RING_KERNEL;
+			if (++rx == frames)
+				rx = 0;
+		}
+
+		err = smokey_check_errno(
+			__RT(clock_gettime(CLOCK_MONOTONIC, &now)));
+		if (err < 0)
+			goto unmap;
+
+		diff = (now.tv_sec - last_print.tv_sec) * 1000000000LL
+			+ now.tv_nsec - last_print.tv_nsec;
+		if (diff >= 1000000000LL) {
+			ring_report("RX", received - last_received,
+				    bytes - last_bytes, diff);
+			last_received = received;
+			last_bytes = bytes;
+			last_print = now;
+		}
+
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000000LL
+			+ now.tv_nsec - start.tv_nsec;
+		if (elapsed >= bclient->duration * 1000000000LL)
+			break;
+	}
+
+	smokey_trace("\nsent %Lu frames, received %Lu, %Lu TX errors",
+		     sent, received, errors);
+	ring_report("total", received, bytes, elapsed);
+
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_RING_STATS, &stats)));
+	if (err < 0)
+		goto unmap;
+	smokey_trace("ring: %Lu frames delivered, %Lu dropped",
+		     (unsigned long long)stats.rx_delivered,
+		     (unsigned long long)stats.rx_drops);
+
+	err = 0;
+	if (received == 0) {
+		fprintf(stderr, "RTnet %s ring test failed, all packets lost"
+			" (is smokey_net_server running ?)\n", bclient->name);
+		err = -EPROTO;
+	}
+
+  unmap:
+	munmap(mem, size);
+  close:
+	len = smokey_check_errno(__RT(close(sock)));
+	if (err == 0)
+		err = len;
+
+	return err;
+}
+
 static int
 run_net_packet_raw(struct smokey_test *t, int argc, char *const argv[])
 {
@@ -114,6 +314,17 @@ run_net_packet_raw(struct smokey_test *t, int argc, char *const argv[])
 	};
 	struct smokey_net_client *bclient = &client.base;
 
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(*t, rtnet_ring)) {
+		client.ring_frames = SMOKEY_ARG_INT(*t, rtnet_ring);
+		if (client.ring_frames == 0) {
+			smokey_warning("ring size can not be null");
+			return -EINVAL;
+		}
+		bclient->loop = &packet_raw_ring_loop;
+	}
+
 	memset(&bclient->ll_peer, '\0', sizeof(bclient->ll_peer));
 	bclient->ll_peer.sll_family = AF_PACKET;
 	bclient->peer_len = sizeof(bclient->ll_peer);
@@ -0,0 +1,292 @@
+/*
+ * RTnet TCP test
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <sys/cobalt.h>
+#include <smokey/smokey.h>
+#include <rtdm/net.h>
+#include "smokey_net.h"
+
+smokey_test_plugin(net_tcp,
+	SMOKEY_ARGLIST(
+		SMOKEY_STRING(rtnet_driver),
+		SMOKEY_STRING(rtnet_interface),
+		SMOKEY_INT(rtnet_rate),
+		SMOKEY_INT(rtnet_duration),
+	),
+	"Check RTnet driver, using a TCP connection, measuring the bulk\n"
+	"\ttransfer throughput,\n"
+	"\tthe rtnet_driver parameter allows choosing the network driver\n"
+	"\tthe rtnet_interface parameter allows choosing the network interface\n"
+	"\tthe rtnet_duration parameter allows choosing the test duration\n"
+	"\tOver the loopback driver, the test runs its own receiver, otherwise\n"
+	"\tthe peer must accept connections on the TCP discard port."
+);
+
+#define TCP_DISCARD_PORT 9
+#define TCP_CHUNK_SIZE   16384
+
+struct tcp_sink {
+	sem_t ready;
+	volatile unsigned long long bytes;
+	int err;
+};
+
+static int tcp_create_socket(struct smokey_net_client *client)
+{
+	return smokey_check_errno(__RT(socket(PF_INET, SOCK_STREAM, 0)));
+}
+
+static int tcp_sink_listen(void)
+{
+	nanosecs_rel_t timeout = 5000000000LL;
+	struct sockaddr_in name;
+	int sock, err;
+
+	sock = tcp_create_socket(NULL);
+	if (sock < 0)
+		return sock;
+
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_TIMEOUT, &timeout)));
+	if (err < 0)
+		goto err;
+
+	memset(&name, 0, sizeof(name));
+	name.sin_family = AF_INET;
+	name.sin_port = htons(TCP_DISCARD_PORT);
+	name.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	err = smokey_check_errno(
+		__RT(bind(sock, (struct sockaddr *)&name, sizeof(name))));
+	if (err < 0)
+		goto err;
+
+	err = smokey_check_errno(__RT(listen(sock, 1)));
+	if (err < 0)
+		goto err;
+
+	return sock;
+
+  err:
+	__RT(close(sock));
+	return err;
+}
+
+/*
+ * Loopback peer: accept a single connection, then count and drop
+ * whatever arrives until the client closes it.
+ */
+static void *tcp_sink(void *cookie)
+{
+	struct tcp_sink *sink = cookie;
+	struct sched_param prio;
+	char buf[TCP_CHUNK_SIZE];
+	int sock, conn, ret;
+
+	prio.sched_priority = 20;
+	__RT(pthread_setschedparam(pthread_self(), SCHED_FIFO, &prio));
+
+	sock = tcp_sink_listen();
+	sink->err = sock < 0 ? sock : 0;
+	sem_post(&sink->ready);
+	if (sock < 0)
+		return NULL;
+
+	/* RTnet TCP turns the listening socket into the connection. */
+	conn = smokey_check_errno(__RT(accept(sock, NULL, NULL)));
+	if (conn < 0) {
+		sink->err = conn;
+		goto out;
+	}
+
+	for (;;) {
+		ret = __RT(read(conn, buf, sizeof(buf)));
+		if (ret <= 0)
+			break;
+		sink->bytes += ret;
+	}
+
+	if (ret < 0) {
+		sink->err = -errno;
+		smokey_warning("read: %s", strerror(errno));
+	}
+
+	if (conn != sock)
+		__RT(close(conn));
+  out:
+	__RT(close(sock));
+
+	return NULL;
+}
+
+static void tcp_report(const char *what, unsigned long long bytes,
+		       long long ns)
+{
+	double secs = ns / 1000000000.0;
+
+	smokey_trace("%s: %Lu bytes, %.2f MB/s",
+		     what, bytes, bytes / secs / (1024 * 1024));
+}
+
+static int tcp_throughput_loop(struct smokey_net_client *client)
+{
+	unsigned long long sent = 0, last_sent = 0;
+	struct timespec start, now, last_print;
+	long long diff, elapsed = 0;
+	struct sched_param prio;
+	struct tcp_sink sink;
+	pthread_t sink_tid;
+	struct timeval tv;
+	int sock, err, tmp, n;
+	bool local;
+	char *buf;
+
+	prio.sched_priority = 20;
+	err = smokey_check_status(
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &prio));
+	if (err < 0)
+		return err;
+
+	buf = malloc(TCP_CHUNK_SIZE);
+	if (buf == NULL)
+		return -ENOMEM;
+	memset(buf, 0xa5, TCP_CHUNK_SIZE);
+
+	local = (ntohl(client->in_peer.sin_addr.s_addr) >> IN_CLASSA_NSHIFT)
+		== IN_LOOPBACKNET;
+	if (local) {
+		memset(&sink, 0, sizeof(sink));
+		sem_init(&sink.ready, 0, 0);
+		err = smokey_check_status(
+			__RT(pthread_create(&sink_tid, NULL, tcp_sink, &sink)));
+		if (err < 0)
+			goto free;
+		sem_wait(&sink.ready);
+		if (sink.err) {
+			err = sink.err;
+			goto join;
+		}
+	}
+
+	sock = client->create_socket(client);
+	if (sock < 0) {
+		err = sock;
+		goto join;
+	}
+
+	/* Do not hang if the peer stops acknowledging. */
+	tv.tv_sec = 1;
+	tv.tv_usec = 0;
+	err = smokey_check_errno(
+		__RT(setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO,
+				&tv, sizeof(tv))));
+	if (err < 0)
+		goto close;
+
+	err = __RT(connect(sock, &client->peer, client->peer_len));
+	if (err < 0) {
+		err = -errno;
+		smokey_warning("connect: %s (is the peer listening on"
+			       " port %d ?)", strerror(errno),
+			       TCP_DISCARD_PORT);
+		goto close;
+	}
+
+	err = smokey_check_errno(__RT(clock_gettime(CLOCK_MONOTONIC, &start)));
+	if (err < 0)
+		goto close;
+	last_print = start;
+
+	for (;;) {
+		err = smokey_check_errno(
+			__RT(write(sock, buf, TCP_CHUNK_SIZE)));
+		if (err < 0)
+			goto close;
+		sent += err;
+
+		err = smokey_check_errno(
+			__RT(clock_gettime(CLOCK_MONOTONIC, &now)));
+		if (err < 0)
+			goto close;
+
+		diff = (now.tv_sec - last_print.tv_sec) * 1000000000LL
+			+ now.tv_nsec - last_print.tv_nsec;
+		if (diff >= 1000000000LL) {
+			tcp_report("TX", sent - last_sent, diff);
+			last_sent = sent;
+			last_print = now;
+		}
+
+		elapsed = (now.tv_sec - start.tv_sec) * 1000000000LL
+			+ now.tv_nsec - start.tv_nsec;
+		if (elapsed >= client->duration * 1000000000LL)
+			break;
+	}
+
+	tcp_report("total", sent, elapsed);
+	err = 0;
+
+	/*
+	 * Data still queued at the receiver is dropped once our FIN
+	 * arrives, let the sink drain it first.
+	 */
+	for (n = 0; local && sink.bytes < sent && n < 1000; n++)
+		__RT(usleep(1000));
+
+  close:
+	tmp = smokey_check_errno(__RT(close(sock)));
+	if (err == 0)
+		err = tmp;
+  join:
+	if (local) {
+		/* Closing the connection ends the sink. */
+		pthread_join(sink_tid, NULL);
+		sem_destroy(&sink.ready);
+		if (err == 0)
+			err = sink.err;
+		if (err == 0 && sink.bytes != sent) {
+			smokey_warning("sent %Lu bytes, received %Lu",
+				       sent, sink.bytes);
+			err = -EPROTO;
+		}
+	}
+  free:
+	free(buf);
+
+	return err;
+}
+
+static int
+run_net_tcp(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct smokey_net_client client = {
+		.name = "TCP",
+		.option = _CC_COBALT_NET_TCP,
+		.create_socket = &tcp_create_socket,
+		.loop = &tcp_throughput_loop,
+	};
+
+	memset(&client.in_peer, '\0', sizeof(client.in_peer));
+	client.in_peer.sin_family = AF_INET;
+	client.in_peer.sin_port = htons(TCP_DISCARD_PORT);
+	client.in_peer.sin_addr.s_addr = htonl(INADDR_ANY);
+	client.peer_len = sizeof(client.in_peer);
+
+	return smokey_net_client_run(t, &client, argc, argv);
+}
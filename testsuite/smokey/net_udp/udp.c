@@ -6,10 +6,17 @@
  * SPDX-License-Identifier: MIT
  */
 
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 
 #include <sys/cobalt.h>
 #include <smokey/smokey.h>
+#include <rtdm/net.h>
 #include "smokey_net.h"
 
 smokey_test_plugin(net_udp,
@@ -18,6 +25,7 @@ smokey_test_plugin(net_udp,
 		SMOKEY_STRING(rtnet_interface),
 		SMOKEY_INT(rtnet_rate),
 		SMOKEY_INT(rtnet_duration),
+		SMOKEY_INT(rtnet_ring),
 	),
 	"Check RTnet driver, using UDP packets, measuring round trip time\n"
 	"\tand packet losses,\n"
@@ -25,9 +33,18 @@ smokey_test_plugin(net_udp,
 	"\tthe rtnet_interface parameter allows choosing the network interface\n"
 	"\tthe rtnet_rate parameter allows choosing the packet rate\n"
 	"\tthe rtnet_duration parameter allows choosing the test duration\n"
+	"\tthe rtnet_ring parameter switches to receiving the replies\n"
+	"\tthrough a mmap'ed RX ring with the given number of frames\n"
 	"\tA server on the network must run the smokey_rtnet_server program."
 );
 
+struct udp_client {
+	struct smokey_net_client base;
+	unsigned int ring_frames;
+};
+
+#define RING_FRAME_SIZE 256
+
 static int
 udp_create_socket(struct smokey_net_client *client)
 {
@@ -54,22 +71,244 @@ udp_extract(struct smokey_net_client *client,
 	return len;
 }
 
+static inline struct rtnet_ring_slot *
+ring_slot(void *mem, unsigned int n)
+{
+	return mem + (size_t)n * RING_FRAME_SIZE;
+}
+
+static inline void *ring_data(struct rtnet_ring_slot *slot)
+{
+	return (void *)slot + RTNET_RING_DATA_OFFSET;
+}
+
+/* Returns 1 if @sock becomes readable within @usecs, 0 otherwise. */
+static int ring_readable(int sock, long usecs)
+{
+	struct timeval tv = { .tv_sec = 0, .tv_usec = usecs };
+	fd_set set;
+
+	FD_ZERO(&set);
+	FD_SET(sock, &set);
+
+	return smokey_check_errno(
+		__RT(select(sock + 1, &set, NULL, NULL, &tv)));
+}
+
+/*
+ * Send datagrams with sendto(), collect the echoed ones from the RX
+ * ring. Each batch checks the select() readiness rules documented
+ * along with RTNET_RTIOC_RING_WAIT: readable once a reply landed into
+ * the empty ring, not anymore once the ring was emptied and
+ * RTNET_RTIOC_RING_WAIT found the next slot empty.
+ */
+static int udp_ring_loop(struct smokey_net_client *bclient)
+{
+	struct udp_client *client = (struct udp_client *)bclient;
+	unsigned int frames = client->ring_frames, rx = 0, batch, n;
+	unsigned long long sent = 0, received = 0, bad = 0;
+	nanosecs_rel_t timeout = 100000000, nonblock = -1;
+	struct smokey_net_payload payload, reply;
+	struct rtnet_ring_stats stats;
+	struct rtnet_ring_slot *slot;
+	struct timespec start, now;
+	struct rtnet_ring_req req;
+	struct sched_param prio;
+	char packet[256];
+	int sock, err, len;
+	size_t size;
+	void *mem;
+
+	sock = bclient->create_socket(bclient);
+	if (sock < 0)
+		return sock;
+
+	prio.sched_priority = 20;
+	err = smokey_check_status(
+		pthread_setschedparam(pthread_self(), SCHED_FIFO, &prio));
+	if (err < 0)
+		goto close;
+
+	req.frame_size = RING_FRAME_SIZE;
+	req.rx_frames = frames;
+	req.tx_frames = 0;
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_RING, &req)));
+	if (err < 0)
+		goto close;
+
+	size = (size_t)RING_FRAME_SIZE * frames;
+	mem = __RT(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			sock, 0));
+	if (mem == MAP_FAILED) {
+		err = -errno;
+		smokey_warning("mmap(): %s", strerror(errno));
+		goto close;
+	}
+
+	err = smokey_check_errno(
+		__RT(clock_gettime(CLOCK_MONOTONIC, &start)));
+	if (err < 0)
+		goto unmap;
+
+	smokey_trace("\nRX ring mode, %u frames of %u bytes", frames,
+		     RING_FRAME_SIZE);
+
+	/* Keep at least one slot free, replies may outrun us. */
+	batch = frames > 1 ? frames - 1 : 1;
+	payload.seq = 0;
+	for (;;) {
+		for (n = 0; n < batch; n++) {
+			payload.seq++;
+			__RT(clock_gettime(CLOCK_MONOTONIC, &payload.ts));
+			len = bclient->prepare(bclient, packet, sizeof(packet),
+					       &payload);
+			err = smokey_check_errno(
+				__RT(sendto(sock, packet, len, 0,
+					    &bclient->peer, bclient->peer_len)));
+			if (err < 0)
+				goto unmap;
+			sent++;
+		}
+
+		/* The first reply makes the socket readable. */
+		err = ring_readable(sock, 100000);
+		if (err < 0)
+			goto unmap;
+		if (err == 0)
+			goto next;
+
+		err = smokey_check_errno(
+			__RT(ioctl(sock, RTNET_RTIOC_TIMEOUT, &timeout)));
+		if (err < 0)
+			goto unmap;
+
+		for (n = 0; n < batch; n++) {
+			slot = ring_slot(mem, rx);
+			if (slot->status != RTNET_RING_USER &&
+			    __RT(ioctl(sock, RTNET_RTIOC_RING_WAIT, &rx)) < 0) {
+				if (errno == ETIMEDOUT)
+					break;
+				err = -errno;
+				smokey_warning("RTNET_RTIOC_RING_WAIT: %s",
+					       strerror(errno));
+				goto unmap;
+			}
+			__sync_synchronize();
+			if (slot->addrlen != sizeof(struct sockaddr_in) ||
+			    bclient->extract(bclient, &reply, ring_data(slot),
+					     slot->len) != sizeof(reply))
+				bad++;
+			else
+				received++;
+			slot->status = RTNET_RING_KERNEL;
+			if (++rx == frames)
+				rx = 0;
+		}
+
+		/*
+		 * Unless replies are missing and may still show up, the
+		 * ring is empty: a non-blocking wait on the next slot
+		 * must fail, which clears the readiness.
+		 */
+		if (n < batch)
+			goto next;
+
+		err = smokey_check_errno(
+			__RT(ioctl(sock, RTNET_RTIOC_TIMEOUT, &nonblock)));
+		if (err < 0)
+			goto unmap;
+
+		if (__RT(ioctl(sock, RTNET_RTIOC_RING_WAIT, &rx)) == 0 ||
+		    errno != EWOULDBLOCK) {
+			smokey_warning("RTNET_RTIOC_RING_WAIT on an empty ring"
+				       " did not fail with EWOULDBLOCK");
+			err = -EPROTO;
+			goto unmap;
+		}
+
+		err = ring_readable(sock, 0);
+		if (err < 0)
+			goto unmap;
+		if (err > 0) {
+			smokey_warning("select() reports an empty ring readable");
+			err = -EPROTO;
+			goto unmap;
+		}
+	next:
+		err = smokey_check_errno(
+			__RT(clock_gettime(CLOCK_MONOTONIC, &now)));
+		if (err < 0)
+			goto unmap;
+
+		if ((now.tv_sec - start.tv_sec) * 1000000000LL
+		    + now.tv_nsec - start.tv_nsec >=
+		    bclient->duration * 1000000000LL)
+			break;
+	}
+
+	err = smokey_check_errno(
+		__RT(ioctl(sock, RTNET_RTIOC_RING_STATS, &stats)));
+	if (err < 0)
+		goto unmap;
+
+	smokey_trace("sent %Lu datagrams, received %Lu, %Lu malformed",
+		     sent, received, bad);
+	smokey_trace("ring: %Lu frames delivered, %Lu dropped",
+		     (unsigned long long)stats.rx_delivered,
+		     (unsigned long long)stats.rx_drops);
+
+	err = 0;
+	if (bad) {
+		fprintf(stderr, "RTnet %s ring test failed, %Lu malformed"
+			" replies\n", bclient->name, bad);
+		err = -EPROTO;
+	} else if (received == 0) {
+		fprintf(stderr, "RTnet %s ring test failed, all packets lost"
+			" (is smokey_net_server running ?)\n", bclient->name);
+		err = -EPROTO;
+	}
+
+  unmap:
+	munmap(mem, size);
+  close:
+	len = smokey_check_errno(__RT(close(sock)));
+	if (err == 0)
+		err = len;
+
+	return err;
+}
+
 static int
 run_net_udp(struct smokey_test *t, int argc, char *const argv[])
 {
-	struct smokey_net_client client = {
-		.name = "UDP",
-		.option = _CC_COBALT_NET_UDP,
-		.create_socket = &udp_create_socket,
-		.prepare = &udp_prepare,
-		.extract = &udp_extract,
+	struct udp_client client = {
+		.base = {
+			.name = "UDP",
+			.option = _CC_COBALT_NET_UDP,
+			.create_socket = &udp_create_socket,
+			.prepare = &udp_prepare,
+			.extract = &udp_extract,
+		},
 	};
+	struct smokey_net_client *bclient = &client.base;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(*t, rtnet_ring)) {
+		client.ring_frames = SMOKEY_ARG_INT(*t, rtnet_ring);
+		if (client.ring_frames == 0) {
+			smokey_warning("ring size can not be null");
+			return -EINVAL;
+		}
+		bclient->loop = &udp_ring_loop;
+	}
 
-	memset(&client.in_peer, '\0', sizeof(client.in_peer));
-	client.in_peer.sin_family = AF_INET;
-	client.in_peer.sin_port = htons(7); /* UDP echo port */
-	client.in_peer.sin_addr.s_addr = htonl(INADDR_ANY);
-	client.peer_len = sizeof(client.in_peer);
+	memset(&bclient->in_peer, '\0', sizeof(bclient->in_peer));
+	bclient->in_peer.sin_family = AF_INET;
+	bclient->in_peer.sin_port = htons(7); /* UDP echo port */
+	bclient->in_peer.sin_addr.s_addr = htonl(INADDR_ANY);
+	bclient->peer_len = sizeof(bclient->in_peer);
 
-	return smokey_net_client_run(t, &client, argc, argv);
+	return smokey_net_client_run(t, bclient, argc, argv);
 }
@@ -16,6 +16,7 @@
 #include <pthread.h>
 #include <semaphore.h>
 #include <smokey/smokey.h>
+#include <sys/cobalt.h>
 
 smokey_test_plugin(posix_cond,
 		   SMOKEY_NOARGS,
@@ -116,6 +117,7 @@ static int cond_init(pthread_cond_t *cond, int absolute)
 	return -ret;
 }
 #define cond_signal(cond) (-pthread_cond_signal(cond))
+#define cond_broadcast(cond) (-pthread_cond_broadcast(cond))
 
 static int cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, unsigned long long ns)
 {
@@ -761,6 +763,149 @@ static void cond_ppmutex(void)
 	check("cond_destroy", cond_destroy(&cond), 0);
 }
 
+#define BROADCAST_WAITERS 8
+
+struct broadcast_context {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int order[BROADCAST_WAITERS];
+	int count;
+};
+
+struct broadcast_waiter {
+	struct broadcast_context *ctx;
+	pthread_t tid;
+	int prio;
+};
+
+static void *cond_broadcast_waiter(void *cookie)
+{
+	struct broadcast_waiter *w = cookie;
+	struct broadcast_context *ctx = w->ctx;
+
+	check("mutex_lock", mutex_lock(&ctx->mutex), 0);
+	check("cond_wait", cond_wait(&ctx->cond, &ctx->mutex, 0), 0);
+	ctx->order[ctx->count++] = w->prio;
+	check("mutex_unlock", mutex_unlock(&ctx->mutex), 0);
+
+	return NULL;
+}
+
+static void cond_broadcast_handover(void)
+{
+	struct broadcast_waiter waiters[BROADCAST_WAITERS];
+	struct broadcast_context ctx;
+	int n;
+
+	smokey_trace("%s", __func__);
+
+	check("mutex_init", mutex_init(&ctx.mutex, PTHREAD_MUTEX_DEFAULT,
+				       PTHREAD_PRIO_INHERIT), 0);
+	check("cond_init", cond_init(&ctx.cond, 0), 0);
+	ctx.count = 0;
+
+	/* Each waiter outranks us, it blocks on ctx.cond on startup. */
+	for (n = 0; n < BROADCAST_WAITERS; n++) {
+		waiters[n].ctx = &ctx;
+		waiters[n].prio = 3 + (n * 3) % BROADCAST_WAITERS;
+		check("thread_spawn",
+		      thread_spawn(&waiters[n].tid, waiters[n].prio,
+				   cond_broadcast_waiter, &waiters[n]), 0);
+	}
+
+	/*
+	 * The mutex has to be passed to all waiters in turn, by
+	 * decreasing priority.
+	 */
+	check("mutex_lock", mutex_lock(&ctx.mutex), 0);
+	check("cond_broadcast", cond_broadcast(&ctx.cond), 0);
+	check("waiters still blocked", ctx.count, 0);
+	check("mutex_unlock", mutex_unlock(&ctx.mutex), 0);
+
+	for (n = 0; n < BROADCAST_WAITERS; n++)
+		check("thread_join", thread_join(waiters[n].tid), 0);
+
+	check("waiters done", ctx.count, BROADCAST_WAITERS);
+	for (n = 0; n < BROADCAST_WAITERS; n++)
+		check("handover order", ctx.order[n],
+		      3 + BROADCAST_WAITERS - 1 - n);
+
+	check("mutex_destroy", mutex_destroy(&ctx.mutex), 0);
+	check("cond_destroy", cond_destroy(&ctx.cond), 0);
+}
+
+struct fastlock_waiter {
+	struct broadcast_context *ctx;
+	unsigned long long timeout;
+	unsigned int hold_ms;
+	pthread_t tid;
+	int status;
+};
+
+static void *cond_fastlock_waiter(void *cookie)
+{
+	struct fastlock_waiter *w = cookie;
+	struct broadcast_context *ctx = w->ctx;
+
+	check("mutex_lock", mutex_lock(&ctx->mutex), 0);
+	w->status = cond_wait(&ctx->cond, &ctx->mutex, w->timeout);
+	ctx->count++;
+	if (w->hold_ms)
+		thread_msleep(w->hold_ms);
+	check("mutex_unlock", mutex_unlock(&ctx->mutex), 0);
+
+	return NULL;
+}
+
+static void cond_fastlock_handover(void)
+{
+	struct fastlock_waiter holder, timed;
+	struct broadcast_context ctx;
+
+	smokey_trace("%s", __func__);
+
+	check("mutex_init", mutex_init(&ctx.mutex, PTHREAD_MUTEX_DEFAULT,
+				       PTHREAD_PRIO_INHERIT), 0);
+	check("cond_init", cond_init(&ctx.cond, 0), 0);
+	ctx.count = 0;
+
+	/*
+	 * The first waiter gets the mutex first, then keeps it past
+	 * the timeout of the second one, which is still queued on the
+	 * mutex by then, but has been signaled nevertheless.
+	 */
+	holder.ctx = &ctx;
+	holder.timeout = 0;
+	holder.hold_ms = 200;
+	check("thread_spawn",
+	      thread_spawn(&holder.tid, 4, cond_fastlock_waiter, &holder), 0);
+	timed.ctx = &ctx;
+	timed.timeout = 100 * NS_PER_MS;
+	timed.hold_ms = 0;
+	check("thread_spawn",
+	      thread_spawn(&timed.tid, 3, cond_fastlock_waiter, &timed), 0);
+
+	/*
+	 * Lock from primary mode, so that the mutex is grabbed from
+	 * user space and the kernel does not know about its owner
+	 * until we release it.
+	 */
+	cobalt_thread_harden();
+	check("mutex_lock", mutex_lock(&ctx.mutex), 0);
+	check("cond_broadcast", cond_broadcast(&ctx.cond), 0);
+	check("mutex_unlock", mutex_unlock(&ctx.mutex), 0);
+
+	check("thread_join", thread_join(holder.tid), 0);
+	check("thread_join", thread_join(timed.tid), 0);
+
+	check("waiters done", ctx.count, 2);
+	check("holder signaled", holder.status, 0);
+	check("timed waiter signaled", timed.status, 0);
+
+	check("mutex_destroy", mutex_destroy(&ctx.mutex), 0);
+	check("cond_destroy", cond_destroy(&ctx.cond), 0);
+}
+
 int run_posix_cond(struct smokey_test *t, int argc, char *const argv[])
 {
 	struct sched_param sparam;
@@ -783,6 +928,8 @@ int run_posix_cond(struct smokey_test *t, int argc, char *const argv[])
 	sig_restart_double();
 	cond_destroy_whilewait();
 	cond_ppmutex();
+	cond_broadcast_handover();
+	cond_fastlock_handover();
 
 	return 0;
 }
@@ -58,6 +58,7 @@ static void sigdebug(int sig, siginfo_t *si, void *context)
 #define THREAD_PRIO_VERY_HIGH	4
 
 #define MAX_100_MS  100000000ULL
+#define MAX_1_S     1000000000ULL
 
 struct locker_context {
 	pthread_mutex_t *mutex;
@@ -393,6 +394,84 @@ static int dynamic_init_errorcheck_contend(void)
 	return __dynamic_init_contend(PTHREAD_MUTEX_ERRORCHECK);
 }
 
+static int dynamic_init_adaptive_contend(void)
+{
+	return __dynamic_init_contend(PTHREAD_MUTEX_ADAPTIVE_NP);
+}
+
+static int adaptive_spinstat(void)
+{
+	struct smokey_barrier barrier;
+	unsigned int hits, misses;
+	struct locker_context args;
+	pthread_mutex_t mutex;
+	pthread_t tid;
+	void *status;
+	int ret;
+
+	ret = do_init_mutex(&mutex, PTHREAD_MUTEX_NORMAL, PTHREAD_PRIO_NONE);
+	if (ret)
+		return ret;
+
+	if (!__F(ret, pthread_mutex_getspinstat_np(&mutex, &hits, &misses)) ||
+	    !__Tassert(ret == -EINVAL))
+		return -EINVAL;
+
+	if (!__T(ret, pthread_mutex_destroy(&mutex)))
+		return ret;
+
+	ret = do_init_mutex(&mutex, PTHREAD_MUTEX_ADAPTIVE_NP,
+			    PTHREAD_PRIO_NONE);
+	if (ret)
+		return ret;
+
+	if (!__T(ret, pthread_mutex_lock(&mutex)))
+		return ret;
+
+	args.mutex = &mutex;
+	smokey_barrier_init(&barrier);
+	args.barrier = &barrier;
+	args.lock_acquired = 0;
+	ret = create_thread(&tid, SCHED_FIFO, THREAD_PRIO_HIGH,
+			    mutex_locker, &args);
+	if (ret)
+		return ret;
+
+	/*
+	 * The owner sleeps while holding the lock, the locker must
+	 * give up spinning and block.
+	 */
+	sleep_ms(10);
+
+	if (!__Tassert(args.lock_acquired == 0))
+		return -EINVAL;
+
+	if (!__T(ret, pthread_mutex_unlock(&mutex)))
+		return ret;
+
+	if (!__T(ret, smokey_barrier_wait(&barrier)))
+		return ret;
+
+	if (!__T(ret, pthread_join(tid, &status)))
+		return ret;
+
+	if (!__Tassert(status == NULL))
+		return -EINVAL;
+
+	if (!__T(ret, pthread_mutex_getspinstat_np(&mutex, &hits, &misses)))
+		return ret;
+
+	if (!__Tassert(hits == 0 && misses == 1))
+		return -EINVAL;
+
+	if (!__T(ret, pthread_mutex_destroy(&mutex)))
+		return ret;
+
+	smokey_barrier_destroy(&barrier);
+
+	return 0;
+}
+
 static int timed_contend(void)
 {
 	pthread_mutex_t mutex;
@@ -999,6 +1078,181 @@ static int protect_handover(void)
 	return 0;
 }
 
+#define FANIN_WAITERS		128
+#define FANIN_PRIO_MIN		10
+#define FANIN_PRIO_MAX		89
+#define FANIN_OWNER_PRIO	90
+
+struct fanin_context {
+	pthread_mutex_t mutex;
+	int order[FANIN_WAITERS];
+	int count;
+};
+
+struct fanin_waiter {
+	struct fanin_context *ctx;
+	pthread_t tid;
+	int prio;
+};
+
+static void *mutex_fanin_waiter(void *arg)
+{
+	struct fanin_waiter *w = arg;
+	struct fanin_context *ctx = w->ctx;
+	int ret;
+
+	if (!__T(ret, pthread_mutex_lock(&ctx->mutex)))
+		return (void *)(long)ret;
+
+	ctx->order[ctx->count++] = w->prio;
+
+	if (!__T(ret, pthread_mutex_unlock(&ctx->mutex)))
+		return (void *)(long)ret;
+
+	return NULL;
+}
+
+static inline unsigned long long fanin_elapsed(const struct timespec *start)
+{
+	struct timespec now, delta;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	timespec_sub(&delta, &now, start);
+
+	return timespec_scalar(&delta);
+}
+
+/*
+ * Stress the wait queue of a PI mutex with many sleepers: queue
+ * FANIN_WAITERS threads with scattered priorities, move each of them
+ * to another priority level while sleeping, then check that the
+ * lock is handed over in priority order. The per-operation cost of
+ * requeuing and handing over is reported, which reflects the
+ * complexity of the wait queue implementation
+ * (CONFIG_XENO_OPT_SCALABLE_SYNCH).
+ */
+static int pi_fanin(void)
+{
+	unsigned long long requeue_ns = 0, handover_ns;
+	struct fanin_waiter *waiters, *w;
+	struct sched_param param;
+	struct fanin_context ctx;
+	struct timespec start;
+	pthread_attr_t thattr;
+	int ret, err, n;
+	void *status;
+
+	waiters = calloc(FANIN_WAITERS, sizeof(*waiters));
+	if (waiters == NULL)
+		return -ENOMEM;
+
+	ret = do_init_mutex(&ctx.mutex, PTHREAD_MUTEX_NORMAL,
+			    PTHREAD_PRIO_INHERIT);
+	if (ret)
+		goto out;
+
+	ctx.count = 0;
+
+	param.sched_priority = FANIN_OWNER_PRIO;
+	if (!__T(ret, pthread_setschedparam(pthread_self(),
+					    SCHED_FIFO, &param)))
+		goto out;
+
+	if (!__T(ret, pthread_mutex_lock(&ctx.mutex)))
+		goto out;
+
+	pthread_attr_init(&thattr);
+	pthread_attr_setschedpolicy(&thattr, SCHED_FIFO);
+	pthread_attr_setinheritsched(&thattr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setstacksize(&thattr, PTHREAD_STACK_MIN * 4);
+
+	for (n = 0; n < FANIN_WAITERS; n++) {
+		w = waiters + n;
+		w->ctx = &ctx;
+		w->prio = FANIN_PRIO_MIN +
+			(n * 7) % (FANIN_PRIO_MAX - FANIN_PRIO_MIN + 1);
+		param.sched_priority = w->prio;
+		pthread_attr_setschedparam(&thattr, &param);
+		if (!__T(ret, pthread_create(&w->tid, &thattr,
+					     mutex_fanin_waiter, w)))
+			break;
+	}
+
+	pthread_attr_destroy(&thattr);
+
+	if (ret) {
+		/* Let the waiters created so far go. */
+		pthread_mutex_unlock(&ctx.mutex);
+		while (--n >= 0)
+			pthread_join(waiters[n].tid, NULL);
+		goto out;
+	}
+
+	/* The waiters only run once we sleep, let all of them block. */
+	sleep_ms(50);
+
+	if (!__Tassert(ctx.count == 0)) {
+		ret = -EINVAL;
+		goto release;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (n = 0; n < FANIN_WAITERS; n++) {
+		w = waiters + n;
+		w->prio = FANIN_PRIO_MAX -
+			(n * 13) % (FANIN_PRIO_MAX - FANIN_PRIO_MIN + 1);
+		param.sched_priority = w->prio;
+		if (!__T(ret, pthread_setschedparam(w->tid,
+						    SCHED_FIFO, &param)))
+			break;
+	}
+
+	requeue_ns = fanin_elapsed(&start);
+release:
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (!__T(err, pthread_mutex_unlock(&ctx.mutex)) && ret == 0)
+		ret = err;
+
+	for (n = 0; n < FANIN_WAITERS; n++) {
+		pthread_join(waiters[n].tid, &status);
+		if (status && ret == 0)
+			ret = (long)status;
+	}
+
+	handover_ns = fanin_elapsed(&start);
+
+	if (ret)
+		goto out;
+
+	if (!__Tassert(ctx.count == FANIN_WAITERS)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (n = 1; n < FANIN_WAITERS; n++) {
+		if (!__Tassert(ctx.order[n] <= ctx.order[n - 1])) {
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	smokey_trace("%d waiters: requeue %llu ns/op, handover %llu ns/op",
+		     FANIN_WAITERS, requeue_ns / FANIN_WAITERS,
+		     handover_ns / FANIN_WAITERS);
+
+	if (!__T(ret, pthread_mutex_destroy(&ctx.mutex)))
+		goto out;
+out:
+	free(waiters);
+
+	param.sched_priority = THREAD_PRIO_MEDIUM;
+	pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+	return ret;
+}
+
 /* Detect obviously wrong execution times. */
 static int check_time_limit(const struct timespec *start,
 			    xnticks_t limit_ns)
@@ -1049,6 +1303,8 @@ static int run_posix_mutex(struct smokey_test *t, int argc, char *const argv[])
 	do_test(static_init_errorcheck_destroy, MAX_100_MS);
 	do_test(static_init_errorcheck_contend, MAX_100_MS);
 	do_test(dynamic_init_errorcheck_contend, MAX_100_MS);
+	do_test(dynamic_init_adaptive_contend, MAX_100_MS);
+	do_test(adaptive_spinstat, MAX_100_MS);
 	do_test(timed_contend, MAX_100_MS);
 	do_test(weak_mode_switch, MAX_100_MS);
 	do_test(pi_contend, MAX_100_MS);
@@ -1062,6 +1318,7 @@ static int run_posix_mutex(struct smokey_test *t, int argc, char *const argv[])
 	do_test(protect_dynamic, MAX_100_MS);
 	do_test(protect_trylock, MAX_100_MS);
 	do_test(protect_handover, MAX_100_MS);
+	do_test(pi_fanin, MAX_1_S);
 
 	return 0;
 }
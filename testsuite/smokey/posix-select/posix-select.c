@@ -33,11 +33,13 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/cobalt.h>
 #include <smokey/smokey.h>
 
 smokey_test_plugin(posix_select,
 		   SMOKEY_NOARGS,
-		   "Check POSIX select service"
+		   "Check POSIX select service, over regular and fast path\n"
+		   "\tmessage queues"
 );
 
 static const char *tunes[] = {
@@ -102,23 +104,26 @@ static void *mq_thread(void *cookie)
 	return NULL;
 }
 
-static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
+static int run_select_test(const char *name, long flags)
 {
 	struct mq_attr qa;
 	pthread_t tcb;
 	int i, j, ret;
 	mqd_t mq;
 
-	mq_unlink("/select_test_mq");
+	test_status = 0;
+	mq_unlink(name);
+	memset(&qa, 0, sizeof(qa));
+	qa.mq_flags = flags;
 	qa.mq_maxmsg = 128;
 	qa.mq_msgsize = 128;
-	mq = smokey_check_errno(mq_open("/select_test_mq", O_RDWR | O_CREAT | O_NONBLOCK, 0, &qa));
+	mq = smokey_check_errno(mq_open(name, O_RDWR | O_CREAT | O_NONBLOCK, 0, &qa));
 	if (mq < 0)
 		return mq;
 
 	ret = smokey_check_status(pthread_create(&tcb, NULL, mq_thread, (void *)(long)mq));
 	if (ret)
-		return ret;
+		goto close;
 
 	for (j = 0; j < 3; j++) {
 		for (i = 0; i < sizeof(tunes) / sizeof(tunes[0]); i++) {
@@ -140,6 +145,22 @@ static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
 	ret = test_status;
 out:
 	pthread_join(tcb, NULL);
-	
+close:
+	mq_close(mq);
+	mq_unlink(name);
+
 	return ret;
 }
+
+static int run_posix_select(struct smokey_test *t, int argc, char *const argv[])
+{
+	int ret;
+
+	ret = run_select_test("/select_test_mq", 0);
+	if (ret)
+		return ret;
+
+	smokey_trace("same with the user space fast path");
+
+	return run_select_test("/select_test_mq_fast", COBALT_MQ_FASTPATH);
+}
@@ -0,0 +1,287 @@
+/*
+ * rt_print binary mode test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/cobalt.h>
+#include <cobalt/tunables.h>
+#include <boilerplate/time.h>
+#include <smokey/smokey.h>
+#if HAVE_DECL___RSEQ_OFFSET && HAVE_DECL___RSEQ_SIZE
+#include <sys/rseq.h>
+#endif
+
+smokey_test_plugin(rt_print,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(loops),
+		   ),
+   "Check the binary mode of rt_printf(), which defers formatting to\n"
+   "\tthe printer thread, against the regular mode. Then compare the\n"
+   "\tcost of both modes per call, as seen by the caller, over loops\n"
+   "\tbatches of calls. With --print-percpu-size, also check that\n"
+   "\tthreads sharing a CPU ring keep their ordering and that lost\n"
+   "\tmessages are accounted for."
+);
+
+#define BATCH	64
+
+static int check_output(void)
+{
+	char expected[512], output[512], partial[3] = { 'a', 'b', 'c' };
+	size_t len;
+	FILE *fp;
+	int ret;
+
+	fp = tmpfile();
+	if (fp == NULL)
+		return -errno;
+
+	cobalt_thread_harden();
+	rt_fbprintf(fp, "%d %5u %-6x|%lld %zu %jd|", -1, 2U, 0xabcU,
+		    1LL << 40, (size_t)9, (intmax_t)-7);
+	rt_fbprintf(fp, "%f %.3e %Lg %%|", 3.25, 2.5e10, (long double)1.5);
+	rt_fprintf(fp, "text|");
+	rt_fbprintf(fp, "%s|%.2s|%*.*s|%c|%p\n", "str", partial,
+		    5, 2, partial, 'X', (void *)0x1234);
+	/* %n can't be deferred, this one is formatted in place. */
+	rt_fbprintf(fp, "%d%n|\n", 42, &ret);
+	rt_print_flush_buffers();
+
+	len = snprintf(expected, sizeof(expected),
+		       "%d %5u %-6x|%lld %zu %jd|"
+		       "%f %.3e %Lg %%|"
+		       "text|"
+		       "%s|%.2s|%*.*s|%c|%p\n"
+		       "42|\n",
+		       -1, 2U, 0xabcU, 1LL << 40, (size_t)9, (intmax_t)-7,
+		       3.25, 2.5e10, (long double)1.5,
+		       "str", partial, 5, 2, partial, 'X', (void *)0x1234);
+
+	fflush(fp);
+	rewind(fp);
+	memset(output, 0, sizeof(output));
+	ret = fread(output, 1, sizeof(output) - 1, fp);
+	fclose(fp);
+
+	if (!__Tassert(ret == len && memcmp(output, expected, len) == 0)) {
+		smokey_warning("expected: %s", expected);
+		smokey_warning("got: %s", output);
+		return -EPROTO;
+	}
+
+	return 0;
+}
+
+#define PRODUCERS	4
+
+struct producer {
+	FILE *fp;
+	int id;
+	int count;
+	pthread_t tid;
+};
+
+static void *percpu_producer(void *arg)
+{
+	struct producer *p = arg;
+	int n;
+
+	cobalt_thread_harden();
+
+	for (n = 0; n < p->count; n++) {
+		rt_fprintf(p->fp, "%d %d\n", p->id, n);
+		/* Interleave with the other producers. */
+		if ((n & 7) == 7)
+			sched_yield();
+	}
+
+	return NULL;
+}
+
+static int spawn_producer(struct producer *p, int cpu)
+{
+	struct sched_param param = { .sched_priority = 10 };
+	pthread_attr_t attr;
+	cpu_set_t cpus;
+	int ret;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+	pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+	ret = pthread_create(&p->tid, &attr, percpu_producer, p);
+	pthread_attr_destroy(&attr);
+
+	return -ret;
+}
+
+static int check_percpu(void)
+{
+	int ret = 0, n, id, seq, cpu, nslots, total, lines = 0;
+	int next[PRODUCERS] = { 0 };
+	struct producer producers[PRODUCERS];
+	long drops, dropped = 0;
+	FILE *fp, *errfp;
+	char buf[128];
+	int errfd;
+
+	/* The library uses 256-byte slots. */
+	nslots = get_config_tunable(print_percpu_size) / 256;
+	if (nslots <= 0) {
+		smokey_trace("per-CPU print rings disabled, skipped");
+		return 0;
+	}
+#if HAVE_DECL___RSEQ_OFFSET && HAVE_DECL___RSEQ_SIZE
+	if (__rseq_size == 0)
+#endif
+	{
+		/* Per-thread buffers are used instead. */
+		smokey_trace("no rseq support, per-CPU check skipped");
+		return 0;
+	}
+
+	fp = tmpfile();
+	errfp = tmpfile();
+	if (fp == NULL || errfp == NULL)
+		return -errno;
+
+	cpu = sched_getcpu();
+	if (cpu < 0)
+		cpu = 0;
+
+	/* Send twice what the ring holds, so that it may overflow. */
+	total = 2 * nslots;
+	rt_print_flush_buffers();
+	fflush(stderr);
+	errfd = dup(STDERR_FILENO);
+	dup2(fileno(errfp), STDERR_FILENO);
+
+	for (n = 0; n < PRODUCERS; n++) {
+		producers[n].fp = fp;
+		producers[n].id = n;
+		producers[n].count = total / PRODUCERS;
+		ret = spawn_producer(producers + n, cpu);
+		if (ret)
+			break;
+	}
+
+	while (--n >= 0)
+		pthread_join(producers[n].tid, NULL);
+
+	rt_print_flush_buffers();
+	fflush(stderr);
+	dup2(errfd, STDERR_FILENO);
+	close(errfd);
+	if (ret)
+		goto out;
+
+	rewind(errfp);
+	while (fgets(buf, sizeof(buf), errfp)) {
+		if (sscanf(buf, "[rt_print: %ld message(s) dropped", &drops) == 1)
+			dropped += drops;
+	}
+
+	/* Each producer's messages must come out in order. */
+	rewind(fp);
+	while (fgets(buf, sizeof(buf), fp)) {
+		if (!__Tassert(sscanf(buf, "%d %d", &id, &seq) == 2 &&
+			       id >= 0 && id < PRODUCERS && seq >= next[id])) {
+			smokey_warning("out of order: %s", buf);
+			ret = -EPROTO;
+			goto out;
+		}
+		next[id] = seq + 1;
+		lines++;
+	}
+
+	smokey_trace("per-CPU ring: %d messages sent, %d printed, %ld dropped",
+		     total, lines, dropped);
+
+	if (!__Tassert(lines + dropped == total))
+		ret = -EPROTO;
+out:
+	fclose(errfp);
+	fclose(fp);
+
+	return ret;
+}
+
+static void run_bench(FILE *fp, int binary, int loops,
+		      unsigned long long *min_r, unsigned long long *avg_r)
+{
+	unsigned long long dt, min = ~0ULL, sum = 0;
+	struct timespec start, end, delta;
+	int i, n;
+
+	for (n = 0; n < loops; n++) {
+		cobalt_thread_harden();
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (binary) {
+			for (i = 0; i < BATCH; i++)
+				rt_fbprintf(fp, "loop %d, cycle %u, %s: %.3f us\n",
+					    n, i, "delta", (double)i / 3);
+		} else {
+			for (i = 0; i < BATCH; i++)
+				rt_fprintf(fp, "loop %d, cycle %u, %s: %.3f us\n",
+					   n, i, "delta", (double)i / 3);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		/* Keep the printer out of the measurement. */
+		rt_print_flush_buffers();
+		timespec_sub(&delta, &end, &start);
+		dt = delta.tv_sec * 1000000000ULL + delta.tv_nsec;
+		if (dt < min)
+			min = dt;
+		sum += dt;
+	}
+
+	*min_r = min / BATCH;
+	*avg_r = sum / loops / BATCH;
+}
+
+static int run_rt_print(struct smokey_test *t, int argc, char *const argv[])
+{
+	unsigned long long fmin, favg, bmin, bavg;
+	int ret, loops = 1000;
+	FILE *fp;
+
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(rt_print, loops) &&
+	    SMOKEY_ARG_INT(rt_print, loops) > 0)
+		loops = SMOKEY_ARG_INT(rt_print, loops);
+
+	ret = check_output();
+	if (ret)
+		return ret;
+
+	ret = check_percpu();
+	if (ret)
+		return ret;
+
+	fp = fopen("/dev/null", "w");
+	if (fp == NULL)
+		return -errno;
+
+	run_bench(fp, 0, loops, &fmin, &favg);
+	run_bench(fp, 1, loops, &bmin, &bavg);
+	fclose(fp);
+
+	smokey_trace("rt_fprintf():  min %llu ns, avg %llu ns per call",
+		     fmin, favg);
+	smokey_trace("rt_fbprintf(): min %llu ns, avg %llu ns per call",
+		     bmin, bavg);
+
+	return 0;
+}
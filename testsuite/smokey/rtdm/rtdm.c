@@ -10,12 +10,18 @@
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/cobalt.h>
 #include <rtdm/testing.h>
 #include <smokey/smokey.h>
 
 smokey_test_plugin(rtdm,
-		   SMOKEY_NOARGS,
-		   "Check core interface to RTDM services."
+		   SMOKEY_ARGLIST(
+			   SMOKEY_BOOL(fd_bench),
+		   ),
+		   "Check core interface to RTDM services.\n"
+		   "\tfd_bench=1: measure the fd lookup cost vs open fd count."
 );
 
 #define NS_PER_MS (1000000)
@@ -149,10 +155,119 @@ static int test_handover(int fd)
 	return (int)(long)p;
 }
 
+#define EXTCLOCK_LOOPS	1000
+
+static long long ts2ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+/*
+ * The test driver registers an external clock ticking on the core
+ * counter, which applications must read through the vDSO, i.e.
+ * without any syscall.
+ */
+static int test_extclock(int fd)
+{
+	struct cobalt_threadstat before, after;
+	struct timespec t0, now, t1;
+	clockid_t clk_id;
+	int ret, n;
+
+	if (!__Terrno(ret, ioctl(fd, RTTST_RTIOC_RTDM_GET_EXTCLOCK, &clk_id)))
+		return ret;
+
+	if (!__T(ret, cobalt_thread_stat(0, &before)))
+		return ret;
+
+	for (n = 0; n < EXTCLOCK_LOOPS; n++) {
+		if (!__Terrno(ret, clock_gettime(CLOCK_MONOTONIC, &t0)) ||
+		    !__Terrno(ret, clock_gettime(clk_id, &now)) ||
+		    !__Terrno(ret, clock_gettime(CLOCK_MONOTONIC, &t1)))
+			return ret;
+		/* Allow for the offset sampling error. */
+		if (!__Tassert(ts2ns(&now) >= ts2ns(&t0) - 1000 &&
+			       ts2ns(&now) <= ts2ns(&t1) + 1000))
+			return -EINVAL;
+	}
+
+	/* Only the second stat call may count (CONFIG_XENO_OPT_STATS). */
+	if (!__T(ret, cobalt_thread_stat(0, &after)))
+		return ret;
+
+	if (!__Tassert(after.xsc - before.xsc <= 1))
+		return -EINVAL;
+
+	/* The time of a clock the driver can set must be republished. */
+	now.tv_sec += 1000;
+	if (clock_settime(clk_id, &now)) {
+		if (!__Tassert(errno == EINVAL))
+			return -errno;
+		return 0;	/* !CONFIG_XENO_OPT_EXTCLOCK */
+	}
+
+	if (!__Terrno(ret, clock_gettime(CLOCK_MONOTONIC, &t0)) ||
+	    !__Terrno(ret, clock_gettime(clk_id, &now)))
+		return ret;
+
+	if (!__Tassert(ts2ns(&now) - ts2ns(&t0) >= 999000000000LL))
+		return -EINVAL;
+
+	return 0;
+}
+
+#define FD_BENCH_MAX    512
+#define FD_BENCH_LOOPS  10000
+
+/*
+ * timerfd_gettime() is about the cheapest call going through a RTDM
+ * fd lookup, time it with a growing number of open descriptors.
+ */
+static int run_fd_bench(void)
+{
+	static const int steps[] = { 1, 16, 64, 256, FD_BENCH_MAX };
+	unsigned long long start, ns;
+	struct itimerspec its;
+	int fds[FD_BENCH_MAX];
+	int nfds = 0, ret = 0, i, n;
+
+	for (i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+		while (nfds < steps[i]) {
+			fds[nfds] = timerfd_create(CLOCK_MONOTONIC, 0);
+			if (fds[nfds] < 0) {
+				ret = -errno;
+				goto out;
+			}
+			nfds++;
+		}
+
+		start = timer_get_tsc();
+		for (n = 0; n < FD_BENCH_LOOPS; n++) {
+			if (!__Terrno(ret, timerfd_gettime(fds[nfds - 1], &its)))
+				goto out;
+		}
+		ns = timer_tsc2ns(timer_get_tsc() - start);
+
+		smokey_trace("%4d open fds: %Lu ns per lookup call",
+			     nfds, ns / FD_BENCH_LOOPS);
+	}
+out:
+	while (nfds > 0)
+		close(fds[--nfds]);
+
+	return ret;
+}
+
 static int run_rtdm(struct smokey_test *t, int argc, char *const argv[])
 {
 	int dev, dev2, status;
 
+	smokey_parse_args(t, argc, argv);
+
+	if (SMOKEY_ARG_ISSET(rtdm, fd_bench) &&
+	    SMOKEY_ARG_BOOL(rtdm, fd_bench))
+		return run_fd_bench();
+
 	status = system("modprobe -q xeno_rtdmtest");
 	if (status < 0 || WEXITSTATUS(status))
 		return -ENOSYS;
@@ -175,6 +290,11 @@ static int run_rtdm(struct smokey_test *t, int argc, char *const argv[])
 	if (status)
 		return status;
 
+	smokey_trace("External clock read from the vDSO");
+	status = test_extclock(dev);
+	if (status)
+		return status;
+
 	smokey_trace("Defer close by pending reference");
 	check("ioctl", ioctl(dev, RTTST_RTIOC_RTDM_DEFER_CLOSE,
 			     RTTST_RTDM_DEFER_CLOSE_CONTEXT), 0);
@@ -0,0 +1,279 @@
+/*
+ * SCHED_EDF test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <errno.h>
+#include <error.h>
+#include <sys/cobalt.h>
+#include <boilerplate/time.h>
+#include <boilerplate/ancillaries.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(sched_edf,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(budget),
+		   ),
+   "Check the SCHED_EDF scheduling policy. Parameter checking and\n"
+   "\tthe per-CPU admission control are verified first. Then the\n"
+   "\tamount of work a SCHED_EDF thread performs over a second is\n"
+   "\tcompared to the amount a SCHED_FIFO thread performs when\n"
+   "\trunning uninterrupted, which should match the share of CPU\n"
+   "\ttime reserved by the EDF thread, i.e. budget percent of its\n"
+   "\tperiod (barring rounding errors and marginal latency)."
+);
+
+#define EDF_PERIOD_NS	10000000
+#define TEST_SECS	1
+
+static unsigned long long crunch_per_sec;
+
+static volatile int stop;
+
+static sem_t ready;
+
+static unsigned long __attribute__(( noinline ))
+__do_work(unsigned long count)
+{
+	return count + 1;
+}
+
+static void __attribute__(( noinline ))
+do_work(unsigned long loops, unsigned long *count_r)
+{
+	unsigned long n;
+
+	for (n = 0; n < loops; n++)
+		*count_r = __do_work(*count_r);
+}
+
+static void *crunch_body(void *arg)
+{
+	unsigned long *count_r = arg, loops;
+
+	loops = crunch_per_sec / 10000; /* check for stop every 100 us */
+	*count_r = 0;
+	sem_post(&ready);
+
+	while (!stop)
+		do_work(loops, count_r);
+
+	return NULL;
+}
+
+static void *idle_body(void *arg)
+{
+	sem_t *sem = arg;
+
+	sem_post(&ready);
+	sem_wait(sem);
+
+	return NULL;
+}
+
+static void set_edf_param(struct sched_param_ex *param_ex,
+			  long runtime, long deadline, long period)
+{
+	param_ex->sched_priority = 1;
+	param_ex->sched_edf_runtime.tv_sec = 0;
+	param_ex->sched_edf_runtime.tv_nsec = runtime;
+	param_ex->sched_edf_deadline.tv_sec = 0;
+	param_ex->sched_edf_deadline.tv_nsec = deadline;
+	param_ex->sched_edf_period.tv_sec = 0;
+	param_ex->sched_edf_period.tv_nsec = period;
+}
+
+static int create_thread(pthread_t *tid, int policy,
+			 const struct sched_param_ex *param_ex,
+			 void *(*body)(void *), void *arg)
+{
+	pthread_attr_ex_t attr_ex;
+	int ret;
+
+	pthread_attr_init_ex(&attr_ex);
+	pthread_attr_setdetachstate_ex(&attr_ex, PTHREAD_CREATE_JOINABLE);
+	pthread_attr_setinheritsched_ex(&attr_ex, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy_ex(&attr_ex, policy);
+	pthread_attr_setschedparam_ex(&attr_ex, param_ex);
+	ret = pthread_create_ex(tid, &attr_ex, body, arg);
+	pthread_attr_destroy_ex(&attr_ex);
+	if (ret)
+		return ret;
+
+	sem_wait(&ready);
+
+	return 0;
+}
+
+static int check_params(void)
+{
+	struct sched_param_ex param_ex, fifo_param;
+	pthread_t a, b;
+	sem_t sem;
+	int policy, ret;
+
+	sem_init(&sem, 0, 0);
+	fifo_param.sched_priority = 1;
+	if (!__T(ret, create_thread(&a, SCHED_FIFO, &fifo_param,
+				    idle_body, &sem)))
+		return ret;
+	if (!__T(ret, create_thread(&b, SCHED_FIFO, &fifo_param,
+				    idle_body, &sem)))
+		return ret;
+
+	/* runtime > deadline */
+	set_edf_param(&param_ex, 2000000, 1000000, EDF_PERIOD_NS);
+	if (!__Tassert(pthread_setschedparam_ex(a, SCHED_EDF, &param_ex) == EINVAL))
+		return -EINVAL;
+
+	/* deadline > period */
+	set_edf_param(&param_ex, 1000000, 20000000, EDF_PERIOD_NS);
+	if (!__Tassert(pthread_setschedparam_ex(a, SCHED_EDF, &param_ex) == EINVAL))
+		return -EINVAL;
+
+	/* 60% then another 60% on CPU0: the latter must be denied. */
+	set_edf_param(&param_ex, 6000000, 8000000, EDF_PERIOD_NS);
+	if (!__T(ret, pthread_setschedparam_ex(a, SCHED_EDF, &param_ex)))
+		return ret;
+	if (!__Tassert(pthread_setschedparam_ex(b, SCHED_EDF, &param_ex) == EBUSY))
+		return -EINVAL;
+
+	/* Shrinking b's reservation so that it fits must succeed. */
+	set_edf_param(&param_ex, 3000000, 0, EDF_PERIOD_NS);
+	if (!__T(ret, pthread_setschedparam_ex(b, SCHED_EDF, &param_ex)))
+		return ret;
+
+	/* The deadline should default to the period. */
+	if (!__T(ret, pthread_getschedparam_ex(b, &policy, &param_ex)))
+		return ret;
+	if (!__Tassert(policy == SCHED_EDF))
+		return -EINVAL;
+	if (!__Tassert(param_ex.sched_edf_runtime.tv_nsec == 3000000 &&
+		       param_ex.sched_edf_deadline.tv_nsec == EDF_PERIOD_NS &&
+		       param_ex.sched_edf_period.tv_nsec == EDF_PERIOD_NS))
+		return -EINVAL;
+
+	/* Releasing a's bandwidth must make room for b. */
+	if (!__T(ret, pthread_setschedparam_ex(a, SCHED_FIFO, &fifo_param)))
+		return ret;
+	set_edf_param(&param_ex, 6000000, 8000000, EDF_PERIOD_NS);
+	if (!__T(ret, pthread_setschedparam_ex(b, SCHED_EDF, &param_ex)))
+		return ret;
+
+	sem_post(&sem);
+	sem_post(&sem);
+	pthread_join(a, NULL);
+	pthread_join(b, NULL);
+	sem_destroy(&sem);
+
+	return 0;
+}
+
+static unsigned long run_crunch(int policy,
+				const struct sched_param_ex *param_ex)
+{
+	struct timespec req;
+	unsigned long count;
+	pthread_t tid;
+	int ret;
+
+	stop = 0;
+	ret = create_thread(&tid, policy, param_ex, crunch_body, &count);
+	if (ret)
+		error(1, ret, "pthread_create_ex(%s)",
+		      policy == SCHED_EDF ? "SCHED_EDF" : "SCHED_FIFO");
+
+	req.tv_sec = TEST_SECS;
+	req.tv_nsec = 0;
+	clock_nanosleep(CLOCK_MONOTONIC, 0, &req, NULL);
+	stop = 1;
+	pthread_join(tid, NULL);
+
+	return count;
+}
+
+static void calibrate(void)
+{
+	struct timespec start, end, delta;
+	const int crunch_loops = 10000;
+	unsigned long count = 0;
+	unsigned long long ns;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do_work(crunch_loops, &count);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	timespec_sub(&delta, &end, &start);
+	ns = delta.tv_sec * ONE_BILLION + delta.tv_nsec;
+	crunch_per_sec = (unsigned long long)((double)ONE_BILLION / (double)ns * crunch_loops);
+}
+
+static int run_sched_edf(struct smokey_test *t, int argc, char *const argv[])
+{
+	struct sched_param_ex param_ex;
+	pthread_t me = pthread_self();
+	unsigned long ref, count;
+	struct sched_param param;
+	int ret, budget = 0, policies;
+	cpu_set_t affinity;
+	double effective;
+
+	ret = cobalt_corectl(_CC_COBALT_GET_POLICIES, &policies, sizeof(policies));
+	if (ret || (policies & _CC_COBALT_SCHED_EDF) == 0)
+		return -ENOSYS;
+
+	CPU_ZERO(&affinity);
+	CPU_SET(0, &affinity);
+	ret = sched_setaffinity(0, sizeof(affinity), &affinity);
+	if (ret)
+		error(1, errno, "sched_setaffinity");
+
+	smokey_parse_args(t, argc, argv);
+	sem_init(&ready, 0, 0);
+
+	param.sched_priority = 50;
+	ret = pthread_setschedparam(me, SCHED_FIFO, &param);
+	if (ret) {
+		warning("pthread_setschedparam(SCHED_FIFO, 50) failed");
+		return -ret;
+	}
+
+	if (SMOKEY_ARG_ISSET(sched_edf, budget))
+		budget = SMOKEY_ARG_INT(sched_edf, budget);
+
+	if (budget <= 0 || budget > 90)
+		budget = 20;
+
+	ret = check_params();
+	if (ret)
+		return ret;
+
+	calibrate();
+	param_ex.sched_priority = 1;
+	run_crunch(SCHED_FIFO, &param_ex); /* Warming up, ignore result. */
+	ref = run_crunch(SCHED_FIFO, &param_ex);
+	smokey_trace("calibrating: %lu loops/sec", ref / TEST_SECS);
+
+	set_edf_param(&param_ex, EDF_PERIOD_NS / 100 * budget,
+		      EDF_PERIOD_NS, EDF_PERIOD_NS);
+	count = run_crunch(SCHED_EDF, &param_ex);
+	effective = (double)count * 100.0 / ref;
+	smokey_trace("budget=%d%%, effective=%.1f%%", budget, effective);
+
+	sem_destroy(&ready);
+
+	if (!smokey_on_vm && fabs(effective - (double)budget) > 1.5) {
+		smokey_warning("out of budget: %.1f%%",
+			       effective - (double)budget);
+		return -EPROTO;
+	}
+
+	return 0;
+}
@@ -0,0 +1,320 @@
+/*
+ * Timer queue scalability test.
+ *
+ * Released under the terms of GPLv2.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/timerfd.h>
+#include <boilerplate/time.h>
+#include <smokey/smokey.h>
+
+smokey_test_plugin(timer_scale,
+		   SMOKEY_ARGLIST(
+			   SMOKEY_INT(timers),
+			   SMOKEY_INT(duration),
+		   ),
+   "Check the core timer queue with many outstanding timers.\n"
+   "\tA set of timerfds is first armed with random deadlines, then\n"
+   "\tpolled to make sure each of them expires in time, no earlier.\n\n"
+   "\tThe worst-case wake up latency of a periodic SCHED_FIFO thread\n"
+   "\tis then measured with no other timer, then with all timerfds\n"
+   "\tarmed and continuously re-armed or cancelled before they\n"
+   "\telapse (watchdog pattern). Comparing the results obtained with\n"
+   "\tkernels built with different timer indexing methods\n"
+   "\t(CONFIG_XENO_OPT_TIMER_*) shows their cost in the tick handler."
+);
+
+#ifndef TFD_NONBLOCK
+#define TFD_NONBLOCK O_NONBLOCK
+#endif
+
+#define DEFAULT_TIMERS		1000
+#define DEFAULT_DURATION	2	/* s */
+#define SAMPLE_PERIOD		1000000	/* 1 ms */
+#define CHECK_MARGIN		2000000	/* 2 ms */
+
+static int nrtimers;
+
+static int *fds;
+
+static long long *deadlines;
+
+static volatile int churning;
+
+static inline long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * rand_r() does not return more than RAND_MAX, combine two draws to
+ * cover ranges of several seconds.
+ */
+static inline long long rand_ns(unsigned int *seed, long long range)
+{
+	unsigned long long r;
+
+	r = (unsigned long long)rand_r(seed) * (RAND_MAX + 1ULL);
+	r += rand_r(seed);
+
+	return r % range;
+}
+
+static inline void ns_to_ts(long long ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000LL;
+	ts->tv_nsec = ns % 1000000000LL;
+}
+
+static int arm_timer(int n, long long date)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	ns_to_ts(date, &its.it_value);
+	deadlines[n] = date;
+
+	return smokey_check_errno(timerfd_settime(fds[n], TFD_TIMER_ABSTIME,
+						  &its, NULL));
+}
+
+static int disarm_timer(int n)
+{
+	struct itimerspec its;
+
+	memset(&its, 0, sizeof(its));
+	deadlines[n] = 0;
+
+	return smokey_check_errno(timerfd_settime(fds[n], 0, &its, NULL));
+}
+
+static int check_expiries(long long date)
+{
+	unsigned long long ticks;
+	int n, ret, expired = 0;
+
+	for (n = 0; n < nrtimers; n++) {
+		ret = read(fds[n], &ticks, sizeof(ticks));
+		if (ret == sizeof(ticks)) {
+			expired++;
+			if (!smokey_assert(deadlines[n] <= date)) {
+				smokey_warning("timer #%d fired %Ld ns early",
+					       n, deadlines[n] - date);
+				return -EINVAL;
+			}
+			deadlines[n] = 0;
+			continue;
+		}
+		if (errno != EAGAIN)
+			return smokey_check_errno(ret);
+		if (deadlines[n] && deadlines[n] < date - CHECK_MARGIN) {
+			smokey_warning("timer #%d late by %Ld ns",
+				       n, date - deadlines[n]);
+			return -EINVAL;
+		}
+	}
+
+	smokey_trace("%d timers expired at checkpoint", expired);
+
+	return 0;
+}
+
+static int check_ordering(unsigned int *seed)
+{
+	long long start;
+	struct timespec ts;
+	int n, ret;
+
+	start = now_ns();
+
+	/* Random deadlines within [10 ms, 110 ms) from now. */
+	for (n = 0; n < nrtimers; n++) {
+		ret = arm_timer(n, start + 10000000LL +
+				rand_ns(seed, 100000000LL));
+		if (ret)
+			return ret;
+	}
+
+	/* Cancel every other timer, like watchdogs would be. */
+	for (n = 0; n < nrtimers; n += 2) {
+		ret = disarm_timer(n);
+		if (ret)
+			return ret;
+	}
+
+	ns_to_ts(start + 60000000LL, &ts);
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	ret = check_expiries(now_ns());
+	if (ret)
+		return ret;
+
+	ns_to_ts(start + 120000000LL, &ts);
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+	ret = check_expiries(now_ns());
+	if (ret)
+		return ret;
+
+	for (n = 0; n < nrtimers; n++) {
+		if (!smokey_assert(deadlines[n] == 0)) {
+			smokey_warning("timer #%d never fired", n);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void *churn_thread(void *arg)
+{
+	unsigned int seed = (unsigned int)now_ns();
+	struct timespec ts;
+	long long date;
+	int n;
+
+	ts.tv_sec = 0;
+	ts.tv_nsec = 100000;
+
+	/*
+	 * Keep re-arming timers 1 to 5 s ahead, or cancelling them,
+	 * so that none of them ever elapses.
+	 */
+	while (churning) {
+		for (n = 0; n < 32; n++) {
+			date = now_ns() + 1000000000LL +
+				rand_ns(&seed, 4000000000LL);
+			if (rand_r(&seed) & 1)
+				arm_timer(rand_r(&seed) % nrtimers, date);
+			else
+				disarm_timer(rand_r(&seed) % nrtimers);
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, 0, &ts, NULL);
+	}
+
+	return NULL;
+}
+
+static int measure_latency(int duration, long long *maxlat_r,
+			   long long *avglat_r)
+{
+	long long next, lat, maxlat = 0, sum = 0;
+	struct timespec ts;
+	int n, samples;
+
+	samples = duration * (1000000000 / SAMPLE_PERIOD);
+	next = now_ns() + SAMPLE_PERIOD;
+
+	for (n = 0; n < samples; n++) {
+		ns_to_ts(next, &ts);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+		lat = now_ns() - next;
+		if (lat > maxlat)
+			maxlat = lat;
+		sum += lat;
+		next += SAMPLE_PERIOD;
+	}
+
+	*maxlat_r = maxlat;
+	*avglat_r = sum / samples;
+
+	return 0;
+}
+
+static int run_timer_scale(struct smokey_test *t, int argc, char *const argv[])
+{
+	long long maxlat0, avglat0, maxlat, avglat, date;
+	struct sched_param param;
+	pthread_attr_t attr;
+	int n, ret, duration;
+	pthread_t churner;
+	unsigned int seed;
+
+	smokey_parse_args(t, argc, argv);
+
+	nrtimers = DEFAULT_TIMERS;
+	if (SMOKEY_ARG_ISSET(timer_scale, timers) &&
+	    SMOKEY_ARG_INT(timer_scale, timers) > 0)
+		nrtimers = SMOKEY_ARG_INT(timer_scale, timers);
+
+	duration = DEFAULT_DURATION;
+	if (SMOKEY_ARG_ISSET(timer_scale, duration) &&
+	    SMOKEY_ARG_INT(timer_scale, duration) > 0)
+		duration = SMOKEY_ARG_INT(timer_scale, duration);
+
+	seed = (unsigned int)now_ns();
+
+	fds = calloc(nrtimers, sizeof(*fds));
+	deadlines = calloc(nrtimers, sizeof(*deadlines));
+	if (fds == NULL || deadlines == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < nrtimers; n++) {
+		fds[n] = smokey_check_errno(timerfd_create(CLOCK_MONOTONIC,
+							   TFD_NONBLOCK));
+		if (fds[n] < 0) {
+			ret = fds[n];
+			goto out;
+		}
+	}
+
+	param.sched_priority = 99;
+	ret = smokey_check_status(pthread_setschedparam(pthread_self(),
+							SCHED_FIFO, &param));
+	if (ret)
+		goto out;
+
+	ret = check_ordering(&seed);
+	if (ret)
+		goto out;
+
+	measure_latency(duration, &maxlat0, &avglat0);
+	smokey_trace("no timer: avg latency %Ld ns, max %Ld ns",
+		     avglat0, maxlat0);
+
+	for (n = 0; n < nrtimers; n++) {
+		date = now_ns() + 1000000000LL + rand_ns(&seed, 4000000000LL);
+		ret = arm_timer(n, date);
+		if (ret)
+			goto out;
+	}
+
+	churning = 1;
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = 50;
+	pthread_attr_setschedparam(&attr, &param);
+	ret = smokey_check_status(pthread_create(&churner, &attr,
+						 churn_thread, NULL));
+	pthread_attr_destroy(&attr);
+	if (ret)
+		goto out;
+
+	measure_latency(duration, &maxlat, &avglat);
+	churning = 0;
+	pthread_join(churner, NULL);
+
+	smokey_trace("%d timers: avg latency %Ld ns, max %Ld ns",
+		     nrtimers, avglat, maxlat);
+	smokey_trace("worst-case overhead of %d outstanding timers: %Ld ns",
+		     nrtimers, maxlat - maxlat0);
+out:
+	for (n = 0; n < nrtimers && fds[n] > 0; n++)
+		close(fds[n]);
+
+	free(deadlines);
+	free(fds);
+
+	return ret;
+}
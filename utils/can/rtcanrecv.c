@@ -5,6 +5,7 @@
 #include <time.h>
 #include <errno.h>
 #include <getopt.h>
+#include <string.h>
 
 #include <alchemy/task.h>
 #include <boilerplate/ancillaries.h>
@@ -23,6 +24,11 @@ static void print_usage(char *prg)
 	    " -R, --timestamp-rel   with relative timestamp\n"
 	    " -v, --verbose         be verbose\n"
 	    " -p, --print=MODULO    print every MODULO message\n"
+	    " -B, --bench=COUNT     benchmark mode: install COUNT extra\n"
+	    "                       non-matching filters and report the\n"
+	    "                       delay from frame dispatch to reception\n"
+	    " -M, --bench-masked    use masked filters instead of exact ones\n"
+	    "                       for benchmark padding\n"
 	    " -h, --help            this help\n",
 	    prg);
 }
@@ -32,6 +38,13 @@ extern int optind, opterr, optopt;
 
 static int s = -1, verbose = 0, print = 1;
 static nanosecs_rel_t timeout = 0, with_timestamp = 0, timestamp_rel = 0;
+static int bench_filters = -1, bench_masked = 0;
+
+static struct {
+    unsigned long count;
+    nanosecs_rel_t min, max;
+    long long sum;
+} bench_stats;
 
 RT_TASK rt_task_desc;
 
@@ -39,7 +52,7 @@ RT_TASK rt_task_desc;
 #define MAX_FILTER 16
 
 struct sockaddr_can recv_addr;
-struct can_filter recv_filter[MAX_FILTER];
+struct can_filter *recv_filter;
 static int filter_count = 0;
 
 static int add_filter(u_int32_t id, u_int32_t mask)
@@ -53,6 +66,59 @@ static int add_filter(u_int32_t id, u_int32_t mask)
     return 0;
 }
 
+/*
+ * Padding filters for the benchmark mode, on extended IDs counting
+ * down from the top of the range, which regular traffic is unlikely
+ * to use. Masked filters ignore the lowest ID bit, which keeps them
+ * out of the driver's exact-ID index.
+ */
+static void add_bench_filters(void)
+{
+    u_int32_t mask = CAN_EFF_FLAG | CAN_EFF_MASK;
+    int i;
+
+    if (bench_masked)
+	mask &= ~1U;
+
+    for (i = 0; i < bench_filters; i++) {
+	recv_filter[filter_count].can_id =
+		CAN_EFF_FLAG | ((CAN_EFF_MASK - 2 * i) & mask);
+	recv_filter[filter_count].can_mask = mask;
+	filter_count++;
+    }
+
+    printf("Benchmark: %d %s padding filters\n", bench_filters,
+	   bench_masked ? "masked" : "exact");
+}
+
+static void bench_account(nanosecs_abs_t timestamp)
+{
+    struct timespec now;
+    nanosecs_rel_t delay;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    delay = (nanosecs_abs_t)now.tv_sec * 1000000000 + now.tv_nsec - timestamp;
+
+    if (bench_stats.count == 0 || delay < bench_stats.min)
+	bench_stats.min = delay;
+    if (delay > bench_stats.max)
+	bench_stats.max = delay;
+    bench_stats.sum += delay;
+    bench_stats.count++;
+}
+
+static void bench_report(void)
+{
+    if (bench_stats.count == 0)
+	return;
+
+    printf("filters %d, frames %lu: delay min %lld ns, avg %lld ns, "
+	   "max %lld ns\n", filter_count, bench_stats.count,
+	   (long long)bench_stats.min,
+	   bench_stats.sum / (long long)bench_stats.count,
+	   (long long)bench_stats.max);
+}
+
 static void cleanup(void)
 {
     int ret;
@@ -60,6 +126,9 @@ static void cleanup(void)
     if (verbose)
 	printf("Cleaning up...\n");
 
+    if (bench_filters >= 0)
+	bench_report();
+
     if (s >= 0) {
 	ret = close(s);
 	s = -1;
@@ -121,6 +190,14 @@ static void rt_task(void)
 	    break;
 	}
 
+	if (bench_filters >= 0) {
+	    if (msg.msg_controllen)
+		bench_account(timestamp);
+	    if (print && (++count % print) == 0)
+		bench_report();
+	    continue;
+	}
+
 	if (print && (count % print) == 0) {
 	    printf("#%d: (%d) ", count, addr.can_ifindex);
 	    if (with_timestamp && msg.msg_controllen) {
@@ -173,13 +250,21 @@ int main(int argc, char **argv)
 	{ "timeout", required_argument, 0, 't'},
 	{ "timestamp", no_argument, 0, 'T'},
 	{ "timestamp-rel", no_argument, 0, 'R'},
+	{ "bench", required_argument, 0, 'B'},
+	{ "bench-masked", no_argument, 0, 'M'},
 	{ 0, 0, 0, 0},
     };
 
     signal(SIGTERM, cleanup_and_exit);
     signal(SIGINT, cleanup_and_exit);
 
-    while ((opt = getopt_long(argc, argv, "hve:f:t:p:RT",
+    recv_filter = malloc(MAX_FILTER * sizeof(*recv_filter));
+    if (recv_filter == NULL) {
+	fprintf(stderr, "malloc: %s\n", strerror(errno));
+	exit(1);
+    }
+
+    while ((opt = getopt_long(argc, argv, "hve:f:t:p:RTB:M",
 			      long_options, NULL)) != -1) {
 	switch (opt) {
 	case 'h':
@@ -227,6 +312,15 @@ int main(int argc, char **argv)
 	    with_timestamp = 1;
 	    break;
 
+	case 'B':
+	    bench_filters = strtoul(optarg, NULL, 0);
+	    with_timestamp = 1;
+	    break;
+
+	case 'M':
+	    bench_masked = 1;
+	    break;
+
 	default:
 	    fprintf(stderr, "Unknown option %c\n", opt);
 	    break;
@@ -271,9 +365,24 @@ int main(int argc, char **argv)
 	    printf("Using err_mask=%#x\n", err_mask);
     }
 
+    if (bench_filters > 0) {
+	/* Padding alone must not filter out the benchmark traffic */
+	if (filter_count == 0)
+	    add_filter(0, 0);
+	recv_filter = realloc(recv_filter, (filter_count + bench_filters) *
+			      sizeof(*recv_filter));
+	if (recv_filter == NULL) {
+	    fprintf(stderr, "realloc: %s\n", strerror(errno));
+	    goto failure;
+	}
+	add_bench_filters();
+	if (print == 1)
+	    print = 1000;
+    }
+
     if (filter_count) {
 	ret = setsockopt(s, SOL_CAN_RAW, CAN_RAW_FILTER,
-				&recv_filter, filter_count *
+				recv_filter, filter_count *
 				sizeof(struct can_filter));
 	if (ret < 0) {
 	    fprintf(stderr, "setsockopt: %s\n", strerror(errno));